@@ -0,0 +1,92 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <arena_memalloc.h>
+#include <block.h>
+#include <memalloc.h>
+#include <queries_state.h>
+}
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/* Builds the same tree with malloc and with an arena, timing the insertions
+ * and the teardown (free_rec_block against k2tree_arena_destroy) */
+static void run(const std::vector<pair2dl_t> &points, uint32_t treedepth,
+                bool use_arena) {
+  struct k2tree_arena *arena = use_arena ? k2tree_arena_create() : nullptr;
+  struct k2tree_allocator allocator;
+  const struct k2tree_allocator *previous = nullptr;
+  if (use_arena) {
+    allocator = k2tree_arena_allocator(arena);
+    previous = k2tree_bind_allocator(&allocator);
+  }
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 256, root);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (auto &p : points) {
+    int already_exists;
+    insert_point(root, p.col, p.row, &qs, &already_exists);
+  }
+  auto inserted = std::chrono::high_resolution_clock::now();
+  if (use_arena) {
+    k2tree_bind_allocator(previous);
+    k2tree_arena_destroy(arena);
+  } else {
+    free_rec_block(root);
+  }
+  auto freed = std::chrono::high_resolution_clock::now();
+  finish_queries_state(&qs);
+
+  std::cout << (use_arena ? "arena " : "malloc") << ": insertions "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   inserted - start)
+                   .count()
+            << " ms, teardown "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   freed - inserted)
+                   .count()
+            << " us" << std::endl;
+}
+
+int main(void) {
+  const uint32_t treedepth = 24;
+  const size_t points_count = 1 << 21;
+  std::mt19937_64 gen(123321);
+  std::uniform_int_distribution<uint64_t> dist(0, (1UL << treedepth) - 1);
+  std::vector<pair2dl_t> points(points_count);
+  for (auto &p : points) {
+    p.col = dist(gen);
+    p.row = dist(gen);
+  }
+  std::cout << points_count << " points, treedepth " << treedepth
+            << std::endl;
+  run(points, treedepth, false);
+  run(points, treedepth, true);
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <band_intersection.h>
+#include <k2node.h>
+#include <vectors.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/* Microseconds per query */
+static double time_queries(size_t queries_count,
+                           const std::function<void(size_t)> &query) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < queries_count; i++)
+    query(i);
+  auto stop = std::chrono::high_resolution_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop -
+                                                                      start)
+             .count() /
+         1000.0 / (double)queries_count;
+}
+
+/* Points in few rows (or columns, transposed) and columns taken from a range
+ * shared by all trees, so the bands are long and overlap */
+static struct k2node *band_tree(std::mt19937_64 &gen, size_t points_count,
+                                uint64_t crowded_side, uint64_t shared_side,
+                                bool transposed, struct k2qstate *st) {
+  std::uniform_int_distribution<uint64_t> crowded(0, crowded_side - 1);
+  std::uniform_int_distribution<uint64_t> shared(0, shared_side - 1);
+  std::vector<pair2dl_t> points(points_count);
+  for (auto &p : points) {
+    p.col = shared(gen);
+    p.row = crowded(gen);
+    if (transposed)
+      std::swap(p.col, p.row);
+  }
+  struct k2node *root = create_k2node();
+  uint64_t inserted;
+  k2node_insert_points_batch(root, points.data(), points.size(), st,
+                             &inserted);
+  return root;
+}
+
+static void band_coords(const struct vector_pair2dl_t &band, bool use_col,
+                        std::vector<uint64_t> &coords) {
+  coords.clear();
+  for (long i = 0; i < band.nof_items; i++)
+    coords.push_back(use_col ? band.data[i].col : band.data[i].row);
+  std::sort(coords.begin(), coords.end());
+}
+
+int main(void) {
+  const TREE_DEPTH_T treedepth = 22;
+  const TREE_DEPTH_T cut_depth = 8;
+  const size_t points_count = 1 << 20;
+  const size_t queries_count = 500;
+
+  std::mt19937_64 gen(1029);
+  struct k2qstate st[3];
+  for (auto &s : st)
+    init_k2qstate(&s, treedepth, 256, cut_depth);
+
+  std::cout << "Crowded side,Shared side,Common (avg),Materialize and "
+               "intersect (us),Leapfrog (us),Speedup"
+            << std::endl;
+  for (uint64_t shared_side : {1UL << 14, 1UL << 17, 1UL << 20}) {
+    const uint64_t crowded_side = 512;
+    struct k2node *a =
+        band_tree(gen, points_count, crowded_side, shared_side, false, &st[0]);
+    struct k2node *b =
+        band_tree(gen, points_count, crowded_side, shared_side, true, &st[1]);
+    /* the third relation is the selective one, with short rows */
+    struct k2node *c = band_tree(gen, points_count / 64, crowded_side,
+                                 shared_side, false, &st[2]);
+
+    std::uniform_int_distribution<uint64_t> crowded(0, crowded_side - 1);
+    std::vector<uint64_t> coords(3 * queries_count);
+    for (auto &coord : coords)
+      coord = crowded(gen);
+
+    struct vector_pair2dl_t band;
+    vector_pair2dl_t__init_vector(&band);
+    std::vector<uint64_t> first, second, common, tmp;
+    uint64_t materialized_total = 0;
+    double materialize_us = time_queries(queries_count, [&](size_t i) {
+      band.nof_items = 0;
+      k2node_report_row(a, coords[3 * i], &st[0], &band);
+      band_coords(band, true, first);
+      band.nof_items = 0;
+      k2node_report_column(b, coords[3 * i + 1], &st[1], &band);
+      band_coords(band, false, second);
+      tmp.clear();
+      std::set_intersection(first.begin(), first.end(), second.begin(),
+                            second.end(), std::back_inserter(tmp));
+      band.nof_items = 0;
+      k2node_report_row(c, coords[3 * i + 2], &st[2], &band);
+      band_coords(band, true, first);
+      common.clear();
+      std::set_intersection(tmp.begin(), tmp.end(), first.begin(),
+                            first.end(), std::back_inserter(common));
+      materialized_total += common.size();
+    });
+
+    uint64_t leapfrog_total = 0;
+    double leapfrog_us = time_queries(queries_count, [&](size_t i) {
+      struct k2node_band_spec specs[3] = {
+          {a, &st[0], REPORT_ROW, coords[3 * i]},
+          {b, &st[1], REPORT_COLUMN, coords[3 * i + 1]},
+          {c, &st[2], REPORT_ROW, coords[3 * i + 2]}};
+      struct k2node_lazy_handler_band_intersection_t lh;
+      k2node_band_intersection_lazy_init(&lh, specs, 3);
+      int has_next;
+      for (k2node_band_intersection_has_next(&lh, &has_next); has_next;
+           k2node_band_intersection_has_next(&lh, &has_next)) {
+        uint64_t result;
+        k2node_band_intersection_next(&lh, &result);
+        leapfrog_total++;
+      }
+      k2node_band_intersection_lazy_clean(&lh);
+    });
+
+    if (materialized_total != leapfrog_total) {
+      std::cerr << "results mismatch: " << materialized_total << " vs "
+                << leapfrog_total << std::endl;
+      return 1;
+    }
+    std::cout << crowded_side << "," << shared_side << ","
+              << (double)leapfrog_total / (double)queries_count << ","
+              << materialize_us << "," << leapfrog_us << ","
+              << materialize_us / leapfrog_us << std::endl;
+
+    vector_pair2dl_t__free_vector(&band);
+    free_rec_k2node(a, 0, cut_depth);
+    free_rec_k2node(b, 0, cut_depth);
+    free_rec_k2node(c, 0, cut_depth);
+  }
+
+  for (auto &s : st)
+    clean_k2qstate(&s);
+  return 0;
+}
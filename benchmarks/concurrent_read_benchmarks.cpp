@@ -0,0 +1,102 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <block.h>
+#include <morton_code.h>
+#include <queries_state.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+/* Membership queries on a single tree from an increasing amount of threads,
+ * each one with its own query_ctx */
+int main(void) {
+  const uint32_t treedepth = 22;
+  const size_t points_count = 1 << 20;
+  const size_t queries_per_thread = 1 << 20;
+
+  std::mt19937_64 gen(123321);
+  std::uniform_int_distribution<uint64_t> dist(0, (1UL << treedepth) - 1);
+  std::vector<pair2dl_t> points(points_count);
+  for (auto &p : points) {
+    p.col = dist(gen);
+    p.row = dist(gen);
+  }
+  sort_points_morton_order(points.data(), points.size());
+  struct block *root =
+      build_block_tree_from_sorted(points.data(), points.size(), treedepth, 256);
+
+  std::vector<pair2dl_t> queries(queries_per_thread);
+  for (auto &q : queries) {
+    q = points[gen() % points.size()];
+  }
+
+  unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << "tree with " << points_count << " points, treedepth "
+            << treedepth << ", " << max_threads << " hardware threads"
+            << std::endl;
+
+  for (unsigned threads_count = 1; threads_count <= max_threads;
+       threads_count *= 2) {
+    std::vector<uint64_t> found(threads_count, 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < threads_count; t++) {
+      threads.emplace_back([&, t]() {
+        struct query_ctx ctx;
+        init_query_ctx(&ctx, treedepth, root);
+        for (auto &q : queries) {
+          int result;
+          has_point(root, q.col, q.row, &ctx.qs, &result);
+          found[t] += result;
+        }
+        finish_query_ctx(&ctx);
+      });
+    }
+    for (auto &th : threads) {
+      th.join();
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+    double total_queries = (double)threads_count * queries_per_thread;
+    std::cout << threads_count << " threads: " << ms << " ms, "
+              << (uint64_t)(total_queries / std::max<int64_t>(ms, 1) * 1000)
+              << " queries/s" << std::endl;
+    for (auto f : found) {
+      if (f != queries_per_thread) {
+        std::cout << "Missing points!" << std::endl;
+      }
+    }
+  }
+
+  free_rec_block(root);
+  return 0;
+}
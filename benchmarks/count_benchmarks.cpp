@@ -0,0 +1,134 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <k2node.h>
+#include <vectors.h>
+}
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/* Runs query once per coordinate, returning the nanoseconds per call */
+static double time_queries(const std::vector<uint64_t> &coords,
+                           const std::function<void(uint64_t)> &query) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (auto coord : coords)
+    query(coord);
+  auto stop = std::chrono::high_resolution_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop -
+                                                                      start)
+             .count() /
+         (double)coords.size();
+}
+
+static void print_row(const char *name, double report_ns, double count_ns) {
+  std::cout << name << "," << report_ns << "," << count_ns << ","
+            << report_ns / count_ns << std::endl;
+}
+
+int main(void) {
+  const TREE_DEPTH_T treedepth = 20;
+  const TREE_DEPTH_T cut_depth = 8;
+  const uint64_t side = 1UL << treedepth;
+  const size_t points_count = 1 << 20;
+
+  /* points gathered in a band of 4096 rows, so row queries find many */
+  std::mt19937_64 gen(2468);
+  std::uniform_int_distribution<uint64_t> col_dist(0, side - 1);
+  std::uniform_int_distribution<uint64_t> row_dist(0, 4095);
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 256, cut_depth);
+  struct k2node *root = create_k2node();
+  for (size_t i = 0; i < points_count; i++) {
+    int already_exists;
+    k2node_insert_point(root, col_dist(gen), row_dist(gen), &st,
+                        &already_exists);
+  }
+
+  std::vector<uint64_t> rows(2000), cols(2000), ranges(200), full(5);
+  for (auto &r : rows)
+    r = row_dist(gen);
+  for (auto &c : cols)
+    c = col_dist(gen);
+  for (auto &r : ranges)
+    r = col_dist(gen) % (side - 65536);
+
+  uint64_t sink = 0;
+  struct vector_pair2dl_t result;
+  vector_pair2dl_t__init_vector(&result);
+  auto reporting = [&](const std::function<void()> &report) {
+    result.nof_items = 0;
+    report();
+    sink += (uint64_t)result.nof_items;
+  };
+
+  std::cout << "Query,Report (ns),Count (ns),Speedup" << std::endl;
+  print_row(
+      "full scan", time_queries(full, [&](uint64_t) {
+        reporting([&] { k2node_naive_scan_points(root, &st, &result); });
+      }),
+      time_queries(full, [&](uint64_t) {
+        uint64_t count;
+        k2node_count_points(root, &st, &count);
+        sink += count;
+      }));
+  print_row(
+      "row", time_queries(rows, [&](uint64_t row) {
+        reporting([&] { k2node_report_row(root, row, &st, &result); });
+      }),
+      time_queries(rows, [&](uint64_t row) {
+        uint64_t count;
+        k2node_count_row(root, row, &st, &count);
+        sink += count;
+      }));
+  print_row(
+      "column", time_queries(cols, [&](uint64_t col) {
+        reporting([&] { k2node_report_column(root, col, &st, &result); });
+      }),
+      time_queries(cols, [&](uint64_t col) {
+        uint64_t count;
+        k2node_count_column(root, col, &st, &count);
+        sink += count;
+      }));
+  print_row(
+      "range 65536 x 2048", time_queries(ranges, [&](uint64_t lo) {
+        reporting([&] {
+          k2node_report_range(root, lo, lo + 65535, 1024, 3071, &st, &result);
+        });
+      }),
+      time_queries(ranges, [&](uint64_t lo) {
+        uint64_t count;
+        k2node_count_range(root, lo, lo + 65535, 1024, 3071, &st, &count);
+        sink += count;
+      }));
+  std::cerr << "checksum " << sink << std::endl;
+
+  vector_pair2dl_t__free_vector(&result);
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+  return 0;
+}
@@ -0,0 +1,214 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <block.h>
+#include <morton_code.h>
+#include <queries_state.h>
+}
+
+#include "fisher_yates.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+void batch_delete_vs_loop_benchmark(uint32_t treedepth, uint32_t points_count,
+                                    uint32_t deleted_count);
+void deferred_compaction_latency_benchmark(uint32_t treedepth,
+                                           uint32_t points_count,
+                                           uint32_t deleted_count);
+
+int main(void) {
+  batch_delete_vs_loop_benchmark(16, 1 << 16, 1 << 12);
+  batch_delete_vs_loop_benchmark(16, 1 << 16, 1 << 16);
+  batch_delete_vs_loop_benchmark(20, 1 << 20, 1 << 16);
+  batch_delete_vs_loop_benchmark(20, 1 << 20, 1 << 20);
+  deferred_compaction_latency_benchmark(20, 1 << 20, 1 << 18);
+  return 0;
+}
+
+static struct block *build_tree(const std::vector<pair2dl_t> &points,
+                                uint32_t treedepth) {
+  std::vector<pair2dl_t> sorted_points(points);
+  sort_points_morton_order(sorted_points.data(), sorted_points.size());
+  return build_block_tree_from_sorted(sorted_points.data(),
+                                      sorted_points.size(), treedepth,
+                                      MAX_NODES_IN_BLOCK);
+}
+
+void batch_delete_vs_loop_benchmark(uint32_t treedepth, uint32_t points_count,
+                                    uint32_t deleted_count) {
+  uint64_t side = 1 << treedepth;
+  auto random_seq_1 = fisher_yates(points_count, side);
+  auto random_seq_2 = fisher_yates(points_count, side);
+
+  /* fisher_yates gives values in [1, side] */
+  std::vector<pair2dl_t> points(points_count);
+  for (size_t i = 0; i < points_count; i++) {
+    points[i].col = random_seq_1[i] - 1;
+    points[i].row = random_seq_2[i] - 1;
+  }
+  std::vector<pair2dl_t> deleted(points.begin(),
+                                 points.begin() + deleted_count);
+
+  std::cout << "-------------------\n";
+  std::cout << "Started batch_delete_vs_loop_benchmark with treedepth = "
+            << treedepth << ", points_count = " << points_count
+            << " and deleted_count = " << deleted_count << std::endl;
+
+  struct block *loop_root = build_tree(points, treedepth);
+  struct queries_state loop_qs;
+  init_queries_state(&loop_qs, treedepth, MAX_NODES_IN_BLOCK, loop_root);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  int already_not_exists;
+  for (auto &point : deleted) {
+    delete_point(loop_root, point.col, point.row, &loop_qs,
+                 &already_not_exists);
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto loop_duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  struct block *batch_root = build_tree(points, treedepth);
+  struct queries_state batch_qs;
+  init_queries_state(&batch_qs, treedepth, MAX_NODES_IN_BLOCK, batch_root);
+
+  start = std::chrono::high_resolution_clock::now();
+  uint64_t batch_deleted_count;
+  delete_points_batch(batch_root, deleted.data(), deleted.size(), &batch_qs,
+                      &batch_deleted_count);
+  stop = std::chrono::high_resolution_clock::now();
+  auto batch_duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  std::cout << "\n\nPoint at a time deletion\n";
+  std::cout << "Total Time in Microseconds: " << loop_duration.count()
+            << std::endl;
+  std::cout << "\n\nBatch deletion (sorting included)\n";
+  std::cout << "Total Time in Microseconds: " << batch_duration.count()
+            << std::endl;
+  std::cout << "Deleted points: " << batch_deleted_count << std::endl;
+
+  for (size_t i = deleted_count; i < points_count; i++) {
+    int has_point_result;
+    has_point(batch_root, points[i].col, points[i].row, &batch_qs,
+              &has_point_result);
+    if (!has_point_result) {
+      std::cerr << "Point " << i << " not found (" << points[i].col << ", "
+                << points[i].row << ")" << std::endl;
+      exit(1);
+    }
+  }
+
+  std::cout << "-------------------\n\n\n" << std::endl;
+
+  free_rec_block(loop_root);
+  finish_queries_state(&loop_qs);
+  free_rec_block(batch_root);
+  finish_queries_state(&batch_qs);
+}
+
+static void print_latencies(std::vector<uint64_t> &latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  size_t last = latencies.size() - 1;
+  std::cout << "p50: " << latencies[last / 2]
+            << " ns, p99: " << latencies[last * 99 / 100]
+            << " ns, p99.9: " << latencies[last * 999 / 1000]
+            << " ns, max: " << latencies[last] << " ns" << std::endl;
+}
+
+static std::vector<uint64_t>
+timed_deletions(struct block *root, struct queries_state *qs,
+                const std::vector<pair2dl_t> &deleted) {
+  std::vector<uint64_t> latencies;
+  latencies.reserve(deleted.size());
+  int already_not_exists;
+  for (auto &point : deleted) {
+    auto start = std::chrono::high_resolution_clock::now();
+    delete_point(root, point.col, point.row, qs, &already_not_exists);
+    auto stop = std::chrono::high_resolution_clock::now();
+    latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start)
+            .count());
+  }
+  return latencies;
+}
+
+void deferred_compaction_latency_benchmark(uint32_t treedepth,
+                                           uint32_t points_count,
+                                           uint32_t deleted_count) {
+  uint64_t side = 1 << treedepth;
+  auto random_seq_1 = fisher_yates(points_count, side);
+  auto random_seq_2 = fisher_yates(points_count, side);
+
+  std::vector<pair2dl_t> points(points_count);
+  for (size_t i = 0; i < points_count; i++) {
+    points[i].col = random_seq_1[i] - 1;
+    points[i].row = random_seq_2[i] - 1;
+  }
+  std::vector<pair2dl_t> deleted(points.begin(),
+                                 points.begin() + deleted_count);
+
+  std::cout << "-------------------\n";
+  std::cout << "Started deferred_compaction_latency_benchmark with treedepth = "
+            << treedepth << ", points_count = " << points_count
+            << " and deleted_count = " << deleted_count << std::endl;
+
+  struct block *immediate_root = build_tree(points, treedepth);
+  struct queries_state immediate_qs;
+  init_queries_state(&immediate_qs, treedepth, MAX_NODES_IN_BLOCK,
+                     immediate_root);
+  auto immediate_latencies =
+      timed_deletions(immediate_root, &immediate_qs, deleted);
+
+  struct block *deferred_root = build_tree(points, treedepth);
+  struct queries_state deferred_qs;
+  init_queries_state(&deferred_qs, treedepth, MAX_NODES_IN_BLOCK,
+                     deferred_root);
+  deferred_qs.deferred_compaction = TRUE;
+  auto deferred_latencies =
+      timed_deletions(deferred_root, &deferred_qs, deleted);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  uint64_t pending_count;
+  compact_block_tree(deferred_root, &deferred_qs, 0, &pending_count);
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto compaction_duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  std::cout << "\n\nImmediate compaction\n";
+  print_latencies(immediate_latencies);
+  std::cout << "\n\nDeferred compaction\n";
+  print_latencies(deferred_latencies);
+  std::cout << "compact_block_tree afterwards: "
+            << compaction_duration.count() << " microseconds" << std::endl;
+
+  std::cout << "-------------------\n\n\n" << std::endl;
+
+  free_rec_block(immediate_root);
+  finish_queries_state(&immediate_qs);
+  free_rec_block(deferred_root);
+  finish_queries_state(&deferred_qs);
+}
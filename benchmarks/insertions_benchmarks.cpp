@@ -23,6 +23,7 @@ SOFTWARE.
 */
 extern "C" {
 #include <block.h>
+#include <morton_code.h>
 #include <queries_state.h>
 }
 
@@ -38,6 +39,7 @@ std::mt19937 rng(123321);
 
 void random_benchmark_by_depth(uint32_t treedepth, uint32_t points_count);
 void random_benchmark_by_depth_dense(uint32_t treedepth, uint32_t points_count);
+void batch_vs_loop_benchmark(uint32_t treedepth, uint32_t points_count);
 
 int main(void) {
 
@@ -48,6 +50,10 @@ int main(void) {
   random_benchmark_by_depth(28, 1 << 20);
   random_benchmark_by_depth(30, 1 << 20);
 
+  batch_vs_loop_benchmark(16, 1 << 16);
+  batch_vs_loop_benchmark(20, 1 << 20);
+  batch_vs_loop_benchmark(30, 1 << 20);
+
   return 0;
 }
 
@@ -96,9 +102,12 @@ void random_benchmark_by_depth(uint32_t treedepth, uint32_t points_count) {
             << qs.dstats.time_on_frontier_check / points_count
             << " microseconds" << std::endl;
   std::cout << "Split count: " << qs.dstats.split_count << std::endl;
+  std::cout << "Time spent on splits in total " << qs.dstats.time_on_split
+            << " microseconds" << std::endl;
   qs.dstats.time_on_sequential_scan = 0;
   qs.dstats.time_on_frontier_check = 0;
   qs.dstats.split_count = 0;
+  qs.dstats.time_on_split = 0;
 #endif
 
   start = std::chrono::high_resolution_clock::now();
@@ -136,9 +145,12 @@ void random_benchmark_by_depth(uint32_t treedepth, uint32_t points_count) {
             << qs.dstats.time_on_frontier_check / points_count
             << " microseconds" << std::endl;
   std::cout << "Split count: " << qs.dstats.split_count << std::endl;
+  std::cout << "Time spent on splits in total " << qs.dstats.time_on_split
+            << " microseconds" << std::endl;
   qs.dstats.time_on_sequential_scan = 0;
   qs.dstats.time_on_frontier_check = 0;
   qs.dstats.split_count = 0;
+  qs.dstats.time_on_split = 0;
 #endif
 
   std::cout << "-------------------\n\n\n" << std::endl;
@@ -196,9 +208,12 @@ void random_benchmark_by_depth_dense(uint32_t treedepth,
             << qs.dstats.time_on_frontier_check / points_count
             << " microseconds" << std::endl;
   std::cout << "Split count: " << qs.dstats.split_count << std::endl;
+  std::cout << "Time spent on splits in total " << qs.dstats.time_on_split
+            << " microseconds" << std::endl;
   qs.dstats.time_on_sequential_scan = 0;
   qs.dstats.time_on_frontier_check = 0;
   qs.dstats.split_count = 0;
+  qs.dstats.time_on_split = 0;
 #endif
 
   start = std::chrono::high_resolution_clock::now();
@@ -238,13 +253,105 @@ void random_benchmark_by_depth_dense(uint32_t treedepth,
             << qs.dstats.time_on_frontier_check / points_count
             << " microseconds" << std::endl;
   std::cout << "Split count: " << qs.dstats.split_count << std::endl;
+  std::cout << "Time spent on splits in total " << qs.dstats.time_on_split
+            << " microseconds" << std::endl;
   qs.dstats.time_on_sequential_scan = 0;
   qs.dstats.time_on_frontier_check = 0;
   qs.dstats.split_count = 0;
+  qs.dstats.time_on_split = 0;
 #endif
 
   std::cout << "-------------------\n\n\n" << std::endl;
 
   free_rec_block(root_block);
   finish_queries_state(&qs);
-}
\ No newline at end of file
+}
+void batch_vs_loop_benchmark(uint32_t treedepth, uint32_t points_count) {
+  uint64_t side = 1 << treedepth;
+  auto random_seq_1 = fisher_yates(points_count, side);
+  auto random_seq_2 = fisher_yates(points_count, side);
+
+  /* fisher_yates gives values in [1, side] */
+  std::vector<pair2dl_t> points(points_count);
+  for (size_t i = 0; i < points_count; i++) {
+    points[i].col = random_seq_1[i] - 1;
+    points[i].row = random_seq_2[i] - 1;
+  }
+
+  std::cout << "-------------------\n";
+  std::cout << "Started batch_vs_loop_benchmark with treedepth = " << treedepth
+            << " and points_count = " << points_count << std::endl;
+
+  struct block *loop_root = create_block();
+  struct queries_state loop_qs;
+  init_queries_state(&loop_qs, treedepth, MAX_NODES_IN_BLOCK, loop_root);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  int point_exists;
+  for (size_t i = 0; i < points_count; i++) {
+    insert_point(loop_root, points[i].col, points[i].row, &loop_qs,
+                 &point_exists);
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto loop_duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  struct block *batch_root = create_block();
+  struct queries_state batch_qs;
+  init_queries_state(&batch_qs, treedepth, MAX_NODES_IN_BLOCK, batch_root);
+
+  start = std::chrono::high_resolution_clock::now();
+  uint64_t inserted_count;
+  insert_points_batch(batch_root, points.data(), points_count, &batch_qs,
+                      &inserted_count);
+  stop = std::chrono::high_resolution_clock::now();
+  auto batch_duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  start = std::chrono::high_resolution_clock::now();
+  std::vector<pair2dl_t> sorted_points(points);
+  sort_points_morton_order(sorted_points.data(), points_count);
+  struct block *bulk_root = build_block_tree_from_sorted(
+      sorted_points.data(), points_count, treedepth, MAX_NODES_IN_BLOCK);
+  stop = std::chrono::high_resolution_clock::now();
+  auto bulk_duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  std::cout << "\n\nPoint at a time insertion\n";
+  std::cout << "Total Time in Microseconds: " << loop_duration.count()
+            << std::endl;
+  std::cout << "\n\nBatch insertion (sorting included)\n";
+  std::cout << "Total Time in Microseconds: " << batch_duration.count()
+            << std::endl;
+  std::cout << "Inserted points: " << inserted_count << std::endl;
+  std::cout << "\n\nBulk load from scratch (sorting included)\n";
+  std::cout << "Total Time in Microseconds: " << bulk_duration.count()
+            << std::endl;
+#ifdef DEBUG_STATS
+  std::cout << "\n\nSplits (point at a time / batch)\n";
+  std::cout << "Split count: " << loop_qs.dstats.split_count << " / "
+            << batch_qs.dstats.split_count << std::endl;
+  std::cout << "Time spent on splits in microseconds: "
+            << loop_qs.dstats.time_on_split << " / "
+            << batch_qs.dstats.time_on_split << std::endl;
+#endif
+
+  for (size_t i = 0; i < points_count; i++) {
+    int has_point_result;
+    has_point(batch_root, points[i].col, points[i].row, &batch_qs,
+              &has_point_result);
+    if (!has_point_result) {
+      std::cerr << "Point " << i << " not found (" << points[i].col << ", "
+                << points[i].row << ")" << std::endl;
+      exit(1);
+    }
+  }
+
+  std::cout << "-------------------\n\n\n" << std::endl;
+
+  free_rec_block(loop_root);
+  finish_queries_state(&loop_qs);
+  free_rec_block(batch_root);
+  finish_queries_state(&batch_qs);
+  free_rec_block(bulk_root);
+}
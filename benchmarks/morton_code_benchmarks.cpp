@@ -0,0 +1,144 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <morton_code.h>
+}
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/* The previous representation, one byte per level, kept as a baseline */
+struct byte_morton_code {
+  std::vector<uint8_t> container;
+  uint32_t treedepth;
+};
+
+static void byte_coordinates_to_morton_code(uint64_t col, uint64_t row,
+                                            uint32_t treedepth,
+                                            byte_morton_code &result) {
+  uint64_t half_level =
+      treedepth == 64 ? 1UL << 63UL : (1UL << (uint64_t)(treedepth - 1));
+  uint32_t mc_position = 0;
+  while (half_level > 0) {
+    uint32_t quadrant;
+    if (col >= half_level && row >= half_level) {
+      quadrant = 3;
+    } else if (col >= half_level && row < half_level) {
+      quadrant = 2;
+    } else if (col < half_level && row >= half_level) {
+      quadrant = 1;
+    } else {
+      quadrant = 0;
+    }
+    col %= half_level;
+    row %= half_level;
+    half_level >>= 1UL;
+    result.container[mc_position++] = (uint8_t)quadrant;
+  }
+}
+
+static void byte_morton_code_to_coordinates(const byte_morton_code &mc,
+                                            pair2dl_t &result) {
+  uint64_t col = 0;
+  uint64_t row = 0;
+  for (uint64_t i = 0; i < mc.treedepth; i++) {
+    uint64_t current = mc.container[i];
+    uint64_t current_pow = mc.treedepth - 1 - i;
+    col += (current >> 1) << current_pow;
+    row += (current & 1) << current_pow;
+  }
+  result.col = col;
+  result.row = row;
+}
+
+static void morton_benchmark(uint32_t treedepth);
+
+int main(void) {
+  morton_benchmark(16);
+  morton_benchmark(32);
+  morton_benchmark(64);
+  return 0;
+}
+
+static void morton_benchmark(uint32_t treedepth) {
+  const size_t points_count = 1 << 20;
+  std::mt19937_64 gen(123321);
+  uint64_t mask = treedepth == 64 ? ~0UL : (1UL << treedepth) - 1;
+  std::vector<pair2dl_t> points(points_count);
+  for (auto &p : points) {
+    p.col = gen() & mask;
+    p.row = gen() & mask;
+  }
+
+  byte_morton_code byte_mc;
+  byte_mc.container.resize(treedepth);
+  byte_mc.treedepth = treedepth;
+  uint64_t checksum_bytes = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (auto &p : points) {
+    pair2dl_t back;
+    byte_coordinates_to_morton_code(p.col, p.row, treedepth, byte_mc);
+    for (uint32_t i = 0; i < treedepth; i++) {
+      checksum_bytes += byte_mc.container[i];
+    }
+    byte_morton_code_to_coordinates(byte_mc, back);
+    checksum_bytes += back.col ^ back.row;
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto bytes_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start)
+          .count();
+
+  struct morton_code mc;
+  init_morton_code(&mc, treedepth);
+  uint64_t checksum_packed = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for (auto &p : points) {
+    pair2dl_t back;
+    convert_coordinates_to_morton_code(p.col, p.row, treedepth, &mc);
+    for (uint32_t i = 0; i < treedepth; i++) {
+      checksum_packed += get_code_at_morton_code(&mc, i);
+    }
+    convert_morton_code_to_coordinates(&mc, &back);
+    checksum_packed += back.col ^ back.row;
+  }
+  stop = std::chrono::high_resolution_clock::now();
+  auto packed_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start)
+          .count();
+  clean_morton_code(&mc);
+
+  std::cout << "-------------------\n";
+  std::cout << "treedepth = " << treedepth << ", " << points_count
+            << " points (encode, read every level, decode)" << std::endl;
+  std::cout << "Byte per level: " << bytes_ns / points_count
+            << " ns per point" << std::endl;
+  std::cout << "Packed: " << packed_ns / points_count << " ns per point"
+            << std::endl;
+  if (checksum_bytes != checksum_packed) {
+    std::cout << "Results differ!" << std::endl;
+  }
+}
@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <morton_code.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+/* Loads the same points into a k2node tree with k2node_insert_points_parallel
+ * and an increasing amount of threads */
+int main(void) {
+  const uint32_t treedepth = 32;
+  const uint32_t cut_depth = 8;
+  const size_t points_count = 1 << 22;
+
+  std::mt19937_64 gen(123321);
+  std::uniform_int_distribution<uint64_t> dist(0, (1UL << treedepth) - 1);
+  std::vector<pair2dl_t> points(points_count);
+  for (auto &p : points) {
+    p.col = dist(gen);
+    p.row = dist(gen);
+  }
+
+  unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << points_count << " points, treedepth " << treedepth
+            << ", cut_depth " << cut_depth << ", " << max_threads
+            << " hardware threads" << std::endl;
+
+  for (unsigned threads_count = 1; threads_count <= max_threads;
+       threads_count *= 2) {
+    struct k2qstate st;
+    init_k2qstate(&st, treedepth, 256, cut_depth);
+    struct k2node *root = create_k2node();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    uint64_t inserted_count;
+    k2node_insert_points_parallel(root, points.data(), points.size(),
+                                  (int)threads_count, &st, &inserted_count);
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+    std::cout << threads_count << " threads: " << inserted_count
+              << " points inserted in " << duration.count() << " ms"
+              << std::endl;
+
+    free_rec_k2node(root, 0, st.cut_depth);
+    clean_k2qstate(&st);
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <k2node.h>
+}
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/* Milliseconds taken by operation */
+static double time_ms(const std::function<void()> &operation) {
+  auto start = std::chrono::high_resolution_clock::now();
+  operation();
+  auto stop = std::chrono::high_resolution_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::microseconds>(stop -
+                                                                       start)
+             .count() /
+         1000.0;
+}
+
+static void count_point(uint64_t, uint64_t, void *data) {
+  (*reinterpret_cast<uint64_t *>(data))++;
+}
+
+/* Expands a BFS frontier: all the rows of the frontier reported one by one
+ * with k2node_report_row_interactively against a single
+ * k2node_report_rows_interactively */
+int main(void) {
+  const TREE_DEPTH_T treedepth = 20;
+  const TREE_DEPTH_T cut_depth = 8;
+  const uint64_t nodes = 1UL << 18;
+
+  std::mt19937_64 gen(24680);
+  std::uniform_int_distribution<uint64_t> node_dist(0, nodes - 1);
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 256, cut_depth);
+
+  struct k2node *root = create_k2node();
+  for (size_t i = 0; i < nodes * 8; i++) {
+    int already_exists;
+    k2node_insert_point(root, node_dist(gen), node_dist(gen), &st,
+                        &already_exists);
+  }
+
+  std::cout << "Frontier,Points,One row at a time (ms),All rows (ms)"
+            << std::endl;
+  for (size_t frontier_size : {1UL << 8, 1UL << 12, 1UL << 16}) {
+    std::vector<uint64_t> frontier;
+    for (size_t i = 0; i < frontier_size; i++)
+      frontier.push_back(node_dist(gen));
+
+    uint64_t single = 0;
+    double single_ms = time_ms([&] {
+      for (uint64_t row : frontier)
+        k2node_report_row_interactively(root, row, &st, count_point, &single);
+    });
+
+    uint64_t shared = 0;
+    double shared_ms = time_ms([&] {
+      k2node_report_rows_interactively(root, frontier.data(), frontier.size(),
+                                       &st, count_point, &shared);
+    });
+
+    std::cout << frontier_size << "," << shared << "," << single_ms << ","
+              << shared_ms << std::endl;
+  }
+
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <bitvector.h>
+#include <block.h>
+#include <block_scan.h>
+#include <block_topology.h>
+#include <morton_code.h>
+#include <queries_state.h>
+
+int sequential_scan_child(struct block *input_block, uint32_t input_node_idx,
+                          uint32_t subtrees_to_skip,
+                          uint32_t *frontier_traversal_idx,
+                          TREE_DEPTH_T input_node_relative_depth,
+                          struct queries_state *qs, TREE_DEPTH_T block_depth);
+}
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+struct scan_query {
+  uint32_t node_index;
+  uint32_t subtrees_to_skip;
+  uint32_t depth;
+};
+
+void scan_benchmark(const char *name, uint32_t treedepth,
+                    std::vector<pair2dl_t> points);
+
+static void build_nodes(const std::vector<pair2dl_t> &points, size_t from,
+                        size_t to, uint32_t depth, uint32_t treedepth,
+                        std::vector<uint32_t> &nodes,
+                        std::vector<uint32_t> &depths);
+
+int main(void) {
+  std::mt19937_64 gen(123321);
+
+  /* every cell of a 64x64 square: full nodes down to the leaves */
+  std::vector<pair2dl_t> dense;
+  for (uint64_t col = 0; col < 64; col++) {
+    for (uint64_t row = 0; row < 64; row++) {
+      dense.push_back({col, row});
+    }
+  }
+  scan_benchmark("dense", 6, dense);
+
+  /* a few points in a big matrix: long chains of nodes with a single child */
+  std::vector<pair2dl_t> sparse;
+  std::uniform_int_distribution<uint64_t> dist(0, (1UL << 20) - 1);
+  for (int i = 0; i < 160; i++) {
+    sparse.push_back({dist(gen), dist(gen)});
+  }
+  scan_benchmark("sparse", 20, sparse);
+
+  /* clustered points: dense top levels, sparse lower levels */
+  std::vector<pair2dl_t> clustered;
+  std::uniform_int_distribution<uint64_t> cluster_dist(0, (1UL << 7) - 1);
+  for (int i = 0; i < 400; i++) {
+    clustered.push_back({cluster_dist(gen), cluster_dist(gen)});
+  }
+  scan_benchmark("clustered", 10, clustered);
+
+  return 0;
+}
+
+static void build_nodes(const std::vector<pair2dl_t> &points, size_t from,
+                        size_t to, uint32_t depth, uint32_t treedepth,
+                        std::vector<uint32_t> &nodes,
+                        std::vector<uint32_t> &depths) {
+  uint32_t shift = treedepth - depth - 1;
+  size_t node_position = nodes.size();
+  nodes.push_back(0);
+  depths.push_back(depth);
+  size_t group_start = from;
+  while (group_start < to) {
+    uint32_t code = (((points[group_start].col >> shift) & 1) << 1) |
+                    ((points[group_start].row >> shift) & 1);
+    size_t group_end = group_start + 1;
+    while (group_end < to &&
+           ((((points[group_end].col >> shift) & 1) << 1) |
+            ((points[group_end].row >> shift) & 1)) == code) {
+      group_end++;
+    }
+    nodes[node_position] |= 1u << (3 - code);
+    if (depth + 1 < treedepth) {
+      build_nodes(points, group_start, group_end, depth + 1, treedepth, nodes,
+                  depths);
+    }
+    group_start = group_end;
+  }
+}
+
+void scan_benchmark(const char *name, uint32_t treedepth,
+                    std::vector<pair2dl_t> points) {
+  sort_points_morton_order(points.data(), points.size());
+  points.erase(std::unique(points.begin(), points.end(),
+                           [](const pair2dl_t &a, const pair2dl_t &b) {
+                             return a.col == b.col && a.row == b.row;
+                           }),
+               points.end());
+
+  std::vector<uint32_t> nodes;
+  std::vector<uint32_t> depths;
+  build_nodes(points, 0, points.size(), 0, treedepth, nodes, depths);
+
+  /* a single block without frontier holding the whole tree */
+  struct block b;
+  init_block_frontier(&b);
+  init_block_topology(&b, nodes.size());
+  for (size_t i = 0; i < nodes.size(); i++) {
+    bits_write(&b, 4 * i, 4 * i + 3, nodes[i]);
+  }
+
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, MAX_NODES_IN_BLOCK, &b);
+
+  std::vector<scan_query> queries;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (depths[i] + 1 >= treedepth) {
+      continue;
+    }
+    for (uint32_t skip = 1; skip <= (uint32_t)__builtin_popcount(nodes[i]);
+         skip++) {
+      queries.push_back({(uint32_t)i, skip, depths[i]});
+    }
+  }
+
+  const int repetitions = 200;
+  uint64_t checksum_loop = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    for (auto &q : queries) {
+      uint32_t fidx = 0;
+      sequential_scan_child(&b, q.node_index, q.subtrees_to_skip, &fidx,
+                            q.depth, &qs, 0);
+      checksum_loop += qs.sc_result.child_preorder;
+    }
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto loop_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start)
+          .count();
+
+  uint64_t checksum_kernel = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    for (auto &q : queries) {
+      uint32_t fidx = 0;
+      checksum_kernel += block_scan_skip_subtrees(
+          &b, q.node_index + 1, q.subtrees_to_skip, q.depth + 1, treedepth,
+          &fidx);
+    }
+  }
+  stop = std::chrono::high_resolution_clock::now();
+  auto kernel_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start)
+          .count();
+
+  uint64_t scans = (uint64_t)repetitions * queries.size();
+  std::cout << "-------------------\n";
+  std::cout << name << " block: " << nodes.size()
+            << " nodes, treedepth = " << treedepth << std::endl;
+  std::cout << "Node by node scan: " << loop_ns / scans << " ns per scan"
+            << std::endl;
+  std::cout << "Word kernel scan: " << kernel_ns / scans << " ns per scan"
+            << std::endl;
+  if (checksum_loop != checksum_kernel) {
+    std::cout << "Results differ!" << std::endl;
+  }
+
+  finish_queries_state(&qs);
+  free_block_topology(&b);
+}
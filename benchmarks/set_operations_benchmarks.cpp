@@ -0,0 +1,126 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <k2node.h>
+}
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+
+/* Milliseconds taken by operation */
+static double time_ms(const std::function<void()> &operation) {
+  auto start = std::chrono::high_resolution_clock::now();
+  operation();
+  auto stop = std::chrono::high_resolution_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::microseconds>(stop -
+                                                                       start)
+             .count() /
+         1000.0;
+}
+
+struct probe_state {
+  struct k2node *other;
+  struct k2qstate *other_st;
+  uint64_t found;
+};
+
+static void probe_point(uint64_t col, uint64_t row, void *data) {
+  auto *state = reinterpret_cast<probe_state *>(data);
+  int exists;
+  k2node_has_point(state->other, col, row, state->other_st, &exists);
+  state->found += (uint64_t)exists;
+}
+
+static void count_point(uint64_t, uint64_t, void *data) {
+  (*reinterpret_cast<uint64_t *>(data))++;
+}
+
+static struct k2node *random_tree(std::mt19937_64 &gen, uint64_t side,
+                                  size_t points_count, struct k2qstate *st) {
+  std::uniform_int_distribution<uint64_t> col_dist(0, side - 1);
+  std::uniform_int_distribution<uint64_t> row_dist(0, side / 64 - 1);
+  struct k2node *root = create_k2node();
+  for (size_t i = 0; i < points_count; i++) {
+    int already_exists;
+    k2node_insert_point(root, col_dist(gen), row_dist(gen), st,
+                        &already_exists);
+  }
+  return root;
+}
+
+int main(void) {
+  const TREE_DEPTH_T treedepth = 20;
+  const TREE_DEPTH_T cut_depth = 8;
+  const uint64_t side = 1UL << treedepth;
+
+  std::mt19937_64 gen(97531);
+  struct k2qstate st, other_st;
+  init_k2qstate(&st, treedepth, 256, cut_depth);
+  init_k2qstate(&other_st, treedepth, 256, cut_depth);
+
+  std::cout << "Points,Overlap,Scan and probe (ms),Intersection (ms),Union "
+               "(ms),Difference (ms)"
+            << std::endl;
+  for (size_t points_count : {1UL << 16, 1UL << 18, 1UL << 20}) {
+    struct k2node *lhs = random_tree(gen, side, points_count, &st);
+    struct k2node *rhs = random_tree(gen, side, points_count, &st);
+
+    probe_state probe = {rhs, &other_st, 0};
+    double probe_ms = time_ms([&] {
+      k2node_scan_points_interactively(lhs, &st, probe_point, &probe);
+    });
+
+    uint64_t intersection = 0, united = 0, difference = 0;
+    double intersection_ms = time_ms([&] {
+      k2node_set_operation_interactively(lhs, rhs, SET_INTERSECTION, &st,
+                                         count_point, &intersection);
+    });
+    double union_ms = time_ms([&] {
+      k2node_set_operation_interactively(lhs, rhs, SET_UNION, &st, count_point,
+                                         &united);
+    });
+    double difference_ms = time_ms([&] {
+      k2node_set_operation_interactively(lhs, rhs, SET_DIFFERENCE, &st,
+                                         count_point, &difference);
+    });
+    if (probe.found != intersection) {
+      std::cerr << "intersection mismatch: " << probe.found << " vs "
+                << intersection << std::endl;
+      return 1;
+    }
+
+    std::cout << points_count << "," << intersection << "," << probe_ms << ","
+              << intersection_ms << "," << union_ms << "," << difference_ms
+              << std::endl;
+
+    free_rec_k2node(lhs, 0, st.cut_depth);
+    free_rec_k2node(rhs, 0, st.cut_depth);
+  }
+
+  clean_k2qstate(&st);
+  clean_k2qstate(&other_st);
+  return 0;
+}
@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+extern "C" {
+#include <bitvector.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/* The shifts as they were done before the kernels: 32 bits chunks moved
+ * with bits_read/bits_write, each one checking its bounds */
+static void chunked_move(BVCTYPE *uarr, int size, uint32_t dst_from,
+                         uint32_t src_from, uint32_t length) {
+  uint32_t chunk;
+  if (dst_from > src_from) {
+    uint32_t remaining = length;
+    while (remaining > 0) {
+      uint32_t count = std::min(remaining, 32U);
+      remaining -= count;
+      bits_read_uarray_small(uarr, size, src_from + remaining,
+                             src_from + remaining + count - 1, &chunk);
+      bits_write_uarray_small(uarr, size, dst_from + remaining,
+                              dst_from + remaining + count - 1, chunk);
+    }
+  } else {
+    for (uint32_t done = 0; done < length; done += 32) {
+      uint32_t count = std::min(length - done, 32U);
+      bits_read_uarray_small(uarr, size, src_from + done,
+                             src_from + done + count - 1, &chunk);
+      bits_write_uarray_small(uarr, size, dst_from + done,
+                              dst_from + done + count - 1, chunk);
+    }
+  }
+}
+
+/* Opens and closes a gap of shift_nodes nodes at the start of a block of
+ * block_nodes nodes, as make_room and collapse_nodes do, returning the
+ * nanoseconds per shift */
+static double run(uint32_t block_nodes, uint32_t shift_nodes, bool kernel,
+                  int repetitions) {
+  uint32_t bits = 4 * block_nodes;
+  uint32_t shift = 4 * shift_nodes;
+  int size = (int)((bits + shift + BVCTYPE_BITS - 1) / BVCTYPE_BITS);
+  std::vector<BVCTYPE> uarr(size);
+  std::mt19937_64 gen(1);
+  for (auto &word : uarr)
+    word = (BVCTYPE)gen();
+
+  /* odd positions, so the words are not aligned */
+  uint32_t from = 4;
+  uint32_t length = bits - from;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < repetitions; i++) {
+    if (kernel) {
+      bits_move_uarray(uarr.data(), from + shift, uarr.data(), from, length);
+      bits_clear_uarray(uarr.data(), from, shift);
+      bits_move_uarray(uarr.data(), from, uarr.data(), from + shift, length);
+    } else {
+      chunked_move(uarr.data(), size, from + shift, from, length);
+      chunked_move(uarr.data(), size, from, from + shift, length);
+    }
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop -
+                                                                      start)
+             .count() /
+         (2.0 * repetitions);
+}
+
+int main(void) {
+  std::cout << "Block nodes,Shift nodes,Chunked (ns),Kernel (ns),Speedup"
+            << std::endl;
+  for (uint32_t block_nodes : {64U, 256U, 1024U, 4096U}) {
+    for (uint32_t shift_nodes : {1U, 3U, 8U, 24U}) {
+      int repetitions = (int)(4000000 / block_nodes);
+      double chunked = run(block_nodes, shift_nodes, false, repetitions);
+      double kernel = run(block_nodes, shift_nodes, true, repetitions);
+      std::cout << block_nodes << "," << shift_nodes << "," << chunked << ","
+                << kernel << "," << chunked / kernel << std::endl;
+    }
+  }
+  return 0;
+}
@@ -40,18 +40,20 @@ std::mt19937 rng(123321);
 struct BenchmarkResult {
   int treedepth;
   int node_count;
+  uint32_t growth_percent;
   uint64_t points_count;
   uint64_t size_bytes;
   uint64_t bytes_ptrs;
   uint64_t bytes_topologies;
+  uint64_t bytes_counts;
   uint64_t total_microseconds_inserting;
   uint64_t inserted_points;
 };
 
 BenchmarkResult space_benchmark_random_insertion_by_depth_and_node_count(
     TREE_DEPTH_T treedepth, MAX_NODE_COUNT_T node_count,
-    uint64_t points_count, std::vector<uint64_t> &cols,
-    std::vector<uint64_t> &rows);
+    uint32_t growth_percent, uint64_t points_count,
+    std::vector<uint64_t> &cols, std::vector<uint64_t> &rows);
 
 int main(void) {
 
@@ -66,22 +68,29 @@ int main(void) {
   std::vector<BenchmarkResult> results;
   std::cout << "size of block" << sizeof(struct block) << std::endl;
   std::cout << "started experiments" << std::endl;
+  /* power of two containers against fixed 1.25x steps */
+  std::vector<uint32_t> growth_policies = {BLOCK_GROWTH_POWER_OF_TWO, 125};
   for (int node_count_base = 6; node_count_base <= 10; node_count_base++) {
-
-    results.push_back(space_benchmark_random_insertion_by_depth_and_node_count(
-        treedepth, 1 << node_count_base, points_count, random_seq_1,
-        random_seq_2));
+    for (uint32_t growth_percent : growth_policies) {
+      results.push_back(
+          space_benchmark_random_insertion_by_depth_and_node_count(
+              treedepth, 1 << node_count_base, growth_percent, points_count,
+              random_seq_1, random_seq_2));
+    }
   }
 
-  std::cout << "Tree depth,Node count,Points count,Total Bytes,Bytes "
-               "Ptrs+Preorders,Bytes Topologies,Total Time(Microsecs), Avg "
+  std::cout << "Tree depth,Node count,Growth percent,Points count,Total "
+               "Bytes,Bytes "
+               "Ptrs+Preorders,Bytes Topologies,Bytes Counts,Total "
+               "Time(Microsecs), Avg "
                "Time(Microsecs)"
             << std::endl;
 
   for (auto bm : results) {
     std::cout << bm.treedepth << "," << bm.node_count << ","
-              << bm.inserted_points << "," << bm.size_bytes << ","
+              << bm.growth_percent << "," << bm.inserted_points << "," << bm.size_bytes << ","
               << bm.bytes_ptrs << "," << bm.bytes_topologies << ","
+              << bm.bytes_counts << ","
               << bm.total_microseconds_inserting << ","
               << (float)bm.total_microseconds_inserting /
                      (float)bm.inserted_points
@@ -93,12 +102,13 @@ int main(void) {
 
 BenchmarkResult space_benchmark_random_insertion_by_depth_and_node_count(
     TREE_DEPTH_T treedepth, MAX_NODE_COUNT_T node_count,
-    uint64_t points_count, std::vector<uint64_t> &cols,
-    std::vector<uint64_t> &rows) {
+    uint32_t growth_percent, uint64_t points_count,
+    std::vector<uint64_t> &cols, std::vector<uint64_t> &rows) {
   struct block *root_block = create_block();
 
   struct queries_state qs;
   init_queries_state(&qs, treedepth, node_count, root_block);
+  qs.block_growth_percent = growth_percent;
 
   auto start = std::chrono::high_resolution_clock::now();
   uint64_t inserted_points = 0;
@@ -124,11 +134,18 @@ BenchmarkResult space_benchmark_random_insertion_by_depth_and_node_count(
 
   return {treedepth,
           node_count,
+          growth_percent,
           points_count,
           measurements.total_bytes,
           measurements.total_blocks *
               (sizeof(uint32_t) + sizeof(struct block *)),
           measurements.bytes_topology,
+#ifdef POINT_COUNTS
+          /* part of the total, as sizeof(struct block) includes it */
+          measurements.total_blocks * sizeof(uint64_t),
+#else
+          0,
+#endif
           (uint64_t)duration.count(),
           inserted_points};
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _ARENA_MEMALLOC_H_
+#define _ARENA_MEMALLOC_H_
+
+#include <stdint.h>
+
+#include "memalloc.h"
+
+/**
+ * @brief Slab arena holding the memory of one tree
+ *
+ * Allocations are served from 64KB chunks, each one dedicated to a size
+ * class. The classes go up to 4KB and cover the container sizes given by
+ * enlarge_block_size_to, the frontier arrays and the blocks and k2nodes;
+ * bigger requests get a chunk of their own. Released memory goes back to the
+ * free list of its class. The arena is guarded by a mutex, so it can back the
+ * parallel insertions.
+ *
+ * k2tree_arena_destroy frees the whole tree at once, in O(chunks), without
+ * calling free_rec_block/free_rec_k2node.
+ */
+struct k2tree_arena;
+
+struct k2tree_arena *k2tree_arena_create(void);
+void k2tree_arena_destroy(struct k2tree_arena *arena);
+
+/* Hooks allocating from arena, to be bound with k2tree_bind_allocator while
+ * the tree is created. The arena must outlive them */
+struct k2tree_allocator k2tree_arena_allocator(struct k2tree_arena *arena);
+
+/* Bytes taken from the system, chunk headers and free lists included */
+uint64_t k2tree_arena_reserved_bytes(struct k2tree_arena *arena);
+uint64_t k2tree_arena_chunks_count(struct k2tree_arena *arena);
+
+#endif /* _ARENA_MEMALLOC_H_ */
@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _BAND_INTERSECTION_H_
+#define _BAND_INTERSECTION_H_
+
+#include <stdint.h>
+
+#include "block.h"
+#include "definitions.h"
+#include "k2node.h"
+#include "queries_state.h"
+
+/**
+ * @brief A row or a column of a block tree, its coordinates are the ones
+ * report_row (REPORT_ROW) or report_column (REPORT_COLUMN) gives for coord
+ *
+ * The handler of a band keeps its path in the morton code of qs, so each band
+ * needs its own queries_state even when several bands are on the same tree. A
+ * query_ctx per band is enough.
+ */
+struct band_spec {
+  struct block *tree;
+  struct queries_state *qs;
+  int which_report;
+  uint64_t coord;
+};
+
+/**
+ * @brief Lazy handler yielding, in ascending order, the coordinates found in
+ * all the bands given
+ *
+ * Leapfrog join over the lazy band handlers: every band seeks the highest
+ * coordinate any of them is at, until all of them land on the same one. A seek
+ * descends from the deepest node a band shares with the target, so the
+ * quadrants missing from one band are skipped in the others without visiting
+ * them, and no band is ever materialized.
+ */
+struct lazy_handler_band_intersection_t {
+  struct lazy_handler_report_band_t *bands;
+  uint32_t bands_count;
+  uint64_t next_result;
+  int has_next;
+};
+
+int band_intersection_lazy_init(
+    struct lazy_handler_band_intersection_t *lazy_handler,
+    const struct band_spec *specs, uint32_t specs_count);
+int band_intersection_lazy_clean(
+    struct lazy_handler_band_intersection_t *lazy_handler);
+int band_intersection_next(
+    struct lazy_handler_band_intersection_t *lazy_handler, uint64_t *result);
+int band_intersection_has_next(
+    struct lazy_handler_band_intersection_t *lazy_handler, int *result);
+int band_intersection_reset(
+    struct lazy_handler_band_intersection_t *lazy_handler);
+/* Skips the common coordinates lower than coord, see report_band_seek */
+int band_intersection_seek(
+    struct lazy_handler_band_intersection_t *lazy_handler, uint64_t coord);
+
+/* Same as band_spec for a k2node tree, each band with its own k2qstate */
+struct k2node_band_spec {
+  struct k2node *tree;
+  struct k2qstate *st;
+  int which_report;
+  uint64_t coord;
+};
+
+struct k2node_lazy_handler_band_intersection_t {
+  struct k2node_lazy_handler_report_band_t *bands;
+  uint32_t bands_count;
+  uint64_t next_result;
+  int has_next;
+};
+
+int k2node_band_intersection_lazy_init(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler,
+    const struct k2node_band_spec *specs, uint32_t specs_count);
+int k2node_band_intersection_lazy_clean(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler);
+int k2node_band_intersection_next(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler,
+    uint64_t *result);
+int k2node_band_intersection_has_next(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler, int *result);
+int k2node_band_intersection_reset(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler);
+int k2node_band_intersection_seek(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler,
+    uint64_t coord);
+
+#endif /* _BAND_INTERSECTION_H_ */
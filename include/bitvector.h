@@ -10,8 +10,22 @@
 #define ERR_OUT_OF_BOUNDARIES -3
 #define ERR_BITS_WRITE_FROM_GT_TO -4
 
-// TODO: refactor to allow custom BVCTYPE
+/* Word of the block containers, 32 bits unless built with BVCTYPE_64. Nodes
+ * are stored from the most significant bits of each word */
+#ifdef BVCTYPE_64
+typedef uint64_t BVCTYPE;
+#else
 typedef uint32_t BVCTYPE;
+#endif
+
+#define BVCTYPE_BITS ((uint32_t)(sizeof(BVCTYPE) * 8))
+#define NODES_PER_BVCTYPE (BVCTYPE_BITS / 4)
+
+/* Node at node_index of a container */
+#define BVCTYPE_NODE(container, node_index)                                    \
+  ((uint32_t)((container)[(node_index) / NODES_PER_BVCTYPE] >>                 \
+              (BVCTYPE_BITS - 4 - 4 * ((node_index) % NODES_PER_BVCTYPE))) &   \
+   0xFU)
 
 #ifdef VERY_LIGHT_FIELDS
 typedef uint8_t CONTAINER_SZ_T;
@@ -35,20 +49,30 @@ int bit_set(struct block *input_bitvector, uint32_t position,
             int *bit_was_set_already);
 int bit_clear(struct block *input_bitvector, uint32_t position);
 int bits_write(struct block *input_bitvector, uint32_t from, uint32_t to,
-               BVCTYPE to_write);
+               uint32_t to_write);
 int bits_read(struct block *input_bitvector, uint32_t from, uint32_t to,
               uint32_t *result);
 
 int bits_write_bv(struct block *input_bitvector, struct block *output_bitvector,
                   int start_src, int start_dst, int length);
 
-int bits_write_uarray_small(uint32_t *input_uarr, int sz, uint32_t from,
+/* The small versions read and write up to 32 bits */
+int bits_write_uarray_small(BVCTYPE *input_uarr, int sz, uint32_t from,
                             uint32_t to, uint32_t to_write);
-int bits_read_uarray_small(uint32_t *input_uarr, int sz, uint32_t from,
+int bits_read_uarray_small(BVCTYPE *input_uarr, int sz, uint32_t from,
                            uint32_t to, uint32_t *result);
 
-int bits_write_uarray(uint32_t *input_uarr, int input_size,
-                      uint32_t *output_uarr, int output_size, int start_src,
+int bits_write_uarray(BVCTYPE *input_uarr, int input_size,
+                      BVCTYPE *output_uarr, int output_size, int start_src,
                       int start_dst, int length);
 
+/* Shift kernels, without bound checks */
+
+/* Copies length bits from src_from in src to dst_from in dst. The ranges can
+ * overlap, as with memmove */
+void bits_move_uarray(BVCTYPE *dst, uint32_t dst_from, const BVCTYPE *src,
+                      uint32_t src_from, uint32_t length);
+/* Zeroes length bits from 'from' */
+void bits_clear_uarray(BVCTYPE *uarr, uint32_t from, uint32_t length);
+
 #endif /* _BITVECTOR_H_ */
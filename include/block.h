@@ -28,6 +28,7 @@ SOFTWARE.
 
 #include "bitvector.h"
 #include "block_frontier.h"
+#include "block_skip_index.h"
 #include "block_topology.h"
 #include "definitions.h"
 #include "queries_state.h"
@@ -52,6 +53,14 @@ SOFTWARE.
    ((current_col) >= (half_length) &&                                          \
     REPORT_SECOND_HALF(which_report, child_pos)))
 
+/* Child of a band node holding the reported coordinates on the half given by
+ * reported_bit, the band half is the one holding current_col */
+#define REPORT_BAND_CHILD(current_col, half_length, which_report,              \
+                          reported_bit)                                        \
+  ((which_report) == REPORT_COLUMN                                             \
+       ? ((uint32_t)((current_col) >= (half_length)) << 1 | (reported_bit))    \
+       : ((uint32_t)(reported_bit) << 1 | ((current_col) >= (half_length))))
+
 struct block {
   NODES_BV_T *preorders;
   struct block *children_blocks;
@@ -61,6 +70,19 @@ struct block {
   NODES_BV_T children;
   CONTAINER_SZ_T container_size;
   NODES_BV_T nodes_count;
+
+#ifdef TREE_ALLOCATOR
+  /* Allocator of the whole tree, only set on its root block when it is
+   * created. NULL for malloc */
+  const struct k2tree_allocator *allocator;
+#endif
+#ifdef BLOCK_SKIP_INDEX
+  struct block_skip_index *skip_index;
+#endif
+#ifdef POINT_COUNTS
+  /* Points of the subtree of the block, including its children blocks */
+  uint64_t points_count;
+#endif
 };
 
 struct k2tree_measurement {
@@ -96,14 +118,100 @@ typedef void (*coord_reporter_fun_t)(uint64_t, void *);
 int has_point(struct block *input_block, uint64_t col, uint64_t row,
               struct queries_state *qs, int *result);
 
+/**
+ * @brief Checks the existence of many points with a single traversal
+ *
+ * The points are sorted in morton order so that queries sharing a path prefix
+ * descend through it only once. results[i] is set to TRUE if points[i] exists
+ * and FALSE otherwise.
+ */
+int has_point_batch(struct block *input_block, const pair2dl_t *points,
+                    uint64_t points_count, struct queries_state *qs,
+                    int *results);
+
+/* Same as has_point_batch, but the points must be already sorted in morton
+ * order. results[points[i].index] is written for each point */
+int has_point_batch_sorted(struct block *input_block,
+                           const ipair2dl_t *points, uint64_t points_count,
+                           struct queries_state *qs, int *results);
+
 int insert_point(struct block *input_block, uint64_t col,
                  uint64_t row, struct queries_state *qs,
                  int *already_exists);
 
+/**
+ * @brief Builds a whole tree from points sorted in morton order
+ *
+ * The topology is emitted in preorder and cut into blocks bottom-up, so no
+ * block is ever resized or split. The resulting tree can be queried and
+ * modified as any other. Only the lowest 'treedepth' bits of the coordinates
+ * are used.
+ *
+ * @return struct block* Root block of the new tree, to be freed with
+ * free_rec_block
+ */
+struct block *build_block_tree_from_sorted(const pair2dl_t *points,
+                                           uint64_t points_count,
+                                           TREE_DEPTH_T treedepth,
+                                           MAX_NODE_COUNT_T max_nodes_count);
+
+/**
+ * @brief Inserts many points at once
+ *
+ * The points are sorted in morton order and every block is traversed once per
+ * round, writing all its new nodes with a single shift. A block is split only
+ * when the batch needs more room in its existing paths. inserted_count is set
+ * to the amount of points which didn't exist before.
+ */
+int insert_points_batch(struct block *input_block, const pair2dl_t *points,
+                        uint64_t points_count, struct queries_state *qs,
+                        uint64_t *inserted_count);
+
+/* Same as insert_points_batch, but the points must be already sorted in morton
+ * order */
+int insert_points_batch_sorted(struct block *input_block,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct queries_state *qs,
+                               uint64_t *inserted_count);
+
 int delete_point(struct block *input_block, uint64_t col,
                  uint64_t row, struct queries_state *qs,
                  int *already_not_exists);
 
+/**
+ * @brief Deletes many points at once
+ *
+ * The points are sorted in morton order and every block is visited once: its
+ * bits are cleared in place, the nodes left empty are removed with a single
+ * shift and the merge with each of its children blocks which lost points is
+ * evaluated once, after the whole batch. deleted_count is set to the amount of
+ * points which existed.
+ */
+int delete_points_batch(struct block *input_block, const pair2dl_t *points,
+                        uint64_t points_count, struct queries_state *qs,
+                        uint64_t *deleted_count);
+
+/* Same as delete_points_batch, but the points must be already sorted in morton
+ * order */
+int delete_points_batch_sorted(struct block *input_block,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct queries_state *qs,
+                               uint64_t *deleted_count);
+
+/**
+ * @brief Merges and shrinks the blocks left behind by the deletions made with
+ * qs->deferred_compaction set
+ *
+ * Takes the blocks queued in qs->compaction_candidates, most recent first,
+ * shrinks their containers and the ones of the blocks above them to the nodes
+ * they hold and merges them into their parents when they fit, as delete_point
+ * does right away otherwise. With a time_budget_us other than 0 it stops after
+ * the first block which ends past it, so it can run in small steps between
+ * updates. pending_count is set to the blocks still queued.
+ */
+int compact_block_tree(struct block *input_block, struct queries_state *qs,
+                       uint64_t time_budget_us, uint64_t *pending_count);
+
 int naive_scan_points(struct block *input_block, struct queries_state *qs,
                       struct vector_pair2dl_t *result);
 
@@ -112,6 +220,40 @@ int scan_points_interactively(struct block *input_block,
                               point_reporter_fun_t point_reporter,
                               void *report_state);
 
+/**
+ * @brief Reports the points of the union, intersection or difference of two
+ * trees, walking both at once
+ *
+ * A quadrant is descended into only while both trees have it. One present in
+ * a single tree is scanned whole if the operation keeps it (any for a union,
+ * those of lhs for a difference) and skipped otherwise, so the cost follows
+ * the topology the trees share instead of the amount of points. Points are
+ * reported in morton order. Both trees must have the same treedepth, and qs
+ * can be the state of either one or a query_ctx.
+ */
+int k2tree_set_operation_interactively(struct block *lhs, struct block *rhs,
+                                       set_operation_t operation,
+                                       struct queries_state *qs,
+                                       point_reporter_fun_t point_reporter,
+                                       void *report_state);
+
+/**
+ * @brief Builds a new tree with the points in lhs or rhs, in both or in lhs
+ * but not in rhs
+ *
+ * The points of k2tree_set_operation_interactively are collected in a vector,
+ * already in morton order, and built into a tree by
+ * build_block_tree_from_sorted with the treedepth and max_nodes_count of qs,
+ * which can't be a query_ctx, and the allocator the thread has bound. The
+ * result is freed with free_rec_block.
+ */
+int k2tree_union(struct block *lhs, struct block *rhs, struct queries_state *qs,
+                 struct block **result);
+int k2tree_intersect(struct block *lhs, struct block *rhs,
+                     struct queries_state *qs, struct block **result);
+int k2tree_difference(struct block *lhs, struct block *rhs,
+                      struct queries_state *qs, struct block **result);
+
 int report_column(struct block *input_block, uint64_t col,
                   struct queries_state *qs, struct vector_pair2dl_t *result);
 
@@ -128,6 +270,136 @@ int report_row_interactively(struct block *input_block, uint64_t row,
                              point_reporter_fun_t point_reporter,
                              void *report_state);
 
+/**
+ * @brief Copies the coordinates lower than 2^treedepth into a new sorted array
+ * without repetitions, returning its size. The caller frees *result.
+ */
+uint64_t sort_band_coords(const uint64_t *coords, uint64_t coords_count,
+                          TREE_DEPTH_T treedepth, uint64_t **result);
+
+/**
+ * @brief First position in the sorted range coords[lo..hi) whose coordinate
+ * has the given bit set, or hi if there is none. The coordinates of the range
+ * must agree on the bits above it.
+ */
+uint64_t split_band_coords(const uint64_t *coords, uint64_t lo, uint64_t hi,
+                           uint32_t bit);
+
+/**
+ * @brief Report the points of several rows (or columns) in a single traversal
+ *
+ * The coordinates are sorted and, at each node, split between the children
+ * holding them, so the nodes shared by several bands are visited once instead
+ * of once per band. Points are reported in morton order and carry their own
+ * row and column, which tells the band they come from. Repeated coordinates
+ * are reported once and the ones outside the tree are ignored.
+ */
+int report_rows(struct block *input_block, const uint64_t *rows,
+                uint64_t rows_count, struct queries_state *qs,
+                struct vector_pair2dl_t *result);
+
+int report_columns(struct block *input_block, const uint64_t *cols,
+                   uint64_t cols_count, struct queries_state *qs,
+                   struct vector_pair2dl_t *result);
+
+int report_rows_interactively(struct block *input_block, const uint64_t *rows,
+                              uint64_t rows_count, struct queries_state *qs,
+                              point_reporter_fun_t point_reporter,
+                              void *report_state);
+
+int report_columns_interactively(struct block *input_block,
+                                 const uint64_t *cols, uint64_t cols_count,
+                                 struct queries_state *qs,
+                                 point_reporter_fun_t point_reporter,
+                                 void *report_state);
+
+/**
+ * @brief Same as report_rows_interactively (which_report REPORT_ROW) or
+ * report_columns_interactively (REPORT_COLUMN), for the coordinates
+ * coords[coords_lo..coords_hi) already sorted and without repetitions, as
+ * returned by sort_band_coords. Only their lowest treedepth bits are used.
+ */
+int report_sorted_bands_interactively(struct block *input_block,
+                                      const uint64_t *coords,
+                                      uint64_t coords_lo, uint64_t coords_hi,
+                                      int which_report,
+                                      struct queries_state *qs,
+                                      point_reporter_fun_t point_reporter,
+                                      void *report_state);
+
+/**
+ * @brief Inclusive rectangle of a range query, relative to the origin of the
+ * subtree being visited.
+ */
+struct report_range {
+  uint64_t col_lo;
+  uint64_t col_hi;
+  uint64_t row_lo;
+  uint64_t row_hi;
+};
+
+int init_report_range(struct report_range *range, uint64_t col_lo,
+                      uint64_t col_hi, uint64_t row_lo, uint64_t row_hi,
+                      TREE_DEPTH_T treedepth);
+
+int clip_report_range(const struct report_range *range, uint32_t child_pos,
+                      uint64_t half_length, struct report_range *child_range);
+
+/**
+ * @brief point_reporter_fun_t appending each point to the vector_pair2dl_t
+ * passed as report_state
+ */
+void report_range_to_vector(uint64_t col, uint64_t row, void *report_state);
+
+int report_range(struct block *input_block, uint64_t col_lo, uint64_t col_hi,
+                 uint64_t row_lo, uint64_t row_hi, struct queries_state *qs,
+                 struct vector_pair2dl_t *result);
+
+int report_range_interactively(struct block *input_block, uint64_t col_lo,
+                               uint64_t col_hi, uint64_t row_lo,
+                               uint64_t row_hi, struct queries_state *qs,
+                               point_reporter_fun_t point_reporter,
+                               void *report_state);
+
+/**
+ * @brief Count the points of the tree, of a column, of a row or inside a
+ * rectangle, without building coordinates or storing any point
+ *
+ * The rectangle of count_range is inclusive, as in report_range. Builds with
+ * POINT_COUNTS read the count stored in each block instead of walking it, so
+ * count_points takes constant time and count_range doesn't enter the child
+ * blocks fully inside the rectangle.
+ *
+ * @param result Number of points found
+ * @return int Result code
+ */
+int count_points(struct block *input_block, struct queries_state *qs,
+                 uint64_t *result);
+
+int count_column(struct block *input_block, uint64_t col,
+                 struct queries_state *qs, uint64_t *result);
+
+int count_row(struct block *input_block, uint64_t row,
+              struct queries_state *qs, uint64_t *result);
+
+int count_range(struct block *input_block, uint64_t col_lo, uint64_t col_hi,
+                uint64_t row_lo, uint64_t row_hi, struct queries_state *qs,
+                uint64_t *result);
+
+#ifdef POINT_COUNTS
+/**
+ * @brief Recomputes the points_count of a block and of all the blocks below it
+ *
+ * The modifying functions keep the counts updated, this is only needed for
+ * blocks filled by other means, as when a snapshot is loaded.
+ *
+ * @param block_depth Real depth of the root of the block
+ * @return int Result code
+ */
+int refresh_points_count(struct block *input_block, TREE_DEPTH_T block_depth,
+                         TREE_DEPTH_T treedepth);
+#endif
+
 struct block *create_block(void);
 
 int free_rec_block(struct block *input_block);
@@ -179,6 +451,46 @@ define_stack_of_type(lazy_report_band_state_t)
   struct block *tree_root;
 };
 
+typedef struct {
+  struct child_result current_cr;
+  struct report_range range;
+  uint32_t last_iteration;
+  uint32_t frontier_traversal_idx;
+} lazy_report_range_state_t;
+
+define_stack_of_type(lazy_report_range_state_t)
+
+    struct lazy_handler_report_range_t {
+  struct queries_state *qs;
+  struct lazy_report_range_state_t_stack stack;
+  pair2dl_t next_result;
+  int has_next;
+  int empty_range;
+  struct report_range range;
+  struct block *tree_root;
+};
+
+typedef struct {
+  struct child_result current_cr;
+  uint64_t coords_lo;
+  uint64_t coords_hi;
+  uint32_t last_iteration;
+  uint32_t frontier_traversal_idx;
+} lazy_report_bands_state_t;
+
+define_stack_of_type(lazy_report_bands_state_t)
+
+    struct lazy_handler_report_bands_t {
+  struct queries_state *qs;
+  struct lazy_report_bands_state_t_stack stack;
+  int which_report;
+  pair2dl_t next_result;
+  int has_next;
+  uint64_t *coords;
+  uint64_t coords_count;
+  struct block *tree_root;
+};
+
 int naive_scan_points_lazy_init(struct block *input_block,
                                 struct queries_state *qs,
                                 struct lazy_handler_naive_scan_t *lazy_handler);
@@ -195,6 +507,17 @@ int naive_scan_points_lazy_has_next(
 int naive_scan_points_lazy_reset(
     struct lazy_handler_naive_scan_t *lazy_handler);
 
+/**
+ * @brief Skips the points before (col, row) in morton order, so the next call
+ * to naive_scan_points_lazy_next returns the first point not before it
+ *
+ * Goes back up to the deepest pending node holding the target and descends
+ * from it, skipping whole subtrees before the target. Does nothing if the next
+ * point is already not before the target.
+ */
+int naive_scan_points_lazy_seek(struct lazy_handler_naive_scan_t *lazy_handler,
+                                uint64_t col, uint64_t row);
+
 int report_row_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
                          struct block *input_block, struct queries_state *qs,
                          uint64_t coord);
@@ -210,6 +533,41 @@ int report_band_reset(struct lazy_handler_report_band_t *lazy_handler);
 int report_band_has_next(struct lazy_handler_report_band_t *lazy_handler,
                          int *result);
 
+/**
+ * @brief Skips the reported coordinates lower than coord, the next call to
+ * report_band_next returns the first one greater or equal to it
+ *
+ * Same as naive_scan_points_lazy_seek, meant to be used by merge and leapfrog
+ * joins over several bands.
+ */
+int report_band_seek(struct lazy_handler_report_band_t *lazy_handler,
+                     uint64_t coord);
+
+int report_range_lazy_init(struct lazy_handler_report_range_t *lazy_handler,
+                           struct block *input_block, struct queries_state *qs,
+                           uint64_t col_lo, uint64_t col_hi, uint64_t row_lo,
+                           uint64_t row_hi);
+int report_range_lazy_clean(struct lazy_handler_report_range_t *lazy_handler);
+int report_range_next(struct lazy_handler_report_range_t *lazy_handler,
+                      pair2dl_t *result);
+int report_range_reset(struct lazy_handler_report_range_t *lazy_handler);
+int report_range_has_next(struct lazy_handler_report_range_t *lazy_handler,
+                          int *result);
+
+int report_rows_lazy_init(struct lazy_handler_report_bands_t *lazy_handler,
+                          struct block *input_block, struct queries_state *qs,
+                          const uint64_t *rows, uint64_t rows_count);
+int report_columns_lazy_init(struct lazy_handler_report_bands_t *lazy_handler,
+                             struct block *input_block,
+                             struct queries_state *qs, const uint64_t *cols,
+                             uint64_t cols_count);
+int report_bands_lazy_clean(struct lazy_handler_report_bands_t *lazy_handler);
+int report_bands_next(struct lazy_handler_report_bands_t *lazy_handler,
+                      pair2dl_t *result);
+int report_bands_reset(struct lazy_handler_report_bands_t *lazy_handler);
+int report_bands_has_next(struct lazy_handler_report_bands_t *lazy_handler,
+                          int *result);
+
 int clean_child_result(struct child_result *cresult);
 
 void debug_print_block_tree_structure(struct block *input_block);
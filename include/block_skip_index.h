@@ -0,0 +1,183 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _BLOCK_SKIP_INDEX_H_
+#define _BLOCK_SKIP_INDEX_H_
+
+#include <stdint.h>
+
+#include "definitions.h"
+
+struct block;
+struct queries_state;
+
+/* Most nodes summarized by an entry of the skip index */
+#define SKIP_INDEX_CHUNK_NODES 64
+
+/* Blocks with less nodes than this are always scanned sequentially */
+#ifndef SKIP_INDEX_MIN_NODES
+#define SKIP_INDEX_MIN_NODES 512
+#endif
+
+/**
+ * @brief Summary of up to SKIP_INDEX_CHUNK_NODES consecutive nodes of a block.
+ *
+ * Scanning a node with c children (0 for leaf-level and frontier nodes) adds
+ * c - 1 to the amount of subtrees left to skip. excess is the sum over the
+ * whole chunk and min_excess the minimum prefix sum, so a chunk can be jumped
+ * over entirely when the subtrees left to skip plus min_excess stay positive.
+ *
+ * Bit i of childless_mask tells if node first + i has no children in the
+ * block, which doesn't depend on its nibble and is kept up to date by every
+ * update. excess and min_excess are only valid if the chunk isn't dirty.
+ */
+struct skip_index_chunk {
+  uint64_t childless_mask;
+  uint32_t first;
+  uint16_t nodes;
+  int16_t excess;
+  int16_t min_excess;
+  uint8_t dirty;
+};
+
+/*
+ * The chunks cover the nodes of the block in order. Inserting nodes grows
+ * the chunk they land in, splitting it when it overflows, and removing them
+ * shrinks their chunks, merging neighbours that fit in one. Updates which
+ * rewrite a whole block only mark its index stale and rebuild it when done,
+ * and merges drop the index of the parent block.
+ * The index is a cache: if it can't be grown it is marked stale too.
+ */
+struct block_skip_index {
+  struct skip_index_chunk *chunks;
+  uint32_t chunks_count;
+  uint32_t chunks_capacity;
+  uint32_t nodes_count;
+  TREE_DEPTH_T block_depth;
+  TREE_DEPTH_T treedepth;
+  int stale;
+};
+
+#ifdef BLOCK_SKIP_INDEX
+
+int skip_index_build(struct block *input_block, TREE_DEPTH_T block_depth,
+                     TREE_DEPTH_T treedepth);
+
+void skip_index_free(struct block *input_block);
+
+void skip_index_refresh(struct block *input_block);
+
+void skip_index_insert_nodes(struct block *input_block, uint32_t node_index,
+                            uint32_t nodes_count);
+
+void skip_index_remove_nodes(struct block *input_block, uint32_t node_index,
+                            uint32_t nodes_count);
+
+void skip_index_resize(struct block *input_block, uint32_t nodes_count);
+
+void skip_index_node_changed(struct block *input_block, uint32_t node_index);
+
+void skip_index_set_childless(struct block *input_block, uint32_t node_index);
+
+int skip_index_scan_child(struct block *input_block, uint32_t input_node_idx,
+                          uint32_t subtrees_to_skip,
+                          uint32_t *frontier_traversal_idx,
+                          TREE_DEPTH_T input_node_relative_depth,
+                          struct queries_state *qs, TREE_DEPTH_T block_depth);
+
+int debug_validate_skip_index(struct block *input_block);
+
+/* True if the block has an index the incremental updates have to maintain */
+#define SKIP_INDEX_MAINTAINED(input_block)                                     \
+  ((input_block)->skip_index && !(input_block)->skip_index->stale)
+
+/* Updates which can't be followed node by node leave the index to be rebuilt
+ * by SKIP_INDEX_REFRESH, or by the next child() if nothing refreshes it */
+#define SKIP_INDEX_INVALIDATE(input_block)                                     \
+  do {                                                                         \
+    if ((input_block)->skip_index)                                             \
+      (input_block)->skip_index->stale = TRUE;                                 \
+  } while (0)
+
+#define SKIP_INDEX_REFRESH(input_block)                                        \
+  do {                                                                         \
+    if ((input_block)->skip_index && (input_block)->skip_index->stale)         \
+      skip_index_refresh(input_block);                                         \
+  } while (0)
+
+#define SKIP_INDEX_FREE(input_block)                                           \
+  do {                                                                         \
+    if ((input_block)->skip_index)                                             \
+      skip_index_free(input_block);                                            \
+  } while (0)
+
+#define SKIP_INDEX_INSERT_NODES(input_block, node_index, nodes_count)          \
+  do {                                                                         \
+    if (SKIP_INDEX_MAINTAINED(input_block))                                    \
+      skip_index_insert_nodes(input_block, node_index, nodes_count);           \
+  } while (0)
+
+#define SKIP_INDEX_REMOVE_NODES(input_block, node_index, nodes_count)          \
+  do {                                                                         \
+    if (SKIP_INDEX_MAINTAINED(input_block))                                    \
+      skip_index_remove_nodes(input_block, node_index, nodes_count);           \
+  } while (0)
+
+#define SKIP_INDEX_RESIZE(input_block, nodes_count)                            \
+  do {                                                                         \
+    if (SKIP_INDEX_MAINTAINED(input_block))                                    \
+      skip_index_resize(input_block, nodes_count);                             \
+  } while (0)
+
+#define SKIP_INDEX_NODE_CHANGED(input_block, node_index)                       \
+  do {                                                                         \
+    if (SKIP_INDEX_MAINTAINED(input_block))                                    \
+      skip_index_node_changed(input_block, node_index);                        \
+  } while (0)
+
+#define SKIP_INDEX_SET_CHILDLESS(input_block, node_index)                      \
+  do {                                                                         \
+    if (SKIP_INDEX_MAINTAINED(input_block))                                    \
+      skip_index_set_childless(input_block, node_index);                       \
+  } while (0)
+
+#else
+
+#define SKIP_INDEX_NOOP                                                        \
+  do {                                                                         \
+  } while (0)
+
+#define SKIP_INDEX_INVALIDATE(input_block) SKIP_INDEX_NOOP
+#define SKIP_INDEX_REFRESH(input_block) SKIP_INDEX_NOOP
+#define SKIP_INDEX_FREE(input_block) SKIP_INDEX_NOOP
+#define SKIP_INDEX_INSERT_NODES(input_block, node_index, nodes_count)          \
+  SKIP_INDEX_NOOP
+#define SKIP_INDEX_REMOVE_NODES(input_block, node_index, nodes_count)          \
+  SKIP_INDEX_NOOP
+#define SKIP_INDEX_RESIZE(input_block, nodes_count) SKIP_INDEX_NOOP
+#define SKIP_INDEX_NODE_CHANGED(input_block, node_index) SKIP_INDEX_NOOP
+#define SKIP_INDEX_SET_CHILDLESS(input_block, node_index) SKIP_INDEX_NOOP
+
+#endif /* BLOCK_SKIP_INDEX */
+
+#endif /* _BLOCK_SKIP_INDEX_H_ */
@@ -45,6 +45,14 @@ SOFTWARE.
 #define K2TREE_ERR_NULL_BITVECTOR 10
 #define K2TREE_ERR_NULL_BITVECTOR_CONTAINER 11
 #define INVALID_MC_VALUE 12
+#define SKIP_INDEX_ALLOCATION_FAILED 13
+#define READ_ONLY_QUERY_CONTEXT 14
+#define SHARED_TREE_LOCK_FAILED 15
+#define SNAPSHOT_IO_ERROR 16
+#define SNAPSHOT_INVALID_FORMAT 17
+#define PARALLEL_THREAD_FAILED 18
+#define CONTAINER_ALLOCATION_FAILED 19
+#define NO_SPLIT_LOCATION_FOUND 20
 
 // non error
 #define LAZY_STOP_ECODE_K2T 100
@@ -86,12 +94,24 @@ SOFTWARE.
 #define POP_COUNT(u32_input) __builtin_popcount(u32_input)
 #endif
 
+#ifndef CLZ64
+#define CLZ64(u64_input) __builtin_clzll(u64_input)
+#endif
+
+#ifndef CLZ32
+#define CLZ32(u32_input) __builtin_clz(u32_input)
+#endif
+
 #ifndef MAX_NODES_IN_BLOCK
 #define MAX_NODES_IN_BLOCK 256
 #endif
 #ifndef STARTING_BLOCK_CAPACITY
 #define STARTING_BLOCK_CAPACITY 64
 #endif
+/* Coordinates are 64 bits, so no tree is deeper */
+#ifndef MAX_TREE_DEPTH
+#define MAX_TREE_DEPTH 64
+#endif
 
 typedef struct pair2dl {
   uint64_t col;
@@ -100,21 +120,28 @@ typedef struct pair2dl {
 
 // typedef struct pair2dl pair2dl_t;
 
+/* A point tagged with its position in the caller's input, used by the batched
+ * operations to write results back after sorting */
+typedef struct indexed_pair2dl {
+  pair2dl_t point;
+  uint64_t index;
+} ipair2dl_t;
+
 typedef enum { COLUMN_COORD = 0, ROW_COORD = 1 } coord_t;
 
+/* Points kept by k2tree_set_operation_interactively: those in any of the two
+ * trees, in both or in the first one but not in the second */
+typedef enum {
+  SET_UNION = 0,
+  SET_INTERSECTION = 1,
+  SET_DIFFERENCE = 2
+} set_operation_t;
+
 struct sip_ipoint {
   uint64_t coord;
   coord_t coord_type;
 };
 
-struct node_subtree_info {
-  uint32_t node_index;
-  uint32_t node_relative_depth;
-  uint32_t subtree_size;
-};
-
-typedef struct node_subtree_info nsi_t;
-
 typedef uint8_t TREE_DEPTH_T;
 typedef uint16_t MAX_NODE_COUNT_T;
 typedef uint32_t BLOCK_INDEX_T;
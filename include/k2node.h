@@ -39,16 +39,53 @@ struct k2node {
     struct k2node *children[4];
     struct block *block_child;
   } k2subtree;
+#ifdef TREE_ALLOCATOR
+  /* Allocator of the whole tree, set by create_k2node. NULL for malloc */
+  const struct k2tree_allocator *allocator;
+#endif
+#ifdef POINT_COUNTS
+  /* Points below the k2node */
+  uint64_t points_count;
+#endif
 };
 
 int k2node_has_point(struct k2node *k2node, uint64_t col,
                      uint64_t row, struct k2qstate *st, int *result);
+int k2node_has_point_batch(struct k2node *root_node, const pair2dl_t *points,
+                           uint64_t points_count, struct k2qstate *st,
+                           int *results);
 int k2node_insert_point(struct k2node *input_node, uint64_t col,
                         uint64_t row, struct k2qstate *st,
                         int *already_exists);
+/* Builds a whole k2node tree from points sorted in morton order, see
+ * build_block_tree_from_sorted */
+struct k2node *k2node_build_from_sorted(const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct k2qstate *st);
+int k2node_insert_points_batch(struct k2node *root_node,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct k2qstate *st, uint64_t *inserted_count);
+/**
+ * @brief Inserts a batch of points using threads_count threads
+ *
+ * The points are grouped by the block tree under cut_depth they fall in, the
+ * missing k2nodes and block roots are created by the calling thread, then the
+ * block trees are filled in parallel, each thread with its own k2qstate built
+ * with the parameters of st. threads_count <= 1 is k2node_insert_points_batch.
+ */
+int k2node_insert_points_parallel(struct k2node *root_node,
+                                  const pair2dl_t *points,
+                                  uint64_t points_count, int threads_count,
+                                  struct k2qstate *st,
+                                  uint64_t *inserted_count);
 int k2node_delete_point(struct k2node *input_node, uint64_t col,
                         uint64_t row, struct k2qstate *st,
                         int *already_not_exists);
+/* Deletes a batch of points, see delete_points_batch. The k2nodes left
+ * without points are freed, as with k2node_delete_point. */
+int k2node_delete_points_batch(struct k2node *root_node,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct k2qstate *st, uint64_t *deleted_count);
 
 int k2node_naive_scan_points(struct k2node *input_node, struct k2qstate *st,
                              struct vector_pair2dl_t *result);
@@ -58,6 +95,23 @@ int k2node_scan_points_interactively(struct k2node *input_node,
                                      point_reporter_fun_t point_reporter,
                                      void *report_state);
 
+/* See k2tree_set_operation_interactively. Both trees must have the
+ * k2tree_depth and cut_depth of st */
+int k2node_set_operation_interactively(struct k2node *lhs, struct k2node *rhs,
+                                       set_operation_t operation,
+                                       struct k2qstate *st,
+                                       point_reporter_fun_t point_reporter,
+                                       void *report_state);
+
+/* See k2tree_union, k2tree_intersect and k2tree_difference. The result is
+ * built with k2node_build_from_sorted and freed with free_rec_k2node */
+int k2node_union(struct k2node *lhs, struct k2node *rhs, struct k2qstate *st,
+                 struct k2node **result);
+int k2node_intersect(struct k2node *lhs, struct k2node *rhs,
+                     struct k2qstate *st, struct k2node **result);
+int k2node_difference(struct k2node *lhs, struct k2node *rhs,
+                      struct k2qstate *st, struct k2node **result);
+
 int k2node_report_column(struct k2node *input_node, uint64_t col,
                          struct k2qstate *st, struct vector_pair2dl_t *result);
 int k2node_report_row(struct k2node *input_node, uint64_t row,
@@ -72,12 +126,102 @@ int k2node_report_row_interactively(struct k2node *input_node,
                                     point_reporter_fun_t point_reporter,
                                     void *report_state);
 
+/* Receives the points reported by the parallel scans in batches. Calls never
+ * overlap, but they come from different threads and in no particular order */
+typedef void (*points_batch_reporter_fun_t)(const pair2dl_t *points,
+                                            uint64_t points_count,
+                                            void *report_state);
+
+/**
+ * @brief Parallel versions of k2node_naive_scan_points, k2node_report_column
+ * and k2node_report_row
+ *
+ * Each block tree under cut_depth is a task, threads_count threads (the
+ * calling one included) take tasks until none is left. st only provides the
+ * tree parameters, it can be a read-only k2qstate. The _parallel versions
+ * leave in result the same points in the same order as the sequential ones,
+ * the _parallel_batched versions hand them to batch_reporter as each thread
+ * fills its buffer. Trees with cut_depth 0 are a single task.
+ */
+int k2node_naive_scan_points_parallel(struct k2node *input_node,
+                                      struct k2qstate *st, int threads_count,
+                                      struct vector_pair2dl_t *result);
+int k2node_report_column_parallel(struct k2node *input_node, uint64_t col,
+                                  struct k2qstate *st, int threads_count,
+                                  struct vector_pair2dl_t *result);
+int k2node_report_row_parallel(struct k2node *input_node, uint64_t row,
+                               struct k2qstate *st, int threads_count,
+                               struct vector_pair2dl_t *result);
+int k2node_scan_points_parallel_batched(
+    struct k2node *input_node, struct k2qstate *st, int threads_count,
+    points_batch_reporter_fun_t batch_reporter, void *report_state);
+int k2node_report_column_parallel_batched(
+    struct k2node *input_node, uint64_t col, struct k2qstate *st,
+    int threads_count, points_batch_reporter_fun_t batch_reporter,
+    void *report_state);
+int k2node_report_row_parallel_batched(
+    struct k2node *input_node, uint64_t row, struct k2qstate *st,
+    int threads_count, points_batch_reporter_fun_t batch_reporter,
+    void *report_state);
+
+int k2node_report_range(struct k2node *input_node, uint64_t col_lo,
+                        uint64_t col_hi, uint64_t row_lo, uint64_t row_hi,
+                        struct k2qstate *st, struct vector_pair2dl_t *result);
+int k2node_report_range_interactively(struct k2node *input_node,
+                                      uint64_t col_lo, uint64_t col_hi,
+                                      uint64_t row_lo, uint64_t row_hi,
+                                      struct k2qstate *st,
+                                      point_reporter_fun_t point_reporter,
+                                      void *report_state);
+
+/* Several rows or columns in one traversal, see report_rows in block.h */
+int k2node_report_rows(struct k2node *input_node, const uint64_t *rows,
+                       uint64_t rows_count, struct k2qstate *st,
+                       struct vector_pair2dl_t *result);
+int k2node_report_columns(struct k2node *input_node, const uint64_t *cols,
+                          uint64_t cols_count, struct k2qstate *st,
+                          struct vector_pair2dl_t *result);
+int k2node_report_rows_interactively(struct k2node *input_node,
+                                     const uint64_t *rows, uint64_t rows_count,
+                                     struct k2qstate *st,
+                                     point_reporter_fun_t point_reporter,
+                                     void *report_state);
+int k2node_report_columns_interactively(struct k2node *input_node,
+                                        const uint64_t *cols,
+                                        uint64_t cols_count,
+                                        struct k2qstate *st,
+                                        point_reporter_fun_t point_reporter,
+                                        void *report_state);
+
+/* Counting versions of the reports above, see count_points in block.h */
+int k2node_count_points(struct k2node *input_node, struct k2qstate *st,
+                        uint64_t *result);
+int k2node_count_column(struct k2node *input_node, uint64_t col,
+                        struct k2qstate *st, uint64_t *result);
+int k2node_count_row(struct k2node *input_node, uint64_t row,
+                     struct k2qstate *st, uint64_t *result);
+int k2node_count_range(struct k2node *input_node, uint64_t col_lo,
+                       uint64_t col_hi, uint64_t row_lo, uint64_t row_hi,
+                       struct k2qstate *st, uint64_t *result);
+
+#ifdef POINT_COUNTS
+/* k2node version of refresh_points_count, for the k2nodes and their block
+ * trees */
+int k2node_refresh_points_count(struct k2node *input_node,
+                                TREE_DEPTH_T treedepth,
+                                TREE_DEPTH_T cut_depth);
+#endif
+
 struct k2node *create_k2node(void);
 int free_rec_k2node(struct k2node *input_node, uint64_t current_depth,
                     uint64_t cut_depth);
 
 int init_k2qstate(struct k2qstate *st, TREE_DEPTH_T treedepth,
                   MAX_NODE_COUNT_T max_nodes_count, TREE_DEPTH_T cut_depth);
+/* k2qstate for reads only, see struct query_ctx. Each thread querying the
+ * same tree concurrently needs its own one */
+int init_k2qstate_read_only(struct k2qstate *st, TREE_DEPTH_T treedepth,
+                            TREE_DEPTH_T cut_depth);
 int clean_k2qstate(struct k2qstate *st);
 struct k2tree_measurement k2node_measure_tree_size(struct k2node *input_node,
                                                    uint64_t cut_depth);
@@ -130,6 +274,54 @@ define_stack_of_type(k2node_lazy_report_band_state_t)
   uint64_t coord_report;
 };
 
+typedef struct {
+  struct k2node *input_node;
+  struct report_range range;
+  uint32_t last_iteration;
+  uint64_t current_depth;
+} k2node_lazy_report_range_state_t;
+
+define_stack_of_type(k2node_lazy_report_range_state_t)
+
+    struct k2node_lazy_handler_report_range_t {
+  struct k2qstate *st;
+  struct k2node_lazy_report_range_state_t_stack stack;
+  struct lazy_handler_report_range_t sub_handler;
+  int at_leaf;
+  pair2dl_t next_result;
+  int has_next;
+  int empty_range;
+  uint64_t base_col;
+  uint64_t base_row;
+  struct report_range range;
+  struct k2node *tree_root;
+};
+
+typedef struct {
+  struct k2node *input_node;
+  uint64_t coords_lo;
+  uint64_t coords_hi;
+  uint32_t last_iteration;
+  uint64_t current_depth;
+} k2node_lazy_report_bands_state_t;
+
+define_stack_of_type(k2node_lazy_report_bands_state_t)
+
+    struct k2node_lazy_handler_report_bands_t {
+  struct k2qstate *st;
+  struct k2node_lazy_report_bands_state_t_stack stack;
+  struct lazy_handler_report_bands_t sub_handler;
+  int which_report;
+  int at_leaf;
+  pair2dl_t next_result;
+  int has_next;
+  uint64_t base_col;
+  uint64_t base_row;
+  uint64_t *coords;
+  uint64_t coords_count;
+  struct k2node *tree_root;
+};
+
 int k2node_naive_scan_points_lazy_init(
     struct k2node *input_node, struct k2qstate *st,
     struct k2node_lazy_handler_naive_scan_t *lazy_handler);
@@ -146,6 +338,11 @@ int k2node_naive_scan_points_lazy_has_next(
 int k2node_naive_scan_points_lazy_reset(
     struct k2node_lazy_handler_naive_scan_t *lazy_handler);
 
+/* See naive_scan_points_lazy_seek */
+int k2node_naive_scan_points_lazy_seek(
+    struct k2node_lazy_handler_naive_scan_t *lazy_handler, uint64_t col,
+    uint64_t row);
+
 int k2node_report_row_lazy_init(
     struct k2node_lazy_handler_report_band_t *lazy_handler,
     struct k2node *input_node, struct k2qstate *st, uint64_t coord);
@@ -164,6 +361,42 @@ int k2node_report_band_has_next(
 int k2node_report_band_reset(
     struct k2node_lazy_handler_report_band_t *lazy_handler);
 
+/* See report_band_seek */
+int k2node_report_band_seek(
+    struct k2node_lazy_handler_report_band_t *lazy_handler, uint64_t coord);
+
+int k2node_report_range_lazy_init(
+    struct k2node_lazy_handler_report_range_t *lazy_handler,
+    struct k2node *input_node, struct k2qstate *st, uint64_t col_lo,
+    uint64_t col_hi, uint64_t row_lo, uint64_t row_hi);
+int k2node_report_range_lazy_clean(
+    struct k2node_lazy_handler_report_range_t *lazy_handler);
+int k2node_report_range_next(
+    struct k2node_lazy_handler_report_range_t *lazy_handler,
+    pair2dl_t *result);
+int k2node_report_range_has_next(
+    struct k2node_lazy_handler_report_range_t *lazy_handler, int *result);
+int k2node_report_range_reset(
+    struct k2node_lazy_handler_report_range_t *lazy_handler);
+
+int k2node_report_rows_lazy_init(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler,
+    struct k2node *input_node, struct k2qstate *st, const uint64_t *rows,
+    uint64_t rows_count);
+int k2node_report_columns_lazy_init(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler,
+    struct k2node *input_node, struct k2qstate *st, const uint64_t *cols,
+    uint64_t cols_count);
+int k2node_report_bands_lazy_clean(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler);
+int k2node_report_bands_next(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler,
+    pair2dl_t *result);
+int k2node_report_bands_has_next(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler, int *result);
+int k2node_report_bands_reset(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler);
+
 int print_debug_k2node(struct k2node *node, struct k2qstate *st);
 
 #endif
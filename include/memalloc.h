@@ -24,21 +24,90 @@ SOFTWARE.
 #ifndef _MEMALLOC_H_
 #define _MEMALLOC_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "bitvector.h"
+
 struct block;
 struct block_topology;
 struct block_frontier;
 
 struct bitvector;
 struct k2node;
+struct block_skip_index;
+struct skip_index_chunk;
+
+/**
+ * @brief Hooks serving the memory of the trees: containers, preorders,
+ * children arrays, blocks and k2nodes
+ *
+ * allocate returns memory aligned for any type, release gets the pointers
+ * returned by allocate, never NULL. ctx is passed back to all of them.
+ *
+ * reallocate is optional, it resizes a block of old_size bytes to new_size
+ * keeping its first min(old_size, new_size) bytes, in place when it can, and
+ * returns NULL on failure leaving ptr untouched. When NULL, containers are
+ * resized with allocate, a copy and release.
+ */
+struct k2tree_allocator {
+  void *(*allocate)(void *ctx, size_t size);
+  void (*release)(void *ctx, void *ptr);
+  void *ctx;
+  void *(*reallocate)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+};
+
+/* Allocator used by the threads with none bound, NULL for malloc. Must not
+ * change while a tree allocated with the previous one is being used */
+void k2tree_set_default_allocator(const struct k2tree_allocator *allocator);
+/* Binds allocator to the calling thread, NULL to use the default. Returns the
+ * binding it replaces */
+const struct k2tree_allocator *
+k2tree_bind_allocator(const struct k2tree_allocator *allocator);
+/* Allocator serving the calling thread: the bound one, otherwise the default.
+ * NULL for malloc. With TREE_ALLOCATOR trees record it when they are created */
+const struct k2tree_allocator *k2tree_current_allocator(void);
+
+#ifdef TREE_ALLOCATOR
+
+/* Records the allocator serving the thread on the root of a new tree */
+#define TREE_ALLOCATOR_RECORD(root)                                            \
+  ((root)->allocator = k2tree_current_allocator())
+/* Binds the allocator of the tree at root until TREE_ALLOCATOR_LEAVE */
+#define TREE_ALLOCATOR_ENTER(root)                                             \
+  const struct k2tree_allocator *previous_allocator =                          \
+      k2tree_bind_allocator((root)->allocator)
+#define TREE_ALLOCATOR_LEAVE() k2tree_bind_allocator(previous_allocator)
+
+#else
+
+/* Trees are served by the allocator bound while they are used */
+#define TREE_ALLOCATOR_NOOP                                                    \
+  do {                                                                         \
+  } while (0)
+#define TREE_ALLOCATOR_RECORD(root) TREE_ALLOCATOR_NOOP
+#define TREE_ALLOCATOR_ENTER(root) TREE_ALLOCATOR_NOOP
+#define TREE_ALLOCATOR_LEAVE() TREE_ALLOCATOR_NOOP
+
+#endif /* TREE_ALLOCATOR */
 
 struct block *k2tree_alloc_block(void);
 
-uint32_t *k2tree_alloc_u32array(int size);
+/* Containers of the blocks, sizes are in BVCTYPE words */
+BVCTYPE *k2tree_alloc_container(int size);
+/* Resizes data from old_size to new_size words, zeroing the words added.
+ * Returns NULL on failure, leaving data untouched */
+BVCTYPE *k2tree_realloc_container(BVCTYPE *data, int old_size, int new_size);
 
 int k2tree_free_block(struct block *);
+int k2tree_free_container(BVCTYPE *data, int size);
+
+#ifndef BVCTYPE_64
+/* Former names of k2tree_alloc_container and k2tree_free_container, kept for
+ * existing callers. The library itself only calls the new ones */
+uint32_t *k2tree_alloc_u32array(int size);
 int k2tree_free_u32array(uint32_t *data, int size);
+#endif
 
 void *k2tree_alloc_preorders(int capacity);
 struct block *k2tree_alloc_blocks_array(int capacity);
@@ -48,4 +117,12 @@ void k2tree_free_blocks_array(struct block *blocks_array);
 
 struct k2node *k2tree_allocate_k2node(void);
 void k2tree_free_k2node(struct k2node *node);
+
+/* Index with room for chunks_capacity chunks and none in use */
+struct block_skip_index *k2tree_alloc_skip_index(int chunks_capacity);
+/* Returns NULL on failure, leaving chunks untouched */
+struct skip_index_chunk *
+k2tree_realloc_skip_index_chunks(struct skip_index_chunk *chunks,
+                                 int chunks_capacity);
+void k2tree_free_skip_index(struct block_skip_index *skip_index);
 #endif /* __MEMALLOC_H_ */
@@ -28,10 +28,12 @@ SOFTWARE.
 
 #include "definitions.h"
 
-#define MC_CONTAINER_T uint8_t
-
+/* The code of the level i is packed as the bit (treedepth - i - 1) of
+ * col_bits (column half) and of row_bits (row half), so both words are the
+ * coordinates of the point and the conversions are shifts and masks */
 struct morton_code {
-  MC_CONTAINER_T *container;
+  uint64_t col_bits;
+  uint64_t row_bits;
   uint32_t treedepth;
 };
 
@@ -52,4 +54,20 @@ int convert_morton_code_to_coordinates(struct morton_code *input_mc,
 int convert_morton_code_to_coordinates_select_treedepth(
     struct morton_code *input_mc, struct pair2dl *result,
     TREE_DEPTH_T treedepth);
+
+/* Quadrant (0..3) of the point at the given depth, same encoding as the codes
+ * stored in a morton code */
+#define MORTON_CODE_AT(col, row, treedepth, depth)                             \
+  ((uint32_t)(((((col) >> ((treedepth) - (depth)-1)) & 1UL) << 1) |            \
+              (((row) >> ((treedepth) - (depth)-1)) & 1UL)))
+
+/* TRUE if the node at the given depth holding coordinate a also holds
+ * coordinate b */
+#define SAME_NODE_AT(a, b, treedepth, depth)                                   \
+  ((depth) == 0 || ((((a) ^ (b)) >> ((treedepth) - (depth))) == 0))
+
+int compare_points_morton_order(const pair2dl_t *lhs, const pair2dl_t *rhs);
+void sort_points_morton_order(pair2dl_t *points, uint64_t points_count);
+void sort_indexed_points_morton_order(ipair2dl_t *points,
+                                      uint64_t points_count);
 #endif /* _MORTON_CODE_H */
@@ -30,12 +30,11 @@ SOFTWARE.
 #include "memalloc.h"
 #include "morton_code.h"
 #include "stacks.h"
+#include "vector.h"
 
 struct sequential_scan_result {
   uint32_t child_preorder;
   uint32_t node_relative_depth;
-  uint32_t *subtrees_count_map;
-  uint32_t *relative_depth_map;
 };
 
 #ifdef DEBUG_STATS
@@ -43,17 +42,42 @@ struct debug_stats {
   uint64_t time_on_sequential_scan;
   uint64_t time_on_frontier_check;
   uint64_t split_count;
+  uint64_t time_on_split;
 };
 #endif
 
+/* Blocks whose root is at a depth lower than LEVEL_THRESHOLD_1 hold at most
+ * MAX_NODES_LEVEL_1 nodes, and lower than LEVEL_THRESHOLD_2 at most
+ * MAX_NODES_LEVEL_2. The rest can have up to max_nodes_count */
+#define LEVEL_THRESHOLD_1 4
+#define LEVEL_THRESHOLD_2 8
+#define MAX_NODES_LEVEL_1 64
+#define MAX_NODES_LEVEL_2 128
+
+/* Compaction queues shorter than this are never deduplicated */
+#define COMPACTION_DEDUP_MIN_CANDIDATES 64
+
+/* Value of block_growth_percent rounding the containers of the blocks that
+ * grow up to the next power of two of nodes */
+#define BLOCK_GROWTH_POWER_OF_TWO 0
+
 struct block;
 
+/* Block left for compact_block_tree by a deletion: the one whose root is the
+ * node at depth holding (col, row). Blocks are kept by value in the arrays of
+ * their parents, which move, so they are found again from the root */
+typedef struct compaction_candidate {
+  uint64_t col;
+  uint64_t row;
+  TREE_DEPTH_T depth;
+} compaction_candidate_t;
+
+define_cvector(compaction_candidate_t, long)
+
 struct queries_state {
   struct morton_code mc;
   struct sequential_scan_result sc_result;
   struct int_stack not_yet_traversed;
-  struct nsi_t_stack subtrees_count;
-  int find_split_data;
   MAX_NODE_COUNT_T max_nodes_count;
   TREE_DEPTH_T treedepth;
 
@@ -63,16 +87,62 @@ struct queries_state {
   int max_nodes_1;
   int max_nodes_2;
 
+  /* Slack given to a block whose container has to grow.
+   * BLOCK_GROWTH_POWER_OF_TWO (the default) rounds it up to a power of two
+   * nodes, any other value gives it room for that percent of the nodes it
+   * needs (125 for 1.25x), in whole words and up to the max of its level.
+   * Values up to 100 grow the blocks to the exact word they need */
+  uint32_t block_growth_percent;
+
   struct block *root;
+  /* Set for the state of a query_ctx, which can't be used to modify a tree */
+  int read_only;
+  /* When set, deletions through this state leave merging children blocks and
+   * shrinking containers to compact_block_tree and queue the blocks to look
+   * at in compaction_candidates. FALSE by default */
+  int deferred_compaction;
+  struct vector_compaction_candidate_t compaction_candidates;
+  /* Candidates left by the last deduplication of the queue, which runs again
+   * once the queue doubles */
+  long compaction_candidates_deduped;
 #ifdef DEBUG_STATS
   struct debug_stats dstats;
 #endif
+#ifdef POINT_COUNTS
+  /* Blocks entered by the last find_point, from the one it started at. An
+   * insertion adds its point to the counts of all of them */
+  struct block *points_path[MAX_TREE_DEPTH + 1];
+  uint32_t points_path_length;
+#endif
+};
+
+/**
+ * @brief Lightweight state for read operations only
+ *
+ * Holds the morton code and the scan stack used while traversing, without the
+ * limits and settings that only modifications use. Pass &ctx->qs to any of
+ * the read functions (has_point, has_point_batch, report_*, scans and their
+ * lazy handlers). Functions modifying the tree return READ_ONLY_QUERY_CONTEXT.
+ *
+ * Any number of threads can query the same tree at once, each one with its
+ * own query_ctx, as long as nothing modifies the tree meanwhile (see
+ * shared_tree.h for mixed workloads). Reads don't change the nodes, but with
+ * BLOCK_SKIP_INDEX they store the skip index they build for a big block
+ * which has none. It is published with an atomic compare and swap, so
+ * concurrent readers keep the first one, which is only safe while no writer
+ * is active. Builds with DEBUG_STATS are not thread safe, their timers are
+ * global.
+ */
+struct query_ctx {
+  struct queries_state qs;
 };
 
 struct deletion_state {
   struct morton_code mc;
   struct int_stack nodes_to_delete;
   struct queries_state *qs;
+  /* Depth of the root of the last block reached by the deletion */
+  TREE_DEPTH_T last_block_depth;
 };
 
 int init_queries_state(struct queries_state *qs, uint32_t tree_depth,
@@ -80,4 +150,13 @@ int init_queries_state(struct queries_state *qs, uint32_t tree_depth,
                        struct block *root_block);
 int finish_queries_state(struct queries_state *qs);
 
+/* Initializes qs in read-only mode, as in a query_ctx */
+int init_read_only_queries_state(struct queries_state *qs,
+                                 uint32_t tree_depth,
+                                 struct block *root_block);
+
+int init_query_ctx(struct query_ctx *ctx, uint32_t tree_depth,
+                   struct block *root_block);
+int finish_query_ctx(struct query_ctx *ctx);
+
 #endif /* _QUERIES_STATE_H */
@@ -0,0 +1,119 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _SHARED_TREE_H_
+#define _SHARED_TREE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "block.h"
+#include "definitions.h"
+#include "queries_state.h"
+
+/**
+ * @brief Block tree guarded by a reader-writer lock, for workloads mixing
+ * queries and updates from several threads
+ *
+ * Reads take the lock in shared mode, so they run in parallel with each other;
+ * every reading thread brings its own query_ctx (see
+ * init_shared_tree_query_ctx). Insertions and deletions take the lock in
+ * exclusive mode and use the queries_state owned by the tree.
+ *
+ * Any read function of block.h can be run between shared_tree_read_lock and
+ * shared_tree_read_unlock with the qs of a query_ctx. The lock functions return
+ * SHARED_TREE_LOCK_FAILED if pthread fails.
+ *
+ * shared_tree_start_compaction turns on writer_qs.deferred_compaction and
+ * leaves the merges and container shrinking of the deletions to a background
+ * thread, which runs compact_block_tree under the write lock in short steps.
+ */
+struct shared_block_tree {
+  struct block *root;
+  struct queries_state writer_qs;
+  pthread_rwlock_t lock;
+
+  /* Background compaction, guarded by compaction_lock */
+  pthread_t compaction_thread;
+  pthread_mutex_t compaction_lock;
+  pthread_cond_t compaction_wakeup;
+  int compaction_running;
+  int compaction_stop;
+  uint32_t compaction_interval_ms;
+  uint64_t compaction_budget_us;
+  /* First error of compact_block_tree in the thread */
+  int compaction_err;
+};
+
+int init_shared_block_tree(struct shared_block_tree *tree, uint32_t treedepth,
+                           MAX_NODE_COUNT_T max_nodes_count);
+int free_shared_block_tree(struct shared_block_tree *tree);
+
+int init_shared_tree_query_ctx(struct shared_block_tree *tree,
+                               struct query_ctx *ctx);
+
+int shared_tree_read_lock(struct shared_block_tree *tree);
+int shared_tree_read_unlock(struct shared_block_tree *tree);
+
+int shared_tree_has_point(struct shared_block_tree *tree, uint64_t col,
+                          uint64_t row, struct query_ctx *ctx, int *result);
+int shared_tree_report_range_interactively(
+    struct shared_block_tree *tree, uint64_t col_lo, uint64_t col_hi,
+    uint64_t row_lo, uint64_t row_hi, struct query_ctx *ctx,
+    point_reporter_fun_t point_reporter, void *report_state);
+
+int shared_tree_insert_point(struct shared_block_tree *tree, uint64_t col,
+                             uint64_t row, int *already_exists);
+int shared_tree_insert_points_batch(struct shared_block_tree *tree,
+                                    const pair2dl_t *points,
+                                    uint64_t points_count,
+                                    uint64_t *inserted_count);
+int shared_tree_delete_point(struct shared_block_tree *tree, uint64_t col,
+                             uint64_t row, int *already_not_exists);
+int shared_tree_delete_points_batch(struct shared_block_tree *tree,
+                                    const pair2dl_t *points,
+                                    uint64_t points_count,
+                                    uint64_t *deleted_count);
+
+/* Runs compact_block_tree on the tree under the write lock */
+int shared_tree_compact(struct shared_block_tree *tree,
+                        uint64_t time_budget_us, uint64_t *pending_count);
+
+/**
+ * @brief Starts a thread compacting the tree after deletions
+ *
+ * Sets writer_qs.deferred_compaction, so deletions only clear bits and remove
+ * nodes. The thread takes the write lock for at most about time_budget_us at a
+ * time and releases it between steps. It sleeps interval_ms once nothing is
+ * queued. Does nothing if the thread is already running.
+ */
+int shared_tree_start_compaction(struct shared_block_tree *tree,
+                                 uint32_t interval_ms,
+                                 uint64_t time_budget_us);
+
+/* Stops the compaction thread and turns deferred_compaction off, returning the
+ * first error the thread got. Blocks still queued stay there until the next
+ * shared_tree_compact */
+int shared_tree_stop_compaction(struct shared_block_tree *tree);
+
+#endif /* _SHARED_TREE_H_ */
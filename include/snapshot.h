@@ -0,0 +1,110 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <stdint.h>
+
+#include "block.h"
+#include "definitions.h"
+#include "k2node.h"
+
+/* On-disk format of a tree, in the byte order of the machine writing it:
+ *
+ *   struct snapshot_header
+ *   struct snapshot_k2node_record[k2nodes_count]
+ *   struct snapshot_block_record[blocks_count]
+ *   containers and preorders of every block, aligned to sizeof(BVCTYPE)
+ *
+ * Blocks are numbered so that the children of a block are consecutive, the
+ * same layout children_blocks has in memory, and the roots of the block trees
+ * come first. For a block tree the root is the block 0. For a k2node tree the
+ * root is the k2node 0; the k2nodes at cut_depth link to the root of their
+ * block tree. Links are indexes plus one, 0 being NULL. */
+
+#define SNAPSHOT_MAGIC "K2DYNSNP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER_MARK 0x01020304U
+
+#define SNAPSHOT_KIND_BLOCK_TREE 0
+#define SNAPSHOT_KIND_K2NODE_TREE 1
+
+struct snapshot_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order_mark;
+  uint32_t kind;
+  uint32_t nodes_bv_size; /* sizeof(NODES_BV_T) of the writer */
+  uint32_t treedepth;
+  uint32_t cut_depth;
+  uint32_t bvctype_size; /* sizeof(BVCTYPE) of the writer */
+  uint32_t padding;
+  uint64_t k2nodes_count;
+  uint64_t blocks_count;
+  uint64_t file_size;
+};
+
+struct snapshot_k2node_record {
+  uint64_t links[4]; /* children, or links[0] = block tree root at cut_depth */
+  uint64_t at_cut_depth;
+};
+
+struct snapshot_block_record {
+  uint64_t container_offset;
+  uint64_t preorders_offset;
+  uint64_t first_child;
+  uint32_t container_size;
+  uint32_t nodes_count;
+  uint32_t children;
+  uint32_t padding;
+};
+
+/**
+ * @brief Tree served from a mapped snapshot file
+ *
+ * The topology containers and preorders are read from the mapping, only the
+ * block and k2node structs are allocated. The tree is read-only: query it with
+ * a query_ctx (or init_k2qstate_read_only), modifying it faults.
+ */
+struct k2tree_snapshot {
+  void *mapping;
+  uint64_t mapping_size;
+  struct block *blocks;
+  struct k2node *k2nodes;
+  uint64_t blocks_count;
+  /* root_block for block trees, root_node for k2node trees, the other NULL */
+  struct block *root_block;
+  struct k2node *root_node;
+  TREE_DEPTH_T treedepth;
+  TREE_DEPTH_T cut_depth;
+};
+
+int k2tree_save(struct block *root_block, TREE_DEPTH_T treedepth, int fd);
+int k2tree_save_k2node(struct k2node *root_node, TREE_DEPTH_T treedepth,
+                       TREE_DEPTH_T cut_depth, int fd);
+
+int k2tree_load_mmap(const char *path, struct k2tree_snapshot *snapshot);
+int k2tree_snapshot_close(struct k2tree_snapshot *snapshot);
+
+#endif /* _SNAPSHOT_H_ */
@@ -27,6 +27,6 @@ SOFTWARE.
 #include "definitions.h"
 #include "stack_creator.h"
 
-define_stack_of_type(int) define_stack_of_type(nsi_t)
+define_stack_of_type(int)
 
 #endif
@@ -0,0 +1,226 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "arena_memalloc.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE ((size_t)1 << 16)
+#define ARENA_SIZE_CLASSES 16
+#define ARENA_LARGE_CLASS ARENA_SIZE_CLASSES
+/* keeps the objects after the header 16 bytes aligned */
+#define ARENA_CHUNK_HEADER_SIZE                                                \
+  ((sizeof(struct arena_chunk) + 15) & ~(size_t)15)
+
+/* Containers are powers of two bytes, frontier arrays multiples of
+ * sizeof(NODES_BV_T) and sizeof(struct block), the classes in between halve
+ * the waste for those */
+static const size_t arena_class_sizes[ARENA_SIZE_CLASSES] = {
+    16,  32,  48,   64,   96,   128,  192,  256,
+    384, 512, 768, 1024, 1536, 2048, 3072, 4096};
+
+/* Chunks are ARENA_CHUNK_SIZE aligned, so the chunk of an object is found by
+ * masking its address */
+struct arena_chunk {
+  struct arena_chunk *prev;
+  struct arena_chunk *next;
+  size_t bytes;
+  uint32_t size_class;
+};
+
+struct arena_free_object {
+  struct arena_free_object *next;
+};
+
+struct k2tree_arena {
+  pthread_mutex_t lock;
+  struct arena_chunk *chunks;
+  struct arena_free_object *free_lists[ARENA_SIZE_CLASSES];
+  char *bump[ARENA_SIZE_CLASSES];
+  char *bump_end[ARENA_SIZE_CLASSES];
+  uint64_t chunks_count;
+  uint64_t reserved_bytes;
+};
+
+/* PRIVATE FUNCTIONS PROTOTYPES */
+static uint32_t arena_size_class(size_t size);
+static struct arena_chunk *arena_new_chunk(struct k2tree_arena *arena,
+                                           size_t bytes, uint32_t size_class);
+static void *arena_allocate(void *ctx, size_t size);
+static void arena_release(void *ctx, void *ptr);
+static void *arena_reallocate(void *ctx, void *ptr, size_t old_size,
+                              size_t new_size);
+/* END PRIVATE FUNCTIONS PROTOTYPES */
+
+/* PRIVATE FUNCTIONS IMPLEMENTATIONS */
+static uint32_t arena_size_class(size_t size) {
+  for (uint32_t i = 0; i < ARENA_SIZE_CLASSES; i++) {
+    if (size <= arena_class_sizes[i])
+      return i;
+  }
+  return ARENA_LARGE_CLASS;
+}
+
+static struct arena_chunk *arena_new_chunk(struct k2tree_arena *arena,
+                                           size_t bytes, uint32_t size_class) {
+  void *memory;
+  if (posix_memalign(&memory, ARENA_CHUNK_SIZE, bytes) != 0)
+    return NULL;
+  struct arena_chunk *chunk = (struct arena_chunk *)memory;
+  chunk->prev = NULL;
+  chunk->next = arena->chunks;
+  chunk->bytes = bytes;
+  chunk->size_class = size_class;
+  if (arena->chunks)
+    arena->chunks->prev = chunk;
+  arena->chunks = chunk;
+  arena->chunks_count++;
+  arena->reserved_bytes += bytes;
+  return chunk;
+}
+
+static void *arena_allocate(void *ctx, size_t size) {
+  struct k2tree_arena *arena = (struct k2tree_arena *)ctx;
+  uint32_t size_class = arena_size_class(size);
+  void *result = NULL;
+
+  pthread_mutex_lock(&arena->lock);
+  if (size_class == ARENA_LARGE_CLASS) {
+    struct arena_chunk *chunk = arena_new_chunk(
+        arena, ARENA_CHUNK_HEADER_SIZE + size, ARENA_LARGE_CLASS);
+    if (chunk)
+      result = (char *)chunk + ARENA_CHUNK_HEADER_SIZE;
+  } else if (arena->free_lists[size_class]) {
+    struct arena_free_object *object = arena->free_lists[size_class];
+    arena->free_lists[size_class] = object->next;
+    result = object;
+  } else {
+    size_t class_size = arena_class_sizes[size_class];
+    if (arena->bump_end[size_class] - arena->bump[size_class] <
+        (ptrdiff_t)class_size) {
+      struct arena_chunk *chunk =
+          arena_new_chunk(arena, ARENA_CHUNK_SIZE, size_class);
+      if (chunk) {
+        arena->bump[size_class] = (char *)chunk + ARENA_CHUNK_HEADER_SIZE;
+        arena->bump_end[size_class] = (char *)chunk + ARENA_CHUNK_SIZE;
+      }
+    }
+    if (arena->bump_end[size_class] - arena->bump[size_class] >=
+        (ptrdiff_t)class_size) {
+      result = arena->bump[size_class];
+      arena->bump[size_class] += class_size;
+    }
+  }
+  pthread_mutex_unlock(&arena->lock);
+  return result;
+}
+
+static void arena_release(void *ctx, void *ptr) {
+  struct k2tree_arena *arena = (struct k2tree_arena *)ctx;
+  struct arena_chunk *chunk =
+      (struct arena_chunk *)((uintptr_t)ptr & ~(uintptr_t)(ARENA_CHUNK_SIZE - 1));
+
+  pthread_mutex_lock(&arena->lock);
+  if (chunk->size_class == ARENA_LARGE_CLASS) {
+    if (chunk->prev)
+      chunk->prev->next = chunk->next;
+    else
+      arena->chunks = chunk->next;
+    if (chunk->next)
+      chunk->next->prev = chunk->prev;
+    arena->chunks_count--;
+    arena->reserved_bytes -= chunk->bytes;
+    free(chunk);
+  } else {
+    struct arena_free_object *object = (struct arena_free_object *)ptr;
+    object->next = arena->free_lists[chunk->size_class];
+    arena->free_lists[chunk->size_class] = object;
+  }
+  pthread_mutex_unlock(&arena->lock);
+}
+/* Objects of a size class have room for any size up to the class size, so
+ * containers growing within their class stay in place */
+static void *arena_reallocate(void *ctx, void *ptr, size_t old_size,
+                              size_t new_size) {
+  uint32_t old_class = arena_size_class(old_size);
+  if (old_class != ARENA_LARGE_CLASS &&
+      arena_size_class(new_size) == old_class)
+    return ptr;
+
+  void *result = arena_allocate(ctx, new_size);
+  if (!result)
+    return NULL;
+  memcpy(result, ptr, old_size < new_size ? old_size : new_size);
+  arena_release(ctx, ptr);
+  return result;
+}
+/* END PRIVATE FUNCTIONS IMPLEMENTATIONS */
+
+/* PUBLIC FUNCTIONS */
+struct k2tree_arena *k2tree_arena_create(void) {
+  struct k2tree_arena *arena =
+      (struct k2tree_arena *)calloc(1, sizeof(struct k2tree_arena));
+  if (!arena)
+    return NULL;
+  if (pthread_mutex_init(&arena->lock, NULL) != 0) {
+    free(arena);
+    return NULL;
+  }
+  return arena;
+}
+
+void k2tree_arena_destroy(struct k2tree_arena *arena) {
+  struct arena_chunk *chunk = arena->chunks;
+  while (chunk) {
+    struct arena_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  pthread_mutex_destroy(&arena->lock);
+  free(arena);
+}
+
+struct k2tree_allocator k2tree_arena_allocator(struct k2tree_arena *arena) {
+  struct k2tree_allocator allocator;
+  allocator.allocate = arena_allocate;
+  allocator.release = arena_release;
+  allocator.ctx = arena;
+  allocator.reallocate = arena_reallocate;
+  return allocator;
+}
+
+uint64_t k2tree_arena_reserved_bytes(struct k2tree_arena *arena) {
+  pthread_mutex_lock(&arena->lock);
+  uint64_t result = arena->reserved_bytes;
+  pthread_mutex_unlock(&arena->lock);
+  return result;
+}
+
+uint64_t k2tree_arena_chunks_count(struct k2tree_arena *arena) {
+  pthread_mutex_lock(&arena->lock);
+  uint64_t result = arena->chunks_count;
+  pthread_mutex_unlock(&arena->lock);
+  return result;
+}
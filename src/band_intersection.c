@@ -0,0 +1,241 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdlib.h>
+
+#include "band_intersection.h"
+
+/* Leaves the bands at the lowest coordinate not lower than their current ones
+ * that all of them report, or sets has_next to FALSE if there is none */
+static int band_intersection_find(
+    struct lazy_handler_band_intersection_t *lazy_handler) {
+  lazy_handler->has_next = FALSE;
+  if (lazy_handler->bands_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  for (;;) {
+    uint64_t target = 0;
+    for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+      struct lazy_handler_report_band_t *band = &lazy_handler->bands[i];
+      if (!band->has_next) {
+        return SUCCESS_ECODE_K2T;
+      }
+      if (band->next_result > target) {
+        target = band->next_result;
+      }
+    }
+
+    int all_at_target = TRUE;
+    for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+      struct lazy_handler_report_band_t *band = &lazy_handler->bands[i];
+      CHECK_ERR(report_band_seek(band, target));
+      if (!band->has_next) {
+        return SUCCESS_ECODE_K2T;
+      }
+      all_at_target = all_at_target && band->next_result == target;
+    }
+
+    if (all_at_target) {
+      lazy_handler->next_result = target;
+      lazy_handler->has_next = TRUE;
+      return SUCCESS_ECODE_K2T;
+    }
+  }
+}
+
+int band_intersection_lazy_init(
+    struct lazy_handler_band_intersection_t *lazy_handler,
+    const struct band_spec *specs, uint32_t specs_count) {
+  lazy_handler->bands_count = specs_count;
+  lazy_handler->bands = (struct lazy_handler_report_band_t *)malloc(
+      sizeof(struct lazy_handler_report_band_t) * (specs_count + 1));
+  for (uint32_t i = 0; i < specs_count; i++) {
+    const struct band_spec *spec = &specs[i];
+    if (spec->which_report == REPORT_ROW) {
+      CHECK_ERR(report_row_lazy_init(&lazy_handler->bands[i], spec->tree,
+                                     spec->qs, spec->coord));
+    } else {
+      CHECK_ERR(report_column_lazy_init(&lazy_handler->bands[i], spec->tree,
+                                        spec->qs, spec->coord));
+    }
+  }
+  return band_intersection_find(lazy_handler);
+}
+
+int band_intersection_lazy_clean(
+    struct lazy_handler_band_intersection_t *lazy_handler) {
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    CHECK_ERR(report_band_lazy_clean(&lazy_handler->bands[i]));
+  }
+  free(lazy_handler->bands);
+  lazy_handler->bands = NULL;
+  lazy_handler->bands_count = 0;
+  return SUCCESS_ECODE_K2T;
+}
+
+int band_intersection_next(
+    struct lazy_handler_band_intersection_t *lazy_handler, uint64_t *result) {
+  *result = lazy_handler->next_result;
+  if (!lazy_handler->has_next) {
+    return SUCCESS_ECODE_K2T;
+  }
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    uint64_t reported;
+    CHECK_ERR(report_band_next(&lazy_handler->bands[i], &reported));
+  }
+  return band_intersection_find(lazy_handler);
+}
+
+int band_intersection_has_next(
+    struct lazy_handler_band_intersection_t *lazy_handler, int *result) {
+  *result = lazy_handler->has_next;
+  return SUCCESS_ECODE_K2T;
+}
+
+int band_intersection_reset(
+    struct lazy_handler_band_intersection_t *lazy_handler) {
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    CHECK_ERR(report_band_reset(&lazy_handler->bands[i]));
+  }
+  return band_intersection_find(lazy_handler);
+}
+
+int band_intersection_seek(
+    struct lazy_handler_band_intersection_t *lazy_handler, uint64_t coord) {
+  if (!lazy_handler->has_next || lazy_handler->next_result >= coord) {
+    return SUCCESS_ECODE_K2T;
+  }
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    CHECK_ERR(report_band_seek(&lazy_handler->bands[i], coord));
+  }
+  return band_intersection_find(lazy_handler);
+}
+
+static int k2node_band_intersection_find(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler) {
+  lazy_handler->has_next = FALSE;
+  if (lazy_handler->bands_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  for (;;) {
+    uint64_t target = 0;
+    for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+      struct k2node_lazy_handler_report_band_t *band = &lazy_handler->bands[i];
+      if (!band->has_next) {
+        return SUCCESS_ECODE_K2T;
+      }
+      if (band->next_result > target) {
+        target = band->next_result;
+      }
+    }
+
+    int all_at_target = TRUE;
+    for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+      struct k2node_lazy_handler_report_band_t *band = &lazy_handler->bands[i];
+      CHECK_ERR(k2node_report_band_seek(band, target));
+      if (!band->has_next) {
+        return SUCCESS_ECODE_K2T;
+      }
+      all_at_target = all_at_target && band->next_result == target;
+    }
+
+    if (all_at_target) {
+      lazy_handler->next_result = target;
+      lazy_handler->has_next = TRUE;
+      return SUCCESS_ECODE_K2T;
+    }
+  }
+}
+
+int k2node_band_intersection_lazy_init(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler,
+    const struct k2node_band_spec *specs, uint32_t specs_count) {
+  lazy_handler->bands_count = specs_count;
+  lazy_handler->bands = (struct k2node_lazy_handler_report_band_t *)malloc(
+      sizeof(struct k2node_lazy_handler_report_band_t) * (specs_count + 1));
+  for (uint32_t i = 0; i < specs_count; i++) {
+    const struct k2node_band_spec *spec = &specs[i];
+    if (spec->which_report == REPORT_ROW) {
+      CHECK_ERR(k2node_report_row_lazy_init(&lazy_handler->bands[i],
+                                            spec->tree, spec->st,
+                                            spec->coord));
+    } else {
+      CHECK_ERR(k2node_report_column_lazy_init(&lazy_handler->bands[i],
+                                               spec->tree, spec->st,
+                                               spec->coord));
+    }
+  }
+  return k2node_band_intersection_find(lazy_handler);
+}
+
+int k2node_band_intersection_lazy_clean(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler) {
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    CHECK_ERR(k2node_report_band_lazy_clean(&lazy_handler->bands[i]));
+  }
+  free(lazy_handler->bands);
+  lazy_handler->bands = NULL;
+  lazy_handler->bands_count = 0;
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_band_intersection_next(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler,
+    uint64_t *result) {
+  *result = lazy_handler->next_result;
+  if (!lazy_handler->has_next) {
+    return SUCCESS_ECODE_K2T;
+  }
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    uint64_t reported;
+    CHECK_ERR(k2node_report_band_next(&lazy_handler->bands[i], &reported));
+  }
+  return k2node_band_intersection_find(lazy_handler);
+}
+
+int k2node_band_intersection_has_next(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler,
+    int *result) {
+  *result = lazy_handler->has_next;
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_band_intersection_reset(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler) {
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    CHECK_ERR(k2node_report_band_reset(&lazy_handler->bands[i]));
+  }
+  return k2node_band_intersection_find(lazy_handler);
+}
+
+int k2node_band_intersection_seek(
+    struct k2node_lazy_handler_band_intersection_t *lazy_handler,
+    uint64_t coord) {
+  if (!lazy_handler->has_next || lazy_handler->next_result >= coord) {
+    return SUCCESS_ECODE_K2T;
+  }
+  for (uint32_t i = 0; i < lazy_handler->bands_count; i++) {
+    CHECK_ERR(k2node_report_band_seek(&lazy_handler->bands[i], coord));
+  }
+  return k2node_band_intersection_find(lazy_handler);
+}
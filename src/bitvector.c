@@ -36,7 +36,6 @@ SOFTWARE.
   } while (0)
 
 #define BITS_IN_TYPE(input_type) (sizeof(input_type) * 8)
-#define BVCTYPE_BITS BITS_IN_TYPE(uint32_t)
 
 #define CONVERT_BITS_TO_CONTAINER_NUM(bits_num, container_type)                \
   (((bits_num) / BITS_IN_TYPE(container_type)) +                               \
@@ -66,10 +65,17 @@ SOFTWARE.
 #define POSITION_IN_BLOCK(block_size_in_bits, bit_position)                    \
   ((bit_position) % (block_size_in_bits))
 
-#define BITMASK_FROM_POS_IN_BLOCK(pos_in_block) (1 << (31 - (pos_in_block)))
+#define BITMASK_FROM_POS_IN_BLOCK(pos_in_block)                                \
+  ((BVCTYPE)1 << (BVCTYPE_BITS - 1 - (pos_in_block)))
 
-static inline uint32_t _extract_right_side(uint32_t input_block,
-                                           uint32_t extract_index);
+static inline BVCTYPE bits_span_mask(uint32_t pos_in_block, uint32_t count);
+static inline BVCTYPE bits_read_left_aligned(const BVCTYPE *uarr,
+                                             uint32_t from, uint32_t count);
+static inline void bits_write_left_aligned(BVCTYPE *uarr, uint32_t from,
+                                           uint32_t count, BVCTYPE bits);
+static void bits_move_same_offset(BVCTYPE *dst, uint32_t dst_from,
+                                  const BVCTYPE *src, uint32_t src_from,
+                                  uint32_t length);
 
 int init_bitvector(struct block *input_bitvector, NODES_BV_T nodes_count_) {
   if (!input_bitvector)
@@ -102,7 +108,7 @@ int bit_read(struct block *input_bitvector, uint32_t position, int *result) {
 
   uint32_t block_index = BLOCK_INDEX(BVCTYPE_BITS, position);
   uint32_t position_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, position);
-  uint32_t pos_bitmask = BITMASK_FROM_POS_IN_BLOCK(position_in_block);
+  BVCTYPE pos_bitmask = BITMASK_FROM_POS_IN_BLOCK(position_in_block);
 
   *result = (int)((pos_bitmask & container[block_index]) > 0 ? 1 : 0);
 
@@ -116,11 +122,12 @@ int bit_set(struct block *input_bitvector, uint32_t position,
   if (*bit_was_set_already)
     return SUCCESS_ECODE;
 
+  SKIP_INDEX_NODE_CHANGED(input_bitvector, position / 4);
   BVCTYPE *container = input_bitvector->container;
 
   uint32_t block_index = BLOCK_INDEX(BVCTYPE_BITS, position);
   uint32_t position_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, position);
-  uint32_t pos_bitmask = BITMASK_FROM_POS_IN_BLOCK(position_in_block);
+  BVCTYPE pos_bitmask = BITMASK_FROM_POS_IN_BLOCK(position_in_block);
 
   container[block_index] |= pos_bitmask;
 
@@ -134,44 +141,29 @@ int bit_clear(struct block *input_bitvector, uint32_t position) {
   if (!bit_is_set)
     return SUCCESS_ECODE;
 
+  SKIP_INDEX_NODE_CHANGED(input_bitvector, position / 4);
   BVCTYPE *container = input_bitvector->container;
 
   uint32_t block_index = BLOCK_INDEX(BVCTYPE_BITS, position);
   uint32_t position_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, position);
-  uint32_t pos_bitmask = BITMASK_FROM_POS_IN_BLOCK(position_in_block);
+  BVCTYPE pos_bitmask = BITMASK_FROM_POS_IN_BLOCK(position_in_block);
 
   container[block_index] ^= pos_bitmask;
 
   return SUCCESS_ECODE;
 }
 
-uint32_t right_side_bitmasks[] = {
-    (1u << 0u) - 1u, (1u << 1) - 1, (1u << 2) - 1,    // 0, 1, 3 -- ..000,
-                                                      // ..001, ..011
-    (1u << 3u) - 1u, (1u << 4) - 1, (1u << 5) - 1,    // 7, 15, 31 -- ..111,
-                                                      // ..1111, ..11111
-    (1u << 6u) - 1u, (1u << 7) - 1, (1u << 8) - 1,    // 63, 127, 255
-    (1u << 9u) - 1u, (1u << 10) - 1, (1u << 11) - 1,  // 511, 1023, 2047
-    (1u << 12u) - 1u, (1u << 13) - 1, (1u << 14) - 1, // 4095, 8191, ...
-    (1u << 15u) - 1u, (1u << 16) - 1, (1u << 17) - 1, (1u << 18u) - 1u,
-    (1u << 19) - 1, (1u << 20) - 1, (1u << 21u) - 1u, (1u << 22) - 1,
-    (1u << 23) - 1, (1u << 24u) - 1u, (1u << 25) - 1, (1u << 26) - 1,
-    (1u << 27u) - 1u, (1u << 28) - 1, (1u << 29) - 1, (1u << 30u) - 1u,
-    (1u << 31) - 1, (uint32_t)-1};
-
-static inline uint32_t _extract_right_side(uint32_t input_block,
-                                           uint32_t extract_index) {
-  return input_block & right_side_bitmasks[extract_index];
-}
-
 int bits_write(struct block *input_bitvector, uint32_t from, uint32_t to,
-               BVCTYPE to_write) {
+               uint32_t to_write) {
+  SKIP_INDEX_NODE_CHANGED(input_bitvector, from / 4);
+  if (to / 4 != from / 4)
+    SKIP_INDEX_NODE_CHANGED(input_bitvector, to / 4);
   return bits_write_uarray_small(input_bitvector->container,
                                  input_bitvector->container_size, from, to,
                                  to_write);
 }
 
-int bits_write_uarray_small(uint32_t *input_uarr, int sz, uint32_t from,
+int bits_write_uarray_small(BVCTYPE *input_uarr, int sz, uint32_t from,
                             uint32_t to, uint32_t to_write) {
   CHECK_BOUNDARIES_UARRAY(from, sz);
   CHECK_BOUNDARIES_UARRAY(to, sz);
@@ -179,42 +171,15 @@ int bits_write_uarray_small(uint32_t *input_uarr, int sz, uint32_t from,
     return ERR_BITS_WRITE_FROM_GT_TO;
   }
 
-  BVCTYPE *container = input_uarr;
-
-  uint32_t right_pos_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, to);
-
-  uint32_t left_block_idx = BLOCK_INDEX(BVCTYPE_BITS, from);
-  uint32_t right_block_idx = BLOCK_INDEX(BVCTYPE_BITS, to);
-
   uint32_t bits_to_write = to - from + 1;
-
-  BVCTYPE left_block = container[left_block_idx];
-  uint32_t right_bits_to_right = BVCTYPE_BITS - right_pos_in_block - 1;
-
-  if (left_block_idx == right_block_idx) {
-    uint32_t parts_to_remove_rshift = left_block >> right_bits_to_right;
-    uint32_t part_to_remove =
-        _extract_right_side(parts_to_remove_rshift, bits_to_write)
-        << right_bits_to_right;
-    uint32_t part_to_add = to_write << right_bits_to_right;
-
-    container[left_block_idx] += part_to_add - part_to_remove;
+  BVCTYPE bits = (BVCTYPE)to_write << (BVCTYPE_BITS - bits_to_write);
+  uint32_t first_part = BVCTYPE_BITS - POSITION_IN_BLOCK(BVCTYPE_BITS, from);
+  if (first_part >= bits_to_write) {
+    bits_write_left_aligned(input_uarr, from, bits_to_write, bits);
   } else {
-    BVCTYPE right_block = container[right_block_idx];
-    uint32_t right_block_keep_part =
-        _extract_right_side(right_block, right_bits_to_right);
-    uint32_t right_extract_to_add =
-        _extract_right_side(to_write, right_pos_in_block + 1);
-    uint32_t right_part_to_add = right_extract_to_add << right_bits_to_right;
-    container[right_block_idx] = right_block_keep_part + right_part_to_add;
-
-    uint32_t to_left_pos_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, from) - 1;
-    uint32_t left_bits_to_right = BVCTYPE_BITS - to_left_pos_in_block - 1;
-    uint32_t left_block_part_to_remove =
-        _extract_right_side(left_block, left_bits_to_right);
-    uint32_t left_block_part_to_add = to_write >> (right_pos_in_block + 1);
-    container[left_block_idx] =
-        left_block - left_block_part_to_remove + left_block_part_to_add;
+    bits_write_left_aligned(input_uarr, from, first_part, bits);
+    bits_write_left_aligned(input_uarr, from + first_part,
+                            bits_to_write - first_part, bits << first_part);
   }
 
   return SUCCESS_ECODE;
@@ -227,7 +192,7 @@ int bits_read(struct block *input_bitvector, uint32_t from, uint32_t to,
                                 result);
 }
 
-int bits_read_uarray_small(uint32_t *input_uarr, int sz, uint32_t from,
+int bits_read_uarray_small(BVCTYPE *input_uarr, int sz, uint32_t from,
                            uint32_t to, uint32_t *result) {
   CHECK_BOUNDARIES_UARRAY(from, sz);
   CHECK_BOUNDARIES_UARRAY(to, sz);
@@ -235,52 +200,23 @@ int bits_read_uarray_small(uint32_t *input_uarr, int sz, uint32_t from,
     return ERR_BITS_WRITE_FROM_GT_TO;
   }
 
-  BVCTYPE *container = input_uarr;
-
-  uint32_t right_pos_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, to);
-
-  uint32_t left_block_idx = BLOCK_INDEX(BVCTYPE_BITS, from);
-  uint32_t right_block_idx = BLOCK_INDEX(BVCTYPE_BITS, to);
-
-  if (left_block_idx == right_block_idx) {
-    uint32_t block = container[left_block_idx];
-    uint32_t block_shifted = block >> (BVCTYPE_BITS - right_pos_in_block - 1);
-    uint32_t bits_to_read = to - from + 1;
-    if (bits_to_read == BVCTYPE_BITS) {
-      *result = block_shifted;
-      return SUCCESS_ECODE;
-    }
-
-    *result = _extract_right_side(block_shifted, bits_to_read);
-    return SUCCESS_ECODE;
-  }
-
-  uint32_t from_pos_in_left_block = POSITION_IN_BLOCK(BVCTYPE_BITS, from) - 1;
-  uint32_t right_block = container[right_block_idx];
-  uint32_t left_block = container[left_block_idx];
-
-  uint32_t to_shift_right = BVCTYPE_BITS - (right_pos_in_block + 1);
-  uint32_t right_block_shifted = right_block >> to_shift_right;
-
-  uint32_t left_shift = right_pos_in_block + 1;
-  uint32_t left_block_shifted =
-      _extract_right_side(left_block, BVCTYPE_BITS - from_pos_in_left_block - 1)
-      << left_shift;
-
-  *result = right_block_shifted + left_block_shifted;
+  uint32_t bits_to_read = to - from + 1;
+  *result = (uint32_t)(bits_read_left_aligned(input_uarr, from, bits_to_read) >>
+                       (BVCTYPE_BITS - bits_to_read));
   return SUCCESS_ECODE;
 }
 
 int bits_write_bv(struct block *input_bitvector, struct block *output_bitvector,
                   int start_src, int start_dst, int length) {
+  SKIP_INDEX_INVALIDATE(output_bitvector);
   return bits_write_uarray(
       input_bitvector->container, input_bitvector->container_size,
       output_bitvector->container, output_bitvector->container_size, start_src,
       start_dst, length);
 }
 
-int bits_write_uarray(uint32_t *input_uarr, int input_size,
-                      uint32_t *output_uarr, int output_size, int start_src,
+int bits_write_uarray(BVCTYPE *input_uarr, int input_size,
+                      BVCTYPE *output_uarr, int output_size, int start_src,
                       int start_dst, int length) {
   int from_src = start_src;
   int to_src = start_src + length - 1;
@@ -298,50 +234,152 @@ int bits_write_uarray(uint32_t *input_uarr, int input_size,
     return ERR_BITS_WRITE_FROM_GT_TO;
   }
 
-  int leftmost_src_container = BLOCK_INDEX(BVCTYPE_BITS, from_src);
-  int rightmost_src_container = BLOCK_INDEX(BVCTYPE_BITS, to_src);
-  if (leftmost_src_container == rightmost_src_container) {
-    uint32_t src_portion;
-    CHECK_ERR(bits_read_uarray_small(input_uarr, input_size, from_src, to_src,
-                                     &src_portion));
-    CHECK_ERR(bits_write_uarray_small(output_uarr, output_size, from_dst,
-                                      to_dst, src_portion));
-    return SUCCESS_ECODE;
-  }
+  bits_move_uarray(output_uarr, (uint32_t)from_dst, input_uarr,
+                   (uint32_t)from_src, (uint32_t)length);
 
-  int left_rbound = ((leftmost_src_container + 1) * BVCTYPE_BITS) - 1;
-  int first_sz = left_rbound - from_src;
+  return SUCCESS_ECODE;
+}
+
+/* Mask of count bits starting at pos_in_block, bit positions go from the most
+ * significant bit of the word. 0 < count, pos_in_block + count <= BVCTYPE_BITS
+ */
+static inline BVCTYPE bits_span_mask(uint32_t pos_in_block, uint32_t count) {
+  return (~(BVCTYPE)0 >> (BVCTYPE_BITS - count))
+         << (BVCTYPE_BITS - pos_in_block - count);
+}
 
-  uint32_t src_portion;
+/* Reads count <= BVCTYPE_BITS bits from 'from', placed at the most
+ * significant bits of the result. The other bits are garbage. Only loads the
+ * words holding the bits */
+static inline BVCTYPE bits_read_left_aligned(const BVCTYPE *uarr,
+                                             uint32_t from, uint32_t count) {
+  uint32_t block_index = BLOCK_INDEX(BVCTYPE_BITS, from);
+  uint32_t pos_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, from);
+  BVCTYPE result = uarr[block_index] << pos_in_block;
+  if (pos_in_block + count > BVCTYPE_BITS)
+    result |= uarr[block_index + 1] >> (BVCTYPE_BITS - pos_in_block);
+  return result;
+}
 
-  bits_read_uarray_small(input_uarr, input_size, from_src, left_rbound,
-                         &src_portion);
-  bits_write_uarray_small(output_uarr, output_size, from_dst,
-                          from_dst + first_sz, src_portion);
+/* Writes the count most significant bits of 'bits' at 'from', which must not
+ * cross a word boundary */
+static inline void bits_write_left_aligned(BVCTYPE *uarr, uint32_t from,
+                                           uint32_t count, BVCTYPE bits) {
+  uint32_t block_index = BLOCK_INDEX(BVCTYPE_BITS, from);
+  uint32_t pos_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, from);
+  BVCTYPE mask = bits_span_mask(pos_in_block, count);
+  uarr[block_index] =
+      (uarr[block_index] & ~mask) | ((bits >> pos_in_block) & mask);
+}
 
-  int intermediate_block_count =
-      rightmost_src_container - leftmost_src_container - 1;
+/* Both ranges start at the same position of their words, so the whole words
+ * in between are moved with memmove. The partial words at both ends go before
+ * or after it depending on the direction, so no source bit is overwritten
+ * before it is read */
+static void bits_move_same_offset(BVCTYPE *dst, uint32_t dst_from,
+                                  const BVCTYPE *src, uint32_t src_from,
+                                  uint32_t length) {
+  uint32_t pos_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, dst_from);
+  uint32_t head = pos_in_block == 0 ? 0 : BVCTYPE_BITS - pos_in_block;
+  if (head > length)
+    head = length;
+  uint32_t words = (length - head) / BVCTYPE_BITS;
+  uint32_t tail = length - head - words * BVCTYPE_BITS;
+  uint32_t dst_words_from = BLOCK_INDEX(BVCTYPE_BITS, dst_from + head);
+  uint32_t src_words_from = BLOCK_INDEX(BVCTYPE_BITS, src_from + head);
+  uint32_t tail_offset = head + words * BVCTYPE_BITS;
+  int forward = dst != src || dst_from < src_from;
+
+  if (forward && head > 0)
+    bits_write_left_aligned(dst, dst_from, head,
+                            bits_read_left_aligned(src, src_from, head));
+  if (!forward && tail > 0)
+    bits_write_left_aligned(
+        dst, dst_from + tail_offset, tail,
+        bits_read_left_aligned(src, src_from + tail_offset, tail));
+
+  if (words > 0)
+    memmove(dst + dst_words_from, src + src_words_from,
+            words * sizeof(BVCTYPE));
+
+  if (forward && tail > 0)
+    bits_write_left_aligned(
+        dst, dst_from + tail_offset, tail,
+        bits_read_left_aligned(src, src_from + tail_offset, tail));
+  if (!forward && head > 0)
+    bits_write_left_aligned(dst, dst_from, head,
+                            bits_read_left_aligned(src, src_from, head));
+}
 
-  intermediate_block_count =
-      intermediate_block_count < 0 ? 0 : intermediate_block_count;
+void bits_move_uarray(BVCTYPE *dst, uint32_t dst_from, const BVCTYPE *src,
+                      uint32_t src_from, uint32_t length) {
+  if (length == 0 || (dst == src && dst_from == src_from))
+    return;
 
-  for (int i = 0; i < intermediate_block_count; i++) {
-    bits_read_uarray_small(input_uarr, input_size,
-                           left_rbound + 1 + i * BVCTYPE_BITS,
-                           left_rbound + (i + 1) * BVCTYPE_BITS, &src_portion);
-    bits_write_uarray_small(
-        output_uarr, output_size, from_dst + first_sz + 1 + i * BVCTYPE_BITS,
-        from_dst + first_sz + (i + 1) * BVCTYPE_BITS, src_portion);
+  if (POSITION_IN_BLOCK(BVCTYPE_BITS, dst_from) ==
+      POSITION_IN_BLOCK(BVCTYPE_BITS, src_from)) {
+    bits_move_same_offset(dst, dst_from, src, src_from, length);
+    return;
   }
 
-  bits_read_uarray_small(input_uarr, input_size,
-                         left_rbound + 1 +
-                             intermediate_block_count * BVCTYPE_BITS,
-                         to_src, &src_portion);
-  bits_write_uarray_small(output_uarr, output_size,
-                          from_dst + first_sz + 1 +
-                              intermediate_block_count * BVCTYPE_BITS,
-                          to_dst, src_portion);
+  /* Funnel shift: each whole destination word takes its bits from two
+   * consecutive source words. Moving to the left goes forward and to the
+   * right backwards, so every source bit is read before it is overwritten */
+  uint32_t head = BVCTYPE_BITS - POSITION_IN_BLOCK(BVCTYPE_BITS, dst_from);
+  if (head == BVCTYPE_BITS)
+    head = 0;
+  if (head > length)
+    head = length;
+  uint32_t words = (length - head) / BVCTYPE_BITS;
+  uint32_t tail_offset = head + words * BVCTYPE_BITS;
+  uint32_t tail = length - tail_offset;
+
+  BVCTYPE *dst_words = dst + BLOCK_INDEX(BVCTYPE_BITS, dst_from + head);
+  const BVCTYPE *src_words = src + BLOCK_INDEX(BVCTYPE_BITS, src_from + head);
+  uint32_t left_shift = POSITION_IN_BLOCK(BVCTYPE_BITS, src_from + head);
+  uint32_t right_shift = BVCTYPE_BITS - left_shift;
+
+  if (dst != src || dst_from < src_from) {
+    if (head > 0)
+      bits_write_left_aligned(dst, dst_from, head,
+                              bits_read_left_aligned(src, src_from, head));
+    for (uint32_t i = 0; i < words; i++)
+      dst_words[i] =
+          (src_words[i] << left_shift) | (src_words[i + 1] >> right_shift);
+    if (tail > 0)
+      bits_write_left_aligned(
+          dst, dst_from + tail_offset, tail,
+          bits_read_left_aligned(src, src_from + tail_offset, tail));
+  } else {
+    if (tail > 0)
+      bits_write_left_aligned(
+          dst, dst_from + tail_offset, tail,
+          bits_read_left_aligned(src, src_from + tail_offset, tail));
+    for (uint32_t i = words; i > 0; i--)
+      dst_words[i - 1] =
+          (src_words[i - 1] << left_shift) | (src_words[i] >> right_shift);
+    if (head > 0)
+      bits_write_left_aligned(dst, dst_from, head,
+                              bits_read_left_aligned(src, src_from, head));
+  }
+}
 
-  return SUCCESS_ECODE;
+void bits_clear_uarray(BVCTYPE *uarr, uint32_t from, uint32_t length) {
+  if (length == 0)
+    return;
+  uint32_t pos_in_block = POSITION_IN_BLOCK(BVCTYPE_BITS, from);
+  if (pos_in_block > 0) {
+    uint32_t head = BVCTYPE_BITS - pos_in_block;
+    if (head > length)
+      head = length;
+    bits_write_left_aligned(uarr, from, head, 0);
+    from += head;
+    length -= head;
+  }
+  uint32_t words = length / BVCTYPE_BITS;
+  memset(uarr + BLOCK_INDEX(BVCTYPE_BITS, from), 0, words * sizeof(BVCTYPE));
+  from += words * BVCTYPE_BITS;
+  length -= words * BVCTYPE_BITS;
+  if (length > 0)
+    bits_write_left_aligned(uarr, from, length, 0);
 }
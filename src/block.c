@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include "block.h"
 #include "block_frontier.h"
+#include "block_scan.h"
 #include "definitions.h"
 #include "morton_code.h"
 #include "stacks.h"
@@ -35,9 +36,7 @@ SOFTWARE.
 
 #include "memalloc.h"
 
-#ifdef DEBUG_STATS
 #include <sys/time.h>
-#endif
 
 struct point_search_result {
   struct child_result last_child_result_reached;
@@ -54,6 +53,90 @@ struct insertion_location {
   int level;
 };
 
+/* Kinds of new nodes written by a batch insertion */
+#define BATCH_FULL_SUBTREE 0
+#define BATCH_SINGLE_NODE 1
+#define BATCH_FRONTIER_NODE 2
+
+/* New nodes to be written before the node 'position' of the block for the
+ * points [points_from, points_to). Either the whole subtree of the points, only
+ * its root node, or its root node as a frontier node of a new block holding the
+ * subtree */
+struct batch_new_subtree {
+  uint32_t position;
+  uint32_t nodes_count;
+  uint32_t final_index;
+  uint64_t points_from;
+  uint64_t points_to;
+  TREE_DEPTH_T depth;
+  int kind;
+};
+
+/* Bits to set on the node 'node_index' (already shifted) of the block */
+struct batch_node_mark {
+  uint32_t node_index;
+  uint32_t bits;
+};
+
+/* Points [points_from, points_to) that continue in the frontier block whose
+ * root is at 'preorder' (already shifted) and at depth 'depth' */
+struct batch_frontier_group {
+  uint32_t preorder;
+  uint64_t points_from;
+  uint64_t points_to;
+  TREE_DEPTH_T depth;
+};
+
+/* Changes to apply to a single block on a batch insertion, gathered in a
+ * single preorder traversal of it */
+struct batch_insertion_plan {
+  const pair2dl_t *points;
+  TREE_DEPTH_T treedepth;
+
+  struct batch_new_subtree *subtrees;
+  uint32_t subtrees_count;
+  struct batch_node_mark *marks;
+  uint32_t marks_count;
+  struct batch_frontier_group *frontier_groups;
+  uint32_t frontier_groups_count;
+
+  uint32_t new_nodes;
+  uint32_t reserved_nodes;
+  uint32_t capacity;
+  uint64_t inserted_points;
+
+  /* how the container grows, taken from the queries_state */
+  uint32_t max_nodes;
+  uint32_t growth_percent;
+
+  /* points left for the next round because the block was full */
+  pair2dl_t *deferred_points;
+  uint64_t deferred_count;
+};
+
+/* Frontier node of a tree being bulk loaded, 'position' is its index in the
+ * pending nodes */
+struct bulk_frontier_entry {
+  uint32_t position;
+  struct block block;
+};
+
+/* State of a bulk load. Holds in preorder the nodes which haven't been assigned
+ * to a block yet, with the frontier nodes among them */
+struct bulk_build_state {
+  const pair2dl_t *points;
+  TREE_DEPTH_T treedepth;
+  MAX_NODE_COUNT_T max_nodes_count;
+
+  uint8_t *nodes;
+  uint32_t nodes_count;
+  uint32_t nodes_capacity;
+
+  struct bulk_frontier_entry *frontier;
+  uint32_t frontier_count;
+  uint32_t frontier_capacity;
+};
+
 uint32_t skip_table[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1,
                          0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 1, 2,
                          0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 2, 0, 1, 1, 2,
@@ -63,19 +146,13 @@ const uint8_t nof_children[16] = {0, 1, 1, 2, 1, 2, 2, 3,
                                   1, 2, 2, 3, 2, 3, 3, 4};
 
 static int get_node_fast(struct block *input_block, int current_node_index) {
-  static const int bits_c = (sizeof(uint32_t) * 8);
-  int bit_pos = (int)(4 * current_node_index);
-  int c_pos = bit_pos / bits_c;
-  int b_offset = bit_pos % bits_c;
-  uint32_t offset = 28 - b_offset;
-  uint32_t curr_b = input_block->container[c_pos];
-  return (int)(curr_b >> offset) & 0xf;
+  return (int)BVCTYPE_NODE(input_block->container,
+                           (uint32_t)current_node_index);
 }
 
 static int child_exists_fast(struct block *input_block, int node_idx,
                              int which_child) {
-  if (node_idx >=
-      (int)input_block->container_size * (int)(sizeof(uint32_t) * 8 / 4)) {
+  if (node_idx >= (int)input_block->container_size * (int)NODES_PER_BVCTYPE) {
     return FALSE;
   }
   int node = get_node_fast(input_block, node_idx);
@@ -88,23 +165,48 @@ static uint32_t get_subtree_skipping_qty(struct block *b, uint32_t node_idx,
   return skip_table[4 * node + child_idx];
 }
 
-static int mark_subtree_size(struct sequential_scan_result *sc_result,
-                             uint32_t node_index,
-                             TREE_DEPTH_T node_relative_depth,
-                             uint32_t subtree_size) {
-
-  sc_result->subtrees_count_map[node_index] = subtree_size;
-  sc_result->relative_depth_map[node_index] = node_relative_depth;
-
-  return SUCCESS_ECODE_K2T;
+static int max_nodes_for_level(struct queries_state *qs, int level) {
+  if (level < qs->level_threshold_1) {
+    return qs->max_nodes_1;
+  } else if (level < qs->level_threshold_2) {
+    return qs->max_nodes_2;
+  }
+  return qs->max_nodes_count;
 }
 
+/* The slack of the last container word can hold more nodes than the level
+ * allows (a 64 bits word holds 16 nodes), so max_nodes is checked too */
 static int block_has_enough_space(struct block *input_block,
-                                  struct insertion_location *il) {
+                                  struct insertion_location *il,
+                                  struct queries_state *qs) {
   uint32_t allocated_nodes = get_allocated_nodes(input_block);
+  uint32_t max_nodes = (uint32_t)max_nodes_for_level(qs, il->level);
+  if (max_nodes < allocated_nodes)
+    allocated_nodes = max_nodes;
+  if (input_block->nodes_count > allocated_nodes)
+    return FALSE;
   return il->remaining_depth <= (allocated_nodes - input_block->nodes_count);
 }
 
+/* Capacity in nodes given to a block growing to hold needed_nodes, following
+ * growth_percent (see queries_state). Fixed steps are rounded to whole
+ * container words and never go past max_nodes */
+static uint32_t next_block_capacity(uint32_t growth_percent,
+                                    uint32_t needed_nodes,
+                                    uint32_t max_nodes) {
+  if (growth_percent == BLOCK_GROWTH_POWER_OF_TWO)
+    return 1 << (uint32_t)ceil(log2(needed_nodes));
+
+  uint32_t nodes_per_word = NODES_PER_BVCTYPE;
+  uint64_t capacity = (uint64_t)needed_nodes * growth_percent / 100;
+  capacity = CEIL_OF_DIV(capacity, nodes_per_word) * nodes_per_word;
+  if (capacity > max_nodes)
+    capacity = max_nodes;
+  if (capacity < needed_nodes)
+    capacity = needed_nodes;
+  return (uint32_t)capacity;
+}
+
 int clean_child_result(struct child_result *cresult) {
   cresult->resulting_block = NULL;
   cresult->block_depth = 0;
@@ -128,13 +230,10 @@ int sequential_scan_child(struct block *input_block, uint32_t input_node_idx,
                           TREE_DEPTH_T input_node_relative_depth,
                           struct queries_state *qs, TREE_DEPTH_T block_depth);
 
-int sequential_scan_child_ins(struct block *input_block,
-                              uint32_t input_node_idx,
-                              uint32_t subtrees_to_skip,
-                              uint32_t *frontier_traversal_idx,
-                              TREE_DEPTH_T input_node_relative_depth,
-                              struct queries_state *qs,
-                              TREE_DEPTH_T block_depth);
+int scan_child(struct block *input_block, uint32_t input_node_idx,
+               uint32_t subtrees_to_skip, uint32_t *frontier_traversal_idx,
+               TREE_DEPTH_T input_node_relative_depth, struct queries_state *qs,
+               TREE_DEPTH_T block_depth);
 
 /**
   Posible return codes:
@@ -201,8 +300,102 @@ int report_rec_interactively(uint64_t current_col,
                              void *report_state,
                              uint32_t *frontier_traversal_idx);
 
+int report_range_rec(struct queries_state *qs,
+                     const struct report_range *range,
+                     point_reporter_fun_t point_reporter,
+                     struct child_result *current_cr, void *report_state,
+                     uint32_t *frontier_traversal_idx);
+
+int count_subtree_in_block(struct block *input_block, uint32_t *node_index,
+                           TREE_DEPTH_T depth, TREE_DEPTH_T treedepth,
+                           uint32_t *frontier_traversal_idx, uint64_t *count);
+
+int count_block_points(struct block *input_block, TREE_DEPTH_T block_depth,
+                       TREE_DEPTH_T treedepth, uint64_t *count);
+
+int count_range_in_block(struct block *input_block, uint32_t *node_index,
+                         TREE_DEPTH_T depth, TREE_DEPTH_T treedepth,
+                         uint32_t *frontier_traversal_idx,
+                         const struct report_range *range, uint64_t *count);
+
+#ifdef POINT_COUNTS
+static void count_inserted_point(struct queries_state *qs,
+                                 struct block *insertion_block);
+int recount_block_points(struct block *input_block, TREE_DEPTH_T block_depth,
+                         TREE_DEPTH_T treedepth);
+int refresh_children_points_rec(struct block *input_block,
+                                uint32_t *node_index, TREE_DEPTH_T depth,
+                                TREE_DEPTH_T treedepth,
+                                uint32_t *frontier_traversal_idx);
+#endif
+
+int has_point_batch_rec(struct child_result *cr,
+                        uint32_t frontier_traversal_idx,
+                        const ipair2dl_t *points, uint64_t points_count,
+                        struct queries_state *qs, int *results);
+
+uint32_t write_points_subtree(struct block *input_block, uint32_t node_index,
+                              const pair2dl_t *points, uint64_t points_count,
+                              TREE_DEPTH_T depth, TREE_DEPTH_T treedepth);
+
+int skip_subtree_in_block(struct block *input_block, uint32_t *node_index,
+                          TREE_DEPTH_T depth, TREE_DEPTH_T treedepth,
+                          uint32_t *frontier_traversal_idx);
+
+int plan_new_subtree(struct batch_insertion_plan *plan, uint32_t position,
+                     uint64_t points_from, uint64_t points_to,
+                     TREE_DEPTH_T depth, int can_be_frontier);
+
+int plan_batch_insertion_rec(struct block *input_block,
+                             struct batch_insertion_plan *plan,
+                             uint32_t *node_index, TREE_DEPTH_T depth,
+                             uint64_t points_from, uint64_t points_to,
+                             uint32_t *frontier_traversal_idx);
+
+int apply_batch_insertion_plan(struct block *input_block,
+                               struct batch_insertion_plan *plan);
+
+int insert_points_batch_in_block(struct block *input_block,
+                                 TREE_DEPTH_T block_depth,
+                                 const pair2dl_t *points,
+                                 uint64_t points_count,
+                                 struct queries_state *qs,
+                                 uint64_t *inserted_count);
+
+int bulk_materialize_block(struct bulk_build_state *bs, uint32_t start,
+                           uint32_t size, struct block *result);
+
+int bulk_cut_subtree(struct bulk_build_state *bs, uint32_t start,
+                     uint32_t size);
+
+uint32_t bulk_build_rec(struct bulk_build_state *bs, uint64_t points_from,
+                        uint64_t points_to, TREE_DEPTH_T depth);
+
 int free_rec_block_internal(struct block *input_block);
 
+/* Bodies of the public modifying functions, which run them with the allocator
+ * of the tree bound when built with TREE_ALLOCATOR */
+int insert_point_internal(struct block *input_block, uint64_t col,
+                          uint64_t row, struct queries_state *qs,
+                          int *already_exists);
+int insert_points_batch_sorted_internal(struct block *input_block,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct queries_state *qs,
+                                        uint64_t *inserted_count);
+int delete_point_internal(struct block *input_block, uint64_t col,
+                          uint64_t row, struct queries_state *qs,
+                          int *already_not_exists);
+int delete_points_batch_sorted_internal(struct block *input_block,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct queries_state *qs,
+                                        uint64_t *deleted_count);
+int compact_block_tree_internal(struct block *input_block,
+                                struct queries_state *qs,
+                                uint64_t time_budget_us,
+                                uint64_t *pending_count);
+
 int delete_point_rec(struct block *input_block, struct deletion_state *ds,
                      struct child_result cr, int *already_not_exists,
                      int *has_children, uint32_t *frontier_traversal_idx);
@@ -282,13 +475,21 @@ int child(struct block *input_block, uint32_t input_node_idx,
 
   uint32_t subtrees_to_skip = get_subtree_skipping_qty(
       input_block, input_node_idx, requested_child_position);
-  qs->find_split_data = FALSE;
 #ifdef DEBUG_STATS
+  struct timeval tval_before, tval_after, tval_result;
   gettimeofday(&tval_before, NULL);
 #endif
-  CHECK_ERR(sequential_scan_child(input_block, input_node_idx, subtrees_to_skip,
+  int scanned = FALSE;
+#ifdef BLOCK_SKIP_INDEX
+  scanned = skip_index_scan_child(input_block, input_node_idx, subtrees_to_skip,
                                   frontier_traversal_idx,
-                                  input_node_relative_depth, qs, block_depth));
+                                  input_node_relative_depth, qs, block_depth);
+#endif
+  if (!scanned) {
+    CHECK_ERR(scan_child(input_block, input_node_idx, subtrees_to_skip,
+                         frontier_traversal_idx, input_node_relative_depth, qs,
+                         block_depth));
+  }
 
 #ifdef DEBUG_STATS
   gettimeofday(&tval_after, NULL);
@@ -311,10 +512,6 @@ int reset_sequential_scan_child(struct queries_state *qs) {
   qs->sc_result.child_preorder = 0;
   qs->sc_result.node_relative_depth = 0;
 
-  if (qs->find_split_data) {
-    reset_nsi_t_stack(&qs->subtrees_count);
-  }
-
   return SUCCESS_ECODE_K2T;
 }
 
@@ -387,149 +584,32 @@ int sequential_scan_child(struct block *input_block, uint32_t input_node_idx,
   return SUCCESS_ECODE_K2T;
 }
 
-int sequential_scan_child_ins(struct block *input_block,
-                              uint32_t input_node_idx,
-                              uint32_t subtrees_to_skip,
-                              uint32_t *frontier_traversal_idx,
-                              TREE_DEPTH_T input_node_relative_depth,
-                              struct queries_state *qs,
-                              TREE_DEPTH_T block_depth) {
-
-  uint32_t fidx = *frontier_traversal_idx;
-
-  int stack_i = -1;
-  int stack_nsi_i = -1;
-
-  int find_split_data = qs->find_split_data;
-
+/**
+ * @brief Same as sequential_scan_child, using the word at a time kernel of
+ * block_scan.c when compiled with WORD_SCAN_KERNEL
+ */
+int scan_child(struct block *input_block, uint32_t input_node_idx,
+               uint32_t subtrees_to_skip, uint32_t *frontier_traversal_idx,
+               TREE_DEPTH_T input_node_relative_depth, struct queries_state *qs,
+               TREE_DEPTH_T block_depth) {
+#ifdef WORD_SCAN_KERNEL
   struct sequential_scan_result *result = &qs->sc_result;
-
   if (subtrees_to_skip == 0) {
     result->child_preorder = input_node_idx;
     result->node_relative_depth = input_node_relative_depth;
     return SUCCESS_ECODE_K2T;
   }
-
-  int *stack = qs->not_yet_traversed.data;
-  stack[++stack_i] = (int)subtrees_to_skip;
-
-  nsi_t *nsi_stack = qs->subtrees_count.data;
-
-  if (find_split_data) {
-    struct node_subtree_info nsi;
-    nsi.node_index = input_node_idx;
-    nsi.node_relative_depth = input_node_relative_depth;
-    nsi.subtree_size = 1;
-    nsi_stack[++stack_nsi_i] = nsi;
-  }
-
-  uint32_t current_node_index = input_node_idx;
-  TREE_DEPTH_T depth = input_node_relative_depth;
-  TREE_DEPTH_T real_depth = depth + block_depth;
-
-  while (stack_i >= 0) {
-    current_node_index++;
-
-    int reaching_leaf = (real_depth == qs->treedepth - 1);
-
-    if (!reaching_leaf) {
-      depth++;
-    }
-
-    /* start block of split data */
-    if (find_split_data) {
-      struct node_subtree_info nsi_w;
-      nsi_w.node_index = current_node_index;
-      nsi_w.node_relative_depth = depth;
-      nsi_w.subtree_size = 1;
-      // push_nsi_t_stack(&qs->subtrees_count, nsi_w);
-      nsi_stack[++stack_nsi_i] = nsi_w;
-    }
-    /* end block of split data */
-
-    int is_frontier = fidx < input_block->children &&
-                      input_block->preorders[fidx] == current_node_index;
-
-    real_depth = depth + block_depth;
-    reaching_leaf = (real_depth == qs->treedepth - 1);
-
-    uint32_t current_children_count;
-
-    int node = get_node_fast(input_block, (int)current_node_index);
-    current_children_count = nof_children[node];
-
-    if (current_children_count > 0 && !reaching_leaf && !is_frontier) {
-      stack[++stack_i] = (int)current_children_count;
-    } else {
-      int next_nyt = stack[stack_i--] - 1;
-
-      struct node_subtree_info nsi_rep;
-      /* start block of split data */
-      if (find_split_data) {
-        if (stack_nsi_i >= 0) {
-          nsi_rep = nsi_stack[stack_nsi_i--];
-          CHECK_ERR(mark_subtree_size(result, nsi_rep.node_index,
-                                      nsi_rep.node_relative_depth,
-                                      nsi_rep.subtree_size));
-          if (stack_nsi_i >= 0) {
-            struct node_subtree_info *nsi_rep_within = &nsi_stack[stack_nsi_i];
-            nsi_rep_within->subtree_size += nsi_rep.subtree_size;
-          }
-        }
-      }
-      /* end block of split data */
-      while (next_nyt == 0 && stack_i >= 0) {
-        next_nyt = stack[stack_i--] - 1;
-
-        /* start block of split data */
-        if (find_split_data && stack_nsi_i >= 0) {
-          nsi_rep = nsi_stack[stack_nsi_i--];
-
-          CHECK_ERR(mark_subtree_size(result, nsi_rep.node_index,
-                                      nsi_rep.node_relative_depth,
-                                      nsi_rep.subtree_size));
-
-          if (stack_nsi_i >= 0) {
-            struct node_subtree_info *nsi_rep_within = &nsi_stack[stack_nsi_i];
-            nsi_rep_within->subtree_size += nsi_rep.subtree_size;
-          }
-        }
-        /* end block of split data */
-
-        if (depth > 0) {
-          depth--;
-        }
-      }
-      if (is_frontier && depth > 0) {
-        depth--;
-        fidx++;
-      }
-      if (next_nyt > 0) {
-        stack[++stack_i] = next_nyt;
-      }
-    }
-  }
-  /* end block of split data */
-  if (find_split_data) {
-    if (stack_nsi_i >= 0) {
-      struct node_subtree_info nsi_out_w = nsi_stack[stack_nsi_i--];
-      CHECK_ERR(mark_subtree_size(result, nsi_out_w.node_index,
-                                  nsi_out_w.node_relative_depth,
-                                  nsi_out_w.subtree_size));
-
-      if (!empty_nsi_t_stack(&qs->subtrees_count)) {
-        struct node_subtree_info *nsi_rep_within = &nsi_stack[stack_nsi_i];
-        nsi_rep_within->subtree_size += nsi_out_w.subtree_size;
-      }
-    }
-  }
-  /* end block of split data */
-
-  *frontier_traversal_idx = fidx;
-  result->child_preorder = current_node_index;
-  result->node_relative_depth = depth;
-
+  result->child_preorder = block_scan_skip_subtrees(
+      input_block, input_node_idx + 1, subtrees_to_skip,
+      block_depth + input_node_relative_depth + 1, qs->treedepth,
+      frontier_traversal_idx);
+  result->node_relative_depth = input_node_relative_depth + 1;
   return SUCCESS_ECODE_K2T;
+#else
+  return sequential_scan_child(input_block, input_node_idx, subtrees_to_skip,
+                               frontier_traversal_idx,
+                               input_node_relative_depth, qs, block_depth);
+#endif
 }
 
 int find_point(struct block *input_block, struct queries_state *qs,
@@ -539,6 +619,10 @@ int find_point(struct block *input_block, struct queries_state *qs,
   clean_child_result(&current_cr);
   current_cr.resulting_block = input_block;
   current_cr.block_depth = block_depth;
+#ifdef POINT_COUNTS
+  qs->points_path[0] = input_block;
+  qs->points_path_length = 1;
+#endif
 
   uint32_t depth = block_depth;
   uint32_t relative_depth = 0;
@@ -554,6 +638,12 @@ int find_point(struct block *input_block, struct queries_state *qs,
     if (child_err_code != 0 && child_err_code != DOES_NOT_EXIST_CHILD_ERR) {
       return child_err_code;
     }
+#ifdef POINT_COUNTS
+    if (current_cr.resulting_block !=
+        qs->points_path[qs->points_path_length - 1]) {
+      qs->points_path[qs->points_path_length++] = current_cr.resulting_block;
+    }
+#endif
 
     if (current_cr.check_frontier && !current_cr.exists &&
         current_cr.resulting_block != NULL &&
@@ -644,14 +734,14 @@ int find_insertion_location(struct block *input_block, struct queries_state *qs,
     return SUCCESS_ECODE_K2T;
   }
 
-  qs->find_split_data = FALSE;
 #ifdef DEBUG_STATS
+  struct timeval tval_before, tval_after, tval_result;
   gettimeofday(&tval_before, NULL);
 #endif
-  CHECK_ERR(sequential_scan_child(
-      reached_block, node_index, to_be_skipped_subtrees,
-      &frontier_traversal_idx, psr.depth_reached - reached_block_depth, qs,
-      reached_block_depth));
+  CHECK_ERR(scan_child(reached_block, node_index, to_be_skipped_subtrees,
+                       &frontier_traversal_idx,
+                       psr.depth_reached - reached_block_depth, qs,
+                       reached_block_depth));
 #ifdef DEBUG_STATS
   gettimeofday(&tval_after, NULL);
   timersub(&tval_after, &tval_before, &tval_result);
@@ -732,6 +822,8 @@ int insert_point_mc(struct block *input_block, struct morton_code *mc,
     uint32_t code = get_code_at_morton_code(mc, code_idx);
     CHECK_ERR(insert_node_at(input_block, current_index++, code));
   }
+  /* the last node inserted is at the leaf level */
+  SKIP_INDEX_SET_CHILDLESS(input_block, current_index - 1);
 
   CHECK_ERR(fix_frontier_indexes(input_block, il->insertion_index,
                                  -((int)il->remaining_depth)));
@@ -769,113 +861,125 @@ int make_new_block(struct block *input_block, uint32_t from, uint32_t to,
   return SUCCESS_ECODE_K2T;
 }
 
+/* Node a block is split at and the last node of its subtree */
+struct split_location {
+  uint32_t node_index;
+  uint32_t last_index;
+  TREE_DEPTH_T relative_depth;
+};
+
 /**
- * @brief Splits the given block
- *
- * The splitting criteria is hardcoded to select the leftmost node
- * which is not already a frontier node and has a subtree of size at least
- * 1/4 of the size of the block
+ * @brief Finds where to split a block in a single preorder pass
  *
- * @param input_block Block to split
- * @param qs Used to gather sizes of each subtree in a single scan
- * @return int
+ * The nodes of a subtree are contiguous in preorder, so the size of a subtree
+ * is known when its last node is reached. The subtrees still open are kept in
+ * a stack as deep as the block, and each one is checked as it closes. The
+ * location is the leftmost node with a subtree of a size between 1/4 and 3/4
+ * of the block, or else the leftmost one with any node below it. The root and
+ * frontier nodes are never picked. Once a node qualifies, only its ancestors
+ * can be further left, so the scan stops when none of them is left open.
  */
-int split_block(struct block *input_block, struct queries_state *qs,
-                TREE_DEPTH_T block_depth) {
-  /* find split location */
-  uint32_t new_frontier_node_position;
-  uint32_t new_frontier_node_relative_depth;
-  /* fallback split location */
-  uint32_t fb_new_frontier_node_position;
-  uint32_t fb_new_frontier_node_relative_depth;
-  int found_fb = FALSE;
-
-  uint32_t traversal_frontier_idx = 0;
-  uint32_t children_count = nof_children[get_node_fast(input_block, 0)];
-
-  qs->find_split_data = TRUE;
-#ifdef DEBUG_STATS
-  struct timeval tval_before, tval_after, tval_result;
-  gettimeofday(&tval_before, NULL);
-#endif
-  CHECK_ERR(sequential_scan_child_ins(input_block, 0, children_count,
-                                      &traversal_frontier_idx, 0, qs,
-                                      block_depth));
-#ifdef DEBUG_STATS
-  gettimeofday(&tval_after, NULL);
-  timersub(&tval_after, &tval_before, &tval_result);
-  qs->dstats.time_on_sequential_scan +=
-      (uint64_t)tval_result.tv_sec * 1000000 + tval_result.tv_usec;
-#endif
-
-  qs->find_split_data = FALSE;
-
-  int is_frontier = FALSE;
-  uint32_t frontier_traversal_index = 0;
-  uint32_t frontier_traversal_index_tmp = 0;
+static int find_split_location(struct block *input_block,
+                               struct queries_state *qs,
+                               TREE_DEPTH_T block_depth,
+                               struct split_location *location) {
+  struct open_subtree {
+    uint32_t node_index;
+    uint32_t children_left;
+    TREE_DEPTH_T relative_depth;
+  } open_subtrees[MAX_TREE_DEPTH + 1];
+  int top = -1;
+
+  uint32_t nodes_count = input_block->nodes_count;
+  uint32_t frontier_idx = 0;
+  int found = FALSE;
+  int found_fallback = FALSE;
+  struct split_location fallback;
+
+  for (uint32_t node_index = 0; node_index < nodes_count; node_index++) {
+    TREE_DEPTH_T depth =
+        top >= 0 ? (TREE_DEPTH_T)(open_subtrees[top].relative_depth + 1) : 0;
+
+    int is_frontier = frontier_idx < input_block->children &&
+                      input_block->preorders[frontier_idx] == node_index;
+    if (is_frontier) {
+      frontier_idx++;
+    }
 
-  int found_loc = FALSE;
-  for (uint32_t node_index = 1; node_index <= qs->sc_result.child_preorder;
-       node_index++) {
+    uint32_t children_count = 0;
+    if (!is_frontier && block_depth + depth + 1 < qs->treedepth) {
+      children_count = nof_children[get_node_fast(input_block, node_index)];
+    }
 
-    is_frontier =
-        frontier_traversal_index < input_block->children &&
-        input_block->preorders[frontier_traversal_index] == node_index;
-    if (is_frontier) {
-      frontier_traversal_index++;
+    if (children_count > 0) {
+      top++;
+      open_subtrees[top].node_index = node_index;
+      open_subtrees[top].children_left = children_count;
+      open_subtrees[top].relative_depth = depth;
       continue;
     }
 
-    uint32_t subtree_size = qs->sc_result.subtrees_count_map[node_index];
-    if (4 * subtree_size >= input_block->nodes_count &&
-        4 * subtree_size <= input_block->nodes_count * 3) {
-      new_frontier_node_position = node_index;
-      new_frontier_node_relative_depth =
-          qs->sc_result.relative_depth_map[node_index];
-      found_loc = TRUE;
-      break;
+    /* node_index is the last node of the subtrees it closes */
+    while (top >= 0 && --open_subtrees[top].children_left == 0) {
+      struct open_subtree *closed = &open_subtrees[top--];
+      if (closed->node_index == 0) {
+        break;
+      }
+      uint32_t subtree_size = node_index - closed->node_index + 1;
+      if (4 * subtree_size >= nodes_count &&
+          4 * subtree_size <= 3 * nodes_count) {
+        if (!found || closed->node_index < location->node_index) {
+          found = TRUE;
+          location->node_index = closed->node_index;
+          location->last_index = node_index;
+          location->relative_depth = closed->relative_depth;
+        }
+      } else if (!found && (!found_fallback ||
+                            closed->node_index < fallback.node_index)) {
+        found_fallback = TRUE;
+        fallback.node_index = closed->node_index;
+        fallback.last_index = node_index;
+        fallback.relative_depth = closed->relative_depth;
+      }
     }
 
-    if (subtree_size >= 2 && !found_fb) {
-      found_fb = TRUE;
-      fb_new_frontier_node_position = node_index;
-      fb_new_frontier_node_relative_depth =
-          qs->sc_result.relative_depth_map[node_index];
-      frontier_traversal_index_tmp = frontier_traversal_index;
+    if (found && top <= 0) {
+      return SUCCESS_ECODE_K2T;
     }
   }
 
-  if (!found_loc) {
-    // exit(1);
-    if (!found_fb) {
-      printf("not found fb \n");
-      exit(1);
-    }
-    new_frontier_node_position = fb_new_frontier_node_position;
-    new_frontier_node_relative_depth = fb_new_frontier_node_relative_depth;
-    frontier_traversal_index = frontier_traversal_index_tmp;
+  if (found) {
+    return SUCCESS_ECODE_K2T;
   }
+  if (!found_fallback) {
+    return NO_SPLIT_LOCATION_FOUND;
+  }
+  *location = fallback;
+  return SUCCESS_ECODE_K2T;
+}
 
-  /* split block */
-  // traversal_frontier_idx = 0;
-  children_count =
-      nof_children[get_node_fast(input_block, new_frontier_node_position)];
-  qs->find_split_data = FALSE;
+/**
+ * @brief Splits the given block
+ *
+ * The splitting criteria is hardcoded to select the leftmost node
+ * which is not already a frontier node and has a subtree of size at least
+ * 1/4 of the size of the block (see find_split_location)
+ *
+ * @param input_block Block to split
+ * @param qs State of the insertion
+ * @return int
+ */
+int split_block(struct block *input_block, struct queries_state *qs,
+                TREE_DEPTH_T block_depth) {
 #ifdef DEBUG_STATS
+  struct timeval tval_before, tval_after, tval_result;
   gettimeofday(&tval_before, NULL);
 #endif
-  CHECK_ERR(sequential_scan_child(input_block, new_frontier_node_position,
-                                  children_count, &frontier_traversal_index,
-                                  new_frontier_node_relative_depth, qs,
-                                  block_depth));
-#ifdef DEBUG_STATS
-  gettimeofday(&tval_after, NULL);
-  timersub(&tval_after, &tval_before, &tval_result);
-  qs->dstats.time_on_sequential_scan +=
-      (uint64_t)tval_result.tv_sec * 1000000 + tval_result.tv_usec;
-#endif
+  struct split_location location;
+  CHECK_ERR(find_split_location(input_block, qs, block_depth, &location));
 
-  uint32_t right_index = qs->sc_result.child_preorder;
+  uint32_t new_frontier_node_position = location.node_index;
+  uint32_t right_index = location.last_index;
 
   struct block new_block;
   new_block.children = 0;
@@ -888,6 +992,20 @@ int split_block(struct block *input_block, struct queries_state *qs,
                            &new_block));
 
   CHECK_ERR(fix_frontier_indexes(&new_block, 0, new_frontier_node_position));
+#ifdef POINT_COUNTS
+  /* the points of the input block don't change, they are just shared now */
+  CHECK_ERR(recount_block_points(
+      &new_block, block_depth + location.relative_depth,
+      qs->treedepth));
+#endif
+#ifdef BLOCK_SKIP_INDEX
+  /* the new block is indexed now so read-only queries can use it. A failed
+   * build leaves it to the next child() */
+  if (new_block.nodes_count >= SKIP_INDEX_MIN_NODES) {
+    skip_index_build(&new_block, block_depth + location.relative_depth,
+                     qs->treedepth);
+  }
+#endif
 
   if (right_index > new_frontier_node_position) {
     int delta_indexes_parent = right_index - new_frontier_node_position;
@@ -898,6 +1016,14 @@ int split_block(struct block *input_block, struct queries_state *qs,
   CHECK_ERR(
       add_frontier_node(input_block, new_frontier_node_position, &new_block));
 
+#ifdef DEBUG_STATS
+  gettimeofday(&tval_after, NULL);
+  timersub(&tval_after, &tval_before, &tval_result);
+  qs->dstats.time_on_split +=
+      (uint64_t)tval_result.tv_sec * 1000000 + tval_result.tv_usec;
+  qs->dstats.split_count++;
+#endif
+
   return SUCCESS_ECODE_K2T;
 }
 
@@ -923,7 +1049,7 @@ int insert_point_at(struct block *insertion_block,
                     struct insertion_location *il, struct queries_state *qs,
                     TREE_DEPTH_T block_depth, int *already_existed) {
   int aux_was_set;
-  if (block_has_enough_space(insertion_block, il)) {
+  if (block_has_enough_space(insertion_block, il, qs)) {
     CHECK_ERR(make_room(insertion_block, il));
     struct child_result *lcresult =
         &(il->parent_node).last_child_result_reached;
@@ -953,6 +1079,11 @@ int insert_point_at(struct block *insertion_block,
       CHECK_ERR(insert_point_mc(insertion_block, &qs->mc, il));
       *already_existed = FALSE;
     }
+#ifdef POINT_COUNTS
+    if (!*already_existed) {
+      count_inserted_point(qs, insertion_block);
+    }
+#endif
 
     return SUCCESS_ECODE_K2T;
   }
@@ -961,18 +1092,12 @@ int insert_point_at(struct block *insertion_block,
   uint32_t next_amount_of_nodes =
       insertion_block->nodes_count + il->remaining_depth;
 
-  int curr_max_nodes;
-  int curr_level = il->level;
-  if (curr_level < qs->level_threshold_1) {
-    curr_max_nodes = qs->max_nodes_1;
-  } else if (curr_level < qs->level_threshold_2) {
-    curr_max_nodes = qs->max_nodes_2;
-  } else {
-    curr_max_nodes = qs->max_nodes_count;
-  }
+  int curr_max_nodes = max_nodes_for_level(qs, il->level);
 
   if ((int)next_amount_of_nodes <= curr_max_nodes) {
-    uint32_t next_block_sz = 1 << (uint32_t)ceil(log2(next_amount_of_nodes));
+    uint32_t next_block_sz =
+        next_block_capacity(qs->block_growth_percent, next_amount_of_nodes,
+                            (uint32_t)curr_max_nodes);
     CHECK_ERR(enlarge_block_size_to(insertion_block, next_block_sz));
     return insert_point_at(insertion_block, il, qs, block_depth,
                            already_existed);
@@ -980,10 +1105,6 @@ int insert_point_at(struct block *insertion_block,
 
   CHECK_ERR(split_block(insertion_block, qs, block_depth));
 
-#ifdef DEBUG_STATS
-  qs->dstats.split_count++;
-#endif
-
   struct insertion_location il_split;
   CHECK_ERR(find_insertion_location(qs->root, qs, &il_split, 0));
 
@@ -1282,448 +1403,2490 @@ int report_rec_interactively(uint64_t current_col,
   return SUCCESS_ECODE_K2T;
 }
 
-/* END PRIVATE FUNCTIONS IMPLEMENTATIONS */
+/**
+ * @brief Clamps a query rectangle to a matrix of side 2^treedepth
+ *
+ * @param range Output rectangle
+ * @return int TRUE if the clamped rectangle is not empty, FALSE otherwise
+ */
+int init_report_range(struct report_range *range, uint64_t col_lo,
+                      uint64_t col_hi, uint64_t row_lo, uint64_t row_hi,
+                      TREE_DEPTH_T treedepth) {
+  uint64_t max_coord =
+      treedepth >= 64 ? UINT64_MAX : (1UL << (uint64_t)treedepth) - 1UL;
+  range->col_lo = col_lo;
+  range->col_hi = col_hi > max_coord ? max_coord : col_hi;
+  range->row_lo = row_lo;
+  range->row_hi = row_hi > max_coord ? max_coord : row_hi;
+  return range->col_lo <= range->col_hi && range->row_lo <= range->row_hi;
+}
 
-/* PUBLIC FUNCTIONS */
+/**
+ * @brief Intersects a rectangle with the quadrant of child_pos and translates
+ * the intersection to the origin of that quadrant
+ *
+ * Children are numbered as (column half << 1) | row half, so child_pos 0 is
+ * the top-left quadrant and child_pos 3 the bottom-right one.
+ *
+ * @param range Rectangle relative to the origin of the parent
+ * @param half_length Side of the quadrants of the parent
+ * @param child_range Output rectangle relative to the origin of the child
+ * @return int TRUE if the quadrant intersects the rectangle, FALSE otherwise
+ */
+int clip_report_range(const struct report_range *range, uint32_t child_pos,
+                      uint64_t half_length, struct report_range *child_range) {
+  uint64_t col_base = (uint64_t)(child_pos >> 1) * half_length;
+  uint64_t row_base = (uint64_t)(child_pos & 1) * half_length;
+  uint64_t col_last = col_base + (half_length - 1);
+  uint64_t row_last = row_base + (half_length - 1);
+
+  if (range->col_hi < col_base || range->col_lo > col_last ||
+      range->row_hi < row_base || range->row_lo > row_last) {
+    return FALSE;
+  }
 
-int has_point(struct block *input_block, uint64_t col, uint64_t row,
-              struct queries_state *qs, int *result) {
+  child_range->col_lo =
+      (range->col_lo > col_base ? range->col_lo : col_base) - col_base;
+  child_range->col_hi =
+      (range->col_hi < col_last ? range->col_hi : col_last) - col_base;
+  child_range->row_lo =
+      (range->row_lo > row_base ? range->row_lo : row_base) - row_base;
+  child_range->row_hi =
+      (range->row_hi < row_last ? range->row_hi : row_last) - row_base;
+  return TRUE;
+}
 
-  convert_coordinates_to_morton_code(col, row, qs->treedepth, &qs->mc);
+/**
+ * @brief Recursive function to report the points inside a rectangle
+ *
+ * Quadrants that don't intersect the rectangle are never visited.
+ *
+ * @param qs Used to store partial morton code and create coordinate from it
+ * when reaching a leaf
+ * @param range Rectangle relative to the origin of the current node
+ * @param point_reporter Function that receives a pair row, column reporting a
+ * point
+ * @param current_cr Used to perform child() operation and store info about the
+ * current node
+ * @return int Result code
+ */
+int report_range_rec(struct queries_state *qs,
+                     const struct report_range *range,
+                     point_reporter_fun_t point_reporter,
+                     struct child_result *current_cr, void *report_state,
+                     uint32_t *frontier_traversal_idx) {
+  struct block *current_block = current_cr->resulting_block;
+  TREE_DEPTH_T current_block_depth = current_cr->block_depth;
+  TREE_DEPTH_T tree_depth = qs->treedepth;
+  TREE_DEPTH_T relative_depth = current_cr->resulting_relative_depth;
+  TREE_DEPTH_T real_depth = relative_depth + current_block_depth;
+  uint64_t half_length =
+      1UL << ((uint64_t)tree_depth - (uint64_t)real_depth - 1UL);
+  uint32_t current_node_index = current_cr->resulting_node_idx;
 
-  struct point_search_result psr;
-  uint32_t frontier_traversal_idx = 0;
-  CHECK_ERR(find_point(input_block, qs, &psr, 0, &frontier_traversal_idx));
+  struct report_range child_range;
+  struct child_result next_cr;
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    if (!clip_report_range(range, child_pos, half_length, &child_range)) {
+      continue;
+    }
 
-  *result = psr.point_exists;
+    if (real_depth + 1 == tree_depth) {
+      if (child_exists_fast(current_block, (int)current_node_index,
+                            (int)child_pos)) {
+        struct pair2dl pair;
+        add_element_morton_code(&qs->mc, real_depth, child_pos);
+        convert_morton_code_to_coordinates(&qs->mc, &pair);
+        point_reporter(pair.col, pair.row, report_state);
+      }
+      continue;
+    }
 
-  return SUCCESS_ECODE_K2T;
+    uint32_t latest_frontier_idx = *frontier_traversal_idx;
+    next_cr = *current_cr;
+    CHECK_CHILD_ERR(child(current_block, current_node_index, child_pos,
+                          relative_depth, &next_cr, qs, current_block_depth,
+                          frontier_traversal_idx));
+    if (next_cr.exists) {
+      add_element_morton_code(&qs->mc, real_depth, child_pos);
+      CHECK_ERR(report_range_rec(qs, &child_range, point_reporter, &next_cr,
+                                 report_state, frontier_traversal_idx));
+    }
+    *frontier_traversal_idx = latest_frontier_idx;
+  }
+
+  return SUCCESS_ECODE_K2T;
 }
 
-int insert_point(struct block *input_block, uint64_t col,
-                 uint64_t row, struct queries_state *qs,
-                 int *already_exists) {
-  convert_coordinates_to_morton_code(col, row, qs->treedepth, &qs->mc);
-  struct insertion_location il;
-  CHECK_ERR(find_insertion_location(input_block, qs, &il, 0));
-  struct block *insertion_block =
-      il.parent_node.last_child_result_reached.resulting_block;
-  TREE_DEPTH_T insertion_block_depth =
-      il.parent_node.last_child_result_reached.block_depth;
-  return insert_point_at(insertion_block, &il, qs, insertion_block_depth,
-                         already_exists);
+/**
+ * @brief Adds to count the points below the node at *node_index, leaving
+ * *node_index after its subtree
+ *
+ * Nodes just above the leaves add the popcount of their nibble, the
+ * subtrees continuing in a child block are counted from that block.
+ *
+ * @param depth Real depth of the node at *node_index
+ * @return int Result code
+ */
+int count_subtree_in_block(struct block *input_block, uint32_t *node_index,
+                           TREE_DEPTH_T depth, TREE_DEPTH_T treedepth,
+                           uint32_t *frontier_traversal_idx, uint64_t *count) {
+  if (frontier_check(input_block, *node_index, frontier_traversal_idx)) {
+    (*node_index)++;
+    return count_block_points(
+        get_child_block(input_block, *frontier_traversal_idx), depth,
+        treedepth, count);
+  }
+  int node = get_node_fast(input_block, (int)*node_index);
+  (*node_index)++;
+  if (depth == treedepth - 1) {
+    *count += (uint64_t)nof_children[node];
+    return SUCCESS_ECODE_K2T;
+  }
+  for (int i = 0; i < nof_children[node]; i++) {
+    CHECK_ERR(count_subtree_in_block(input_block, node_index, depth + 1,
+                                     treedepth, frontier_traversal_idx, count));
+  }
+  return SUCCESS_ECODE_K2T;
 }
 
-int naive_scan_points(struct block *input_block, struct queries_state *qs,
-                      struct vector_pair2dl_t *result) {
-  struct child_result cresult;
-  clean_child_result(&cresult);
+/**
+ * @brief Adds to count all the points of a block and its child blocks
+ *
+ * @param block_depth Real depth of the root of the block
+ * @return int Result code
+ */
+int count_block_points(struct block *input_block, TREE_DEPTH_T block_depth,
+                       TREE_DEPTH_T treedepth, uint64_t *count) {
+#ifdef POINT_COUNTS
+  (void)block_depth;
+  (void)treedepth;
+  *count += input_block->points_count;
+  return SUCCESS_ECODE_K2T;
+#else
+  if (input_block->nodes_count == 0)
+    return SUCCESS_ECODE_K2T;
+  uint32_t node_index = 0;
   uint32_t frontier_traversal_idx = 0;
-  return naive_scan_points_rec(input_block, qs, result, &cresult, 0,
-                               &frontier_traversal_idx);
+  return count_subtree_in_block(input_block, &node_index, block_depth,
+                                treedepth, &frontier_traversal_idx, count);
+#endif
 }
 
-int scan_points_interactively(struct block *input_block,
-                              struct queries_state *qs,
-                              point_reporter_fun_t point_reporter,
-                              void *report_state) {
-  struct child_result cresult;
-  clean_child_result(&cresult);
-  uint32_t frontier_traversal_idx = 0;
-  return naive_scan_points_rec_interactively(input_block, qs, point_reporter,
-                                             report_state, &cresult, 0,
-                                             &frontier_traversal_idx);
+/* Moves *node_index past the subtree starting at it */
+static int skip_counted_subtree(struct block *input_block,
+                                uint32_t *node_index, TREE_DEPTH_T depth,
+                                TREE_DEPTH_T treedepth,
+                                uint32_t *frontier_traversal_idx) {
+  if (frontier_check(input_block, *node_index, frontier_traversal_idx)) {
+    (*node_index)++;
+    return SUCCESS_ECODE_K2T;
+  }
+#ifdef WORD_SCAN_KERNEL
+  *node_index = block_scan_skip_subtrees(input_block, *node_index, 1, depth,
+                                         treedepth, frontier_traversal_idx) +
+                1;
+  return SUCCESS_ECODE_K2T;
+#else
+  return skip_subtree_in_block(input_block, node_index, depth, treedepth,
+                               frontier_traversal_idx);
+#endif
 }
 
-int report_column(struct block *input_block, uint64_t col,
-                  struct queries_state *qs, struct vector_pair2dl_t *result) {
-  struct child_result current_cr;
-  clean_child_result(&current_cr);
-  current_cr.resulting_block = input_block;
-  current_cr.block_depth = 0;
-  uint32_t frontier_traversal_idx = 0;
-  return report_rec(col, qs, result, &current_cr, REPORT_COLUMN,
-                    &frontier_traversal_idx);
+/**
+ * @brief Adds to count the points inside a rectangle below the node at
+ * *node_index, leaving *node_index after its subtree
+ *
+ * The block is walked once in preorder: subtrees outside the rectangle are
+ * skipped and the ones fully inside it are counted whole, so no child() scan
+ * is repeated for each visited node.
+ *
+ * @param depth Real depth of the node at *node_index
+ * @param range Rectangle relative to the origin of the node
+ * @return int Result code
+ */
+int count_range_in_block(struct block *input_block, uint32_t *node_index,
+                         TREE_DEPTH_T depth, TREE_DEPTH_T treedepth,
+                         uint32_t *frontier_traversal_idx,
+                         const struct report_range *range, uint64_t *count) {
+  if (frontier_check(input_block, *node_index, frontier_traversal_idx)) {
+    struct block *child_block =
+        get_child_block(input_block, *frontier_traversal_idx);
+    (*node_index)++;
+    uint32_t child_node_index = 0;
+    uint32_t child_frontier_idx = 0;
+    return count_range_in_block(child_block, &child_node_index, depth,
+                                treedepth, &child_frontier_idx, range, count);
+  }
+  int node = get_node_fast(input_block, (int)*node_index);
+  (*node_index)++;
+  uint64_t half_length = 1UL << ((uint64_t)treedepth - (uint64_t)depth - 1UL);
+
+  struct report_range child_range;
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    if (!(node & (1 << (3 - child_pos))))
+      continue;
+    int intersects =
+        clip_report_range(range, child_pos, half_length, &child_range);
+    if (depth == treedepth - 1) {
+      *count += (uint64_t)intersects;
+      continue;
+    }
+    if (!intersects) {
+      CHECK_ERR(skip_counted_subtree(input_block, node_index, depth + 1,
+                                     treedepth, frontier_traversal_idx));
+    } else if (child_range.col_lo == 0 && child_range.row_lo == 0 &&
+               child_range.col_hi == half_length - 1 &&
+               child_range.row_hi == half_length - 1) {
+      CHECK_ERR(count_subtree_in_block(input_block, node_index, depth + 1,
+                                       treedepth, frontier_traversal_idx,
+                                       count));
+    } else {
+      CHECK_ERR(count_range_in_block(input_block, node_index, depth + 1,
+                                     treedepth, frontier_traversal_idx,
+                                     &child_range, count));
+    }
+  }
+  return SUCCESS_ECODE_K2T;
 }
 
-int report_row(struct block *input_block, uint64_t row,
-               struct queries_state *qs, struct vector_pair2dl_t *result) {
-  struct child_result current_cr;
-  clean_child_result(&current_cr);
-  current_cr.resulting_block = input_block;
-  current_cr.block_depth = 0;
-  uint32_t frontier_traversal_idx = 0;
-  return report_rec(row, qs, result, &current_cr, REPORT_ROW,
-                    &frontier_traversal_idx);
+#ifdef POINT_COUNTS
+/* Adds the point just inserted to the blocks find_point went through, down to
+ * the block holding it */
+static void count_inserted_point(struct queries_state *qs,
+                                 struct block *insertion_block) {
+  for (uint32_t i = 0; i < qs->points_path_length; i++) {
+    qs->points_path[i]->points_count++;
+    if (qs->points_path[i] == insertion_block)
+      break;
+  }
 }
 
-int report_column_interactively(struct block *input_block, uint64_t col,
-                                struct queries_state *qs,
-                                point_reporter_fun_t point_reporter,
-                                void *report_state) {
-  struct child_result current_cr;
-  clean_child_result(&current_cr);
-  current_cr.resulting_block = input_block;
-  current_cr.block_depth = 0;
-  uint32_t frontier_traversal_idx = 0;
-  return report_rec_interactively(col, qs, point_reporter, &current_cr,
-                                  REPORT_COLUMN, report_state,
-                                  &frontier_traversal_idx);
+/**
+ * @brief Sets the points_count of a block from its nodes and the counts
+ * already stored in its children blocks
+ *
+ * @param block_depth Real depth of the root of the block
+ * @return int Result code
+ */
+int recount_block_points(struct block *input_block, TREE_DEPTH_T block_depth,
+                         TREE_DEPTH_T treedepth) {
+  uint64_t count = 0;
+  if (input_block->nodes_count > 0) {
+    uint32_t node_index = 0;
+    uint32_t frontier_traversal_idx = 0;
+    CHECK_ERR(count_subtree_in_block(input_block, &node_index, block_depth,
+                                     treedepth, &frontier_traversal_idx,
+                                     &count));
+  }
+  input_block->points_count = count;
+  return SUCCESS_ECODE_K2T;
 }
 
-int report_row_interactively(struct block *input_block, uint64_t row,
-                             struct queries_state *qs,
-                             point_reporter_fun_t point_reporter,
-                             void *report_state) {
-  struct child_result current_cr;
-  clean_child_result(&current_cr);
-  current_cr.resulting_block = input_block;
-  current_cr.block_depth = 0;
-  uint32_t frontier_traversal_idx = 0;
-  return report_rec_interactively(row, qs, point_reporter, &current_cr,
-                                  REPORT_ROW, report_state,
-                                  &frontier_traversal_idx);
+/* Refreshes the counts of the children blocks found in the subtree at
+ * *node_index, leaving *node_index after it */
+int refresh_children_points_rec(struct block *input_block,
+                                uint32_t *node_index, TREE_DEPTH_T depth,
+                                TREE_DEPTH_T treedepth,
+                                uint32_t *frontier_traversal_idx) {
+  if (frontier_check(input_block, *node_index, frontier_traversal_idx)) {
+    (*node_index)++;
+    return refresh_points_count(
+        get_child_block(input_block, *frontier_traversal_idx), depth,
+        treedepth);
+  }
+  int node = get_node_fast(input_block, (int)*node_index);
+  (*node_index)++;
+  if (depth == treedepth - 1)
+    return SUCCESS_ECODE_K2T;
+  for (int i = 0; i < nof_children[node]; i++) {
+    CHECK_ERR(refresh_children_points_rec(input_block, node_index, depth + 1,
+                                          treedepth, frontier_traversal_idx));
+  }
+  return SUCCESS_ECODE_K2T;
 }
+#endif
 
-struct block *create_block(void) {
-  struct block *new_block = k2tree_alloc_block();
-  new_block->container = NULL;
-  new_block->container_size = 0;
-  new_block->children_blocks = NULL;
-  new_block->preorders = NULL;
-  new_block->nodes_count = 0;
-  new_block->children = 0;
-  create_block_topology(new_block);
-  init_block_frontier(new_block);
+void report_range_to_vector(uint64_t col, uint64_t row, void *report_state) {
+  struct pair2dl pair;
+  pair.col = col;
+  pair.row = row;
+  vector_pair2dl_t__insert_element((struct vector_pair2dl_t *)report_state,
+                                   pair);
+}
+
+/**
+ * @brief Recursive function to answer a sorted group of membership queries
+ *
+ * All the points in the group share the path from the root to the node in
+ * 'cr', so the group is split by the child each point goes to and every child
+ * is visited once for all the points below it.
+ *
+ * @param cr Node shared by all the points in the group
+ * @param frontier_traversal_idx Frontier index corresponding to cr
+ * @param points Group of points sorted in morton order
+ * @param points_count Amount of points in the group
+ * @param qs queries state struct
+ * @param results Output, indexed by the index of each point
+ * @return int Result code
+ */
+int has_point_batch_rec(struct child_result *cr,
+                        uint32_t frontier_traversal_idx,
+                        const ipair2dl_t *points, uint64_t points_count,
+                        struct queries_state *qs, int *results) {
+  struct block *current_block = cr->resulting_block;
+  TREE_DEPTH_T real_depth = cr->resulting_relative_depth + cr->block_depth;
+  TREE_DEPTH_T tree_depth = qs->treedepth;
+
+  if (real_depth + 1 == tree_depth) {
+    for (uint64_t i = 0; i < points_count; i++) {
+      uint32_t leaf_code = MORTON_CODE_AT(points[i].point.col,
+                                          points[i].point.row, tree_depth,
+                                          real_depth);
+      results[points[i].index] = child_exists_fast(
+          current_block, (int)cr->resulting_node_idx, (int)leaf_code);
+    }
+    return SUCCESS_ECODE_K2T;
+  }
+
+  uint64_t group_start = 0;
+  while (group_start < points_count) {
+    uint32_t child_pos =
+        MORTON_CODE_AT(points[group_start].point.col,
+                       points[group_start].point.row, tree_depth, real_depth);
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_count &&
+           MORTON_CODE_AT(points[group_end].point.col,
+                          points[group_end].point.row, tree_depth,
+                          real_depth) == child_pos) {
+      group_end++;
+    }
+
+    struct child_result next_cr = *cr;
+    uint32_t tmp_traversal_idx = frontier_traversal_idx;
+    CHECK_CHILD_ERR(child(current_block, cr->resulting_node_idx, child_pos,
+                          cr->resulting_relative_depth, &next_cr, qs,
+                          cr->block_depth, &tmp_traversal_idx));
+    if (next_cr.exists) {
+      CHECK_ERR(has_point_batch_rec(&next_cr, tmp_traversal_idx,
+                                    points + group_start,
+                                    group_end - group_start, qs, results));
+    } else {
+      for (uint64_t i = group_start; i < group_end; i++) {
+        results[points[i].index] = FALSE;
+      }
+    }
+    group_start = group_end;
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
+/* Depth of the first node at which the paths of both points split, or
+ * treedepth if both are the same point */
+static TREE_DEPTH_T diverging_depth(const pair2dl_t *lhs, const pair2dl_t *rhs,
+                                    TREE_DEPTH_T treedepth) {
+  uint64_t diff = (lhs->col ^ rhs->col) | (lhs->row ^ rhs->row);
+  if (treedepth < 64) {
+    diff &= (1UL << treedepth) - 1UL;
+  }
+  if (diff == 0) {
+    return treedepth;
+  }
+  return (TREE_DEPTH_T)(treedepth - 1 - (63 - CLZ64(diff)));
+}
+
+static uint32_t node_bits_for_points(const pair2dl_t *points,
+                                     uint64_t points_from, uint64_t points_to,
+                                     TREE_DEPTH_T depth,
+                                     TREE_DEPTH_T treedepth) {
+  uint32_t bits = 0;
+  for (uint64_t i = points_from; i < points_to; i++) {
+    bits |= 1U << (3 - MORTON_CODE_AT(points[i].col, points[i].row, treedepth,
+                                      depth));
+  }
+  return bits;
+}
+
+/**
+ * @brief Writes in preorder the subtree of nodes holding the given points
+ *
+ * The nodes are written from 'node_index' onwards, the room for them must have
+ * been already made.
+ *
+ * @param input_block Block where the nodes are written
+ * @param node_index Index of the root of the subtree
+ * @param points Points sorted in morton order, sharing the path until 'depth'
+ * @param points_count Amount of points
+ * @param depth Depth of the root of the subtree
+ * @param treedepth Depth of the tree
+ * @return uint32_t Index of the node following the subtree
+ */
+uint32_t write_points_subtree(struct block *input_block, uint32_t node_index,
+                              const pair2dl_t *points, uint64_t points_count,
+                              TREE_DEPTH_T depth, TREE_DEPTH_T treedepth) {
+  uint32_t node =
+      node_bits_for_points(points, 0, points_count, depth, treedepth);
+  bits_write(input_block, 4 * node_index, 4 * node_index + 3, node);
+  node_index++;
+
+  if (depth == treedepth - 1) {
+    return node_index;
+  }
+
+  uint64_t group_start = 0;
+  while (group_start < points_count) {
+    uint32_t child_pos = MORTON_CODE_AT(
+        points[group_start].col, points[group_start].row, treedepth, depth);
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_count &&
+           MORTON_CODE_AT(points[group_end].col, points[group_end].row,
+                          treedepth, depth) == child_pos) {
+      group_end++;
+    }
+    node_index = write_points_subtree(
+        input_block, node_index, points + group_start, group_end - group_start,
+        depth + 1, treedepth);
+    group_start = group_end;
+  }
+  return node_index;
+}
+
+/* Advances 'node_index' past the subtree rooted at it, which is not a frontier
+ * node */
+int skip_subtree_in_block(struct block *input_block, uint32_t *node_index,
+                          TREE_DEPTH_T depth, TREE_DEPTH_T treedepth,
+                          uint32_t *frontier_traversal_idx) {
+  int node = get_node_fast(input_block, (int)*node_index);
+  (*node_index)++;
+  if (depth == treedepth - 1) {
+    return SUCCESS_ECODE_K2T;
+  }
+  for (int i = 0; i < nof_children[node]; i++) {
+    if (frontier_check(input_block, *node_index, frontier_traversal_idx)) {
+      (*node_index)++;
+      continue;
+    }
+    CHECK_ERR(skip_subtree_in_block(input_block, node_index, depth + 1,
+                                    treedepth, frontier_traversal_idx));
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+static void defer_points(struct batch_insertion_plan *plan,
+                         uint64_t points_from, uint64_t points_to) {
+  memcpy(plan->deferred_points + plan->deferred_count,
+         plan->points + points_from,
+         sizeof(pair2dl_t) * (points_to - points_from));
+  plan->deferred_count += points_to - points_from;
+}
+
+static uint32_t count_child_groups(const pair2dl_t *points,
+                                   uint64_t points_from, uint64_t points_to,
+                                   TREE_DEPTH_T depth,
+                                   TREE_DEPTH_T treedepth) {
+  return POP_COUNT(
+      node_bits_for_points(points, points_from, points_to, depth, treedepth));
+}
+
+static void add_planned_subtree(struct batch_insertion_plan *plan,
+                                uint32_t position, uint32_t nodes_count,
+                                uint64_t points_from, uint64_t points_to,
+                                TREE_DEPTH_T depth, int kind) {
+  struct batch_new_subtree *subtree = &plan->subtrees[plan->subtrees_count++];
+  subtree->position = position;
+  subtree->nodes_count = nodes_count;
+  subtree->final_index = 0;
+  subtree->points_from = points_from;
+  subtree->points_to = points_to;
+  subtree->depth = depth;
+  subtree->kind = kind;
+  plan->new_nodes += nodes_count;
+}
+
+/**
+ * @brief Adds to the plan the new nodes for points whose path is missing from
+ * 'depth' on
+ *
+ * If the whole subtree fits in the block it is written as is. Otherwise its
+ * root is written and its children are planned with the remaining space,
+ * keeping one node for each of them, or if there isn't room for that, the root
+ * becomes a frontier node of a new block holding the subtree. The points are
+ * deferred to the next round only when the block is full.
+ *
+ * @param plan Plan of the block
+ * @param position Node of the block before which the new nodes go
+ * @param points_from First point of the subtree
+ * @param points_to End of the points of the subtree
+ * @param depth Depth of the root of the subtree
+ * @param can_be_frontier FALSE if the subtree is the root of the block
+ * @return int TRUE if the root of the subtree was added, FALSE if deferred
+ */
+int plan_new_subtree(struct batch_insertion_plan *plan, uint32_t position,
+                     uint64_t points_from, uint64_t points_to,
+                     TREE_DEPTH_T depth, int can_be_frontier) {
+  TREE_DEPTH_T treedepth = plan->treedepth;
+  uint32_t available =
+      plan->capacity - plan->new_nodes - plan->reserved_nodes;
+  if (available == 0) {
+    defer_points(plan, points_from, points_to);
+    return FALSE;
+  }
+
+  uint32_t nodes_count = treedepth - depth;
+  uint64_t distinct_points = 1;
+  for (uint64_t i = points_from + 1;
+       i < points_to && nodes_count <= available; i++) {
+    TREE_DEPTH_T next_diverging_depth =
+        diverging_depth(&plan->points[i - 1], &plan->points[i], treedepth);
+    if (next_diverging_depth < treedepth) {
+      nodes_count += treedepth - 1 - next_diverging_depth;
+      distinct_points++;
+    }
+  }
+
+  if (nodes_count <= available) {
+    add_planned_subtree(plan, position, nodes_count, points_from, points_to,
+                        depth, BATCH_FULL_SUBTREE);
+    plan->inserted_points += distinct_points;
+    return TRUE;
+  }
+
+  /* a node at the last level always fits, so depth < treedepth - 1 here */
+  uint32_t child_groups = count_child_groups(plan->points, points_from,
+                                             points_to, depth, treedepth);
+  if (can_be_frontier && available < 1 + child_groups) {
+    add_planned_subtree(plan, position, 1, points_from, points_to, depth,
+                        BATCH_FRONTIER_NODE);
+    return TRUE;
+  }
+
+  add_planned_subtree(plan, position, 1, points_from, points_to, depth,
+                      BATCH_SINGLE_NODE);
+  plan->reserved_nodes += child_groups;
+  uint64_t group_start = points_from;
+  while (group_start < points_to) {
+    uint32_t child_pos =
+        MORTON_CODE_AT(plan->points[group_start].col,
+                       plan->points[group_start].row, treedepth, depth);
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_to &&
+           MORTON_CODE_AT(plan->points[group_end].col,
+                          plan->points[group_end].row, treedepth,
+                          depth) == child_pos) {
+      group_end++;
+    }
+    plan->reserved_nodes--;
+    plan_new_subtree(plan, position, group_start, group_end, depth + 1, TRUE);
+    group_start = group_end;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Traverses the subtree rooted at 'node_index' in preorder, gathering
+ * the changes needed to insert the given points
+ *
+ * @param input_block Block being traversed
+ * @param plan Plan where the changes are accumulated
+ * @param node_index Index of the current node, advanced past its subtree
+ * @param depth Depth of the current node in the tree
+ * @param points_from First point under the current node
+ * @param points_to End of the points under the current node
+ * @param frontier_traversal_idx Current index on the frontier
+ * @return int Result code
+ */
+int plan_batch_insertion_rec(struct block *input_block,
+                             struct batch_insertion_plan *plan,
+                             uint32_t *node_index, TREE_DEPTH_T depth,
+                             uint64_t points_from, uint64_t points_to,
+                             uint32_t *frontier_traversal_idx) {
+  const pair2dl_t *points = plan->points;
+  TREE_DEPTH_T treedepth = plan->treedepth;
+  uint32_t current_index = *node_index;
+  uint32_t shifted_index = current_index + plan->new_nodes;
+  int node = get_node_fast(input_block, (int)current_index);
+  (*node_index)++;
+
+  if (depth == treedepth - 1) {
+    uint32_t new_bits =
+        node_bits_for_points(points, points_from, points_to, depth,
+                             treedepth) &
+        ~(uint32_t)node;
+    if (new_bits) {
+      plan->marks[plan->marks_count].node_index = shifted_index;
+      plan->marks[plan->marks_count].bits = new_bits;
+      plan->marks_count++;
+      plan->inserted_points += POP_COUNT(new_bits);
+    }
+    return SUCCESS_ECODE_K2T;
+  }
+
+  uint64_t group_start = points_from;
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    uint64_t group_end = group_start;
+    while (group_end < points_to &&
+           MORTON_CODE_AT(points[group_end].col, points[group_end].row,
+                          treedepth, depth) == child_pos) {
+      group_end++;
+    }
+
+    int child_exists = (node & (1 << (3 - child_pos))) != 0;
+    if (!child_exists) {
+      if (group_end > group_start) {
+        if (plan_new_subtree(plan, *node_index, group_start, group_end,
+                             depth + 1, TRUE)) {
+          plan->marks[plan->marks_count].node_index = shifted_index;
+          plan->marks[plan->marks_count].bits = 1U << (3 - child_pos);
+          plan->marks_count++;
+        }
+      }
+      group_start = group_end;
+      continue;
+    }
+
+    int is_frontier =
+        frontier_check(input_block, *node_index, frontier_traversal_idx);
+    if (is_frontier) {
+      if (group_end > group_start) {
+        uint32_t frontier_node = get_node_fast(input_block, (int)*node_index);
+        uint32_t new_bits = node_bits_for_points(points, group_start, group_end,
+                                                 depth + 1, treedepth) &
+                            ~frontier_node;
+        if (new_bits) {
+          plan->marks[plan->marks_count].node_index =
+              *node_index + plan->new_nodes;
+          plan->marks[plan->marks_count].bits = new_bits;
+          plan->marks_count++;
+        }
+        struct batch_frontier_group *group =
+            &plan->frontier_groups[plan->frontier_groups_count++];
+        group->preorder = *node_index + plan->new_nodes;
+        group->points_from = group_start;
+        group->points_to = group_end;
+        group->depth = depth + 1;
+      }
+      (*node_index)++;
+    } else if (group_end > group_start) {
+      CHECK_ERR(plan_batch_insertion_rec(input_block, plan, node_index,
+                                         depth + 1, group_start, group_end,
+                                         frontier_traversal_idx));
+    } else {
+      CHECK_ERR(skip_subtree_in_block(input_block, node_index, depth + 1,
+                                      treedepth, frontier_traversal_idx));
+    }
+    group_start = group_end;
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
+/**
+ * @brief Applies the changes of a plan to its block, shifting each existing
+ * node at most once
+ *
+ * @param input_block Block to modify
+ * @param plan Plan built for the block
+ * @return int Result code
+ */
+int apply_batch_insertion_plan(struct block *input_block,
+                               struct batch_insertion_plan *plan) {
+  uint32_t old_nodes_count = input_block->nodes_count;
+  /* nodes are moved one by one, the index is rebuilt once at the end */
+  SKIP_INDEX_INVALIDATE(input_block);
+
+  if (plan->new_nodes > 0) {
+    uint32_t next_amount_of_nodes = old_nodes_count + plan->new_nodes;
+    if (next_amount_of_nodes > get_allocated_nodes(input_block)) {
+      uint32_t next_block_sz = next_block_capacity(
+          plan->growth_percent, next_amount_of_nodes, plan->max_nodes);
+      CHECK_ERR(enlarge_block_size_to(input_block, next_block_sz));
+    }
+    CHECK_ERR(set_nodes_count(input_block, next_amount_of_nodes));
+
+    /* move the nodes to their final position from right to left, writing
+     * the new nodes when their gap is ready */
+    uint32_t shift = plan->new_nodes;
+    int64_t old_index = (int64_t)old_nodes_count - 1;
+    for (int64_t i = (int64_t)plan->subtrees_count - 1; i >= 0; i--) {
+      struct batch_new_subtree *subtree = &plan->subtrees[i];
+      for (; old_index >= (int64_t)subtree->position; old_index--) {
+        uint32_t node = get_node_fast(input_block, (int)old_index);
+        uint32_t next_index = (uint32_t)old_index + shift;
+        bits_write(input_block, 4 * next_index, 4 * next_index + 3, node);
+      }
+      shift -= subtree->nodes_count;
+      subtree->final_index = subtree->position + shift;
+      if (subtree->kind == BATCH_FULL_SUBTREE) {
+        write_points_subtree(input_block, subtree->final_index,
+                             plan->points + subtree->points_from,
+                             subtree->points_to - subtree->points_from,
+                             subtree->depth, plan->treedepth);
+      } else {
+        uint32_t node = node_bits_for_points(
+            plan->points, subtree->points_from, subtree->points_to,
+            subtree->depth, plan->treedepth);
+        bits_write(input_block, 4 * subtree->final_index,
+                   4 * subtree->final_index + 3, node);
+      }
+    }
+
+    /* a frontier node is shifted by all the nodes inserted before it */
+    uint32_t subtree_i = 0;
+    shift = 0;
+    for (uint32_t i = 0; i < input_block->children; i++) {
+      while (subtree_i < plan->subtrees_count &&
+             plan->subtrees[subtree_i].position <= input_block->preorders[i]) {
+        shift += plan->subtrees[subtree_i].nodes_count;
+        subtree_i++;
+      }
+      input_block->preorders[i] += shift;
+    }
+  }
+
+  for (uint32_t i = 0; i < plan->marks_count; i++) {
+    uint32_t node_index = plan->marks[i].node_index;
+    uint32_t node = get_node_fast(input_block, (int)node_index);
+    bits_write(input_block, 4 * node_index, 4 * node_index + 3,
+               node | plan->marks[i].bits);
+  }
+
+  for (uint32_t i = 0; i < plan->subtrees_count; i++) {
+    struct batch_new_subtree *subtree = &plan->subtrees[i];
+    if (subtree->kind != BATCH_FRONTIER_NODE) {
+      continue;
+    }
+    struct block new_block;
+    init_block_frontier(&new_block);
+    CHECK_ERR(init_block_topology(&new_block, 0));
+    CHECK_ERR(add_frontier_node(input_block, subtree->final_index, &new_block));
+
+    struct batch_frontier_group *group =
+        &plan->frontier_groups[plan->frontier_groups_count++];
+    group->preorder = subtree->final_index;
+    group->points_from = subtree->points_from;
+    group->points_to = subtree->points_to;
+    group->depth = subtree->depth;
+  }
+
+  SKIP_INDEX_REFRESH(input_block);
+  return SUCCESS_ECODE_K2T;
+}
+
+/* Index in the frontier of the given preorder, which must be a frontier node */
+static uint32_t frontier_index_of(struct block *input_block,
+                                  uint32_t preorder) {
+  uint32_t low = 0;
+  uint32_t high = input_block->children;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (input_block->preorders[mid] < preorder) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * @brief Inserts a batch of points into the subtree rooted at the given block
+ *
+ * Each round gathers, in a single traversal of the block, all the changes
+ * needed to insert the points and applies them with one shift of the block.
+ * Points that continue through frontier nodes are then inserted in their
+ * blocks. The points whose new nodes didn't fit in the block are deferred: the
+ * block is split once and they are inserted in the next round.
+ *
+ * @param input_block Root of the subtree
+ * @param block_depth Depth of the root node of the block
+ * @param points Points sorted in morton order, all under the block
+ * @param points_count Amount of points
+ * @param qs queries state struct
+ * @param inserted_count Incremented by the amount of points that didn't exist
+ * @return int Result code
+ */
+int insert_points_batch_in_block(struct block *input_block,
+                                 TREE_DEPTH_T block_depth,
+                                 const pair2dl_t *points,
+                                 uint64_t points_count,
+                                 struct queries_state *qs,
+                                 uint64_t *inserted_count) {
+  struct batch_insertion_plan plan;
+  plan.treedepth = qs->treedepth;
+  plan.subtrees = NULL;
+  plan.marks = NULL;
+  plan.frontier_groups = NULL;
+  plan.deferred_points = NULL;
+
+#ifdef POINT_COUNTS
+  uint64_t previously_inserted = *inserted_count;
+#endif
+
+  uint32_t max_nodes = (uint32_t)max_nodes_for_level(qs, block_depth);
+  plan.max_nodes = max_nodes;
+  plan.growth_percent = qs->block_growth_percent;
+  pair2dl_t *round_points_buffer = NULL;
+
+  int err = SUCCESS_ECODE_K2T;
+  const pair2dl_t *round_points = points;
+  uint64_t round_points_count = points_count;
+  while (round_points_count > 0) {
+    plan.points = round_points;
+    plan.subtrees_count = 0;
+    plan.marks_count = 0;
+    plan.frontier_groups_count = 0;
+    plan.new_nodes = 0;
+    plan.reserved_nodes = 0;
+    plan.capacity = max_nodes > input_block->nodes_count
+                        ? max_nodes - input_block->nodes_count
+                        : 0;
+    plan.inserted_points = 0;
+    plan.deferred_count = 0;
+
+    /* every new subtree has at least one node and every mark is either on an
+     * existing node or on the parent of a new subtree */
+    free(plan.subtrees);
+    free(plan.marks);
+    free(plan.frontier_groups);
+    plan.subtrees = (struct batch_new_subtree *)malloc(
+        sizeof(struct batch_new_subtree) * (plan.capacity + 1));
+    plan.marks = (struct batch_node_mark *)malloc(
+        sizeof(struct batch_node_mark) *
+        (input_block->nodes_count + plan.capacity + 1));
+    plan.frontier_groups = (struct batch_frontier_group *)malloc(
+        sizeof(struct batch_frontier_group) *
+        (input_block->children + plan.capacity + 1));
+    if (!plan.deferred_points) {
+      plan.deferred_points =
+          (pair2dl_t *)malloc(sizeof(pair2dl_t) * points_count);
+    }
+
+    if (input_block->nodes_count == 0) {
+      plan_new_subtree(&plan, 0, 0, round_points_count, block_depth, FALSE);
+    } else {
+      uint32_t node_index = 0;
+      uint32_t frontier_traversal_idx = 0;
+      err = plan_batch_insertion_rec(input_block, &plan, &node_index,
+                                     block_depth, 0, round_points_count,
+                                     &frontier_traversal_idx);
+      if (err) {
+        break;
+      }
+    }
+
+    err = apply_batch_insertion_plan(input_block, &plan);
+    if (err) {
+      break;
+    }
+    *inserted_count += plan.inserted_points;
+
+    for (uint32_t i = 0; i < plan.frontier_groups_count; i++) {
+      struct batch_frontier_group *group = &plan.frontier_groups[i];
+      err = insert_points_batch_in_block(
+          get_child_block(input_block,
+                          frontier_index_of(input_block, group->preorder)),
+          group->depth,
+          round_points + group->points_from,
+          group->points_to - group->points_from, qs, inserted_count);
+      if (err) {
+        break;
+      }
+    }
+    if (err) {
+      break;
+    }
+
+    if (plan.deferred_count > 0) {
+      err = split_block(input_block, qs, block_depth);
+      if (err) {
+        break;
+      }
+    }
+
+    /* the deferred points become the input of the next round */
+    pair2dl_t *next_round_points = plan.deferred_points;
+    plan.deferred_points = round_points_buffer;
+    round_points_buffer = next_round_points;
+    round_points = round_points_buffer;
+    round_points_count = plan.deferred_count;
+  }
+#ifdef POINT_COUNTS
+  /* inserted_count includes the points inserted in the children blocks */
+  input_block->points_count += *inserted_count - previously_inserted;
+#endif
+
+  free(plan.subtrees);
+  free(plan.marks);
+  free(plan.frontier_groups);
+  free(plan.deferred_points);
+  free(round_points_buffer);
+  return err;
+}
+
+static uint32_t max_nodes_for_depth(MAX_NODE_COUNT_T max_nodes_count,
+                                    int depth) {
+  if (depth < LEVEL_THRESHOLD_1) {
+    return MAX_NODES_LEVEL_1 < max_nodes_count ? MAX_NODES_LEVEL_1
+                                               : max_nodes_count;
+  } else if (depth < LEVEL_THRESHOLD_2) {
+    return MAX_NODES_LEVEL_2 < max_nodes_count ? MAX_NODES_LEVEL_2
+                                               : max_nodes_count;
+  }
+  return max_nodes_count;
+}
+
+/**
+ * @brief Creates a block with the pending nodes [start, start + size) and the
+ * frontier nodes among them, which are removed from the pending frontier
+ *
+ * @param bs Bulk load state
+ * @param start Index of the root of the block in the pending nodes
+ * @param size Amount of nodes of the block
+ * @param result Block to initialize
+ * @return int Result code
+ */
+int bulk_materialize_block(struct bulk_build_state *bs, uint32_t start,
+                           uint32_t size, struct block *result) {
+  static const uint32_t nodes_per_word = NODES_PER_BVCTYPE;
+  init_block_frontier(result);
+  CHECK_ERR(init_block_topology(result, size));
+  for (uint32_t i = 0; i < size; i++) {
+    result->container[i / nodes_per_word] |=
+        (BVCTYPE)bs->nodes[start + i]
+        << (4 * (nodes_per_word - 1 - i % nodes_per_word));
+  }
+
+  /* the frontier nodes of the block are the last ones of the pending frontier
+   * before the ones at the right of it */
+  uint32_t frontier_to = bs->frontier_count;
+  while (frontier_to > 0 &&
+         bs->frontier[frontier_to - 1].position >= start + size) {
+    frontier_to--;
+  }
+  uint32_t frontier_from = frontier_to;
+  while (frontier_from > 0 &&
+         bs->frontier[frontier_from - 1].position >= start) {
+    frontier_from--;
+  }
+
+  uint32_t children = frontier_to - frontier_from;
+  if (children > 0) {
+    init_block_frontier_with_capacity(result, children);
+    for (uint32_t i = 0; i < children; i++) {
+      struct bulk_frontier_entry *entry = &bs->frontier[frontier_from + i];
+      result->preorders[i] = entry->position - start;
+      result->children_blocks[i] = entry->block;
+    }
+    result->children = children;
+    memmove(bs->frontier + frontier_from, bs->frontier + frontier_to,
+            sizeof(struct bulk_frontier_entry) *
+                (bs->frontier_count - frontier_to));
+    bs->frontier_count -= children;
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+/**
+ * @brief Moves the pending subtree [start, start + size) to its own block,
+ * leaving its root in the pending nodes as a frontier node
+ *
+ * @param bs Bulk load state
+ * @param start Index of the root of the subtree in the pending nodes
+ * @param size Amount of nodes of the subtree
+ * @return int Result code
+ */
+int bulk_cut_subtree(struct bulk_build_state *bs, uint32_t start,
+                     uint32_t size) {
+  struct block new_block;
+  CHECK_ERR(bulk_materialize_block(bs, start, size, &new_block));
+
+  uint32_t insertion_point = bs->frontier_count;
+  while (insertion_point > 0 &&
+         bs->frontier[insertion_point - 1].position > start) {
+    insertion_point--;
+  }
+  if (bs->frontier_count == bs->frontier_capacity) {
+    bs->frontier_capacity =
+        bs->frontier_capacity == 0 ? 16 : 2 * bs->frontier_capacity;
+    bs->frontier = (struct bulk_frontier_entry *)realloc(
+        bs->frontier,
+        sizeof(struct bulk_frontier_entry) * bs->frontier_capacity);
+  }
+  memmove(bs->frontier + insertion_point + 1, bs->frontier + insertion_point,
+          sizeof(struct bulk_frontier_entry) *
+              (bs->frontier_count - insertion_point));
+  bs->frontier[insertion_point].position = start;
+  bs->frontier[insertion_point].block = new_block;
+  bs->frontier_count++;
+
+  uint32_t removed_nodes = size - 1;
+  memmove(bs->nodes + start + 1, bs->nodes + start + size,
+          bs->nodes_count - (start + size));
+  bs->nodes_count -= removed_nodes;
+  for (uint32_t i = insertion_point + 1; i < bs->frontier_count; i++) {
+    bs->frontier[i].position -= removed_nodes;
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+/**
+ * @brief Appends to the pending nodes the subtree of the given points and cuts
+ * from it the blocks that must be created
+ *
+ * The subtree is built bottom-up. Once all the children of a node are built,
+ * if the nodes still pending under it don't fit in a block rooted at its depth,
+ * its children with the most pending nodes are cut into their own blocks until
+ * they do.
+ *
+ * @param bs Bulk load state
+ * @param points_from First point of the subtree
+ * @param points_to End of the points of the subtree
+ * @param depth Depth of the root of the subtree
+ * @return uint32_t Amount of nodes of the subtree left pending
+ */
+uint32_t bulk_build_rec(struct bulk_build_state *bs, uint64_t points_from,
+                        uint64_t points_to, TREE_DEPTH_T depth) {
+  const pair2dl_t *points = bs->points;
+  TREE_DEPTH_T treedepth = bs->treedepth;
+
+  if (bs->nodes_count == bs->nodes_capacity) {
+    bs->nodes_capacity = 2 * bs->nodes_capacity;
+    bs->nodes = (uint8_t *)realloc(bs->nodes, bs->nodes_capacity);
+  }
+  bs->nodes[bs->nodes_count++] = (uint8_t)node_bits_for_points(
+      points, points_from, points_to, depth, treedepth);
+
+  if (depth == treedepth - 1) {
+    return 1;
+  }
+
+  uint32_t children_start[4];
+  uint32_t children_pending[4];
+  int children_cut[4];
+  int children_count = 0;
+  uint32_t pending = 1;
+
+  uint64_t group_start = points_from;
+  while (group_start < points_to) {
+    uint32_t child_pos = MORTON_CODE_AT(
+        points[group_start].col, points[group_start].row, treedepth, depth);
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_to &&
+           MORTON_CODE_AT(points[group_end].col, points[group_end].row,
+                          treedepth, depth) == child_pos) {
+      group_end++;
+    }
+    children_start[children_count] = bs->nodes_count;
+    children_pending[children_count] =
+        bulk_build_rec(bs, group_start, group_end, depth + 1);
+    children_cut[children_count] = FALSE;
+    pending += children_pending[children_count];
+    children_count++;
+    group_start = group_end;
+  }
+
+  uint32_t max_nodes = max_nodes_for_depth(bs->max_nodes_count, depth);
+  while (pending > max_nodes) {
+    int biggest = -1;
+    for (int i = 0; i < children_count; i++) {
+      if (!children_cut[i] && children_pending[i] >= 2 &&
+          (biggest == -1 ||
+           children_pending[i] > children_pending[biggest])) {
+        biggest = i;
+      }
+    }
+    if (biggest == -1) {
+      break;
+    }
+    children_cut[biggest] = TRUE;
+    pending -= children_pending[biggest] - 1;
+  }
+
+  /* from right to left so the start of the remaining children doesn't change */
+  for (int i = children_count - 1; i >= 0; i--) {
+    if (children_cut[i]) {
+      bulk_cut_subtree(bs, children_start[i], children_pending[i]);
+    }
+  }
+
+  return pending;
+}
+
+/* END PRIVATE FUNCTIONS IMPLEMENTATIONS */
+
+/* PUBLIC FUNCTIONS */
+
+int has_point(struct block *input_block, uint64_t col, uint64_t row,
+              struct queries_state *qs, int *result) {
+
+  convert_coordinates_to_morton_code(col, row, qs->treedepth, &qs->mc);
+
+  struct point_search_result psr;
+  uint32_t frontier_traversal_idx = 0;
+  CHECK_ERR(find_point(input_block, qs, &psr, 0, &frontier_traversal_idx));
+
+  *result = psr.point_exists;
+
+  return SUCCESS_ECODE_K2T;
+}
+
+int has_point_batch_sorted(struct block *input_block,
+                           const ipair2dl_t *points, uint64_t points_count,
+                           struct queries_state *qs, int *results) {
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  if (input_block->nodes_count == 0) {
+    for (uint64_t i = 0; i < points_count; i++) {
+      results[points[i].index] = FALSE;
+    }
+    return SUCCESS_ECODE_K2T;
+  }
+
+  struct child_result cr;
+  clean_child_result(&cr);
+  cr.resulting_block = input_block;
+  cr.exists = TRUE;
+  return has_point_batch_rec(&cr, 0, points, points_count, qs, results);
+}
+
+int has_point_batch(struct block *input_block, const pair2dl_t *points,
+                    uint64_t points_count, struct queries_state *qs,
+                    int *results) {
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  ipair2dl_t *sorted_points =
+      (ipair2dl_t *)malloc(sizeof(ipair2dl_t) * points_count);
+  for (uint64_t i = 0; i < points_count; i++) {
+    sorted_points[i].point = points[i];
+    sorted_points[i].index = i;
+  }
+  sort_indexed_points_morton_order(sorted_points, points_count);
+
+  int err = has_point_batch_sorted(input_block, sorted_points, points_count,
+                                   qs, results);
+  free(sorted_points);
+  return err;
+}
+
+int insert_point_internal(struct block *input_block, uint64_t col,
+                          uint64_t row, struct queries_state *qs,
+                          int *already_exists) {
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  convert_coordinates_to_morton_code(col, row, qs->treedepth, &qs->mc);
+  struct insertion_location il;
+  CHECK_ERR(find_insertion_location(input_block, qs, &il, 0));
+  struct block *insertion_block =
+      il.parent_node.last_child_result_reached.resulting_block;
+  TREE_DEPTH_T insertion_block_depth =
+      il.parent_node.last_child_result_reached.block_depth;
+  return insert_point_at(insertion_block, &il, qs, insertion_block_depth,
+                         already_exists);
+}
+
+int insert_point(struct block *input_block, uint64_t col,
+                 uint64_t row, struct queries_state *qs,
+                 int *already_exists) {
+  TREE_ALLOCATOR_ENTER(input_block);
+  int err = insert_point_internal(input_block, col, row, qs, already_exists);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+struct block *build_block_tree_from_sorted(const pair2dl_t *points,
+                                           uint64_t points_count,
+                                           TREE_DEPTH_T treedepth,
+                                           MAX_NODE_COUNT_T max_nodes_count) {
+  if (points_count == 0) {
+    return create_block();
+  }
+  /* only the lowest treedepth bits of the coordinates are looked at, so points
+   * of a subtree of a bigger tree can be given as they are */
+
+  struct bulk_build_state bs;
+  bs.points = points;
+  bs.treedepth = treedepth;
+  bs.max_nodes_count = max_nodes_count;
+  bs.nodes_capacity = 4 * (uint32_t)max_nodes_count;
+  bs.nodes = (uint8_t *)malloc(bs.nodes_capacity);
+  bs.nodes_count = 0;
+  bs.frontier = NULL;
+  bs.frontier_count = 0;
+  bs.frontier_capacity = 0;
+
+  uint32_t root_nodes = bulk_build_rec(&bs, 0, points_count, 0);
+
+  struct block *root_block = k2tree_alloc_block();
+  bulk_materialize_block(&bs, 0, root_nodes, root_block);
+  TREE_ALLOCATOR_RECORD(root_block);
+#ifdef POINT_COUNTS
+  refresh_points_count(root_block, 0, treedepth);
+#endif
+
+  free(bs.nodes);
+  free(bs.frontier);
+  return root_block;
+}
+
+int insert_points_batch_sorted_internal(struct block *input_block,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct queries_state *qs,
+                                        uint64_t *inserted_count) {
+  *inserted_count = 0;
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  return insert_points_batch_in_block(input_block, 0, points, points_count, qs,
+                                      inserted_count);
+}
+
+int insert_points_batch_sorted(struct block *input_block,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct queries_state *qs,
+                               uint64_t *inserted_count) {
+  TREE_ALLOCATOR_ENTER(input_block);
+  int err = insert_points_batch_sorted_internal(input_block, points,
+                                                points_count, qs,
+                                                inserted_count);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+int insert_points_batch(struct block *input_block, const pair2dl_t *points,
+                        uint64_t points_count, struct queries_state *qs,
+                        uint64_t *inserted_count) {
+  *inserted_count = 0;
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  pair2dl_t *sorted_points =
+      (pair2dl_t *)malloc(sizeof(pair2dl_t) * points_count);
+  memcpy(sorted_points, points, sizeof(pair2dl_t) * points_count);
+  sort_points_morton_order(sorted_points, points_count);
+
+  int err = insert_points_batch_sorted(input_block, sorted_points,
+                                       points_count, qs, inserted_count);
+  free(sorted_points);
+  return err;
+}
+
+int naive_scan_points(struct block *input_block, struct queries_state *qs,
+                      struct vector_pair2dl_t *result) {
+  struct child_result cresult;
+  clean_child_result(&cresult);
+  uint32_t frontier_traversal_idx = 0;
+  return naive_scan_points_rec(input_block, qs, result, &cresult, 0,
+                               &frontier_traversal_idx);
+}
+
+int scan_points_interactively(struct block *input_block,
+                              struct queries_state *qs,
+                              point_reporter_fun_t point_reporter,
+                              void *report_state) {
+  struct child_result cresult;
+  clean_child_result(&cresult);
+  uint32_t frontier_traversal_idx = 0;
+  return naive_scan_points_rec_interactively(input_block, qs, point_reporter,
+                                             report_state, &cresult, 0,
+                                             &frontier_traversal_idx);
+}
+
+/* A node of one of the trees walked by a set operation */
+struct set_operation_node {
+  struct child_result cr;
+  uint32_t frontier_traversal_idx;
+};
+
+static void init_set_operation_node(struct set_operation_node *node,
+                                    struct block *root_block) {
+  clean_child_result(&node->cr);
+  node->cr.resulting_block = root_block;
+  node->frontier_traversal_idx = 0;
+}
+
+/* TRUE if the points under a quadrant with the given presence in each tree are
+ * part of the result */
+static int set_operation_keeps(set_operation_t operation, int in_lhs,
+                               int in_rhs) {
+  switch (operation) {
+  case SET_UNION:
+    return in_lhs || in_rhs;
+  case SET_INTERSECTION:
+    return in_lhs && in_rhs;
+  default:
+    return in_lhs && !in_rhs;
+  }
+}
+
+static int set_operation_child(struct set_operation_node *node,
+                               uint32_t child_pos, struct queries_state *qs,
+                               struct set_operation_node *result,
+                               int *exists) {
+  result->frontier_traversal_idx = node->frontier_traversal_idx;
+  clean_child_result(&result->cr);
+  int err = child(node->cr.resulting_block, node->cr.resulting_node_idx,
+                  child_pos, node->cr.resulting_relative_depth, &result->cr,
+                  qs, node->cr.block_depth, &result->frontier_traversal_idx);
+  *exists = err == SUCCESS_ECODE_K2T;
+  return err == DOES_NOT_EXIST_CHILD_ERR ? SUCCESS_ECODE_K2T : err;
+}
+
+static int set_operation_rec(struct set_operation_node *lhs,
+                             struct set_operation_node *rhs,
+                             set_operation_t operation,
+                             struct queries_state *qs,
+                             point_reporter_fun_t point_reporter,
+                             void *report_state) {
+  TREE_DEPTH_T real_depth =
+      lhs->cr.resulting_relative_depth + lhs->cr.block_depth;
+
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    if (real_depth == qs->treedepth - 1) {
+      int in_lhs =
+          child_exists_fast(lhs->cr.resulting_block,
+                            (int)lhs->cr.resulting_node_idx, (int)child_pos);
+      int in_rhs =
+          child_exists_fast(rhs->cr.resulting_block,
+                            (int)rhs->cr.resulting_node_idx, (int)child_pos);
+      if (set_operation_keeps(operation, in_lhs, in_rhs)) {
+        struct pair2dl pair;
+        add_element_morton_code(&qs->mc, real_depth, child_pos);
+        convert_morton_code_to_coordinates(&qs->mc, &pair);
+        point_reporter(pair.col, pair.row, report_state);
+      }
+      continue;
+    }
+
+    struct set_operation_node lhs_child;
+    struct set_operation_node rhs_child;
+    int in_lhs;
+    int in_rhs;
+    CHECK_ERR(set_operation_child(lhs, child_pos, qs, &lhs_child, &in_lhs));
+    CHECK_ERR(set_operation_child(rhs, child_pos, qs, &rhs_child, &in_rhs));
+
+    if (in_lhs && in_rhs) {
+      add_element_morton_code(&qs->mc, real_depth, child_pos);
+      CHECK_ERR(set_operation_rec(&lhs_child, &rhs_child, operation, qs,
+                                  point_reporter, report_state));
+    } else if (set_operation_keeps(operation, in_lhs, in_rhs)) {
+      /* the other tree is empty here, the whole quadrant is in the result */
+      struct set_operation_node *only = in_lhs ? &lhs_child : &rhs_child;
+      add_element_morton_code(&qs->mc, real_depth, child_pos);
+      CHECK_ERR(naive_scan_points_rec_interactively(
+          only->cr.resulting_block, qs, point_reporter, report_state,
+          &only->cr, only->cr.block_depth, &only->frontier_traversal_idx));
+    }
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2tree_set_operation_interactively(struct block *lhs, struct block *rhs,
+                                       set_operation_t operation,
+                                       struct queries_state *qs,
+                                       point_reporter_fun_t point_reporter,
+                                       void *report_state) {
+  struct set_operation_node lhs_root;
+  struct set_operation_node rhs_root;
+  init_set_operation_node(&lhs_root, lhs);
+  init_set_operation_node(&rhs_root, rhs);
+  return set_operation_rec(&lhs_root, &rhs_root, operation, qs, point_reporter,
+                           report_state);
+}
+
+static int k2tree_set_operation(struct block *lhs, struct block *rhs,
+                                set_operation_t operation,
+                                struct queries_state *qs,
+                                struct block **result) {
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  struct vector_pair2dl_t points;
+  vector_pair2dl_t__init_vector(&points);
+  int err = k2tree_set_operation_interactively(
+      lhs, rhs, operation, qs, report_range_to_vector, &points);
+  if (err == SUCCESS_ECODE_K2T) {
+    *result = build_block_tree_from_sorted(points.data,
+                                           (uint64_t)points.nof_items,
+                                           qs->treedepth, qs->max_nodes_count);
+  }
+  vector_pair2dl_t__free_vector(&points);
+  return err;
+}
+
+int k2tree_union(struct block *lhs, struct block *rhs, struct queries_state *qs,
+                 struct block **result) {
+  return k2tree_set_operation(lhs, rhs, SET_UNION, qs, result);
+}
+
+int k2tree_intersect(struct block *lhs, struct block *rhs,
+                     struct queries_state *qs, struct block **result) {
+  return k2tree_set_operation(lhs, rhs, SET_INTERSECTION, qs, result);
+}
+
+int k2tree_difference(struct block *lhs, struct block *rhs,
+                      struct queries_state *qs, struct block **result) {
+  return k2tree_set_operation(lhs, rhs, SET_DIFFERENCE, qs, result);
+}
+
+int report_column(struct block *input_block, uint64_t col,
+                  struct queries_state *qs, struct vector_pair2dl_t *result) {
+  struct child_result current_cr;
+  clean_child_result(&current_cr);
+  current_cr.resulting_block = input_block;
+  current_cr.block_depth = 0;
+  uint32_t frontier_traversal_idx = 0;
+  return report_rec(col, qs, result, &current_cr, REPORT_COLUMN,
+                    &frontier_traversal_idx);
+}
+
+int report_row(struct block *input_block, uint64_t row,
+               struct queries_state *qs, struct vector_pair2dl_t *result) {
+  struct child_result current_cr;
+  clean_child_result(&current_cr);
+  current_cr.resulting_block = input_block;
+  current_cr.block_depth = 0;
+  uint32_t frontier_traversal_idx = 0;
+  return report_rec(row, qs, result, &current_cr, REPORT_ROW,
+                    &frontier_traversal_idx);
+}
+
+int report_column_interactively(struct block *input_block, uint64_t col,
+                                struct queries_state *qs,
+                                point_reporter_fun_t point_reporter,
+                                void *report_state) {
+  struct child_result current_cr;
+  clean_child_result(&current_cr);
+  current_cr.resulting_block = input_block;
+  current_cr.block_depth = 0;
+  uint32_t frontier_traversal_idx = 0;
+  return report_rec_interactively(col, qs, point_reporter, &current_cr,
+                                  REPORT_COLUMN, report_state,
+                                  &frontier_traversal_idx);
+}
+
+int report_row_interactively(struct block *input_block, uint64_t row,
+                             struct queries_state *qs,
+                             point_reporter_fun_t point_reporter,
+                             void *report_state) {
+  struct child_result current_cr;
+  clean_child_result(&current_cr);
+  current_cr.resulting_block = input_block;
+  current_cr.block_depth = 0;
+  uint32_t frontier_traversal_idx = 0;
+  return report_rec_interactively(row, qs, point_reporter, &current_cr,
+                                  REPORT_ROW, report_state,
+                                  &frontier_traversal_idx);
+}
+
+static int compare_band_coords(const void *lhs, const void *rhs) {
+  uint64_t l = *(const uint64_t *)lhs;
+  uint64_t r = *(const uint64_t *)rhs;
+  return (l > r) - (l < r);
+}
+
+uint64_t sort_band_coords(const uint64_t *coords, uint64_t coords_count,
+                          TREE_DEPTH_T treedepth, uint64_t **result) {
+  uint64_t *sorted = (uint64_t *)malloc(sizeof(uint64_t) *
+                                        (coords_count > 0 ? coords_count : 1));
+  uint64_t sorted_count = 0;
+  for (uint64_t i = 0; i < coords_count; i++) {
+    if (treedepth >= 64 || (coords[i] >> treedepth) == 0) {
+      sorted[sorted_count++] = coords[i];
+    }
+  }
+  qsort(sorted, sorted_count, sizeof(uint64_t), compare_band_coords);
+
+  uint64_t unique_count = 0;
+  for (uint64_t i = 0; i < sorted_count; i++) {
+    if (unique_count == 0 || sorted[unique_count - 1] != sorted[i]) {
+      sorted[unique_count++] = sorted[i];
+    }
+  }
+  *result = sorted;
+  return unique_count;
+}
+
+uint64_t split_band_coords(const uint64_t *coords, uint64_t lo, uint64_t hi,
+                           uint32_t bit) {
+  while (lo < hi) {
+    uint64_t middle = lo + (hi - lo) / 2;
+    if ((coords[middle] >> bit) & 1UL) {
+      hi = middle;
+    } else {
+      lo = middle + 1;
+    }
+  }
+  return lo;
+}
+
+/**
+ * @brief Recursive function reporting the points of the bands
+ * coords[coords_lo..coords_hi) below the current node
+ *
+ * The coordinates are split by the bit of the current level, each child
+ * getting the ones of its half.
+ */
+static int report_bands_rec(const uint64_t *coords, uint64_t coords_lo,
+                            uint64_t coords_hi, int which_report,
+                            struct queries_state *qs,
+                            struct child_result *current_cr,
+                            uint32_t frontier_traversal_idx,
+                            point_reporter_fun_t point_reporter,
+                            void *report_state) {
+  struct block *current_block = current_cr->resulting_block;
+  TREE_DEPTH_T real_depth =
+      current_cr->resulting_relative_depth + current_cr->block_depth;
+  uint64_t split = split_band_coords(coords, coords_lo, coords_hi,
+                                     (uint32_t)(qs->treedepth - real_depth - 1));
+
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    int second_half = REPORT_SECOND_HALF(which_report, child_pos);
+    uint64_t lo = second_half ? split : coords_lo;
+    uint64_t hi = second_half ? coords_hi : split;
+    if (lo == hi) {
+      continue;
+    }
+
+    if (real_depth + 1 == qs->treedepth) {
+      if (child_exists_fast(current_block, (int)current_cr->resulting_node_idx,
+                            (int)child_pos)) {
+        struct pair2dl pair;
+        add_element_morton_code(&qs->mc, real_depth, child_pos);
+        convert_morton_code_to_coordinates(&qs->mc, &pair);
+        point_reporter(pair.col, pair.row, report_state);
+      }
+      continue;
+    }
+
+    struct child_result next_cr = *current_cr;
+    uint32_t tmp_frontier_traversal_idx = frontier_traversal_idx;
+    CHECK_CHILD_ERR(child(current_block, current_cr->resulting_node_idx,
+                          child_pos, current_cr->resulting_relative_depth,
+                          &next_cr, qs, current_cr->block_depth,
+                          &tmp_frontier_traversal_idx));
+    if (next_cr.exists) {
+      add_element_morton_code(&qs->mc, real_depth, child_pos);
+      CHECK_ERR(report_bands_rec(coords, lo, hi, which_report, qs, &next_cr,
+                                 tmp_frontier_traversal_idx, point_reporter,
+                                 report_state));
+    }
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+int report_sorted_bands_interactively(struct block *input_block,
+                                      const uint64_t *coords,
+                                      uint64_t coords_lo, uint64_t coords_hi,
+                                      int which_report,
+                                      struct queries_state *qs,
+                                      point_reporter_fun_t point_reporter,
+                                      void *report_state) {
+  if (coords_lo == coords_hi) {
+    return SUCCESS_ECODE_K2T;
+  }
+  struct child_result current_cr;
+  clean_child_result(&current_cr);
+  current_cr.resulting_block = input_block;
+  return report_bands_rec(coords, coords_lo, coords_hi, which_report, qs,
+                          &current_cr, 0, point_reporter, report_state);
+}
+
+static int report_bands_interactively(struct block *input_block,
+                                      const uint64_t *coords,
+                                      uint64_t coords_count, int which_report,
+                                      struct queries_state *qs,
+                                      point_reporter_fun_t point_reporter,
+                                      void *report_state) {
+  uint64_t *sorted_coords;
+  uint64_t sorted_count =
+      sort_band_coords(coords, coords_count, qs->treedepth, &sorted_coords);
+  int err = report_sorted_bands_interactively(input_block, sorted_coords, 0,
+                                              sorted_count, which_report, qs,
+                                              point_reporter, report_state);
+  free(sorted_coords);
+  return err;
+}
+
+int report_rows(struct block *input_block, const uint64_t *rows,
+                uint64_t rows_count, struct queries_state *qs,
+                struct vector_pair2dl_t *result) {
+  return report_bands_interactively(input_block, rows, rows_count, REPORT_ROW,
+                                    qs, report_range_to_vector, result);
+}
+
+int report_columns(struct block *input_block, const uint64_t *cols,
+                   uint64_t cols_count, struct queries_state *qs,
+                   struct vector_pair2dl_t *result) {
+  return report_bands_interactively(input_block, cols, cols_count,
+                                    REPORT_COLUMN, qs, report_range_to_vector,
+                                    result);
+}
+
+int report_rows_interactively(struct block *input_block, const uint64_t *rows,
+                              uint64_t rows_count, struct queries_state *qs,
+                              point_reporter_fun_t point_reporter,
+                              void *report_state) {
+  return report_bands_interactively(input_block, rows, rows_count, REPORT_ROW,
+                                    qs, point_reporter, report_state);
+}
+
+int report_columns_interactively(struct block *input_block,
+                                 const uint64_t *cols, uint64_t cols_count,
+                                 struct queries_state *qs,
+                                 point_reporter_fun_t point_reporter,
+                                 void *report_state) {
+  return report_bands_interactively(input_block, cols, cols_count,
+                                    REPORT_COLUMN, qs, point_reporter,
+                                    report_state);
+}
+
+int report_range(struct block *input_block, uint64_t col_lo, uint64_t col_hi,
+                 uint64_t row_lo, uint64_t row_hi, struct queries_state *qs,
+                 struct vector_pair2dl_t *result) {
+  return report_range_interactively(input_block, col_lo, col_hi, row_lo,
+                                    row_hi, qs, report_range_to_vector, result);
+}
+
+int report_range_interactively(struct block *input_block, uint64_t col_lo,
+                               uint64_t col_hi, uint64_t row_lo,
+                               uint64_t row_hi, struct queries_state *qs,
+                               point_reporter_fun_t point_reporter,
+                               void *report_state) {
+  struct report_range range;
+  if (!init_report_range(&range, col_lo, col_hi, row_lo, row_hi,
+                         qs->treedepth)) {
+    return SUCCESS_ECODE_K2T;
+  }
+  struct child_result current_cr;
+  clean_child_result(&current_cr);
+  current_cr.resulting_block = input_block;
+  current_cr.block_depth = 0;
+  uint32_t frontier_traversal_idx = 0;
+  return report_range_rec(qs, &range, point_reporter, &current_cr,
+                          report_state, &frontier_traversal_idx);
+}
+
+int count_points(struct block *input_block, struct queries_state *qs,
+                 uint64_t *result) {
+  *result = 0;
+  return count_block_points(input_block, 0, qs->treedepth, result);
+}
+
+int count_column(struct block *input_block, uint64_t col,
+                 struct queries_state *qs, uint64_t *result) {
+  return count_range(input_block, col, col, 0, UINT64_MAX, qs, result);
+}
+
+int count_row(struct block *input_block, uint64_t row,
+              struct queries_state *qs, uint64_t *result) {
+  return count_range(input_block, 0, UINT64_MAX, row, row, qs, result);
+}
+
+int count_range(struct block *input_block, uint64_t col_lo, uint64_t col_hi,
+                uint64_t row_lo, uint64_t row_hi, struct queries_state *qs,
+                uint64_t *result) {
+  *result = 0;
+  struct report_range range;
+  if (input_block->nodes_count == 0 ||
+      !init_report_range(&range, col_lo, col_hi, row_lo, row_hi,
+                         qs->treedepth)) {
+    return SUCCESS_ECODE_K2T;
+  }
+  uint32_t node_index = 0;
+  uint32_t frontier_traversal_idx = 0;
+  return count_range_in_block(input_block, &node_index, 0, qs->treedepth,
+                              &frontier_traversal_idx, &range, result);
+}
+
+#ifdef POINT_COUNTS
+int refresh_points_count(struct block *input_block, TREE_DEPTH_T block_depth,
+                         TREE_DEPTH_T treedepth) {
+  if (input_block->nodes_count > 0 && input_block->children > 0) {
+    uint32_t node_index = 0;
+    uint32_t frontier_traversal_idx = 0;
+    CHECK_ERR(refresh_children_points_rec(input_block, &node_index,
+                                          block_depth, treedepth,
+                                          &frontier_traversal_idx));
+  }
+  return recount_block_points(input_block, block_depth, treedepth);
+}
+#endif
+
+struct block *create_block(void) {
+  struct block *new_block = k2tree_alloc_block();
+  new_block->container = NULL;
+  new_block->container_size = 0;
+  new_block->children_blocks = NULL;
+  new_block->preorders = NULL;
+  new_block->nodes_count = 0;
+  new_block->children = 0;
+  TREE_ALLOCATOR_RECORD(new_block);
+  create_block_topology(new_block);
+  init_block_frontier(new_block);
+
+  return new_block;
+}
+
+int free_rec_block(struct block *input_block) {
+  if (!input_block) {
+    return SUCCESS_ECODE_K2T;
+  }
+  TREE_ALLOCATOR_ENTER(input_block);
+  int err = free_rec_block_internal(input_block);
+  if (err == SUCCESS_ECODE_K2T) {
+    k2tree_free_block(input_block);
+  }
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+int free_rec_block_internal(struct block *input_block) {
+  if(!input_block){
+    return SUCCESS_ECODE_K2T;
+  }
+  for (int i = 0; i < (int)input_block->children; i++) {
+    struct block *current_block = &input_block->children_blocks[i];
+    CHECK_ERR(free_rec_block_internal(current_block));
+  }
+
+  CHECK_ERR(free_block(input_block));
+  return SUCCESS_ECODE_K2T;
+}
+
+int free_block(struct block *input_block) {
+  CHECK_ERR(free_block_topology(input_block));
+  free_block_frontier(input_block);
+  // k2tree_free_blocks_array(input_block);
+  // k2tree_free_block(input_block);
+  return SUCCESS_ECODE_K2T;
+}
+
+struct k2tree_measurement measure_tree_size(struct block *input_block) {
+  uint64_t children_total_bytes = 0;
+  uint64_t children_total_blocks = 0;
+  uint64_t children_bytes_topology = 0;
+
+  for (int child_block_index = 0;
+       child_block_index < (int)input_block->children; child_block_index++) {
+    struct k2tree_measurement children_measurement =
+        measure_tree_size(&input_block->children_blocks[child_block_index]);
+    children_total_bytes += children_measurement.total_bytes;
+    children_total_blocks += children_measurement.total_blocks;
+    children_bytes_topology += children_measurement.bytes_topology;
+  }
+
+  uint64_t bytes_topology = input_block->container_size * sizeof(BVCTYPE);
+
+  uint64_t block_total_bytes = sizeof(struct block) + bytes_topology +
+                                    input_block->children * (sizeof(uint32_t));
+
+  struct k2tree_measurement result;
+  result.total_bytes = block_total_bytes + children_total_bytes;
+  result.bytes_topology = bytes_topology + children_bytes_topology;
+  result.total_blocks = 1 + children_total_blocks;
+  return result;
+}
+
+// Returns 0 when the block is valid
+int debug_validate_block(struct block *input_block) {
+  for (int node_i = 0; node_i < (int)input_block->nodes_count; node_i++) {
+    if (BVCTYPE_NODE(input_block->container, (uint32_t)node_i) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+int debug_validate_block_rec(struct block *input_block) {
+  if (debug_validate_block(input_block))
+    return 1;
+
+  for (int i = 0; i < (int)input_block->children; i++) {
+    int res = debug_validate_block_rec(&input_block->children_blocks[i]);
+    if (res)
+      return res + 1;
+  }
+
+  return 0;
+}
+
+void debug_print_block(struct block *b) {
+  printf("nodes count: %d, container size: %d, block ptr: %p\n", b->nodes_count,
+         b->container_size, (void *)b);
+  for (unsigned int i = 0; i < b->container_size; i++) {
+    if ((i * BVCTYPE_BITS) >= 4 * b->nodes_count)
+      break;
+    for (unsigned int j = 0; j < BVCTYPE_BITS; j++) {
+      if ((i * BVCTYPE_BITS + j) >= 4 * b->nodes_count)
+        break;
+      int bit_on =
+          !!(b->container[i] & ((BVCTYPE)1 << (BVCTYPE_BITS - 1 - j)));
+      if (j % 8 == 0 && j != 0)
+        printf(" ");
+      printf("%d", bit_on);
+    }
+    printf("  ");
+  }
+  printf("\n");
+
+  for (unsigned int i = 0; i < b->children; i++) {
+    printf("%d,", b->preorders[i]);
+  }
+  printf("\n\n");
+}
+
+void debug_print_block_rec(struct block *b) {
+  debug_print_block(b);
+  for (int i = 0; i < (int)b->children; i++) {
+    debug_print_block_rec(&b->children_blocks[i]);
+  }
+}
+
+int naive_scan_points_lazy_init(
+    struct block *input_block, struct queries_state *qs,
+    struct lazy_handler_naive_scan_t *lazy_handler) {
+
+  init_lazy_naive_state_stack(&lazy_handler->states_stack, qs->treedepth * 4);
+  lazy_handler->qs = qs;
+  lazy_handler->has_next = FALSE;
+  lazy_handler->tree_root = input_block;
+
+  lazy_naive_state first_state;
+  first_state.block_depth = 0;
+  first_state.input_block = input_block;
+  first_state.last_iteration = 0;
+  first_state.frontier_traversal_idx = 0;
+  clean_child_result(&first_state.cr);
+
+  push_lazy_naive_state_stack(&lazy_handler->states_stack, first_state);
+  naive_scan_points_lazy_next(lazy_handler, &lazy_handler->next_result);
+
+  return SUCCESS_ECODE_K2T;
+}
+
+int naive_scan_points_lazy_clean(
+    struct lazy_handler_naive_scan_t *lazy_handler) {
+  free_lazy_naive_state_stack(&lazy_handler->states_stack);
+  return SUCCESS_ECODE_K2T;
+}
+
+int naive_scan_points_lazy_next(struct lazy_handler_naive_scan_t *lazy_handler,
+                                pair2dl_t *result) {
+  *result = lazy_handler->next_result;
+  while (!empty_lazy_naive_state_stack(&lazy_handler->states_stack)) {
+    lazy_naive_state current =
+        pop_lazy_naive_state_stack(&lazy_handler->states_stack);
+    struct queries_state *qs = lazy_handler->qs;
+    struct block *input_block = current.input_block;
+    struct child_result *cresult = &current.cr;
+
+    TREE_DEPTH_T real_depth =
+        cresult->resulting_relative_depth + current.block_depth;
+    for (uint32_t child_pos = current.last_iteration; child_pos < 4;
+         child_pos++) {
+      if (real_depth == qs->treedepth - 1) {
+        //        int does_child_exist;
+        //        child_exists(input_block, cresult->resulting_node_idx,
+        //        child_pos,
+        //                     &does_child_exist);
+        int does_child_exist = child_exists_fast(
+            input_block, (int)cresult->resulting_node_idx, (int)child_pos);
+        if (does_child_exist) {
+          add_element_morton_code(&qs->mc, real_depth, child_pos);
+          convert_morton_code_to_coordinates(&qs->mc,
+                                             &lazy_handler->next_result);
+          lazy_naive_state next_state;
+          next_state.block_depth = current.block_depth;
+          next_state.input_block = current.input_block;
+          next_state.cr = current.cr;
+          next_state.last_iteration = child_pos + 1;
+          next_state.frontier_traversal_idx = current.frontier_traversal_idx;
+          lazy_handler->has_next = TRUE;
+          push_lazy_naive_state_stack(&lazy_handler->states_stack, next_state);
+
+          return SUCCESS_ECODE_K2T;
+        }
+        continue;
+      }
+
+      uint32_t next_traversal_idx = current.frontier_traversal_idx;
+
+      struct child_result cr;
+      clean_child_result(&cr);
+      int err = child(input_block, cresult->resulting_node_idx, child_pos,
+                      cresult->resulting_relative_depth, &cr, qs,
+                      current.block_depth, &next_traversal_idx);
+
+      if (err == DOES_NOT_EXIST_CHILD_ERR) {
+        continue;
+      } else if (err != 0) {
+        return err;
+      }
+      add_element_morton_code(&qs->mc, real_depth, child_pos);
+
+      if (child_pos < 3) {
+        lazy_naive_state sibling_state;
+        sibling_state.block_depth = current.block_depth;
+        sibling_state.input_block = current.input_block;
+        sibling_state.cr = current.cr;
+        sibling_state.last_iteration = child_pos + 1;
+        sibling_state.frontier_traversal_idx = current.frontier_traversal_idx;
+        push_lazy_naive_state_stack(&lazy_handler->states_stack, sibling_state);
+      }
+
+      lazy_naive_state next_state;
+      next_state.block_depth = cr.block_depth;
+      next_state.input_block = cr.resulting_block;
+      next_state.cr = cr;
+      next_state.last_iteration = 0;
+      next_state.frontier_traversal_idx = next_traversal_idx;
+      push_lazy_naive_state_stack(&lazy_handler->states_stack, next_state);
+      break;
+    }
+  }
+  lazy_handler->has_next = FALSE;
+  return SUCCESS_ECODE_K2T;
+}
+
+int naive_scan_points_lazy_has_next(
+    struct lazy_handler_naive_scan_t *lazy_handler, int *result) {
+  *result = lazy_handler->has_next;
+  return SUCCESS_ECODE_K2T;
+}
+
+int naive_scan_points_lazy_reset(
+    struct lazy_handler_naive_scan_t *lazy_handler) {
+  reset_lazy_naive_state_stack(&lazy_handler->states_stack);
+
+  lazy_handler->has_next = FALSE;
+
+  lazy_naive_state first_state;
+  first_state.block_depth = 0;
+  first_state.input_block = lazy_handler->tree_root;
+  first_state.last_iteration = 0;
+  first_state.frontier_traversal_idx = 0;
+  clean_child_result(&first_state.cr);
+
+  push_lazy_naive_state_stack(&lazy_handler->states_stack, first_state);
+  naive_scan_points_lazy_next(lazy_handler, &lazy_handler->next_result);
+
+  return SUCCESS_ECODE_K2T;
+}
+
+/* Pushes the states that continue the scan from the first point not before
+ * target, descending from current, a pending state whose node holds target */
+static int naive_scan_seek_descend(
+    struct lazy_handler_naive_scan_t *lazy_handler, lazy_naive_state current,
+    const pair2dl_t *target) {
+  struct queries_state *qs = lazy_handler->qs;
+  for (;;) {
+    struct child_result *cresult = &current.cr;
+    TREE_DEPTH_T real_depth =
+        cresult->resulting_relative_depth + current.block_depth;
+    uint32_t target_pos =
+        MORTON_CODE_AT(target->col, target->row, qs->treedepth, real_depth);
+    if (current.last_iteration < target_pos)
+      current.last_iteration = target_pos;
+
+    /* either the child holding the target was already scanned or it is a
+     * leaf, the next call checks the rest in order */
+    if (current.last_iteration > target_pos ||
+        real_depth == qs->treedepth - 1) {
+      push_lazy_naive_state_stack(&lazy_handler->states_stack, current);
+      return SUCCESS_ECODE_K2T;
+    }
+
+    uint32_t next_traversal_idx = current.frontier_traversal_idx;
+    struct child_result cr;
+    clean_child_result(&cr);
+    int err = child(current.input_block, cresult->resulting_node_idx,
+                    target_pos, cresult->resulting_relative_depth, &cr, qs,
+                    current.block_depth, &next_traversal_idx);
+    if (err != SUCCESS_ECODE_K2T && err != DOES_NOT_EXIST_CHILD_ERR) {
+      return err;
+    }
+
+    if (target_pos < 3) {
+      current.last_iteration = target_pos + 1;
+      push_lazy_naive_state_stack(&lazy_handler->states_stack, current);
+    }
+    if (err == DOES_NOT_EXIST_CHILD_ERR) {
+      return SUCCESS_ECODE_K2T;
+    }
+    add_element_morton_code(&qs->mc, real_depth, target_pos);
+
+    lazy_naive_state next_state;
+    next_state.block_depth = cr.block_depth;
+    next_state.input_block = cr.resulting_block;
+    next_state.cr = cr;
+    next_state.last_iteration = 0;
+    next_state.frontier_traversal_idx = next_traversal_idx;
+    current = next_state;
+  }
+}
+
+int naive_scan_points_lazy_seek(struct lazy_handler_naive_scan_t *lazy_handler,
+                                uint64_t col, uint64_t row) {
+  pair2dl_t target;
+  target.col = col;
+  target.row = row;
+  if (!lazy_handler->has_next ||
+      compare_points_morton_order(&lazy_handler->next_result, &target) >= 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  TREE_DEPTH_T treedepth = lazy_handler->qs->treedepth;
+  pair2dl_t *known = &lazy_handler->next_result;
+  /* the pending states are on the path to the next point, the ones whose node
+   * does not hold the target have nothing left but points before it */
+  while (!empty_lazy_naive_state_stack(&lazy_handler->states_stack)) {
+    lazy_naive_state current =
+        pop_lazy_naive_state_stack(&lazy_handler->states_stack);
+    TREE_DEPTH_T real_depth =
+        current.cr.resulting_relative_depth + current.block_depth;
+    if (SAME_NODE_AT(known->col, col, treedepth, real_depth) &&
+        SAME_NODE_AT(known->row, row, treedepth, real_depth)) {
+      CHECK_ERR(naive_scan_seek_descend(lazy_handler, current, &target));
+      break;
+    }
+  }
+
+  pair2dl_t skipped;
+  return naive_scan_points_lazy_next(lazy_handler, &skipped);
+}
+
+int report_band_next(struct lazy_handler_report_band_t *lazy_handler,
+                     uint64_t *result) {
+  *result = lazy_handler->next_result;
+  struct queries_state *qs = lazy_handler->qs;
+  while (!empty_lazy_report_band_state_t_stack(&lazy_handler->stack)) {
+    lazy_report_band_state_t current_state =
+        pop_lazy_report_band_state_t_stack(&lazy_handler->stack);
+    struct child_result *current_cr = &current_state.current_cr;
+    struct block *current_block = current_cr->resulting_block;
+    TREE_DEPTH_T current_block_depth = current_cr->block_depth;
+    TREE_DEPTH_T tree_depth = qs->treedepth;
+    TREE_DEPTH_T relative_depth = current_cr->resulting_relative_depth;
+    TREE_DEPTH_T real_depth = relative_depth + current_block_depth;
+
+    uint64_t half_length =
+        1UL << ((uint64_t)tree_depth - (uint64_t)real_depth - 1);
+
+    for (uint32_t child_pos = current_state.last_iteration; child_pos < 4;
+         child_pos++) {
+      if (!REPORT_CONTINUE_CONDITION(current_state.current_coord, half_length,
+                                     lazy_handler->which_report, child_pos)) {
+        continue;
+      }
+
+      if (real_depth + 1 == tree_depth) {
+        //        int does_child_exist;
+        //        child_exists(current_block, current_cr->resulting_node_idx,
+        //        child_pos,
+        //                     &does_child_exist);
+        int does_child_exist = child_exists_fast(
+            current_block, (int)current_cr->resulting_node_idx, (int)child_pos);
+        if (does_child_exist) {
+          struct pair2dl pair;
+          add_element_morton_code(&qs->mc, real_depth, child_pos);
+          convert_morton_code_to_coordinates(&qs->mc, &pair);
+          if (lazy_handler->which_report == REPORT_COLUMN)
+            lazy_handler->next_result = pair.row;
+          else
+            lazy_handler->next_result = pair.col;
+
+          lazy_report_band_state_t next_state;
+          next_state.current_coord = current_state.current_coord;
+          next_state.current_cr = current_state.current_cr;
+          next_state.last_iteration = child_pos + 1;
+          next_state.frontier_traversal_idx =
+              current_state.frontier_traversal_idx;
+          lazy_handler->has_next = TRUE;
+          push_lazy_report_band_state_t_stack(&lazy_handler->stack, next_state);
+          return SUCCESS_ECODE_K2T;
+        }
+        continue;
+      }
+      uint32_t current_node_index = current_cr->resulting_node_idx;
+      struct child_result next_cr = *current_cr;
+      uint32_t tmp_frontier_traversal_idx =
+          current_state.frontier_traversal_idx;
+      CHECK_CHILD_ERR(child(current_block, current_node_index, child_pos,
+                            relative_depth, &next_cr, qs, current_block_depth,
+                            &tmp_frontier_traversal_idx));
+      if (next_cr.exists) {
+
+        add_element_morton_code(&qs->mc, real_depth, child_pos);
+        if (child_pos < 3) {
+          lazy_report_band_state_t sibling_state;
+          sibling_state.current_coord = current_state.current_coord;
+          sibling_state.current_cr = current_state.current_cr;
+          sibling_state.last_iteration = child_pos + 1;
+          sibling_state.frontier_traversal_idx =
+              current_state.frontier_traversal_idx;
+          push_lazy_report_band_state_t_stack(&lazy_handler->stack,
+                                              sibling_state);
+        }
+        lazy_report_band_state_t next_state;
+        next_state.current_coord = current_state.current_coord % half_length;
+        next_state.current_cr = next_cr;
+        next_state.last_iteration = 0;
+        next_state.frontier_traversal_idx = tmp_frontier_traversal_idx;
+        push_lazy_report_band_state_t_stack(&lazy_handler->stack, next_state);
+        break;
+      }
+    }
+  }
+
+  lazy_handler->has_next = FALSE;
+  return SUCCESS_ECODE_K2T;
+}
+
+int report_band_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
+                          struct block *input_block, struct queries_state *qs,
+                          int which_report, uint64_t coord);
+
+int report_band_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
+                          struct block *input_block, struct queries_state *qs,
+                          int which_report, uint64_t coord) {
+
+  lazy_handler->which_report = which_report;
+  lazy_handler->has_next = FALSE;
+  lazy_handler->qs = qs;
+  lazy_handler->coord_to_report = coord;
+  lazy_handler->tree_root = input_block;
+
+  init_lazy_report_band_state_t_stack(&lazy_handler->stack,
+                                      lazy_handler->qs->treedepth * 4);
+
+  lazy_report_band_state_t first_state;
+  first_state.current_coord = coord;
+  clean_child_result(&first_state.current_cr);
+  first_state.current_cr.resulting_block = input_block;
+  first_state.last_iteration = 0;
+  first_state.frontier_traversal_idx = 0;
 
-  return new_block;
-}
+  push_lazy_report_band_state_t_stack(&lazy_handler->stack, first_state);
+  report_band_next(lazy_handler, &lazy_handler->next_result);
 
-int free_rec_block(struct block *input_block) {
-  CHECK_ERR(free_rec_block_internal(input_block));
-  k2tree_free_block(input_block);
   return SUCCESS_ECODE_K2T;
 }
 
-int free_rec_block_internal(struct block *input_block) {
-  if(!input_block){
-    return SUCCESS_ECODE_K2T;
-  }
-  for (int i = 0; i < (int)input_block->children; i++) {
-    struct block *current_block = &input_block->children_blocks[i];
-    CHECK_ERR(free_rec_block_internal(current_block));
-  }
-
-  CHECK_ERR(free_block(input_block));
+int report_column_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
+                            struct block *input_block, struct queries_state *qs,
+                            uint64_t coord) {
+  report_band_lazy_init(lazy_handler, input_block, qs, REPORT_COLUMN, coord);
   return SUCCESS_ECODE_K2T;
 }
 
-int free_block(struct block *input_block) {
-  CHECK_ERR(free_block_topology(input_block));
-  free_block_frontier(input_block);
-  // k2tree_free_blocks_array(input_block);
-  // k2tree_free_block(input_block);
+int report_row_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
+                         struct block *input_block, struct queries_state *qs,
+                         uint64_t coord) {
+  report_band_lazy_init(lazy_handler, input_block, qs, REPORT_ROW, coord);
   return SUCCESS_ECODE_K2T;
 }
 
-struct k2tree_measurement measure_tree_size(struct block *input_block) {
-  uint64_t children_total_bytes = 0;
-  uint64_t children_total_blocks = 0;
-  uint64_t children_bytes_topology = 0;
-
-  for (int child_block_index = 0;
-       child_block_index < (int)input_block->children; child_block_index++) {
-    struct k2tree_measurement children_measurement =
-        measure_tree_size(&input_block->children_blocks[child_block_index]);
-    children_total_bytes += children_measurement.total_bytes;
-    children_total_blocks += children_measurement.total_blocks;
-    children_bytes_topology += children_measurement.bytes_topology;
-  }
-
-  uint64_t bytes_topology = input_block->container_size * sizeof(BVCTYPE);
-
-  uint64_t block_total_bytes = sizeof(struct block) + bytes_topology +
-                                    input_block->children * (sizeof(uint32_t));
+int report_band_lazy_clean(struct lazy_handler_report_band_t *lazy_handler) {
+  free_lazy_report_band_state_t_stack(&lazy_handler->stack);
+  return SUCCESS_ECODE_K2T;
+}
 
-  struct k2tree_measurement result;
-  result.total_bytes = block_total_bytes + children_total_bytes;
-  result.bytes_topology = bytes_topology + children_bytes_topology;
-  result.total_blocks = 1 + children_total_blocks;
-  return result;
+int report_band_has_next(struct lazy_handler_report_band_t *lazy_handler,
+                         int *result) {
+  *result = lazy_handler->has_next;
+  return SUCCESS_ECODE_K2T;
 }
 
-// Returns 0 when the block is valid
-int debug_validate_block(struct block *input_block) {
-  for (int node_i = 0; node_i < (int)input_block->nodes_count; node_i++) {
-    int container_i = (node_i * 4) / 32;
-    uint32_t part = input_block->container[container_i];
-    int node_in_part = (node_i * 4) % 32;
-    int empty_node = TRUE;
-    for (int j = 0; j < 4; j++) {
-      if (part & (1 << (31 - (node_in_part + j)))) {
-        empty_node = FALSE;
-        break;
-      }
+/* Same as naive_scan_seek_descend, following the band child holding the
+ * reported coordinate */
+static int report_band_seek_descend(
+    struct lazy_handler_report_band_t *lazy_handler,
+    lazy_report_band_state_t current_state, uint64_t coord) {
+  struct queries_state *qs = lazy_handler->qs;
+  TREE_DEPTH_T tree_depth = qs->treedepth;
+  for (;;) {
+    struct child_result *current_cr = &current_state.current_cr;
+    TREE_DEPTH_T real_depth =
+        current_cr->resulting_relative_depth + current_cr->block_depth;
+    uint64_t half_length =
+        1UL << ((uint64_t)tree_depth - (uint64_t)real_depth - 1);
+    uint32_t reported_bit =
+        (uint32_t)((coord >> (tree_depth - real_depth - 1)) & 1UL);
+    uint32_t target_pos =
+        REPORT_BAND_CHILD(current_state.current_coord, half_length,
+                          lazy_handler->which_report, reported_bit);
+    if (current_state.last_iteration < target_pos)
+      current_state.last_iteration = target_pos;
+
+    if (current_state.last_iteration > target_pos ||
+        real_depth + 1 == tree_depth) {
+      push_lazy_report_band_state_t_stack(&lazy_handler->stack, current_state);
+      return SUCCESS_ECODE_K2T;
     }
-    if (empty_node)
-      return 1;
+
+    struct child_result next_cr = *current_cr;
+    uint32_t tmp_frontier_traversal_idx = current_state.frontier_traversal_idx;
+    CHECK_CHILD_ERR(child(current_cr->resulting_block,
+                          current_cr->resulting_node_idx, target_pos,
+                          current_cr->resulting_relative_depth, &next_cr, qs,
+                          current_cr->block_depth,
+                          &tmp_frontier_traversal_idx));
+
+    if (target_pos < 3) {
+      current_state.last_iteration = target_pos + 1;
+      push_lazy_report_band_state_t_stack(&lazy_handler->stack, current_state);
+    }
+    if (!next_cr.exists) {
+      return SUCCESS_ECODE_K2T;
+    }
+    add_element_morton_code(&qs->mc, real_depth, target_pos);
+
+    lazy_report_band_state_t next_state;
+    next_state.current_coord = current_state.current_coord % half_length;
+    next_state.current_cr = next_cr;
+    next_state.last_iteration = 0;
+    next_state.frontier_traversal_idx = tmp_frontier_traversal_idx;
+    current_state = next_state;
   }
-  return 0;
 }
 
-int debug_validate_block_rec(struct block *input_block) {
-  if (debug_validate_block(input_block))
-    return 1;
-
-  for (int i = 0; i < (int)input_block->children; i++) {
-    int res = debug_validate_block_rec(&input_block->children_blocks[i]);
-    if (res)
-      return res + 1;
+int report_band_seek(struct lazy_handler_report_band_t *lazy_handler,
+                     uint64_t coord) {
+  if (!lazy_handler->has_next || lazy_handler->next_result >= coord) {
+    return SUCCESS_ECODE_K2T;
   }
 
-  return 0;
-}
-
-void debug_print_block(struct block *b) {
-  printf("nodes count: %d, container size: %d, block ptr: %p\n", b->nodes_count,
-         b->container_size, (void *)b);
-  for (unsigned int i = 0; i < b->container_size; i++) {
-    if ((i * 32) >= 4 * b->nodes_count)
+  TREE_DEPTH_T tree_depth = lazy_handler->qs->treedepth;
+  uint64_t known = lazy_handler->next_result;
+  while (!empty_lazy_report_band_state_t_stack(&lazy_handler->stack)) {
+    lazy_report_band_state_t current_state =
+        pop_lazy_report_band_state_t_stack(&lazy_handler->stack);
+    TREE_DEPTH_T real_depth =
+        current_state.current_cr.resulting_relative_depth +
+        current_state.current_cr.block_depth;
+    if (SAME_NODE_AT(known, coord, tree_depth, real_depth)) {
+      CHECK_ERR(report_band_seek_descend(lazy_handler, current_state, coord));
       break;
-    for (unsigned int j = 0; j < 32; j++) {
-      if ((i * 32 + j) >= 4 * b->nodes_count)
-        break;
-      int bit_on = !!(b->container[i] & (1U << (31 - j)));
-      if (j % 8 == 0 && j != 0)
-        printf(" ");
-      printf("%d", bit_on);
     }
-    printf("  ");
-  }
-  printf("\n");
-
-  for (unsigned int i = 0; i < b->children; i++) {
-    printf("%d,", b->preorders[i]);
   }
-  printf("\n\n");
-}
 
-void debug_print_block_rec(struct block *b) {
-  debug_print_block(b);
-  for (int i = 0; i < (int)b->children; i++) {
-    debug_print_block_rec(&b->children_blocks[i]);
-  }
+  uint64_t skipped;
+  return report_band_next(lazy_handler, &skipped);
 }
 
-int naive_scan_points_lazy_init(
-    struct block *input_block, struct queries_state *qs,
-    struct lazy_handler_naive_scan_t *lazy_handler) {
-
-  init_lazy_naive_state_stack(&lazy_handler->states_stack, qs->treedepth * 4);
-  lazy_handler->qs = qs;
+int report_band_reset(struct lazy_handler_report_band_t *lazy_handler) {
+  reset_lazy_report_band_state_t_stack(&lazy_handler->stack);
   lazy_handler->has_next = FALSE;
-  lazy_handler->tree_root = input_block;
 
-  lazy_naive_state first_state;
-  first_state.block_depth = 0;
-  first_state.input_block = input_block;
+  lazy_report_band_state_t first_state;
+  first_state.current_coord = lazy_handler->coord_to_report;
+  clean_child_result(&first_state.current_cr);
+  first_state.current_cr.resulting_block = lazy_handler->tree_root;
   first_state.last_iteration = 0;
   first_state.frontier_traversal_idx = 0;
-  clean_child_result(&first_state.cr);
 
-  push_lazy_naive_state_stack(&lazy_handler->states_stack, first_state);
-  naive_scan_points_lazy_next(lazy_handler, &lazy_handler->next_result);
-
-  return SUCCESS_ECODE_K2T;
-}
+  push_lazy_report_band_state_t_stack(&lazy_handler->stack, first_state);
+  report_band_next(lazy_handler, &lazy_handler->next_result);
 
-int naive_scan_points_lazy_clean(
-    struct lazy_handler_naive_scan_t *lazy_handler) {
-  free_lazy_naive_state_stack(&lazy_handler->states_stack);
   return SUCCESS_ECODE_K2T;
 }
 
-int naive_scan_points_lazy_next(struct lazy_handler_naive_scan_t *lazy_handler,
-                                pair2dl_t *result) {
+int report_range_next(struct lazy_handler_report_range_t *lazy_handler,
+                      pair2dl_t *result) {
   *result = lazy_handler->next_result;
-  while (!empty_lazy_naive_state_stack(&lazy_handler->states_stack)) {
-    lazy_naive_state current =
-        pop_lazy_naive_state_stack(&lazy_handler->states_stack);
-    struct queries_state *qs = lazy_handler->qs;
-    struct block *input_block = current.input_block;
-    struct child_result *cresult = &current.cr;
+  struct queries_state *qs = lazy_handler->qs;
+  while (!empty_lazy_report_range_state_t_stack(&lazy_handler->stack)) {
+    lazy_report_range_state_t current_state =
+        pop_lazy_report_range_state_t_stack(&lazy_handler->stack);
+    struct child_result *current_cr = &current_state.current_cr;
+    struct block *current_block = current_cr->resulting_block;
+    TREE_DEPTH_T current_block_depth = current_cr->block_depth;
+    TREE_DEPTH_T tree_depth = qs->treedepth;
+    TREE_DEPTH_T relative_depth = current_cr->resulting_relative_depth;
+    TREE_DEPTH_T real_depth = relative_depth + current_block_depth;
 
-    TREE_DEPTH_T real_depth =
-        cresult->resulting_relative_depth + current.block_depth;
-    for (uint32_t child_pos = current.last_iteration; child_pos < 4;
+    uint64_t half_length =
+        1UL << ((uint64_t)tree_depth - (uint64_t)real_depth - 1);
+
+    struct report_range child_range;
+    for (uint32_t child_pos = current_state.last_iteration; child_pos < 4;
          child_pos++) {
-      if (real_depth == qs->treedepth - 1) {
-        //        int does_child_exist;
-        //        child_exists(input_block, cresult->resulting_node_idx,
-        //        child_pos,
-        //                     &does_child_exist);
+      if (!clip_report_range(&current_state.range, child_pos, half_length,
+                             &child_range)) {
+        continue;
+      }
+
+      if (real_depth + 1 == tree_depth) {
         int does_child_exist = child_exists_fast(
-            input_block, (int)cresult->resulting_node_idx, (int)child_pos);
+            current_block, (int)current_cr->resulting_node_idx, (int)child_pos);
         if (does_child_exist) {
           add_element_morton_code(&qs->mc, real_depth, child_pos);
           convert_morton_code_to_coordinates(&qs->mc,
                                              &lazy_handler->next_result);
-          lazy_naive_state next_state;
-          next_state.block_depth = current.block_depth;
-          next_state.input_block = current.input_block;
-          next_state.cr = current.cr;
+
+          lazy_report_range_state_t next_state = current_state;
           next_state.last_iteration = child_pos + 1;
-          next_state.frontier_traversal_idx = current.frontier_traversal_idx;
           lazy_handler->has_next = TRUE;
-          push_lazy_naive_state_stack(&lazy_handler->states_stack, next_state);
-
+          push_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                               next_state);
           return SUCCESS_ECODE_K2T;
         }
         continue;
       }
+      uint32_t current_node_index = current_cr->resulting_node_idx;
+      struct child_result next_cr = *current_cr;
+      uint32_t tmp_frontier_traversal_idx =
+          current_state.frontier_traversal_idx;
+      CHECK_CHILD_ERR(child(current_block, current_node_index, child_pos,
+                            relative_depth, &next_cr, qs, current_block_depth,
+                            &tmp_frontier_traversal_idx));
+      if (next_cr.exists) {
+        add_element_morton_code(&qs->mc, real_depth, child_pos);
+        if (child_pos < 3) {
+          lazy_report_range_state_t sibling_state = current_state;
+          sibling_state.last_iteration = child_pos + 1;
+          push_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                               sibling_state);
+        }
+        lazy_report_range_state_t next_state;
+        next_state.range = child_range;
+        next_state.current_cr = next_cr;
+        next_state.last_iteration = 0;
+        next_state.frontier_traversal_idx = tmp_frontier_traversal_idx;
+        push_lazy_report_range_state_t_stack(&lazy_handler->stack, next_state);
+        break;
+      }
+    }
+  }
 
-      uint32_t next_traversal_idx = current.frontier_traversal_idx;
+  lazy_handler->has_next = FALSE;
+  return SUCCESS_ECODE_K2T;
+}
 
-      struct child_result cr;
-      clean_child_result(&cr);
-      int err = child(input_block, cresult->resulting_node_idx, child_pos,
-                      cresult->resulting_relative_depth, &cr, qs,
-                      current.block_depth, &next_traversal_idx);
+int report_range_lazy_init(struct lazy_handler_report_range_t *lazy_handler,
+                           struct block *input_block, struct queries_state *qs,
+                           uint64_t col_lo, uint64_t col_hi, uint64_t row_lo,
+                           uint64_t row_hi) {
+  lazy_handler->has_next = FALSE;
+  lazy_handler->qs = qs;
+  lazy_handler->tree_root = input_block;
+  lazy_handler->empty_range =
+      !init_report_range(&lazy_handler->range, col_lo, col_hi, row_lo, row_hi,
+                         qs->treedepth);
 
-      if (err == DOES_NOT_EXIST_CHILD_ERR) {
-        continue;
-      } else if (err != 0) {
-        return err;
-      }
-      add_element_morton_code(&qs->mc, real_depth, child_pos);
+  init_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                       lazy_handler->qs->treedepth * 4);
 
-      if (child_pos < 3) {
-        lazy_naive_state sibling_state;
-        sibling_state.block_depth = current.block_depth;
-        sibling_state.input_block = current.input_block;
-        sibling_state.cr = current.cr;
-        sibling_state.last_iteration = child_pos + 1;
-        sibling_state.frontier_traversal_idx = current.frontier_traversal_idx;
-        push_lazy_naive_state_stack(&lazy_handler->states_stack, sibling_state);
-      }
+  return report_range_reset(lazy_handler);
+}
 
-      lazy_naive_state next_state;
-      next_state.block_depth = cr.block_depth;
-      next_state.input_block = cr.resulting_block;
-      next_state.cr = cr;
-      next_state.last_iteration = 0;
-      next_state.frontier_traversal_idx = next_traversal_idx;
-      push_lazy_naive_state_stack(&lazy_handler->states_stack, next_state);
-      break;
-    }
-  }
-  lazy_handler->has_next = FALSE;
+int report_range_lazy_clean(struct lazy_handler_report_range_t *lazy_handler) {
+  free_lazy_report_range_state_t_stack(&lazy_handler->stack);
   return SUCCESS_ECODE_K2T;
 }
 
-int naive_scan_points_lazy_has_next(
-    struct lazy_handler_naive_scan_t *lazy_handler, int *result) {
+int report_range_has_next(struct lazy_handler_report_range_t *lazy_handler,
+                          int *result) {
   *result = lazy_handler->has_next;
   return SUCCESS_ECODE_K2T;
 }
 
-int naive_scan_points_lazy_reset(
-    struct lazy_handler_naive_scan_t *lazy_handler) {
-  reset_lazy_naive_state_stack(&lazy_handler->states_stack);
-
+int report_range_reset(struct lazy_handler_report_range_t *lazy_handler) {
+  reset_lazy_report_range_state_t_stack(&lazy_handler->stack);
   lazy_handler->has_next = FALSE;
+  if (lazy_handler->empty_range) {
+    return SUCCESS_ECODE_K2T;
+  }
 
-  lazy_naive_state first_state;
-  first_state.block_depth = 0;
-  first_state.input_block = lazy_handler->tree_root;
+  lazy_report_range_state_t first_state;
+  first_state.range = lazy_handler->range;
+  clean_child_result(&first_state.current_cr);
+  first_state.current_cr.resulting_block = lazy_handler->tree_root;
   first_state.last_iteration = 0;
   first_state.frontier_traversal_idx = 0;
-  clean_child_result(&first_state.cr);
-
-  push_lazy_naive_state_stack(&lazy_handler->states_stack, first_state);
-  naive_scan_points_lazy_next(lazy_handler, &lazy_handler->next_result);
 
-  return SUCCESS_ECODE_K2T;
+  push_lazy_report_range_state_t_stack(&lazy_handler->stack, first_state);
+  return report_range_next(lazy_handler, &lazy_handler->next_result);
 }
 
-int report_band_next(struct lazy_handler_report_band_t *lazy_handler,
-                     uint64_t *result) {
+int report_bands_next(struct lazy_handler_report_bands_t *lazy_handler,
+                      pair2dl_t *result) {
   *result = lazy_handler->next_result;
   struct queries_state *qs = lazy_handler->qs;
-  while (!empty_lazy_report_band_state_t_stack(&lazy_handler->stack)) {
-    lazy_report_band_state_t current_state =
-        pop_lazy_report_band_state_t_stack(&lazy_handler->stack);
+  TREE_DEPTH_T tree_depth = qs->treedepth;
+  while (!empty_lazy_report_bands_state_t_stack(&lazy_handler->stack)) {
+    lazy_report_bands_state_t current_state =
+        pop_lazy_report_bands_state_t_stack(&lazy_handler->stack);
     struct child_result *current_cr = &current_state.current_cr;
     struct block *current_block = current_cr->resulting_block;
-    TREE_DEPTH_T current_block_depth = current_cr->block_depth;
-    TREE_DEPTH_T tree_depth = qs->treedepth;
     TREE_DEPTH_T relative_depth = current_cr->resulting_relative_depth;
-    TREE_DEPTH_T real_depth = relative_depth + current_block_depth;
+    TREE_DEPTH_T real_depth = relative_depth + current_cr->block_depth;
 
-    uint64_t half_length =
-        1UL << ((uint64_t)tree_depth - (uint64_t)real_depth - 1);
+    uint64_t split = split_band_coords(
+        lazy_handler->coords, current_state.coords_lo, current_state.coords_hi,
+        (uint32_t)(tree_depth - real_depth - 1));
 
     for (uint32_t child_pos = current_state.last_iteration; child_pos < 4;
          child_pos++) {
-      if (!REPORT_CONTINUE_CONDITION(current_state.current_coord, half_length,
-                                     lazy_handler->which_report, child_pos)) {
+      int second_half =
+          REPORT_SECOND_HALF(lazy_handler->which_report, child_pos);
+      uint64_t lo = second_half ? split : current_state.coords_lo;
+      uint64_t hi = second_half ? current_state.coords_hi : split;
+      if (lo == hi) {
         continue;
       }
 
       if (real_depth + 1 == tree_depth) {
-        //        int does_child_exist;
-        //        child_exists(current_block, current_cr->resulting_node_idx,
-        //        child_pos,
-        //                     &does_child_exist);
         int does_child_exist = child_exists_fast(
             current_block, (int)current_cr->resulting_node_idx, (int)child_pos);
         if (does_child_exist) {
-          struct pair2dl pair;
           add_element_morton_code(&qs->mc, real_depth, child_pos);
-          convert_morton_code_to_coordinates(&qs->mc, &pair);
-          if (lazy_handler->which_report == REPORT_COLUMN)
-            lazy_handler->next_result = pair.row;
-          else
-            lazy_handler->next_result = pair.col;
+          convert_morton_code_to_coordinates(&qs->mc,
+                                             &lazy_handler->next_result);
 
-          lazy_report_band_state_t next_state;
-          next_state.current_coord = current_state.current_coord;
-          next_state.current_cr = current_state.current_cr;
+          lazy_report_bands_state_t next_state = current_state;
           next_state.last_iteration = child_pos + 1;
-          next_state.frontier_traversal_idx =
-              current_state.frontier_traversal_idx;
           lazy_handler->has_next = TRUE;
-          push_lazy_report_band_state_t_stack(&lazy_handler->stack, next_state);
+          push_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                               next_state);
           return SUCCESS_ECODE_K2T;
         }
         continue;
       }
-      uint32_t current_node_index = current_cr->resulting_node_idx;
       struct child_result next_cr = *current_cr;
       uint32_t tmp_frontier_traversal_idx =
           current_state.frontier_traversal_idx;
-      CHECK_CHILD_ERR(child(current_block, current_node_index, child_pos,
-                            relative_depth, &next_cr, qs, current_block_depth,
+      CHECK_CHILD_ERR(child(current_block, current_cr->resulting_node_idx,
+                            child_pos, relative_depth, &next_cr, qs,
+                            current_cr->block_depth,
                             &tmp_frontier_traversal_idx));
       if (next_cr.exists) {
-
         add_element_morton_code(&qs->mc, real_depth, child_pos);
         if (child_pos < 3) {
-          lazy_report_band_state_t sibling_state;
-          sibling_state.current_coord = current_state.current_coord;
-          sibling_state.current_cr = current_state.current_cr;
+          lazy_report_bands_state_t sibling_state = current_state;
           sibling_state.last_iteration = child_pos + 1;
-          sibling_state.frontier_traversal_idx =
-              current_state.frontier_traversal_idx;
-          push_lazy_report_band_state_t_stack(&lazy_handler->stack,
-                                              sibling_state);
+          push_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                               sibling_state);
         }
-        lazy_report_band_state_t next_state;
-        next_state.current_coord = current_state.current_coord % half_length;
+        lazy_report_bands_state_t next_state;
+        next_state.coords_lo = lo;
+        next_state.coords_hi = hi;
         next_state.current_cr = next_cr;
         next_state.last_iteration = 0;
         next_state.frontier_traversal_idx = tmp_frontier_traversal_idx;
-        push_lazy_report_band_state_t_stack(&lazy_handler->stack, next_state);
+        push_lazy_report_bands_state_t_stack(&lazy_handler->stack, next_state);
         break;
       }
     }
@@ -1733,76 +3896,67 @@ int report_band_next(struct lazy_handler_report_band_t *lazy_handler,
   return SUCCESS_ECODE_K2T;
 }
 
-int report_band_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
-                          struct block *input_block, struct queries_state *qs,
-                          int which_report, uint64_t coord);
-
-int report_band_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
-                          struct block *input_block, struct queries_state *qs,
-                          int which_report, uint64_t coord) {
-
-  lazy_handler->which_report = which_report;
+static int report_bands_lazy_init(
+    struct lazy_handler_report_bands_t *lazy_handler, struct block *input_block,
+    struct queries_state *qs, const uint64_t *coords, uint64_t coords_count,
+    int which_report) {
   lazy_handler->has_next = FALSE;
   lazy_handler->qs = qs;
-  lazy_handler->coord_to_report = coord;
   lazy_handler->tree_root = input_block;
+  lazy_handler->which_report = which_report;
+  lazy_handler->coords_count = sort_band_coords(
+      coords, coords_count, qs->treedepth, &lazy_handler->coords);
 
-  init_lazy_report_band_state_t_stack(&lazy_handler->stack,
-                                      lazy_handler->qs->treedepth * 4);
-
-  lazy_report_band_state_t first_state;
-  first_state.current_coord = coord;
-  clean_child_result(&first_state.current_cr);
-  first_state.current_cr.resulting_block = input_block;
-  first_state.last_iteration = 0;
-  first_state.frontier_traversal_idx = 0;
-
-  push_lazy_report_band_state_t_stack(&lazy_handler->stack, first_state);
-  report_band_next(lazy_handler, &lazy_handler->next_result);
+  init_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                       lazy_handler->qs->treedepth * 4);
 
-  return SUCCESS_ECODE_K2T;
+  return report_bands_reset(lazy_handler);
 }
 
-int report_column_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
-                            struct block *input_block, struct queries_state *qs,
-                            uint64_t coord) {
-  report_band_lazy_init(lazy_handler, input_block, qs, REPORT_COLUMN, coord);
-  return SUCCESS_ECODE_K2T;
+int report_rows_lazy_init(struct lazy_handler_report_bands_t *lazy_handler,
+                          struct block *input_block, struct queries_state *qs,
+                          const uint64_t *rows, uint64_t rows_count) {
+  return report_bands_lazy_init(lazy_handler, input_block, qs, rows,
+                                rows_count, REPORT_ROW);
 }
 
-int report_row_lazy_init(struct lazy_handler_report_band_t *lazy_handler,
-                         struct block *input_block, struct queries_state *qs,
-                         uint64_t coord) {
-  report_band_lazy_init(lazy_handler, input_block, qs, REPORT_ROW, coord);
-  return SUCCESS_ECODE_K2T;
+int report_columns_lazy_init(struct lazy_handler_report_bands_t *lazy_handler,
+                             struct block *input_block,
+                             struct queries_state *qs, const uint64_t *cols,
+                             uint64_t cols_count) {
+  return report_bands_lazy_init(lazy_handler, input_block, qs, cols,
+                                cols_count, REPORT_COLUMN);
 }
 
-int report_band_lazy_clean(struct lazy_handler_report_band_t *lazy_handler) {
-  free_lazy_report_band_state_t_stack(&lazy_handler->stack);
+int report_bands_lazy_clean(struct lazy_handler_report_bands_t *lazy_handler) {
+  free_lazy_report_bands_state_t_stack(&lazy_handler->stack);
+  free(lazy_handler->coords);
   return SUCCESS_ECODE_K2T;
 }
 
-int report_band_has_next(struct lazy_handler_report_band_t *lazy_handler,
-                         int *result) {
+int report_bands_has_next(struct lazy_handler_report_bands_t *lazy_handler,
+                          int *result) {
   *result = lazy_handler->has_next;
   return SUCCESS_ECODE_K2T;
 }
 
-int report_band_reset(struct lazy_handler_report_band_t *lazy_handler) {
-  reset_lazy_report_band_state_t_stack(&lazy_handler->stack);
+int report_bands_reset(struct lazy_handler_report_bands_t *lazy_handler) {
+  reset_lazy_report_bands_state_t_stack(&lazy_handler->stack);
   lazy_handler->has_next = FALSE;
+  if (lazy_handler->coords_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
 
-  lazy_report_band_state_t first_state;
-  first_state.current_coord = lazy_handler->coord_to_report;
+  lazy_report_bands_state_t first_state;
+  first_state.coords_lo = 0;
+  first_state.coords_hi = lazy_handler->coords_count;
   clean_child_result(&first_state.current_cr);
   first_state.current_cr.resulting_block = lazy_handler->tree_root;
   first_state.last_iteration = 0;
   first_state.frontier_traversal_idx = 0;
 
-  push_lazy_report_band_state_t_stack(&lazy_handler->stack, first_state);
-  report_band_next(lazy_handler, &lazy_handler->next_result);
-
-  return SUCCESS_ECODE_K2T;
+  push_lazy_report_bands_state_t_stack(&lazy_handler->stack, first_state);
+  return report_bands_next(lazy_handler, &lazy_handler->next_result);
 }
 
 int delete_nodes_in_block(struct block *input_block, struct deletion_state *ds,
@@ -1823,10 +3977,16 @@ int delete_nodes_in_block(struct block *input_block, struct deletion_state *ds,
   int next_amount_of_nodes = input_block->nodes_count - amount_to_delete;
 
   int new_size_bits = next_amount_of_nodes * 4;
-  int new_container_size = CEIL_OF_DIV(new_size_bits, BITS_SIZE(uint32_t));
-  uint32_t *next_container = NULL;
-  if (new_container_size > 0) {
-    next_container = k2tree_alloc_u32array(new_container_size);
+  int new_container_size = CEIL_OF_DIV(new_size_bits, (int)BVCTYPE_BITS);
+  /* deferred compaction moves the nodes left in place, compact_block_tree
+   * shrinks the container later */
+  int in_place = ds->qs->deferred_compaction && next_amount_of_nodes > 0;
+  BVCTYPE *next_container = NULL;
+  if (in_place) {
+    next_container = input_block->container;
+    new_container_size = (int)input_block->container_size;
+  } else if (new_container_size > 0) {
+    next_container = k2tree_alloc_container(new_container_size);
   }
 
   // int next_node_to_delete = pop_int_stack(&ds->nodes_to_delete);
@@ -1837,22 +3997,32 @@ int delete_nodes_in_block(struct block *input_block, struct deletion_state *ds,
   int next_node_to_delete = -1;
   while (!empty_int_stack(&ds->nodes_to_delete)) {
     next_node_to_delete = pop_int_stack(&ds->nodes_to_delete);
+    SKIP_INDEX_REMOVE_NODES(input_block,
+                            (uint32_t)(next_node_to_delete - current_deleted),
+                            1);
 
     int src_left;
     int dst_left;
     int dst_right;
-    src_left = left_side;
 
-    if (left_side == 0) {
+    /* the nodes kept start right after the previously deleted one, which
+     * matters when the deleted nodes are not contiguous */
+    if (current_deleted == 0) {
+      src_left = 0;
       dst_left = 0;
     } else {
+      src_left = left_side + 1;
       dst_left = left_side - (current_deleted - 1);
     }
     dst_right = next_node_to_delete - (current_deleted + 1);
 
     int amount = dst_right - dst_left + 1;
 
-    if (amount > 0) {
+    if (amount > 0 && in_place) {
+      bits_move_uarray(next_container, 4 * (uint32_t)dst_left,
+                       input_block->container, 4 * (uint32_t)src_left,
+                       4 * (uint32_t)amount);
+    } else if (amount > 0) {
       int err = (copy_nodes_between_blocks_uarr(
           input_block->container, input_block->container_size, next_container,
           new_container_size, src_left, dst_left, amount));
@@ -1923,7 +4093,14 @@ int delete_nodes_in_block(struct block *input_block, struct deletion_state *ds,
     current_deleted++;
   }
 
-  if (next_node_to_delete < input_block->nodes_count - 1) {
+  if (next_node_to_delete < input_block->nodes_count - 1 && in_place) {
+    int amount = input_block->nodes_count - next_node_to_delete - 1;
+    bits_move_uarray(next_container,
+                     4 * (uint32_t)(next_node_to_delete - (current_deleted - 1)),
+                     input_block->container,
+                     4 * (uint32_t)(next_node_to_delete + 1),
+                     4 * (uint32_t)amount);
+  } else if (next_node_to_delete < input_block->nodes_count - 1) {
     int amount = input_block->nodes_count - next_node_to_delete - 1;
 
     int err = (copy_nodes_between_blocks_uarr(
@@ -1937,7 +4114,17 @@ int delete_nodes_in_block(struct block *input_block, struct deletion_state *ds,
     }
   }
 
-  k2tree_free_u32array(input_block->container, input_block->container_size);
+  if (next_amount_of_nodes == 0) {
+    SKIP_INDEX_FREE(input_block);
+  }
+  if (in_place) {
+    /* the slack left behind has to read as empty nodes */
+    bits_clear_uarray(next_container, 4 * (uint32_t)next_amount_of_nodes,
+                      4 * (uint32_t)amount_to_delete);
+  } else {
+    k2tree_free_container(input_block->container,
+                          input_block->container_size);
+  }
   input_block->container = next_container;
   input_block->container_size = new_container_size;
   input_block->nodes_count = next_amount_of_nodes;
@@ -1951,8 +4138,8 @@ int merge_blocks(struct block *parent_block, struct block *child_block,
   int merged_nodes = parent_block->nodes_count + child_block->nodes_count - 1;
   int merged_nodes_bits_amount = merged_nodes * 4;
   int new_container_size =
-      CEIL_OF_DIV(merged_nodes_bits_amount, BITS_SIZE(uint32_t));
-  uint32_t *new_container = k2tree_alloc_u32array(new_container_size);
+      CEIL_OF_DIV(merged_nodes_bits_amount, (int)BVCTYPE_BITS);
+  BVCTYPE *new_container = k2tree_alloc_container(new_container_size);
 
   int err;
   // build merged topology
@@ -2047,11 +4234,15 @@ int merge_blocks(struct block *parent_block, struct block *child_block,
   int next_nodes_count =
       parent_block->nodes_count - 1 + child_block->nodes_count;
 
-  k2tree_free_u32array(child_block->container, child_block->container_size);
+  /* a deletion merges before it clears the bit of the merged root, so the
+   * parent can't be indexed yet. The next child() indexes it again */
+  SKIP_INDEX_FREE(child_block);
+  SKIP_INDEX_FREE(parent_block);
+  k2tree_free_container(child_block->container, child_block->container_size);
   k2tree_free_preorders(child_block->preorders);
   k2tree_free_blocks_array(child_block->children_blocks);
 
-  k2tree_free_u32array(parent_block->container, parent_block->container_size);
+  k2tree_free_container(parent_block->container, parent_block->container_size);
   k2tree_free_preorders(parent_block->preorders);
   k2tree_free_blocks_array(
       parent_block->children_blocks); // child block ceased to exist
@@ -2107,6 +4298,7 @@ int delete_point_rec(struct block *input_block, struct deletion_state *ds,
                      int *has_children, uint32_t *frontier_traversal_idx) {
 
   if (cr.is_leaf_result) {
+    ds->last_block_depth = cr.block_depth;
     return SUCCESS_ECODE_K2T;
   }
 
@@ -2121,11 +4313,22 @@ int delete_point_rec(struct block *input_block, struct deletion_state *ds,
     *already_not_exists = TRUE;
     return SUCCESS_ECODE_K2T;
   }
+  if (cr.is_leaf_result && cr.resulting_block != input_block) {
+    /* a frontier jump landed on the last level before the leaves, whose bit
+     * has to be cleared inside the child block */
+    cr.is_leaf_result = FALSE;
+  }
   CHECK_ERR(delete_point_rec(cr.resulting_block, ds, cr, already_not_exists,
                              has_children, frontier_traversal_idx));
 
   if (*already_not_exists)
     return SUCCESS_ECODE_K2T;
+#ifdef POINT_COUNTS
+  /* before a merge, which moves the count into the input block */
+  if (input_block != cr.resulting_block) {
+    cr.resulting_block->points_count--;
+  }
+#endif
 
   int total_deleted = 0;
   int previous_nodes_amount = cr.resulting_block->nodes_count;
@@ -2142,7 +4345,7 @@ int delete_point_rec(struct block *input_block, struct deletion_state *ds,
   }
 
   int did_merge = FALSE;
-  if (input_block != cr.resulting_block) {
+  if (input_block != cr.resulting_block && !ds->qs->deferred_compaction) {
 
     if (next_amount_of_nodes_child > 0 &&
         next_amount_of_nodes_child + input_block->nodes_count <
@@ -2162,14 +4365,111 @@ int delete_point_rec(struct block *input_block, struct deletion_state *ds,
                                     already_not_exists, has_children);
 }
 
-int delete_point(struct block *input_block, uint64_t col,
-                 uint64_t row, struct queries_state *qs,
-                 int *already_not_exists) {
+static int same_compaction_block(const compaction_candidate_t *lhs,
+                                 const compaction_candidate_t *rhs) {
+  return lhs->depth == rhs->depth && lhs->col == rhs->col &&
+         lhs->row == rhs->row;
+}
+
+/* Candidate of the queue at position, to deduplicate the queue */
+struct queued_compaction_candidate {
+  compaction_candidate_t candidate;
+  long position;
+};
+
+/* Same block together, the most recent first */
+static int compare_queued_compaction_candidates(const void *lhs,
+                                                const void *rhs) {
+  const struct queued_compaction_candidate *l =
+      (const struct queued_compaction_candidate *)lhs;
+  const struct queued_compaction_candidate *r =
+      (const struct queued_compaction_candidate *)rhs;
+  if (l->candidate.depth != r->candidate.depth)
+    return l->candidate.depth < r->candidate.depth ? -1 : 1;
+  if (l->candidate.col != r->candidate.col)
+    return l->candidate.col < r->candidate.col ? -1 : 1;
+  if (l->candidate.row != r->candidate.row)
+    return l->candidate.row < r->candidate.row ? -1 : 1;
+  return (l->position < r->position) - (l->position > r->position);
+}
+
+/* Keeps the most recent entry of every block in the queue, in queue order */
+static void dedup_compaction_candidates(struct queries_state *qs) {
+  struct vector_compaction_candidate_t *candidates =
+      &qs->compaction_candidates;
+  long count = candidates->nof_items;
+  /* without memory the queue keeps growing until it doubles again */
+  qs->compaction_candidates_deduped = count;
+  struct queued_compaction_candidate *sorted =
+      (struct queued_compaction_candidate *)malloc(
+          sizeof(struct queued_compaction_candidate) * (size_t)count);
+  char *keep = (char *)calloc((size_t)count, sizeof(char));
+  if (!sorted || !keep) {
+    free(sorted);
+    free(keep);
+    return;
+  }
+  for (long i = 0; i < count; i++) {
+    sorted[i].candidate = candidates->data[i];
+    sorted[i].position = i;
+  }
+  qsort(sorted, (size_t)count, sizeof(struct queued_compaction_candidate),
+        compare_queued_compaction_candidates);
+  for (long i = 0; i < count; i++) {
+    if (i == 0 ||
+        !same_compaction_block(&sorted[i - 1].candidate, &sorted[i].candidate)) {
+      keep[sorted[i].position] = TRUE;
+    }
+  }
+  long kept = 0;
+  for (long i = 0; i < count; i++) {
+    if (keep[i]) {
+      candidates->data[kept++] = candidates->data[i];
+    }
+  }
+  candidates->nof_items = kept;
+  qs->compaction_candidates_deduped = kept;
+  free(sorted);
+  free(keep);
+}
+
+/* Queues the block whose root is the node at depth holding (col, row), keeping
+ * only the bits of the coordinates above the block. The queue is deduplicated
+ * each time it doubles, so it holds at most twice the blocks queued, or
+ * COMPACTION_DEDUP_MIN_CANDIDATES entries */
+static void queue_compaction_candidate(struct queries_state *qs, uint64_t col,
+                                       uint64_t row, TREE_DEPTH_T depth) {
+  struct vector_compaction_candidate_t *candidates =
+      &qs->compaction_candidates;
+  TREE_DEPTH_T shift = (TREE_DEPTH_T)(qs->treedepth - depth);
+  compaction_candidate_t candidate;
+  candidate.col = shift < 64 ? col >> shift << shift : 0;
+  candidate.row = shift < 64 ? row >> shift << shift : 0;
+  candidate.depth = depth;
+  if (candidates->nof_items > 0 &&
+      same_compaction_block(&candidates->data[candidates->nof_items - 1],
+                            &candidate)) {
+    return;
+  }
+  vector_compaction_candidate_t__insert_element(candidates, candidate);
+  if (candidates->nof_items >= COMPACTION_DEDUP_MIN_CANDIDATES &&
+      candidates->nof_items >= 2 * qs->compaction_candidates_deduped) {
+    dedup_compaction_candidates(qs);
+  }
+}
+
+int delete_point_internal(struct block *input_block, uint64_t col,
+                          uint64_t row, struct queries_state *qs,
+                          int *already_not_exists) {
   *already_not_exists = FALSE;
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
   struct deletion_state ds;
   ds.qs = qs;
   init_morton_code(&ds.mc, qs->treedepth);
   init_int_stack(&ds.nodes_to_delete, qs->treedepth);
+  ds.last_block_depth = 0;
   convert_coordinates_to_morton_code(col, row, qs->treedepth, &ds.mc);
 
   struct child_result cr;
@@ -2182,8 +4482,15 @@ int delete_point(struct block *input_block, uint64_t col,
                              &has_children, &frontier_traversal_idx));
 
   if (!(*already_not_exists)) {
+#ifdef POINT_COUNTS
+    input_block->points_count--;
+#endif
     int total_deleted = 0;
     CHECK_ERR(delete_nodes_in_block(input_block, &ds, &total_deleted));
+    if (qs->deferred_compaction) {
+      /* compacting the last block reached also looks at the ones above */
+      queue_compaction_candidate(qs, col, row, ds.last_block_depth);
+    }
   }
 
   free_int_stack(&ds.nodes_to_delete);
@@ -2191,6 +4498,425 @@ int delete_point(struct block *input_block, uint64_t col,
   return SUCCESS_ECODE_K2T;
 }
 
+int delete_point(struct block *input_block, uint64_t col,
+                 uint64_t row, struct queries_state *qs,
+                 int *already_not_exists) {
+  TREE_ALLOCATOR_ENTER(input_block);
+  int err =
+      delete_point_internal(input_block, col, row, qs, already_not_exists);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+/* Changes planned by a batch deletion on a single block */
+struct batch_deletion {
+  struct deletion_state ds;
+  struct int_stack bits_to_clear;
+  int *touched_children;
+  uint64_t deleted_count;
+};
+
+static int delete_points_batch_in_block(struct block *input_block,
+                                        TREE_DEPTH_T block_depth,
+                                        const pair2dl_t *points,
+                                        uint64_t points_from,
+                                        uint64_t points_to,
+                                        struct queries_state *qs,
+                                        uint64_t *deleted_count);
+
+/**
+ * @brief Plans the deletion of points[points_from..points_to) below the node
+ *
+ * Nothing is written in the block: the bits to clear and the nodes left empty
+ * are pushed to bd. Children are visited from right to left so that the nodes
+ * still to be visited keep their positions, which also pushes the emptied
+ * nodes in decreasing preorder as delete_nodes_in_block expects. Frontier
+ * nodes hand the points to their children blocks, which are fully updated.
+ */
+static int delete_points_batch_rec(struct block *input_block,
+                                   uint32_t node_idx,
+                                   TREE_DEPTH_T relative_depth,
+                                   TREE_DEPTH_T block_depth,
+                                   const pair2dl_t *points,
+                                   uint64_t points_from, uint64_t points_to,
+                                   struct queries_state *qs,
+                                   struct batch_deletion *bd,
+                                   uint32_t frontier_traversal_idx,
+                                   int *emptied) {
+  TREE_DEPTH_T treedepth = qs->treedepth;
+  TREE_DEPTH_T depth = block_depth + relative_depth;
+  uint32_t node = (uint32_t)get_node_fast(input_block, (int)node_idx);
+  uint32_t cleared = 0;
+
+  if (depth + 1 == treedepth) {
+    for (uint64_t i = points_from; i < points_to; i++) {
+      uint32_t child_pos =
+          MORTON_CODE_AT(points[i].col, points[i].row, treedepth, depth);
+      uint32_t bit = 1U << (3 - child_pos);
+      if ((node & ~cleared) & bit) {
+        cleared |= bit;
+        push_int_stack(&bd->bits_to_clear, (int)(node_idx * 4 + child_pos));
+        bd->deleted_count++;
+      }
+    }
+  } else if (frontier_check(input_block, node_idx, &frontier_traversal_idx)) {
+    struct block *child_block =
+        &input_block->children_blocks[frontier_traversal_idx];
+    uint64_t child_deleted;
+    CHECK_ERR(delete_points_batch_in_block(child_block, depth, points,
+                                           points_from, points_to, qs,
+                                           &child_deleted));
+    bd->deleted_count += child_deleted;
+    bd->touched_children[frontier_traversal_idx] = child_deleted > 0;
+
+    /* the frontier node mirrors the root of its child block */
+    uint32_t child_root = child_block->nodes_count > 0
+                              ? (uint32_t)get_node_fast(child_block, 0)
+                              : 0;
+    for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+      uint32_t bit = 1U << (3 - child_pos);
+      if ((node & bit) && !(child_root & bit)) {
+        cleared |= bit;
+        push_int_stack(&bd->bits_to_clear, (int)(node_idx * 4 + child_pos));
+      }
+    }
+  } else {
+    uint32_t groups_pos[4];
+    uint64_t groups_from[4];
+    uint64_t groups_to[4];
+    int groups_count = 0;
+    for (uint64_t i = points_from; i < points_to;) {
+      uint32_t child_pos =
+          MORTON_CODE_AT(points[i].col, points[i].row, treedepth, depth);
+      uint64_t j = i + 1;
+      while (j < points_to && MORTON_CODE_AT(points[j].col, points[j].row,
+                                             treedepth, depth) == child_pos) {
+        j++;
+      }
+      groups_pos[groups_count] = child_pos;
+      groups_from[groups_count] = i;
+      groups_to[groups_count] = j;
+      groups_count++;
+      i = j;
+    }
+
+    for (int group = groups_count - 1; group >= 0; group--) {
+      uint32_t child_pos = groups_pos[group];
+      uint32_t bit = 1U << (3 - child_pos);
+      if (!(node & bit)) {
+        continue;
+      }
+      struct child_result cr;
+      clean_child_result(&cr);
+      uint32_t tmp_frontier_traversal_idx = frontier_traversal_idx;
+      CHECK_ERR(child(input_block, node_idx, child_pos, relative_depth, &cr,
+                      qs, block_depth, &tmp_frontier_traversal_idx));
+      int child_emptied;
+      CHECK_ERR(delete_points_batch_rec(
+          input_block, cr.resulting_node_idx, relative_depth + 1, block_depth,
+          points, groups_from[group], groups_to[group], qs, bd,
+          tmp_frontier_traversal_idx, &child_emptied));
+      if (child_emptied) {
+        cleared |= bit;
+        push_int_stack(&bd->bits_to_clear, (int)(node_idx * 4 + child_pos));
+      }
+    }
+  }
+
+  *emptied = (node & ~cleared) == 0;
+  if (*emptied) {
+    push_int_stack(&bd->ds.nodes_to_delete, (int)node_idx);
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+/**
+ * @brief Deletes points[points_from..points_to) from the block and its
+ * children blocks
+ *
+ * The deletion is planned first, then the bits are cleared, the emptied nodes
+ * are removed with a single delete_nodes_in_block and only the children blocks
+ * which lost points are considered for a merge, once each. With
+ * deferred_compaction the merges are left to compact_block_tree and the
+ * deepest blocks which lost points are queued instead.
+ */
+static int delete_points_batch_in_block(struct block *input_block,
+                                        TREE_DEPTH_T block_depth,
+                                        const pair2dl_t *points,
+                                        uint64_t points_from,
+                                        uint64_t points_to,
+                                        struct queries_state *qs,
+                                        uint64_t *deleted_count) {
+  *deleted_count = 0;
+  if (input_block->nodes_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  struct batch_deletion bd;
+  bd.ds.qs = qs;
+  bd.ds.last_block_depth = block_depth;
+  /* stacks don't grow: every node can be emptied and all its bits cleared */
+  init_int_stack(&bd.ds.nodes_to_delete, (int)input_block->nodes_count + 1);
+  init_int_stack(&bd.bits_to_clear, 4 * (int)input_block->nodes_count);
+  int children_count = (int)input_block->children;
+  bd.touched_children = (int *)calloc((size_t)children_count + 1, sizeof(int));
+  bd.deleted_count = 0;
+
+  int emptied;
+  int err = delete_points_batch_rec(input_block, 0, 0, block_depth, points,
+                                    points_from, points_to, qs, &bd, 0,
+                                    &emptied);
+  if (err == SUCCESS_ECODE_K2T && bd.deleted_count > 0) {
+    /* rebuilt once the nodes are deleted, unless a merge drops it */
+    SKIP_INDEX_INVALIDATE(input_block);
+    while (!empty_int_stack(&bd.bits_to_clear)) {
+      bit_clear(input_block, (uint32_t)pop_int_stack(&bd.bits_to_clear));
+    }
+#ifdef POINT_COUNTS
+    input_block->points_count -= bd.deleted_count;
+#endif
+
+    /* positions of the touched children once the emptied ones are gone */
+    int candidates_count = 0;
+    int removed = 0;
+    for (int i = 0; i < children_count; i++) {
+      if (input_block->children_blocks[i].nodes_count == 0) {
+        removed++;
+      } else if (bd.touched_children[i]) {
+        bd.touched_children[candidates_count++] = i - removed;
+      }
+    }
+
+    if (!empty_int_stack(&bd.ds.nodes_to_delete)) {
+      int total_deleted;
+      err = delete_nodes_in_block(input_block, &bd.ds, &total_deleted);
+    }
+
+    if (qs->deferred_compaction && candidates_count == 0) {
+      /* the children blocks left queue themselves and this one with them */
+      queue_compaction_candidate(qs, points[points_from].col,
+                                 points[points_from].row, block_depth);
+    }
+
+    /* right to left, a merge only moves the preorders after it */
+    for (int i = candidates_count - 1;
+         !qs->deferred_compaction && err == SUCCESS_ECODE_K2T && i >= 0;
+         i--) {
+      int child_idx = bd.touched_children[i];
+      struct block *child_block = &input_block->children_blocks[child_idx];
+      if (child_block->nodes_count + input_block->nodes_count <
+          qs->max_nodes_count) {
+        err = merge_blocks(input_block, child_block,
+                           input_block->preorders[child_idx]);
+      }
+    }
+    SKIP_INDEX_REFRESH(input_block);
+  }
+  *deleted_count = bd.deleted_count;
+
+  free(bd.touched_children);
+  free_int_stack(&bd.bits_to_clear);
+  free_int_stack(&bd.ds.nodes_to_delete);
+  return err;
+}
+
+int delete_points_batch_sorted_internal(struct block *input_block,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct queries_state *qs,
+                                        uint64_t *deleted_count) {
+  *deleted_count = 0;
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  return delete_points_batch_in_block(input_block, 0, points, 0, points_count,
+                                      qs, deleted_count);
+}
+
+int delete_points_batch_sorted(struct block *input_block,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct queries_state *qs,
+                               uint64_t *deleted_count) {
+  TREE_ALLOCATOR_ENTER(input_block);
+  int err = delete_points_batch_sorted_internal(input_block, points,
+                                                points_count, qs,
+                                                deleted_count);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+int delete_points_batch(struct block *input_block, const pair2dl_t *points,
+                        uint64_t points_count, struct queries_state *qs,
+                        uint64_t *deleted_count) {
+  *deleted_count = 0;
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  pair2dl_t *sorted_points =
+      (pair2dl_t *)malloc(sizeof(pair2dl_t) * points_count);
+  memcpy(sorted_points, points, sizeof(pair2dl_t) * points_count);
+  sort_points_morton_order(sorted_points, points_count);
+
+  int err = delete_points_batch_sorted(input_block, sorted_points,
+                                       points_count, qs, deleted_count);
+  free(sorted_points);
+  return err;
+}
+
+/* Blocks from the root to a compaction candidate */
+struct compaction_path {
+  struct block *blocks[MAX_TREE_DEPTH + 1];
+  /* Preorder in blocks[i - 1] of the frontier node leading to blocks[i] */
+  uint32_t frontier_preorders[MAX_TREE_DEPTH + 1];
+  int length;
+};
+
+static int find_compaction_path(struct block *input_block,
+                                struct queries_state *qs,
+                                const compaction_candidate_t *candidate,
+                                struct compaction_path *path) {
+  struct block *current_block = input_block;
+  TREE_DEPTH_T block_depth = 0;
+  TREE_DEPTH_T relative_depth = 0;
+  uint32_t node_idx = 0;
+  uint32_t frontier_traversal_idx = 0;
+
+  path->blocks[0] = input_block;
+  path->frontier_preorders[0] = 0;
+  path->length = 1;
+  while (current_block->nodes_count > 0) {
+    TREE_DEPTH_T depth = block_depth + relative_depth;
+    if (depth > candidate->depth) {
+      break;
+    }
+    if (frontier_check(current_block, node_idx, &frontier_traversal_idx)) {
+      if (path->length == MAX_TREE_DEPTH + 1) {
+        break;
+      }
+      path->frontier_preorders[path->length] = node_idx;
+      current_block = &current_block->children_blocks[frontier_traversal_idx];
+      path->blocks[path->length++] = current_block;
+      block_depth = depth;
+      relative_depth = 0;
+      node_idx = 0;
+      frontier_traversal_idx = 0;
+      continue;
+    }
+    if (depth == candidate->depth || depth + 1 == qs->treedepth) {
+      break;
+    }
+    uint32_t child_pos = MORTON_CODE_AT(candidate->col, candidate->row,
+                                        qs->treedepth, depth);
+    if (!child_exists_fast(current_block, (int)node_idx, (int)child_pos)) {
+      break;
+    }
+    struct child_result cr;
+    clean_child_result(&cr);
+    CHECK_ERR(child(current_block, node_idx, child_pos, relative_depth, &cr,
+                    qs, block_depth, &frontier_traversal_idx));
+    node_idx = cr.resulting_node_idx;
+    relative_depth++;
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+/**
+ * @brief Does the cleanup a deletion leaves with deferred_compaction on the
+ * blocks of the path
+ *
+ * The containers are shrunk to the nodes they hold, then the blocks are merged
+ * into their parents from the bottom up when they fit, as delete_point does.
+ * Shrinking goes first: a merge moves the children blocks arrays, and with
+ * them the blocks below it.
+ */
+static int compact_block_path(struct compaction_path *path,
+                              struct queries_state *qs) {
+  for (int i = 0; i < path->length; i++) {
+    struct block *current_block = path->blocks[i];
+    int needed_size =
+        CEIL_OF_DIV(4 * (int)current_block->nodes_count, (int)BVCTYPE_BITS);
+    if (current_block->nodes_count == 0 ||
+        (int)current_block->container_size <= needed_size) {
+      continue;
+    }
+    BVCTYPE *container = k2tree_realloc_container(
+        current_block->container, (int)current_block->container_size,
+        needed_size);
+    if (!container) {
+      return CONTAINER_ALLOCATION_FAILED;
+    }
+    current_block->container = container;
+    current_block->container_size = (CONTAINER_SZ_T)needed_size;
+  }
+
+  for (int i = path->length - 1; i > 0; i--) {
+    struct block *parent_block = path->blocks[i - 1];
+    struct block *child_block = path->blocks[i];
+    if (child_block->nodes_count > 0 &&
+        child_block->nodes_count + parent_block->nodes_count <
+            qs->max_nodes_count) {
+      CHECK_ERR(merge_blocks(parent_block, child_block,
+                             path->frontier_preorders[i]));
+    }
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+int compact_block_tree_internal(struct block *input_block,
+                                struct queries_state *qs,
+                                uint64_t time_budget_us,
+                                uint64_t *pending_count) {
+  struct vector_compaction_candidate_t *candidates =
+      &qs->compaction_candidates;
+  *pending_count = (uint64_t)candidates->nof_items;
+  if (qs->read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+
+  struct timeval tval_start, tval_now, tval_elapsed;
+  gettimeofday(&tval_start, NULL);
+  int err = SUCCESS_ECODE_K2T;
+  while (err == SUCCESS_ECODE_K2T && candidates->nof_items > 0) {
+    compaction_candidate_t candidate =
+        candidates->data[--candidates->nof_items];
+    struct compaction_path path;
+    err = find_compaction_path(input_block, qs, &candidate, &path);
+    if (err == SUCCESS_ECODE_K2T) {
+      err = compact_block_path(&path, qs);
+    }
+
+    if (time_budget_us > 0) {
+      gettimeofday(&tval_now, NULL);
+      timersub(&tval_now, &tval_start, &tval_elapsed);
+      if ((uint64_t)tval_elapsed.tv_sec * 1000000 +
+              (uint64_t)tval_elapsed.tv_usec >=
+          time_budget_us) {
+        break;
+      }
+    }
+  }
+  *pending_count = (uint64_t)candidates->nof_items;
+  if (qs->compaction_candidates_deduped > candidates->nof_items) {
+    qs->compaction_candidates_deduped = candidates->nof_items;
+  }
+  return err;
+}
+
+int compact_block_tree(struct block *input_block, struct queries_state *qs,
+                       uint64_t time_budget_us, uint64_t *pending_count) {
+  TREE_ALLOCATOR_ENTER(input_block);
+  int err = compact_block_tree_internal(input_block, qs, time_budget_us,
+                                        pending_count);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
 static void print_block_structure(struct block *input_block, int block_depth) {
   printf("(%d #nodes, %d #children, %d depth)\n", input_block->nodes_count,
          input_block->children, block_depth);
@@ -2210,3 +4936,7 @@ void debug_print_block_tree_structure(struct block *input_block) {
 declare_stack_of_type(lazy_naive_state)
 
     declare_stack_of_type(lazy_report_band_state_t)
+
+        declare_stack_of_type(lazy_report_range_state_t)
+
+            declare_stack_of_type(lazy_report_bands_state_t)
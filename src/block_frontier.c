@@ -37,6 +37,43 @@ SOFTWARE.
 int find_insertion_point(struct block *input_block, uint32_t preorder);
 /* END PRIVATE PROTOTYPES */
 
+/*
+ * First frontier index not before 'from' whose preorder is not less than
+ * 'preorder', or the amount of children if there is none. Callers mostly
+ * advance in preorder, so it gallops from 'from' before the binary search,
+ * which is branchless.
+ */
+static uint32_t frontier_lower_bound(struct block *input_block, uint32_t from,
+                                     uint32_t preorder) {
+  uint32_t children = (uint32_t)input_block->children;
+  NODES_BV_T *preorders = input_block->preorders;
+  if (from >= children || preorders[from] >= preorder) {
+    return from;
+  }
+
+  /* preorders[low] < preorder, the answer is in (low, high] */
+  uint32_t low = from;
+  uint32_t step = 1;
+  while (low + step < children && preorders[low + step] < preorder) {
+    low += step;
+    step *= 2;
+  }
+  uint32_t high = MIN(low + step, children);
+
+  uint32_t first = low + 1;
+  uint32_t len = high - first;
+  if (len == 0) {
+    return first;
+  }
+  /* the answer is in [first, first + len] */
+  while (len > 1) {
+    uint32_t half = len / 2;
+    first = preorders[first + half] < preorder ? first + half : first;
+    len -= half;
+  }
+  return first + (preorders[first] < preorder);
+}
+
 void init_block_frontier(struct block *input_block) {
   input_block->preorders = NULL;
   input_block->children_blocks = NULL;
@@ -58,20 +95,15 @@ int frontier_check(struct block *input_block, uint32_t node_idx,
                    uint32_t *frontier_traversal_idx) {
   uint32_t tmp_findex = *frontier_traversal_idx;
   uint32_t children = (uint32_t)input_block->children;
-  if (tmp_findex >= children || input_block->children == 0) {
+  if (tmp_findex >= children) {
     return FALSE;
   }
 
-  uint32_t current;
-
-  while (tmp_findex < children &&
-         (current = input_block->preorders[tmp_findex]) < node_idx) {
-    tmp_findex++;
-  }
-
+  tmp_findex = frontier_lower_bound(input_block, tmp_findex, node_idx);
   *frontier_traversal_idx = tmp_findex;
 
-  return node_idx == current;
+  return tmp_findex < children &&
+         input_block->preorders[tmp_findex] == node_idx;
 }
 
 struct block *get_child_block(struct block *input_block,
@@ -84,17 +116,9 @@ struct block *get_child_block(struct block *input_block,
   return &input_block->children_blocks[frontier_node_idx];
 }
 
+/* Index of the first frontier node after preorder */
 int find_insertion_point(struct block *input_block, uint32_t preorder) {
-  if (input_block->children == 0) {
-    return 0;
-  }
-  for (NODES_BV_T i = 0; i < input_block->children; i++) {
-    if (input_block->preorders[i] > preorder) {
-      return i;
-    }
-  }
-
-  return (int)input_block->children;
+  return (int)frontier_lower_bound(input_block, 0, preorder + 1);
 }
 
 int extract_sub_block_frontier(struct block *input_block,
@@ -153,6 +177,7 @@ int extract_sub_block_frontier(struct block *input_block,
 
 int add_frontier_node(struct block *input_block,
                       uint32_t new_frontier_node_preorder, struct block *b) {
+  SKIP_INDEX_SET_CHILDLESS(input_block, new_frontier_node_preorder);
   uint32_t insertion_point =
       find_insertion_point(input_block, new_frontier_node_preorder);
 
@@ -191,61 +216,46 @@ int add_frontier_node(struct block *input_block,
   return SUCCESS_ECODE_K2T;
 }
 
-/* TODO: (OPTIMIZATION) replace by binary search if needed */
+/* Subtracts delta from the preorders not less than start. Those form a suffix
+ * of the frontier, so only the suffix is visited and only its first entry
+ * can underflow */
 int fix_frontier_indexes(struct block *input_block, uint32_t start, int delta) {
-  for (int i = 0; i < (int)input_block->children; i++) {
-    uint32_t current_preorder = input_block->preorders[i];
-    if (current_preorder >= start) {
-      if ((int)current_preorder < delta) {
-        return FIX_INDEXES_PREORDER_HIGHER_THAN_DELTA;
-      }
-      uint32_t new_val = current_preorder - (uint32_t)delta;
-      input_block->preorders[i] = (NODES_BV_T)new_val;
-    }
+  uint32_t children = (uint32_t)input_block->children;
+  uint32_t first = frontier_lower_bound(input_block, 0, start);
+  if (first == children) {
+    return SUCCESS_ECODE_K2T;
+  }
+  if ((int)input_block->preorders[first] < delta) {
+    return FIX_INDEXES_PREORDER_HIGHER_THAN_DELTA;
+  }
+  NODES_BV_T *preorders = input_block->preorders;
+  NODES_BV_T shift = (NODES_BV_T)(-delta);
+  for (uint32_t i = first; i < children; i++) {
+    preorders[i] = (NODES_BV_T)(preorders[i] + shift);
   }
   return SUCCESS_ECODE_K2T;
 }
 
-/* TODO: (OPTIMIZATION) replace by binary search if needed to find extreme
- * points */
 int collapse_frontier_nodes(struct block *input_block, uint32_t from_preorder,
                             uint32_t to_preorder) {
+  uint32_t left = frontier_lower_bound(input_block, 0, from_preorder);
+  uint32_t right = frontier_lower_bound(input_block, left, to_preorder + 1);
   /* nothing to do in this case */
-  if (input_block->children == 0) {
+  if (left >= right) {
     return SUCCESS_ECODE_K2T;
   }
-
-  int left_extreme = -1;
-  int right_extreme = -1;
-  for (int i = 0; i < (int)input_block->children; i++) {
-    // uint32_t current_preorder = read_uint_element(&bf->frontier, i);
-    uint32_t current_preorder = input_block->preorders[i];
-    if (current_preorder >= from_preorder && left_extreme == -1) {
-      left_extreme = i;
-    }
-    if (current_preorder <= to_preorder) {
-      right_extreme = i;
-    }
-  }
-  /* nothing to do in this case */
-  if (left_extreme == -1 || right_extreme == -1) {
-    return SUCCESS_ECODE_K2T;
-  }
-
-  int delete_size = right_extreme - left_extreme + 1;
-  int new_size = input_block->children - delete_size;
+  SKIP_INDEX_INVALIDATE(input_block);
 
   uint32_t children = (uint32_t)input_block->children;
 
-  memmove(input_block->preorders + left_extreme,
-          input_block->preorders + (right_extreme + 1),
-          (children - right_extreme) * sizeof(uint32_t));
+  memmove(input_block->preorders + left, input_block->preorders + right,
+          (children - right) * sizeof(NODES_BV_T));
 
-  memmove(input_block->children_blocks + left_extreme,
-          input_block->children_blocks + (right_extreme + 1),
-          (children - right_extreme) * sizeof(struct block));
+  memmove(input_block->children_blocks + left,
+          input_block->children_blocks + right,
+          (children - right) * sizeof(struct block));
 
-  input_block->children = new_size;
+  input_block->children = children - (right - left);
 
   return SUCCESS_ECODE_K2T;
 }
@@ -0,0 +1,174 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "block_scan.h"
+#include "block.h"
+#include "definitions.h"
+
+extern const uint8_t nof_children[16];
+
+static inline uint32_t read_node_nibble(struct block *input_block,
+                                        uint32_t node_index) {
+  return BVCTYPE_NODE(input_block->container, node_index);
+}
+
+/* byte repeated over a whole container word */
+#define BVCTYPE_REPEAT_BYTE(byte) ((~(BVCTYPE)0 / 0xFF) * (byte))
+
+#ifdef BVCTYPE_64
+#define CLZ_BVCTYPE(word) CLZ64(word)
+#else
+#define CLZ_BVCTYPE(word) CLZ32(word)
+#endif
+
+/*
+ * Mask with the highest bit of every nibble of word that doesn't have
+ * exactly one bit set. The per nibble popcounts are computed in place and
+ * the nonzero test can't carry between nibbles, so the result is exact.
+ */
+static inline BVCTYPE not_one_child_nibbles(BVCTYPE word) {
+  BVCTYPE counts = word - ((word >> 1) & BVCTYPE_REPEAT_BYTE(0x55));
+  counts = (counts & BVCTYPE_REPEAT_BYTE(0x33)) +
+           ((counts >> 2) & BVCTYPE_REPEAT_BYTE(0x33));
+  BVCTYPE diff = counts ^ BVCTYPE_REPEAT_BYTE(0x11);
+  return (((diff & BVCTYPE_REPEAT_BYTE(0x77)) + BVCTYPE_REPEAT_BYTE(0x77)) |
+          diff) &
+         BVCTYPE_REPEAT_BYTE(0x88);
+}
+
+/* Amount of consecutive nodes with a single child starting at node_index,
+ * up to limit, reading a whole word of nodes at a time */
+static uint32_t one_child_run(struct block *input_block, uint32_t node_index,
+                              uint32_t limit) {
+  uint32_t run = 0;
+  uint32_t word_index = node_index / NODES_PER_BVCTYPE;
+  uint32_t offset = node_index % NODES_PER_BVCTYPE;
+
+  while (run < limit) {
+    /* the nibbles shifted in are zero, so they always end the run */
+    BVCTYPE word = input_block->container[word_index] << (4 * offset);
+    BVCTYPE mask = not_one_child_nibbles(word);
+    uint32_t found =
+        mask == 0 ? NODES_PER_BVCTYPE : (uint32_t)CLZ_BVCTYPE(mask) / 4;
+    run += found;
+    if (found < NODES_PER_BVCTYPE - offset) {
+      break;
+    }
+    word_index++;
+    offset = 0;
+  }
+
+  return run < limit ? run : limit;
+}
+
+/**
+ * @brief Finds the last node of the subtrees_to_skip consecutive subtrees
+ * that start at node start, without visiting every node.
+ *
+ * Nodes in the level just above the leaves are skipped together with their
+ * leaves, since they are always 1 + (number of children) nodes long, and
+ * chains of nodes with a single child are consumed a container word at a
+ * time. A chain counts as a single subtree of the level where it starts, so
+ * it doesn't touch the stack.
+ *
+ * @param input_block Block to scan
+ * @param start First node of the subtrees to skip
+ * @param subtrees_to_skip Amount of subtrees to skip, at least 1
+ * @param start_depth Depth of the node start in the tree
+ * @param treedepth Depth of the tree
+ * @param frontier_traversal_idx Index of the first frontier node not before
+ * start, advanced past the frontier nodes skipped
+ * @return uint32_t Index of the last node of the skipped subtrees
+ */
+uint32_t block_scan_skip_subtrees(struct block *input_block, uint32_t start,
+                                  uint32_t subtrees_to_skip,
+                                  TREE_DEPTH_T start_depth,
+                                  TREE_DEPTH_T treedepth,
+                                  uint32_t *frontier_traversal_idx) {
+  /* subtrees still to be completed in each open level, and its depth */
+  uint8_t remaining[256];
+  TREE_DEPTH_T level_depth[256];
+  int top = 0;
+  remaining[0] = (uint8_t)subtrees_to_skip;
+  level_depth[0] = start_depth;
+
+  uint32_t leaf_depth = (uint32_t)treedepth - 1;
+  uint32_t current = start;
+  uint32_t depth = start_depth;
+
+  uint32_t fidx = *frontier_traversal_idx;
+  uint32_t next_frontier = fidx < input_block->children
+                               ? input_block->preorders[fidx]
+                               : UINT32_MAX;
+
+  for (;;) {
+    if (depth == leaf_depth) {
+      /* only reached when the scan starts at the leaves: the remaining
+       * siblings are all leaves */
+      current += remaining[top];
+      remaining[top] = 1;
+    } else if (current == next_frontier) {
+      current++;
+      fidx++;
+      next_frontier = fidx < input_block->children
+                          ? input_block->preorders[fidx]
+                          : UINT32_MAX;
+    } else {
+      uint32_t children_count =
+          nof_children[read_node_nibble(input_block, current)];
+      if (depth + 1 == leaf_depth) {
+        current += 1 + children_count;
+      } else if (children_count == 1) {
+        /* the chain stops before the level above the leaves and before the
+         * next frontier node, which need their own handling */
+        uint32_t limit = leaf_depth - 1 - depth;
+        if (next_frontier - current < limit) {
+          limit = next_frontier - current;
+        }
+        uint32_t run = one_child_run(input_block, current, limit);
+        current += run;
+        depth += run;
+        continue;
+      } else if (children_count > 0) {
+        top++;
+        remaining[top] = (uint8_t)children_count;
+        level_depth[top] = (TREE_DEPTH_T)(depth + 1);
+        current++;
+        depth++;
+        continue;
+      } else {
+        current++;
+      }
+    }
+
+    /* a subtree of the top level was completed */
+    while (--remaining[top] == 0) {
+      if (top == 0) {
+        *frontier_traversal_idx = fidx;
+        return current - 1;
+      }
+      top--;
+    }
+    depth = level_depth[top];
+  }
+}
@@ -0,0 +1,598 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <string.h>
+
+#include "block_skip_index.h"
+#include "block.h"
+#include "definitions.h"
+#include "memalloc.h"
+#include "queries_state.h"
+
+#ifdef BLOCK_SKIP_INDEX
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) > (b) ? (b) : (a))
+
+/* Neighbour chunks are merged when they fit in this many nodes, leaving room
+ * for the next insertions so they don't split again right away */
+#define SKIP_INDEX_MERGE_NODES (3 * SKIP_INDEX_CHUNK_NODES / 4)
+
+extern const uint8_t nof_children[16];
+
+static inline uint32_t read_node_nibble(struct block *input_block,
+                                        uint32_t node_index) {
+  return BVCTYPE_NODE(input_block->container, node_index);
+}
+
+/* Shifts which give 0 instead of being undefined for a whole word */
+static inline uint64_t mask_shl(uint64_t mask, uint32_t amount) {
+  return amount >= 64 ? 0 : mask << amount;
+}
+
+static inline uint64_t mask_shr(uint64_t mask, uint32_t amount) {
+  return amount >= 64 ? 0 : mask >> amount;
+}
+
+static inline uint64_t mask_low(uint64_t mask, uint32_t amount) {
+  return amount >= 64 ? mask : mask & (((uint64_t)1 << amount) - 1);
+}
+
+static void summarize_chunk(struct block *input_block,
+                            struct skip_index_chunk *chunk) {
+  int32_t excess = 0;
+  int32_t min_excess = INT16_MAX;
+  uint64_t childless = chunk->childless_mask;
+  for (uint32_t i = 0; i < chunk->nodes; i++, childless >>= 1) {
+    int32_t children_count = 0;
+    if (!(childless & 1)) {
+      children_count = nof_children[read_node_nibble(input_block,
+                                                     chunk->first + i)];
+    }
+    excess += children_count - 1;
+    if (excess < min_excess) {
+      min_excess = excess;
+    }
+  }
+  chunk->excess = (int16_t)excess;
+  chunk->min_excess = (int16_t)min_excess;
+  chunk->dirty = FALSE;
+}
+
+/* Index of the chunk holding node_index, the index must have chunks */
+static uint32_t find_chunk(struct block_skip_index *skip_index,
+                           uint32_t node_index) {
+  uint32_t low = 0;
+  uint32_t high = skip_index->chunks_count;
+  while (high - low > 1) {
+    uint32_t mid = low + (high - low) / 2;
+    if (skip_index->chunks[mid].first <= node_index) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static int reserve_chunks(struct block_skip_index *skip_index,
+                          uint32_t chunks_count) {
+  if (chunks_count <= skip_index->chunks_capacity) {
+    return TRUE;
+  }
+  uint32_t capacity = MAX(chunks_count, skip_index->chunks_capacity +
+                                            skip_index->chunks_capacity / 2);
+  struct skip_index_chunk *chunks =
+      k2tree_realloc_skip_index_chunks(skip_index->chunks, (int)capacity);
+  if (!chunks) {
+    return FALSE;
+  }
+  skip_index->chunks = chunks;
+  skip_index->chunks_capacity = capacity;
+  return TRUE;
+}
+
+/* Single preorder pass over the block, leaving every chunk full but the last */
+static struct block_skip_index *new_skip_index(struct block *input_block,
+                                               TREE_DEPTH_T block_depth,
+                                               TREE_DEPTH_T treedepth) {
+  uint32_t nodes_count = input_block->nodes_count;
+  uint32_t chunks_count = CEIL_OF_DIV(nodes_count, SKIP_INDEX_CHUNK_NODES);
+  /* room for some splits before growing */
+  struct block_skip_index *skip_index =
+      k2tree_alloc_skip_index((int)(chunks_count + chunks_count / 4 + 1));
+  if (!skip_index) {
+    return NULL;
+  }
+  skip_index->chunks_count = chunks_count;
+  skip_index->nodes_count = nodes_count;
+  skip_index->block_depth = block_depth;
+  skip_index->treedepth = treedepth;
+  skip_index->stale = FALSE;
+
+  /* children still to be visited at each depth below the block root */
+  uint8_t remaining[256];
+  int top = -1;
+  uint32_t depth = block_depth;
+  uint32_t fidx = 0;
+  struct skip_index_chunk *chunk = NULL;
+
+  for (uint32_t i = 0; i < nodes_count; i++) {
+    uint32_t pos_in_chunk = i % SKIP_INDEX_CHUNK_NODES;
+    if (pos_in_chunk == 0) {
+      chunk = &skip_index->chunks[i / SKIP_INDEX_CHUNK_NODES];
+      chunk->childless_mask = 0;
+      chunk->first = i;
+      chunk->nodes = (uint16_t)MIN(nodes_count - i, SKIP_INDEX_CHUNK_NODES);
+      chunk->excess = 0;
+      chunk->min_excess = INT16_MAX;
+      chunk->dirty = FALSE;
+    }
+
+    int is_frontier =
+        fidx < input_block->children && input_block->preorders[fidx] == i;
+    if (is_frontier) {
+      fidx++;
+    }
+
+    uint32_t children_count = 0;
+    if (!is_frontier && depth + 1 < treedepth) {
+      children_count = nof_children[read_node_nibble(input_block, i)];
+    }
+
+    if (children_count == 0) {
+      chunk->childless_mask |= (uint64_t)1 << pos_in_chunk;
+    }
+    chunk->excess += (int16_t)children_count - 1;
+    if (chunk->excess < chunk->min_excess) {
+      chunk->min_excess = chunk->excess;
+    }
+
+    if (children_count > 0) {
+      remaining[++top] = (uint8_t)children_count;
+      depth++;
+    } else {
+      while (top >= 0 && --remaining[top] == 0) {
+        top--;
+        depth--;
+      }
+    }
+  }
+
+  return skip_index;
+}
+
+/**
+ * @brief Builds the skip index of a block with a single preorder pass,
+ * replacing any previous one
+ *
+ * @param input_block Block to index
+ * @param block_depth Depth of the root of the block in the tree
+ * @param treedepth Depth of the tree
+ * @return int Result code
+ */
+int skip_index_build(struct block *input_block, TREE_DEPTH_T block_depth,
+                     TREE_DEPTH_T treedepth) {
+  struct block_skip_index *skip_index =
+      new_skip_index(input_block, block_depth, treedepth);
+  if (!skip_index) {
+    return SKIP_INDEX_ALLOCATION_FAILED;
+  }
+  SKIP_INDEX_FREE(input_block);
+  input_block->skip_index = skip_index;
+  return SUCCESS_ECODE_K2T;
+}
+
+void skip_index_free(struct block *input_block) {
+  k2tree_free_skip_index(input_block->skip_index);
+  input_block->skip_index = NULL;
+}
+
+/* Rebuilds a stale index with the depths it was built for. If that fails the
+ * index is dropped, the next child() builds it again */
+void skip_index_refresh(struct block *input_block) {
+  struct block_skip_index *skip_index = input_block->skip_index;
+  if (skip_index_build(input_block, skip_index->block_depth,
+                       skip_index->treedepth) != SUCCESS_ECODE_K2T) {
+    skip_index_free(input_block);
+  }
+}
+
+/* Flags of the nodes [from, from + len) of a chunk once amount nodes with
+ * children are inserted at offset */
+static uint64_t flags_with_inserted(uint64_t childless_mask, uint32_t offset,
+                                    uint32_t amount, uint32_t from,
+                                    uint32_t len) {
+  uint64_t result = 0;
+  if (from < offset) {
+    uint32_t before = MIN(offset, from + len) - from;
+    result |= mask_low(mask_shr(childless_mask, from), before);
+  }
+  uint32_t after_from = MAX(from, offset + amount);
+  if (after_from < from + len) {
+    uint32_t after = from + len - after_from;
+    result |= mask_shl(
+        mask_low(mask_shr(childless_mask, after_from - amount), after),
+        after_from - from);
+  }
+  return result;
+}
+
+/**
+ * @brief Makes room in the index for nodes_count nodes inserted at
+ * node_index, not childless until skip_index_set_childless says otherwise
+ *
+ * The chunk they land in is split in as many balanced chunks as needed and
+ * the ones after it are moved by the amount of nodes inserted.
+ */
+void skip_index_insert_nodes(struct block *input_block, uint32_t node_index,
+                             uint32_t nodes_count) {
+  struct block_skip_index *skip_index = input_block->skip_index;
+  if (nodes_count == 0) {
+    return;
+  }
+
+  struct skip_index_chunk replaced;
+  uint32_t chunk_i;
+  uint32_t replaced_count;
+  if (skip_index->chunks_count == 0) {
+    replaced.childless_mask = 0;
+    replaced.first = 0;
+    replaced.nodes = 0;
+    chunk_i = 0;
+    replaced_count = 0;
+  } else {
+    chunk_i = node_index >= skip_index->nodes_count
+                  ? skip_index->chunks_count - 1
+                  : find_chunk(skip_index, node_index);
+    replaced = skip_index->chunks[chunk_i];
+    replaced_count = 1;
+  }
+
+  uint32_t total = replaced.nodes + nodes_count;
+  uint32_t new_count = CEIL_OF_DIV(total, SKIP_INDEX_CHUNK_NODES);
+  if (!reserve_chunks(skip_index, skip_index->chunks_count + new_count -
+                                      replaced_count)) {
+    skip_index->stale = TRUE;
+    return;
+  }
+
+  struct skip_index_chunk *chunks = skip_index->chunks;
+  uint32_t after = skip_index->chunks_count - chunk_i - replaced_count;
+  memmove(chunks + chunk_i + new_count, chunks + chunk_i + replaced_count,
+          after * sizeof(struct skip_index_chunk));
+
+  uint32_t offset = node_index - replaced.first;
+  uint32_t from = 0;
+  for (uint32_t i = 0; i < new_count; i++) {
+    uint32_t len = total / new_count + (i < total % new_count);
+    struct skip_index_chunk *chunk = &chunks[chunk_i + i];
+    chunk->childless_mask = flags_with_inserted(
+        replaced.childless_mask, offset, nodes_count, from, len);
+    chunk->first = replaced.first + from;
+    chunk->nodes = (uint16_t)len;
+    chunk->dirty = TRUE;
+    from += len;
+  }
+
+  for (uint32_t i = chunk_i + new_count; i < chunk_i + new_count + after;
+       i++) {
+    chunks[i].first += nodes_count;
+  }
+  skip_index->chunks_count += new_count - replaced_count;
+  skip_index->nodes_count += nodes_count;
+}
+
+/* Joins chunk_i and the next one if they fit in SKIP_INDEX_MERGE_NODES */
+static int merge_with_next_chunk(struct block_skip_index *skip_index,
+                                 uint32_t chunk_i) {
+  struct skip_index_chunk *left = &skip_index->chunks[chunk_i];
+  struct skip_index_chunk *right = left + 1;
+  if (chunk_i + 1 >= skip_index->chunks_count ||
+      left->nodes + right->nodes > SKIP_INDEX_MERGE_NODES) {
+    return FALSE;
+  }
+  left->childless_mask |= mask_shl(right->childless_mask, left->nodes);
+  left->nodes = (uint16_t)(left->nodes + right->nodes);
+  left->dirty = TRUE;
+  memmove(right, right + 1,
+          (skip_index->chunks_count - chunk_i - 2) *
+              sizeof(struct skip_index_chunk));
+  skip_index->chunks_count--;
+  return TRUE;
+}
+
+/**
+ * @brief Drops the nodes [node_index, node_index + nodes_count) from the
+ * index
+ *
+ * The chunks left empty are removed and the ones shrunk are merged with a
+ * neighbour when both fit in one.
+ */
+void skip_index_remove_nodes(struct block *input_block, uint32_t node_index,
+                             uint32_t nodes_count) {
+  struct block_skip_index *skip_index = input_block->skip_index;
+  if (nodes_count == 0) {
+    return;
+  }
+
+  struct skip_index_chunk *chunks = skip_index->chunks;
+  uint32_t end = node_index + nodes_count;
+  uint32_t first_i = find_chunk(skip_index, node_index);
+  uint32_t read_i = first_i;
+  uint32_t write_i = first_i;
+  for (; read_i < skip_index->chunks_count && chunks[read_i].first < end;
+       read_i++) {
+    struct skip_index_chunk chunk = chunks[read_i];
+    uint32_t from = MAX(node_index, chunk.first) - chunk.first;
+    uint32_t to = MIN(end, chunk.first + chunk.nodes) - chunk.first;
+    chunk.childless_mask = mask_low(chunk.childless_mask, from) |
+                           mask_shl(mask_shr(chunk.childless_mask, to), from);
+    chunk.nodes = (uint16_t)(chunk.nodes - (to - from));
+    chunk.first = MIN(chunk.first, node_index);
+    chunk.dirty = TRUE;
+    if (chunk.nodes > 0) {
+      chunks[write_i++] = chunk;
+    }
+  }
+
+  uint32_t after = skip_index->chunks_count - read_i;
+  memmove(chunks + write_i, chunks + read_i,
+          after * sizeof(struct skip_index_chunk));
+  for (uint32_t i = write_i; i < write_i + after; i++) {
+    chunks[i].first -= nodes_count;
+  }
+  skip_index->chunks_count = write_i + after;
+  skip_index->nodes_count -= nodes_count;
+
+  /* only the chunks around the removed nodes changed size */
+  uint32_t merge_i = first_i > 0 ? first_i - 1 : 0;
+  while (merge_i < write_i && merge_i < skip_index->chunks_count) {
+    if (!merge_with_next_chunk(skip_index, merge_i)) {
+      merge_i++;
+    }
+  }
+}
+
+/* Follows set_nodes_count, which adds or drops nodes at the end */
+void skip_index_resize(struct block *input_block, uint32_t nodes_count) {
+  uint32_t indexed = input_block->skip_index->nodes_count;
+  if (nodes_count > indexed) {
+    skip_index_insert_nodes(input_block, indexed, nodes_count - indexed);
+  } else if (nodes_count < indexed) {
+    skip_index_remove_nodes(input_block, nodes_count, indexed - nodes_count);
+  }
+}
+
+void skip_index_node_changed(struct block *input_block, uint32_t node_index) {
+  struct block_skip_index *skip_index = input_block->skip_index;
+  /* nodes written before being counted in the block are summarized when
+   * they are added */
+  if (node_index >= skip_index->nodes_count) {
+    return;
+  }
+  skip_index->chunks[find_chunk(skip_index, node_index)].dirty = TRUE;
+}
+
+/* Marks a leaf-level node just inserted or a node just made a frontier node */
+void skip_index_set_childless(struct block *input_block, uint32_t node_index) {
+  struct block_skip_index *skip_index = input_block->skip_index;
+  if (node_index >= skip_index->nodes_count) {
+    return;
+  }
+  struct skip_index_chunk *chunk =
+      &skip_index->chunks[find_chunk(skip_index, node_index)];
+  chunk->childless_mask |= (uint64_t)1 << (node_index - chunk->first);
+  chunk->dirty = TRUE;
+}
+
+/*
+ * Last node of the subtrees_to_skip consecutive subtrees starting at start.
+ * Dirty chunks are summarized again when the caller may write to the block,
+ * otherwise they are walked node by node.
+ */
+static uint32_t skip_subtrees(struct block *input_block,
+                              struct block_skip_index *skip_index,
+                              uint32_t start, uint32_t subtrees_to_skip,
+                              int can_summarize) {
+  uint32_t nodes_count = skip_index->nodes_count;
+  if (start >= nodes_count) {
+    return nodes_count - 1;
+  }
+  int32_t pending = (int32_t)subtrees_to_skip;
+  uint32_t current = start;
+
+  for (uint32_t chunk_i = find_chunk(skip_index, start);
+       chunk_i < skip_index->chunks_count; chunk_i++) {
+    struct skip_index_chunk *chunk = &skip_index->chunks[chunk_i];
+    if (current == chunk->first) {
+      if (chunk->dirty && can_summarize) {
+        summarize_chunk(input_block, chunk);
+      }
+      if (!chunk->dirty && pending + chunk->min_excess > 0) {
+        pending += chunk->excess;
+        current += chunk->nodes;
+        continue;
+      }
+    }
+
+    uint64_t childless = chunk->childless_mask >> (current - chunk->first);
+    uint32_t end = chunk->first + chunk->nodes;
+    for (; current < end; current++, childless >>= 1) {
+      int32_t children_count = 0;
+      if (!(childless & 1)) {
+        children_count = nof_children[read_node_nibble(input_block, current)];
+      }
+      pending += children_count - 1;
+      if (pending == 0) {
+        return current;
+      }
+    }
+  }
+
+  return nodes_count - 1;
+}
+
+static int skip_index_usable(struct block *input_block,
+                             struct block_skip_index *skip_index,
+                             TREE_DEPTH_T block_depth,
+                             TREE_DEPTH_T treedepth) {
+  return skip_index && !skip_index->stale &&
+         skip_index->nodes_count == input_block->nodes_count &&
+         skip_index->block_depth == block_depth &&
+         skip_index->treedepth == treedepth;
+}
+
+/*
+ * Readers can't replace an index, but concurrent ones may race to set the
+ * first one of a block. The loser frees its copy and uses the winner's.
+ */
+static struct block_skip_index *publish_skip_index(struct block *input_block,
+                                                   TREE_DEPTH_T block_depth,
+                                                   TREE_DEPTH_T treedepth) {
+  struct block_skip_index *built =
+      new_skip_index(input_block, block_depth, treedepth);
+  if (!built) {
+    return NULL;
+  }
+  struct block_skip_index *expected = NULL;
+  if (!__atomic_compare_exchange_n(&input_block->skip_index, &expected, built,
+                                   FALSE, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+    k2tree_free_skip_index(built);
+    return expected;
+  }
+  return built;
+}
+
+/**
+ * @brief Replacement for sequential_scan_child on blocks big enough to be
+ * indexed
+ *
+ * A writable state builds the index of a block which lacks one or has it
+ * stale. Read-only states only build it for blocks which never had one.
+ *
+ * @return int TRUE if qs->sc_result and frontier_traversal_idx were filled,
+ * FALSE if the caller must fall back to the sequential scan
+ */
+int skip_index_scan_child(struct block *input_block, uint32_t input_node_idx,
+                          uint32_t subtrees_to_skip,
+                          uint32_t *frontier_traversal_idx,
+                          TREE_DEPTH_T input_node_relative_depth,
+                          struct queries_state *qs, TREE_DEPTH_T block_depth) {
+  if (subtrees_to_skip == 0 || input_block->nodes_count < SKIP_INDEX_MIN_NODES) {
+    return FALSE;
+  }
+
+  struct block_skip_index *skip_index =
+      __atomic_load_n(&input_block->skip_index, __ATOMIC_ACQUIRE);
+  if (!skip_index_usable(input_block, skip_index, block_depth,
+                         qs->treedepth)) {
+    if (!qs->read_only) {
+      if (skip_index_build(input_block, block_depth, qs->treedepth) !=
+          SUCCESS_ECODE_K2T) {
+        return FALSE;
+      }
+      skip_index = input_block->skip_index;
+    } else if (!skip_index) {
+      skip_index = publish_skip_index(input_block, block_depth, qs->treedepth);
+      if (!skip_index_usable(input_block, skip_index, block_depth,
+                             qs->treedepth)) {
+        return FALSE;
+      }
+    } else {
+      return FALSE;
+    }
+  }
+
+  uint32_t last_skipped =
+      skip_subtrees(input_block, skip_index, input_node_idx + 1,
+                    subtrees_to_skip, !qs->read_only);
+
+  uint32_t fidx = *frontier_traversal_idx;
+  while (fidx < input_block->children &&
+         input_block->preorders[fidx] <= last_skipped) {
+    fidx++;
+  }
+  *frontier_traversal_idx = fidx;
+
+  qs->sc_result.child_preorder = last_skipped;
+  qs->sc_result.node_relative_depth = input_node_relative_depth + 1;
+  return TRUE;
+}
+
+/**
+ * @brief Compares the index of a block, if it has one in use, with one built
+ * from scratch
+ *
+ * @return int 0 if they agree, 1 otherwise
+ */
+int debug_validate_skip_index(struct block *input_block) {
+  struct block_skip_index *skip_index = input_block->skip_index;
+  if (!skip_index || skip_index->stale) {
+    return 0;
+  }
+  if (skip_index->nodes_count != input_block->nodes_count) {
+    return 1;
+  }
+  struct block_skip_index *expected = new_skip_index(
+      input_block, skip_index->block_depth, skip_index->treedepth);
+  if (!expected) {
+    return 1;
+  }
+
+  int result = 0;
+  uint32_t next_first = 0;
+  for (uint32_t i = 0; i < skip_index->chunks_count && !result; i++) {
+    struct skip_index_chunk chunk = skip_index->chunks[i];
+    if (chunk.first != next_first || chunk.nodes == 0 ||
+        chunk.nodes > SKIP_INDEX_CHUNK_NODES) {
+      result = 1;
+      break;
+    }
+    for (uint32_t j = 0; j < chunk.nodes; j++) {
+      uint32_t node_index = chunk.first + j;
+      uint64_t expected_mask =
+          expected->chunks[node_index / SKIP_INDEX_CHUNK_NODES].childless_mask;
+      if (((chunk.childless_mask >> j) & 1) !=
+          ((expected_mask >> (node_index % SKIP_INDEX_CHUNK_NODES)) & 1)) {
+        result = 1;
+      }
+    }
+    if (!chunk.dirty) {
+      struct skip_index_chunk summarized = chunk;
+      summarize_chunk(input_block, &summarized);
+      result |= summarized.excess != chunk.excess ||
+                summarized.min_excess != chunk.min_excess;
+    }
+    next_first += chunk.nodes;
+  }
+  if (next_first != skip_index->nodes_count) {
+    result = 1;
+  }
+
+  k2tree_free_skip_index(expected);
+  return result;
+}
+
+#endif /* BLOCK_SKIP_INDEX */
@@ -32,7 +32,6 @@ SOFTWARE.
 #include "definitions.h"
 
 #define BITS_IN_TYPE(input_type) (sizeof(input_type) * 8)
-#define BVCTYPE_BITS BITS_IN_TYPE(uint32_t)
 
 #define CONVERT_BITS_TO_CONTAINER_NUM(bits_num, container_type)                \
   (((bits_num) / BITS_IN_TYPE(container_type)) +                               \
@@ -44,12 +43,12 @@ int custom_init_bitvector(struct block *input_bitvector,
     return K2TREE_ERR_NULL_BITVECTOR;
 
   input_bitvector->container_size =
-      CONVERT_BITS_TO_CONTAINER_NUM(nodes_count * 4, uint32_t);
+      CONVERT_BITS_TO_CONTAINER_NUM(nodes_count * 4, BVCTYPE);
 
   input_bitvector->container = NULL;
   if (input_bitvector->container_size > 0) {
     input_bitvector->container =
-        k2tree_alloc_u32array(input_bitvector->container_size);
+        k2tree_alloc_container(input_bitvector->container_size);
   }
 
   // input_bitvector->nodes_count = nodes_count;
@@ -63,9 +62,9 @@ int custom_clean_bitvector(struct block *input_bitvector) {
   if (!input_bitvector->container)
     return K2TREE_ERR_NULL_BITVECTOR_CONTAINER;
 
-  uint32_t *to_free = input_bitvector->container;
+  BVCTYPE *to_free = input_bitvector->container;
 
-  k2tree_free_u32array(to_free, input_bitvector->container_size);
+  k2tree_free_container(to_free, input_bitvector->container_size);
   input_bitvector->container = NULL;
 
   return SUCCESS_ECODE_K2T;
@@ -22,45 +22,160 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 #include <stdlib.h>
+#include <string.h>
 
 #include "bitvector.h"
 #include "block.h"
+#include "block_skip_index.h"
 #include "definitions.h"
 #include "k2node.h"
 #include "memalloc.h"
 
+/* Bound allocator of each thread, falling back to default_allocator and then
+ * to malloc */
+static __thread const struct k2tree_allocator *bound_allocator = NULL;
+static const struct k2tree_allocator *default_allocator = NULL;
+
+static void *hooked_allocate(size_t size, int zeroed);
+static void hooked_release(void *ptr);
+static void *hooked_reallocate(void *ptr, size_t old_size, size_t new_size);
+
+static void *hooked_allocate(size_t size, int zeroed) {
+  const struct k2tree_allocator *allocator = k2tree_current_allocator();
+  if (!allocator)
+    return zeroed ? calloc(1, size) : malloc(size);
+  void *ptr = allocator->allocate(allocator->ctx, size);
+  if (ptr && zeroed)
+    memset(ptr, 0, size);
+  return ptr;
+}
+
+static void hooked_release(void *ptr) {
+  if (!ptr)
+    return;
+  const struct k2tree_allocator *allocator = k2tree_current_allocator();
+  if (!allocator) {
+    free(ptr);
+    return;
+  }
+  allocator->release(allocator->ctx, ptr);
+}
+
+static void *hooked_reallocate(void *ptr, size_t old_size, size_t new_size) {
+  const struct k2tree_allocator *allocator = k2tree_current_allocator();
+  if (!allocator)
+    return realloc(ptr, new_size);
+  if (allocator->reallocate)
+    return allocator->reallocate(allocator->ctx, ptr, old_size, new_size);
+  void *result = allocator->allocate(allocator->ctx, new_size);
+  if (!result)
+    return NULL;
+  memcpy(result, ptr, old_size < new_size ? old_size : new_size);
+  allocator->release(allocator->ctx, ptr);
+  return result;
+}
+
+void k2tree_set_default_allocator(const struct k2tree_allocator *allocator) {
+  default_allocator = allocator;
+}
+
+const struct k2tree_allocator *
+k2tree_bind_allocator(const struct k2tree_allocator *allocator) {
+  const struct k2tree_allocator *previous = bound_allocator;
+  bound_allocator = allocator;
+  return previous;
+}
+
+const struct k2tree_allocator *k2tree_current_allocator(void) {
+  return bound_allocator ? bound_allocator : default_allocator;
+}
+
 struct block *k2tree_alloc_block(void) {
-  return (struct block *)malloc(sizeof(struct block));
+  return (struct block *)hooked_allocate(sizeof(struct block), FALSE);
 }
 
-uint32_t *k2tree_alloc_u32array(int size) {
-  return (uint32_t *)calloc(size, sizeof(uint32_t));
+BVCTYPE *k2tree_alloc_container(int size) {
+  return (BVCTYPE *)hooked_allocate((size_t)size * sizeof(BVCTYPE), TRUE);
+}
+
+BVCTYPE *k2tree_realloc_container(BVCTYPE *data, int old_size, int new_size) {
+  if (!data)
+    return k2tree_alloc_container(new_size);
+  BVCTYPE *result = (BVCTYPE *)hooked_reallocate(
+      data, (size_t)old_size * sizeof(BVCTYPE),
+      (size_t)new_size * sizeof(BVCTYPE));
+  if (result && new_size > old_size)
+    memset(result + old_size, 0,
+           (size_t)(new_size - old_size) * sizeof(BVCTYPE));
+  return result;
 }
 
 int k2tree_free_block(struct block *b) {
-  free(b);
+  hooked_release(b);
   return SUCCESS_ECODE_K2T;
 }
 
-int k2tree_free_u32array(uint32_t *data, int size) {
+int k2tree_free_container(BVCTYPE *data, int size) {
   __UNUSED(size);
-  free(data);
+  hooked_release(data);
   return SUCCESS_ECODE_K2T;
 }
 
+#ifndef BVCTYPE_64
+uint32_t *k2tree_alloc_u32array(int size) {
+  return k2tree_alloc_container(size);
+}
+
+int k2tree_free_u32array(uint32_t *data, int size) {
+  return k2tree_free_container(data, size);
+}
+#endif
+
 void *k2tree_alloc_preorders(int capacity) {
-  return malloc(sizeof(NODES_BV_T) * capacity);
+  return hooked_allocate(sizeof(NODES_BV_T) * (size_t)capacity, FALSE);
 }
 struct block *k2tree_alloc_blocks_array(int capacity) {
-  return (struct block *)calloc(capacity, sizeof(struct block));
+  return (struct block *)hooked_allocate(
+      (size_t)capacity * sizeof(struct block), TRUE);
 }
-void k2tree_free_preorders(void *preorders) { free(preorders); }
+void k2tree_free_preorders(void *preorders) { hooked_release(preorders); }
 void k2tree_free_blocks_array(struct block *blocks_array) {
-  free(blocks_array);
+  hooked_release(blocks_array);
 }
 
 struct k2node *k2tree_allocate_k2node(void) {
-  return calloc(1, sizeof(struct k2node));
+  return (struct k2node *)hooked_allocate(sizeof(struct k2node), TRUE);
+}
+
+void k2tree_free_k2node(struct k2node *node) { hooked_release(node); }
+
+/* Readers sharing a tree build the skip indexes they need without knowing
+ * the allocator of the tree, so they always come from malloc */
+struct block_skip_index *k2tree_alloc_skip_index(int chunks_capacity) {
+  struct block_skip_index *skip_index =
+      (struct block_skip_index *)malloc(sizeof(struct block_skip_index));
+  if (!skip_index)
+    return NULL;
+  skip_index->chunks = k2tree_realloc_skip_index_chunks(NULL, chunks_capacity);
+  if (!skip_index->chunks) {
+    free(skip_index);
+    return NULL;
+  }
+  skip_index->chunks_count = 0;
+  skip_index->chunks_capacity = (uint32_t)chunks_capacity;
+  return skip_index;
 }
 
-void k2tree_free_k2node(struct k2node *node) { free(node); }
+struct skip_index_chunk *
+k2tree_realloc_skip_index_chunks(struct skip_index_chunk *chunks,
+                                 int chunks_capacity) {
+  /* an empty block still gets a valid array */
+  size_t capacity = chunks_capacity > 0 ? (size_t)chunks_capacity : 1;
+  return (struct skip_index_chunk *)realloc(
+      chunks, capacity * sizeof(struct skip_index_chunk));
+}
+
+void k2tree_free_skip_index(struct block_skip_index *skip_index) {
+  free(skip_index->chunks);
+  free(skip_index);
+}
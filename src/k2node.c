@@ -1,6 +1,8 @@
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "definitions.h"
 #include "k2node.h"
@@ -14,6 +16,68 @@ struct k2_find_subtree_result {
   struct k2node *last_node_visited;
 };
 
+/* Points of sorted_points in [start, end) belong to the block tree at
+ * subtree_root */
+struct k2node_insertion_group {
+  struct block *subtree_root;
+  uint64_t start;
+  uint64_t end;
+};
+
+struct k2node_parallel_insertion {
+  pair2dl_t *sorted_points;
+  struct k2node_insertion_group *groups;
+  uint64_t groups_count;
+  /* fields below are only accessed atomically */
+  uint64_t next_group;
+  uint64_t inserted_count;
+  int err;
+  /* only read, for the parameters of the per thread states */
+  struct k2qstate *st;
+  /* bound by the workers, to serve the tree as on the calling thread */
+  const struct k2tree_allocator *allocator;
+};
+
+/* which_report of the tasks of a full scan */
+#define K2NODE_FULL_SCAN -1
+/* Points a worker accumulates before handing them to the batch reporter */
+#define K2NODE_SCAN_BATCH_SIZE 4096
+
+/* A block tree to scan, its points are at [start, end) in the buffer of the
+ * worker that ran it */
+struct k2node_scan_task {
+  struct block *subtree_root;
+  uint64_t base_col;
+  uint64_t base_row;
+  int worker;
+  long start;
+  long end;
+};
+
+struct k2node_scan_tasks {
+  struct k2node_scan_task *data;
+  uint64_t count;
+  uint64_t capacity;
+};
+
+struct k2node_parallel_scan {
+  /* serialises batch_reporter */
+  pthread_mutex_t report_lock;
+  struct k2node_scan_tasks tasks;
+  int which_report;
+  uint64_t local_coord;
+  TREE_DEPTH_T block_tree_depth;
+  /* one per worker */
+  struct vector_pair2dl_t *buffers;
+  /* NULL to keep the points in the buffers */
+  points_batch_reporter_fun_t batch_reporter;
+  void *report_state;
+  /* fields below are only accessed atomically */
+  uint64_t next_task;
+  int next_worker;
+  int err;
+};
+
 struct interactive_report_data {
   point_reporter_fun_t point_reporter;
   void *report_state;
@@ -33,6 +97,11 @@ int k2node_scan_points_interactively_rec(struct k2node *node,
                                          uint64_t current_depth,
                                          point_reporter_fun_t point_reporter,
                                          void *report_state);
+int k2node_set_operation_rec(struct k2node *lhs, struct k2node *rhs,
+                             set_operation_t operation,
+                             uint64_t current_depth, struct k2qstate *st,
+                             point_reporter_fun_t point_reporter,
+                             void *report_state);
 int k2node_report_rec(struct k2node *node, uint64_t coord,
                       int which_report, uint64_t current_depth,
                       struct k2qstate *st, struct vector_pair2dl_t *result);
@@ -42,6 +111,34 @@ int k2node_report_interactively_rec(struct k2node *node, uint64_t coord,
                                     struct k2qstate *st,
                                     point_reporter_fun_t point_reporter,
                                     void *report_state);
+int k2node_report_range_rec(struct k2node *node,
+                            const struct report_range *range,
+                            uint64_t current_depth, struct k2qstate *st,
+                            point_reporter_fun_t point_reporter,
+                            void *report_state);
+int k2node_report_bands_rec(struct k2node *node, const uint64_t *coords,
+                            uint64_t coords_lo, uint64_t coords_hi,
+                            int which_report, uint64_t current_depth,
+                            struct k2qstate *st,
+                            point_reporter_fun_t point_reporter,
+                            void *report_state);
+int k2node_count_points_rec(struct k2node *node, struct k2qstate *st,
+                            uint64_t current_depth, uint64_t *count);
+#ifdef POINT_COUNTS
+static void k2node_add_to_points_counts(struct k2node *node,
+                                        struct k2qstate *st, int64_t delta);
+uint64_t k2node_sum_points_counts_rec(struct k2node *node,
+                                      uint64_t current_depth,
+                                      uint64_t cut_depth);
+int k2node_refresh_points_count_rec(struct k2node *node,
+                                    uint64_t current_depth,
+                                    TREE_DEPTH_T treedepth,
+                                    TREE_DEPTH_T cut_depth);
+#endif
+int k2node_count_range_rec(struct k2node *node,
+                           const struct report_range *range,
+                           uint64_t current_depth, struct k2qstate *st,
+                           uint64_t *count);
 struct k2_find_subtree_result fill_insertion_path(struct k2node *from_node,
                                                   uint64_t col,
                                                   uint64_t row,
@@ -55,16 +152,380 @@ k2node_measure_tree_size_rec(struct k2node *input_node,
 void interactive_transform_points(uint64_t col, uint64_t row,
                                   void *data);
 
-int k2node_has_more_than_one_child(struct k2node *input_node, int current_depth,
-                                   int cut_depth);
-
 int k2node_delete_point_rec(struct k2node *input_node, struct k2qstate *st,
                             uint64_t col, uint64_t row,
                             int current_depth, int *already_not_exists,
                             int *has_children);
 
+int k2node_has_point_batch_rec(struct k2node *node, struct k2qstate *st,
+                               uint64_t current_depth,
+                               const ipair2dl_t *points,
+                               uint64_t points_count, int *results);
+
+int k2node_delete_points_batch_rec(struct k2node *node, struct k2qstate *st,
+                                   uint64_t current_depth,
+                                   const pair2dl_t *points,
+                                   uint64_t points_count,
+                                   uint64_t *deleted_count);
+
+int k2node_build_from_sorted_rec(struct k2node *node, struct k2qstate *st,
+                                 uint64_t current_depth,
+                                 const pair2dl_t *points,
+                                 uint64_t points_count);
+
+void k2node_group_points_by_subtree(struct k2node *root_node,
+                                    const pair2dl_t *points,
+                                    uint64_t points_count, struct k2qstate *st,
+                                    pair2dl_t **sorted_points_out,
+                                    struct k2node_insertion_group **groups_out,
+                                    uint64_t *groups_count_out);
+
+void k2node_parallel_set_error(int *shared_err, int err);
+void *k2node_insertion_worker(void *data);
+
+/* Bodies of the public modifying functions, which run them with the allocator
+ * of the tree bound when built with TREE_ALLOCATOR */
+int k2node_insert_point_internal(struct k2node *root_node, uint64_t col,
+                                 uint64_t row, struct k2qstate *st,
+                                 int *already_exists);
+int k2node_insert_points_batch_internal(struct k2node *root_node,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct k2qstate *st,
+                                        uint64_t *inserted_count);
+int k2node_insert_points_parallel_internal(struct k2node *root_node,
+                                           const pair2dl_t *points,
+                                           uint64_t points_count,
+                                           int threads_count,
+                                           struct k2qstate *st,
+                                           uint64_t *inserted_count);
+int k2node_delete_point_internal(struct k2node *input_node, uint64_t col,
+                                 uint64_t row, struct k2qstate *st,
+                                 int *already_not_exists);
+int k2node_delete_points_batch_internal(struct k2node *root_node,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct k2qstate *st,
+                                        uint64_t *deleted_count);
+int free_rec_k2node_internal(struct k2node *input_node,
+                             uint64_t current_depth, uint64_t cut_depth);
+
+void k2node_collect_scan_tasks(struct k2node *node, uint64_t current_depth,
+                               uint64_t col, uint64_t row, uint64_t coord,
+                               int which_report, struct k2qstate *st,
+                               struct k2node_scan_tasks *tasks);
+void *k2node_scan_worker(void *data);
+int k2node_parallel_scan_run(struct k2node *root_node, struct k2qstate *st,
+                             int which_report, uint64_t coord,
+                             int threads_count,
+                             struct vector_pair2dl_t *result,
+                             points_batch_reporter_fun_t batch_reporter,
+                             void *report_state);
+
 /* private implementations */
 
+/* Sorts a copy of points in morton order and splits it in runs of points
+ * falling in the same block tree, creating the k2nodes and block roots that
+ * are missing. The coordinates in the copy are made local to their block
+ * tree */
+void k2node_group_points_by_subtree(struct k2node *root_node,
+                                    const pair2dl_t *points,
+                                    uint64_t points_count, struct k2qstate *st,
+                                    pair2dl_t **sorted_points_out,
+                                    struct k2node_insertion_group **groups_out,
+                                    uint64_t *groups_count_out) {
+  pair2dl_t *sorted_points =
+      (pair2dl_t *)malloc(sizeof(pair2dl_t) * points_count);
+  memcpy(sorted_points, points, sizeof(pair2dl_t) * points_count);
+  sort_points_morton_order(sorted_points, points_count);
+
+  uint32_t block_tree_depth = st->k2tree_depth - st->cut_depth;
+  uint64_t local_mask = block_tree_depth < 64
+                            ? (1UL << block_tree_depth) - 1UL
+                            : ~((uint64_t)0);
+
+  uint64_t groups_capacity = 16;
+  uint64_t groups_count = 0;
+  struct k2node_insertion_group *groups =
+      (struct k2node_insertion_group *)malloc(
+          sizeof(struct k2node_insertion_group) * groups_capacity);
+
+  uint64_t group_start = 0;
+  while (group_start < points_count) {
+    /* Points sharing the same block tree are contiguous in morton order */
+    uint64_t group_col = sorted_points[group_start].col & ~local_mask;
+    uint64_t group_row = sorted_points[group_start].row & ~local_mask;
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_count &&
+           (sorted_points[group_end].col & ~local_mask) == group_col &&
+           (sorted_points[group_end].row & ~local_mask) == group_row) {
+      group_end++;
+    }
+
+    uint64_t col = sorted_points[group_start].col;
+    uint64_t row = sorted_points[group_start].row;
+    convert_coordinates_to_morton_code(col, row, st->k2tree_depth, &st->mc);
+    struct k2_find_subtree_result tr_result =
+        k2_find_subtree(root_node, st, col, row, 0);
+    if (!tr_result.exists) {
+      tr_result =
+          fill_insertion_path(tr_result.last_node_visited, tr_result.col,
+                              tr_result.row, st, tr_result.depth_reached);
+    }
+
+    for (uint64_t i = group_start; i < group_end; i++) {
+      sorted_points[i].col &= local_mask;
+      sorted_points[i].row &= local_mask;
+    }
+
+    if (groups_count == groups_capacity) {
+      groups_capacity *= 2;
+      groups = (struct k2node_insertion_group *)realloc(
+          groups, sizeof(struct k2node_insertion_group) * groups_capacity);
+    }
+    groups[groups_count].subtree_root = tr_result.subtree_root;
+    groups[groups_count].start = group_start;
+    groups[groups_count].end = group_end;
+    groups_count++;
+    group_start = group_end;
+  }
+
+  *sorted_points_out = sorted_points;
+  *groups_out = groups;
+  *groups_count_out = groups_count;
+}
+
+/* Keeps the first error reported by the workers */
+void k2node_parallel_set_error(int *shared_err, int err) {
+  int expected = SUCCESS_ECODE_K2T;
+  if (err != SUCCESS_ECODE_K2T) {
+    __atomic_compare_exchange_n(shared_err, &expected, err, FALSE,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  }
+}
+
+/* Takes groups until none is left. Each group is a different block tree, so
+ * workers never touch the same block */
+void *k2node_insertion_worker(void *data) {
+  struct k2node_parallel_insertion *work =
+      (struct k2node_parallel_insertion *)data;
+  struct k2qstate worker_st;
+  int err = init_k2qstate(&worker_st, work->st->k2tree_depth,
+                          work->st->qs.max_nodes_count, work->st->cut_depth);
+  int st_initialized = err == SUCCESS_ECODE_K2T;
+  worker_st.qs.block_growth_percent = work->st->qs.block_growth_percent;
+  uint64_t inserted_count = 0;
+  const struct k2tree_allocator *previous =
+      k2tree_bind_allocator(work->allocator);
+
+  while (err == SUCCESS_ECODE_K2T &&
+         __atomic_load_n(&work->err, __ATOMIC_RELAXED) == SUCCESS_ECODE_K2T) {
+    uint64_t next = __atomic_fetch_add(&work->next_group, 1, __ATOMIC_RELAXED);
+    if (next >= work->groups_count) {
+      break;
+    }
+    struct k2node_insertion_group *group = &work->groups[next];
+
+    worker_st.qs.root = group->subtree_root;
+    uint64_t group_inserted;
+    err = insert_points_batch_sorted(
+        group->subtree_root, work->sorted_points + group->start,
+        group->end - group->start, &worker_st.qs, &group_inserted);
+    if (err == SUCCESS_ECODE_K2T) {
+      inserted_count += group_inserted;
+    }
+  }
+  if (st_initialized) {
+    clean_k2qstate(&worker_st);
+  }
+  k2tree_bind_allocator(previous);
+
+  __atomic_fetch_add(&work->inserted_count, inserted_count, __ATOMIC_RELAXED);
+  k2node_parallel_set_error(&work->err, err);
+  return NULL;
+}
+
+/* Appends a task for every block tree under node that the scan, or the band
+ * report on coord, has to visit. col and row are the coordinates of node at
+ * current_depth */
+void k2node_collect_scan_tasks(struct k2node *node, uint64_t current_depth,
+                               uint64_t col, uint64_t row, uint64_t coord,
+                               int which_report, struct k2qstate *st,
+                               struct k2node_scan_tasks *tasks) {
+  if (current_depth == st->cut_depth) {
+    if (!node->k2subtree.block_child) {
+      return;
+    }
+    if (tasks->count == tasks->capacity) {
+      tasks->capacity = tasks->capacity ? 2 * tasks->capacity : 64;
+      tasks->data = (struct k2node_scan_task *)realloc(
+          tasks->data, sizeof(struct k2node_scan_task) * tasks->capacity);
+    }
+    uint64_t shift = (uint64_t)st->k2tree_depth - (uint64_t)st->cut_depth;
+    struct k2node_scan_task *task = &tasks->data[tasks->count++];
+    task->subtree_root = node->k2subtree.block_child;
+    task->base_col = shift < 64 ? col << shift : 0;
+    task->base_row = shift < 64 ? row << shift : 0;
+    return;
+  }
+
+  uint64_t half_level = 1UL
+                        << ((uint64_t)st->k2tree_depth - current_depth - 1);
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    if (!node->k2subtree.children[child_pos] ||
+        (which_report != K2NODE_FULL_SCAN &&
+         !REPORT_CONTINUE_CONDITION(coord, half_level, which_report,
+                                    child_pos)))
+      continue;
+    k2node_collect_scan_tasks(node->k2subtree.children[child_pos],
+                              current_depth + 1, (col << 1) | (child_pos >> 1),
+                              (row << 1) | (child_pos & 1), coord % half_level,
+                              which_report, st, tasks);
+  }
+}
+
+/* Takes tasks until none is left, each worker with its own read-only
+ * queries_state and output buffer */
+void *k2node_scan_worker(void *data) {
+  struct k2node_parallel_scan *work = (struct k2node_parallel_scan *)data;
+  int worker = __atomic_fetch_add(&work->next_worker, 1, __ATOMIC_RELAXED);
+  struct vector_pair2dl_t *buffer = &work->buffers[worker];
+
+  struct queries_state qs;
+  int err = init_read_only_queries_state(&qs, work->block_tree_depth, NULL);
+  int qs_initialized = err == SUCCESS_ECODE_K2T;
+
+  while (err == SUCCESS_ECODE_K2T &&
+         __atomic_load_n(&work->err, __ATOMIC_RELAXED) == SUCCESS_ECODE_K2T) {
+    uint64_t next = __atomic_fetch_add(&work->next_task, 1, __ATOMIC_RELAXED);
+    if (next >= work->tasks.count) {
+      break;
+    }
+    struct k2node_scan_task *task = &work->tasks.data[next];
+
+    qs.root = task->subtree_root;
+    long start = buffer->nof_items;
+    if (work->which_report == K2NODE_FULL_SCAN) {
+      err = naive_scan_points(task->subtree_root, &qs, buffer);
+    } else if (work->which_report == REPORT_COLUMN) {
+      err = report_column(task->subtree_root, work->local_coord, &qs, buffer);
+    } else {
+      err = report_row(task->subtree_root, work->local_coord, &qs, buffer);
+    }
+    for (long i = start; i < buffer->nof_items; i++) {
+      buffer->data[i].col += task->base_col;
+      buffer->data[i].row += task->base_row;
+    }
+    task->worker = worker;
+    task->start = start;
+    task->end = buffer->nof_items;
+
+    if (work->batch_reporter && buffer->nof_items >= K2NODE_SCAN_BATCH_SIZE) {
+      pthread_mutex_lock(&work->report_lock);
+      work->batch_reporter(buffer->data, (uint64_t)buffer->nof_items,
+                           work->report_state);
+      pthread_mutex_unlock(&work->report_lock);
+      buffer->nof_items = 0;
+    }
+  }
+
+  if (err == SUCCESS_ECODE_K2T && work->batch_reporter &&
+      buffer->nof_items > 0) {
+    pthread_mutex_lock(&work->report_lock);
+    work->batch_reporter(buffer->data, (uint64_t)buffer->nof_items,
+                         work->report_state);
+    pthread_mutex_unlock(&work->report_lock);
+    buffer->nof_items = 0;
+  }
+  if (qs_initialized) {
+    finish_queries_state(&qs);
+  }
+
+  k2node_parallel_set_error(&work->err, err);
+  return NULL;
+}
+
+/* Runs a full scan (which_report == K2NODE_FULL_SCAN) or a band report on
+ * threads_count threads, the calling one included. The points go to result
+ * in the order of the sequential version or, when result is NULL, to
+ * batch_reporter */
+int k2node_parallel_scan_run(struct k2node *root_node, struct k2qstate *st,
+                             int which_report, uint64_t coord,
+                             int threads_count,
+                             struct vector_pair2dl_t *result,
+                             points_batch_reporter_fun_t batch_reporter,
+                             void *report_state) {
+  struct k2node_parallel_scan work;
+  memset(&work, 0, sizeof(work));
+  work.which_report = which_report;
+  work.block_tree_depth = st->k2tree_depth - st->cut_depth;
+  work.local_coord = work.block_tree_depth < 64
+                         ? coord & ((1UL << work.block_tree_depth) - 1UL)
+                         : coord;
+  work.batch_reporter = batch_reporter;
+  work.report_state = report_state;
+  work.err = SUCCESS_ECODE_K2T;
+
+  k2node_collect_scan_tasks(root_node, 0, 0, 0, coord, which_report, st,
+                            &work.tasks);
+  if (work.tasks.count == 0) {
+    free(work.tasks.data);
+    return SUCCESS_ECODE_K2T;
+  }
+  if (threads_count < 1) {
+    threads_count = 1;
+  }
+  if ((uint64_t)threads_count > work.tasks.count) {
+    threads_count = (int)work.tasks.count;
+  }
+
+  if (pthread_mutex_init(&work.report_lock, NULL) != 0) {
+    free(work.tasks.data);
+    return PARALLEL_THREAD_FAILED;
+  }
+
+  work.buffers = (struct vector_pair2dl_t *)malloc(
+      sizeof(struct vector_pair2dl_t) * (size_t)threads_count);
+  for (int i = 0; i < threads_count; i++) {
+    vector_pair2dl_t__init_vector(&work.buffers[i]);
+  }
+
+  pthread_t *threads =
+      (pthread_t *)malloc(sizeof(pthread_t) * (size_t)threads_count);
+  int started = 0;
+  for (int i = 1; i < threads_count; i++) {
+    if (pthread_create(&threads[started], NULL, k2node_scan_worker, &work) !=
+        0) {
+      /* The tasks left are taken by the workers already running */
+      break;
+    }
+    started++;
+  }
+  k2node_scan_worker(&work);
+  for (int i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  if (result && work.err == SUCCESS_ECODE_K2T) {
+    for (uint64_t t = 0; t < work.tasks.count; t++) {
+      struct k2node_scan_task *task = &work.tasks.data[t];
+      struct vector_pair2dl_t *buffer = &work.buffers[task->worker];
+      for (long i = task->start; i < task->end; i++) {
+        vector_pair2dl_t__insert_element(result, buffer->data[i]);
+      }
+    }
+  }
+
+  for (int i = 0; i < threads_count; i++) {
+    vector_pair2dl_t__free_vector(&work.buffers[i]);
+  }
+  pthread_mutex_destroy(&work.report_lock);
+  free(threads);
+  free(work.buffers);
+  free(work.tasks.data);
+  return work.err;
+}
+
 struct k2_find_subtree_result
 k2_find_subtree(struct k2node *node, struct k2qstate *st, uint64_t col,
                 uint64_t row, uint64_t current_depth) {
@@ -175,6 +636,50 @@ int k2node_scan_points_interactively_rec(struct k2node *node,
   return SUCCESS_ECODE_K2T;
 }
 
+int k2node_set_operation_rec(struct k2node *lhs, struct k2node *rhs,
+                             set_operation_t operation,
+                             uint64_t current_depth, struct k2qstate *st,
+                             point_reporter_fun_t point_reporter,
+                             void *report_state) {
+  if (current_depth == st->cut_depth) {
+    struct pair2dl high_level_coordinates;
+    convert_morton_code_to_coordinates_select_treedepth(
+        &st->mc, &high_level_coordinates, st->cut_depth);
+    struct interactive_report_data middle_state;
+    middle_state.point_reporter = point_reporter;
+    middle_state.report_state = report_state;
+    middle_state.base_col =
+        high_level_coordinates.col
+        << ((uint64_t)st->k2tree_depth - (uint64_t)st->cut_depth);
+    middle_state.base_row =
+        high_level_coordinates.row
+        << ((uint64_t)st->k2tree_depth - (uint64_t)st->cut_depth);
+    return k2tree_set_operation_interactively(
+        lhs->k2subtree.block_child, rhs->k2subtree.block_child, operation,
+        &st->qs, interactive_transform_points, &middle_state);
+  }
+
+  for (int child_index = 0; child_index < 4; child_index++) {
+    struct k2node *lhs_child = lhs->k2subtree.children[child_index];
+    struct k2node *rhs_child = rhs->k2subtree.children[child_index];
+    if (lhs_child != NULL && rhs_child != NULL) {
+      add_element_morton_code(&st->mc, current_depth, child_index);
+      CHECK_ERR(k2node_set_operation_rec(lhs_child, rhs_child, operation,
+                                         current_depth + 1, st,
+                                         point_reporter, report_state));
+    } else if ((lhs_child != NULL && operation != SET_INTERSECTION) ||
+               (rhs_child != NULL && operation == SET_UNION)) {
+      /* the other tree is empty here, the whole subtree is in the result */
+      add_element_morton_code(&st->mc, current_depth, child_index);
+      CHECK_ERR(k2node_scan_points_interactively_rec(
+          lhs_child != NULL ? lhs_child : rhs_child, st, current_depth + 1,
+          point_reporter, report_state));
+    }
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
 int k2node_report_rec(struct k2node *node, uint64_t coord,
                       int which_report, uint64_t current_depth,
                       struct k2qstate *st, struct vector_pair2dl_t *result) {
@@ -269,6 +774,205 @@ int k2node_report_interactively_rec(struct k2node *node, uint64_t coord,
   return SUCCESS_ECODE_K2T;
 }
 
+int k2node_report_range_rec(struct k2node *node,
+                            const struct report_range *range,
+                            uint64_t current_depth, struct k2qstate *st,
+                            point_reporter_fun_t point_reporter,
+                            void *report_state) {
+  uint64_t remaining_depth = st->k2tree_depth - current_depth;
+  if (current_depth == st->cut_depth) {
+    struct pair2dl high_level_coordinates;
+    convert_morton_code_to_coordinates_select_treedepth(
+        &st->mc, &high_level_coordinates, st->cut_depth);
+    struct interactive_report_data middle_state;
+    middle_state.point_reporter = point_reporter;
+    middle_state.report_state = report_state;
+    middle_state.base_col = high_level_coordinates.col
+                            << (st->k2tree_depth - st->cut_depth);
+    middle_state.base_row = high_level_coordinates.row
+                            << (st->k2tree_depth - st->cut_depth);
+    return report_range_interactively(
+        node->k2subtree.block_child, range->col_lo, range->col_hi,
+        range->row_lo, range->row_hi, &st->qs, interactive_transform_points,
+        &middle_state);
+  }
+
+  uint64_t next_remaining_depth = remaining_depth - 1;
+  uint64_t half_level = 1UL << next_remaining_depth;
+
+  struct report_range child_range;
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    if (!node->k2subtree.children[child_pos] ||
+        !clip_report_range(range, child_pos, half_level, &child_range))
+      continue;
+    add_element_morton_code(&st->mc, current_depth, child_pos);
+    CHECK_ERR(k2node_report_range_rec(node->k2subtree.children[child_pos],
+                                      &child_range, current_depth + 1, st,
+                                      point_reporter, report_state));
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_report_bands_rec(struct k2node *node, const uint64_t *coords,
+                            uint64_t coords_lo, uint64_t coords_hi,
+                            int which_report, uint64_t current_depth,
+                            struct k2qstate *st,
+                            point_reporter_fun_t point_reporter,
+                            void *report_state) {
+  if (current_depth == st->cut_depth) {
+    struct pair2dl high_level_coordinates;
+    convert_morton_code_to_coordinates_select_treedepth(
+        &st->mc, &high_level_coordinates, st->cut_depth);
+    struct interactive_report_data middle_state;
+    middle_state.point_reporter = point_reporter;
+    middle_state.report_state = report_state;
+    middle_state.base_col = high_level_coordinates.col
+                            << (st->k2tree_depth - st->cut_depth);
+    middle_state.base_row = high_level_coordinates.row
+                            << (st->k2tree_depth - st->cut_depth);
+    return report_sorted_bands_interactively(
+        node->k2subtree.block_child, coords, coords_lo, coords_hi,
+        which_report, &st->qs, interactive_transform_points, &middle_state);
+  }
+
+  uint64_t split =
+      split_band_coords(coords, coords_lo, coords_hi,
+                        (uint32_t)(st->k2tree_depth - current_depth - 1));
+
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    int second_half = REPORT_SECOND_HALF(which_report, child_pos);
+    uint64_t lo = second_half ? split : coords_lo;
+    uint64_t hi = second_half ? coords_hi : split;
+    if (lo == hi || !node->k2subtree.children[child_pos])
+      continue;
+    add_element_morton_code(&st->mc, current_depth, child_pos);
+    CHECK_ERR(k2node_report_bands_rec(node->k2subtree.children[child_pos],
+                                      coords, lo, hi, which_report,
+                                      current_depth + 1, st, point_reporter,
+                                      report_state));
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_count_points_rec(struct k2node *node, struct k2qstate *st,
+                            uint64_t current_depth, uint64_t *count) {
+#ifdef POINT_COUNTS
+  (void)st;
+  (void)current_depth;
+  *count += node->points_count;
+  return SUCCESS_ECODE_K2T;
+#else
+  if (current_depth == st->cut_depth) {
+    uint64_t block_count;
+    CHECK_ERR(count_points(node->k2subtree.block_child, &st->qs, &block_count));
+    *count += block_count;
+    return SUCCESS_ECODE_K2T;
+  }
+
+  for (int child_pos = 0; child_pos < 4; child_pos++) {
+    if (node->k2subtree.children[child_pos]) {
+      CHECK_ERR(k2node_count_points_rec(node->k2subtree.children[child_pos],
+                                        st, current_depth + 1, count));
+    }
+  }
+
+  return SUCCESS_ECODE_K2T;
+#endif
+}
+
+#ifdef POINT_COUNTS
+/* Adds delta to the counts of the k2nodes on the path to the point in st->mc */
+static void k2node_add_to_points_counts(struct k2node *node,
+                                        struct k2qstate *st, int64_t delta) {
+  for (TREE_DEPTH_T depth = 0; node; depth++) {
+    node->points_count += (uint64_t)delta;
+    if (depth == st->cut_depth)
+      break;
+    node = node->k2subtree.children[get_code_at_morton_code(&st->mc, depth)];
+  }
+}
+
+/* Sets the counts of the k2nodes from the ones of their block trees */
+uint64_t k2node_sum_points_counts_rec(struct k2node *node,
+                                      uint64_t current_depth,
+                                      uint64_t cut_depth) {
+  if (current_depth == cut_depth) {
+    node->points_count = node->k2subtree.block_child
+                             ? node->k2subtree.block_child->points_count
+                             : 0;
+    return node->points_count;
+  }
+  node->points_count = 0;
+  for (int child_pos = 0; child_pos < 4; child_pos++) {
+    struct k2node *child_node = node->k2subtree.children[child_pos];
+    if (child_node)
+      node->points_count += k2node_sum_points_counts_rec(
+          child_node, current_depth + 1, cut_depth);
+  }
+  return node->points_count;
+}
+
+/* Refreshes the counts of the block trees under the k2node */
+int k2node_refresh_points_count_rec(struct k2node *node,
+                                    uint64_t current_depth,
+                                    TREE_DEPTH_T treedepth,
+                                    TREE_DEPTH_T cut_depth) {
+  if (current_depth == cut_depth) {
+    if (node->k2subtree.block_child)
+      CHECK_ERR(refresh_points_count(node->k2subtree.block_child, 0,
+                                     treedepth - cut_depth));
+    return SUCCESS_ECODE_K2T;
+  }
+  for (int child_pos = 0; child_pos < 4; child_pos++) {
+    struct k2node *child_node = node->k2subtree.children[child_pos];
+    if (child_node)
+      CHECK_ERR(k2node_refresh_points_count_rec(child_node, current_depth + 1,
+                                                treedepth, cut_depth));
+  }
+  return SUCCESS_ECODE_K2T;
+}
+#endif
+
+int k2node_count_range_rec(struct k2node *node,
+                           const struct report_range *range,
+                           uint64_t current_depth, struct k2qstate *st,
+                           uint64_t *count) {
+  uint64_t remaining_depth = st->k2tree_depth - current_depth;
+  if (current_depth == st->cut_depth) {
+    uint64_t block_count;
+    CHECK_ERR(count_range(node->k2subtree.block_child, range->col_lo,
+                          range->col_hi, range->row_lo, range->row_hi,
+                          &st->qs, &block_count));
+    *count += block_count;
+    return SUCCESS_ECODE_K2T;
+  }
+
+  uint64_t next_remaining_depth = remaining_depth - 1;
+  uint64_t half_level = 1UL << next_remaining_depth;
+
+  struct report_range child_range;
+  for (uint32_t child_pos = 0; child_pos < 4; child_pos++) {
+    if (!node->k2subtree.children[child_pos] ||
+        !clip_report_range(range, child_pos, half_level, &child_range))
+      continue;
+    /* quadrants inside the rectangle are counted whole */
+    if (child_range.col_lo == 0 && child_range.row_lo == 0 &&
+        child_range.col_hi == half_level - 1 &&
+        child_range.row_hi == half_level - 1) {
+      CHECK_ERR(k2node_count_points_rec(node->k2subtree.children[child_pos],
+                                        st, current_depth + 1, count));
+    } else {
+      CHECK_ERR(k2node_count_range_rec(node->k2subtree.children[child_pos],
+                                       &child_range, current_depth + 1, st,
+                                       count));
+    }
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
 struct k2_find_subtree_result fill_insertion_path(struct k2node *from_node,
                                                   uint64_t col,
                                                   uint64_t row,
@@ -344,19 +1048,16 @@ k2node_measure_tree_size_rec(struct k2node *input_node,
   return measurement;
 }
 
-int k2node_has_more_than_one_child(struct k2node *input_node, int current_depth,
-                                   int cut_depth) {
+static int k2node_is_empty(struct k2node *node, uint64_t current_depth,
+                           uint64_t cut_depth) {
   if (current_depth == cut_depth) {
-    return input_node->k2subtree.block_child != NULL;
+    return node->k2subtree.block_child == NULL;
   }
-  int count = 0;
   for (int i = 0; i < 4; i++) {
-    if (input_node->k2subtree.children[i])
-      count++;
-    if (count > 1)
-      return TRUE;
+    if (node->k2subtree.children[i])
+      return FALSE;
   }
-  return FALSE;
+  return TRUE;
 }
 
 int k2node_delete_point_rec(struct k2node *input_node, struct k2qstate *st,
@@ -373,9 +1074,13 @@ int k2node_delete_point_rec(struct k2node *input_node, struct k2qstate *st,
     }
 
     CHECK_ERR(delete_point(block_tree, col, row, &st->qs, already_not_exists));
+#ifdef POINT_COUNTS
+    if (!*already_not_exists)
+      input_node->points_count--;
+#endif
 
     if (block_tree->nodes_count == 0) {
-      k2tree_free_block(block_tree);
+      CHECK_ERR(free_rec_block(block_tree));
       *has_children = FALSE;
       input_node->k2subtree.block_child = NULL;
     }
@@ -397,10 +1102,15 @@ int k2node_delete_point_rec(struct k2node *input_node, struct k2qstate *st,
                                     row % half_length, next_depth,
                                     already_not_exists, has_children));
 
-  if (*already_not_exists || *has_children)
+  if (*already_not_exists)
+    return SUCCESS_ECODE_K2T;
+#ifdef POINT_COUNTS
+  input_node->points_count--;
+#endif
+  if (*has_children)
     return SUCCESS_ECODE_K2T;
 
-  if (!k2node_has_more_than_one_child(next_node, next_depth, st->cut_depth)) {
+  if (k2node_is_empty(next_node, next_depth, st->cut_depth)) {
     k2tree_free_k2node(next_node);
     input_node->k2subtree.children[child_pos] = NULL;
   } else {
@@ -410,6 +1120,109 @@ int k2node_delete_point_rec(struct k2node *input_node, struct k2qstate *st,
   return SUCCESS_ECODE_K2T;
 }
 
+int k2node_has_point_batch_rec(struct k2node *node, struct k2qstate *st,
+                               uint64_t current_depth,
+                               const ipair2dl_t *points,
+                               uint64_t points_count, int *results) {
+  if (current_depth == st->cut_depth) {
+    if (!node->k2subtree.block_child) {
+      for (uint64_t i = 0; i < points_count; i++) {
+        results[points[i].index] = FALSE;
+      }
+      return SUCCESS_ECODE_K2T;
+    }
+    /* The block tree only looks at the lowest treedepth - cut_depth bits of
+     * the coordinates, so the points can be passed as they are */
+    return has_point_batch_sorted(node->k2subtree.block_child, points,
+                                  points_count, &st->qs, results);
+  }
+
+  uint64_t group_start = 0;
+  while (group_start < points_count) {
+    uint32_t child_pos = MORTON_CODE_AT(points[group_start].point.col,
+                                        points[group_start].point.row,
+                                        st->k2tree_depth, current_depth);
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_count &&
+           MORTON_CODE_AT(points[group_end].point.col,
+                          points[group_end].point.row, st->k2tree_depth,
+                          current_depth) == child_pos) {
+      group_end++;
+    }
+
+    struct k2node *next_node = node->k2subtree.children[child_pos];
+    if (next_node) {
+      CHECK_ERR(k2node_has_point_batch_rec(
+          next_node, st, current_depth + 1, points + group_start,
+          group_end - group_start, results));
+    } else {
+      for (uint64_t i = group_start; i < group_end; i++) {
+        results[points[i].index] = FALSE;
+      }
+    }
+    group_start = group_end;
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_delete_points_batch_rec(struct k2node *node, struct k2qstate *st,
+                                   uint64_t current_depth,
+                                   const pair2dl_t *points,
+                                   uint64_t points_count,
+                                   uint64_t *deleted_count) {
+  if (current_depth == st->cut_depth) {
+    struct block *block_tree = node->k2subtree.block_child;
+    if (!block_tree) {
+      return SUCCESS_ECODE_K2T;
+    }
+    uint64_t block_deleted;
+    CHECK_ERR(delete_points_batch_sorted(block_tree, points, points_count,
+                                         &st->qs, &block_deleted));
+    *deleted_count += block_deleted;
+#ifdef POINT_COUNTS
+    node->points_count -= block_deleted;
+#endif
+    if (block_tree->nodes_count == 0) {
+      CHECK_ERR(free_rec_block(block_tree));
+      node->k2subtree.block_child = NULL;
+    }
+    return SUCCESS_ECODE_K2T;
+  }
+
+  uint64_t group_start = 0;
+  while (group_start < points_count) {
+    uint32_t child_pos =
+        MORTON_CODE_AT(points[group_start].col, points[group_start].row,
+                       st->k2tree_depth, current_depth);
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_count &&
+           MORTON_CODE_AT(points[group_end].col, points[group_end].row,
+                          st->k2tree_depth, current_depth) == child_pos) {
+      group_end++;
+    }
+
+    struct k2node *next_node = node->k2subtree.children[child_pos];
+    if (next_node) {
+      uint64_t child_deleted = 0;
+      CHECK_ERR(k2node_delete_points_batch_rec(
+          next_node, st, current_depth + 1, points + group_start,
+          group_end - group_start, &child_deleted));
+      *deleted_count += child_deleted;
+#ifdef POINT_COUNTS
+      node->points_count -= child_deleted;
+#endif
+      if (k2node_is_empty(next_node, current_depth + 1, st->cut_depth)) {
+        k2tree_free_k2node(next_node);
+        node->k2subtree.children[child_pos] = NULL;
+      }
+    }
+    group_start = group_end;
+  }
+
+  return SUCCESS_ECODE_K2T;
+}
+
 /* public implementations */
 
 int k2node_has_point(struct k2node *root_node, uint64_t col,
@@ -425,22 +1238,227 @@ int k2node_has_point(struct k2node *root_node, uint64_t col,
                    &st->qs, result);
 }
 
-int k2node_insert_point(struct k2node *root_node, uint64_t col,
-                        uint64_t row, struct k2qstate *st,
-                        int *already_exists) {
-  convert_coordinates_to_morton_code(col, row, st->k2tree_depth, &st->mc);
-  struct k2_find_subtree_result tr_result =
-      k2_find_subtree(root_node, st, col, row, 0);
-  if (!tr_result.exists) {
-    tr_result = fill_insertion_path(tr_result.last_node_visited, tr_result.col,
-                                    tr_result.row, st, tr_result.depth_reached);
+int k2node_build_from_sorted_rec(struct k2node *node, struct k2qstate *st,
+                                 uint64_t current_depth,
+                                 const pair2dl_t *points,
+                                 uint64_t points_count) {
+  if (current_depth == st->cut_depth) {
+    node->k2subtree.block_child = build_block_tree_from_sorted(
+        points, points_count, st->k2tree_depth - st->cut_depth,
+        st->qs.max_nodes_count);
+    return SUCCESS_ECODE_K2T;
   }
-  st->qs.root = tr_result.subtree_root;
-  return insert_point(tr_result.subtree_root, tr_result.col, tr_result.row,
-                      &st->qs, already_exists);
-}
 
-int k2node_naive_scan_points(struct k2node *input_node, struct k2qstate *st,
+  uint64_t group_start = 0;
+  while (group_start < points_count) {
+    uint32_t child_pos =
+        MORTON_CODE_AT(points[group_start].col, points[group_start].row,
+                       st->k2tree_depth, current_depth);
+    uint64_t group_end = group_start + 1;
+    while (group_end < points_count &&
+           MORTON_CODE_AT(points[group_end].col, points[group_end].row,
+                          st->k2tree_depth, current_depth) == child_pos) {
+      group_end++;
+    }
+    node->k2subtree.children[child_pos] = create_k2node();
+    CHECK_ERR(k2node_build_from_sorted_rec(
+        node->k2subtree.children[child_pos], st, current_depth + 1,
+        points + group_start, group_end - group_start));
+    group_start = group_end;
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_has_point_batch(struct k2node *root_node, const pair2dl_t *points,
+                           uint64_t points_count, struct k2qstate *st,
+                           int *results) {
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  ipair2dl_t *sorted_points =
+      (ipair2dl_t *)malloc(sizeof(ipair2dl_t) * points_count);
+  for (uint64_t i = 0; i < points_count; i++) {
+    sorted_points[i].point = points[i];
+    sorted_points[i].index = i;
+  }
+  sort_indexed_points_morton_order(sorted_points, points_count);
+
+  int err = k2node_has_point_batch_rec(root_node, st, 0, sorted_points,
+                                       points_count, results);
+  free(sorted_points);
+  return err;
+}
+
+int k2node_insert_point_internal(struct k2node *root_node, uint64_t col,
+                                 uint64_t row, struct k2qstate *st,
+                                 int *already_exists) {
+  if (st->qs.read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  convert_coordinates_to_morton_code(col, row, st->k2tree_depth, &st->mc);
+  struct k2_find_subtree_result tr_result =
+      k2_find_subtree(root_node, st, col, row, 0);
+  if (!tr_result.exists) {
+    tr_result = fill_insertion_path(tr_result.last_node_visited, tr_result.col,
+                                    tr_result.row, st, tr_result.depth_reached);
+  }
+  st->qs.root = tr_result.subtree_root;
+  int err = insert_point(tr_result.subtree_root, tr_result.col, tr_result.row,
+                         &st->qs, already_exists);
+#ifdef POINT_COUNTS
+  if (err == SUCCESS_ECODE_K2T && !*already_exists)
+    k2node_add_to_points_counts(root_node, st, 1);
+#endif
+  return err;
+}
+
+int k2node_insert_point(struct k2node *root_node, uint64_t col,
+                        uint64_t row, struct k2qstate *st,
+                        int *already_exists) {
+  TREE_ALLOCATOR_ENTER(root_node);
+  int err = k2node_insert_point_internal(root_node, col, row, st,
+                                         already_exists);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+struct k2node *k2node_build_from_sorted(const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct k2qstate *st) {
+  struct k2node *root_node = create_k2node();
+  if (points_count > 0) {
+    k2node_build_from_sorted_rec(root_node, st, 0, points, points_count);
+  }
+#ifdef POINT_COUNTS
+  k2node_sum_points_counts_rec(root_node, 0, st->cut_depth);
+#endif
+  return root_node;
+}
+
+
+int k2node_insert_points_batch_internal(struct k2node *root_node,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct k2qstate *st,
+                                        uint64_t *inserted_count) {
+  *inserted_count = 0;
+  if (st->qs.read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  pair2dl_t *sorted_points;
+  struct k2node_insertion_group *groups;
+  uint64_t groups_count;
+  k2node_group_points_by_subtree(root_node, points, points_count, st,
+                                 &sorted_points, &groups, &groups_count);
+
+  int err = SUCCESS_ECODE_K2T;
+  for (uint64_t i = 0; i < groups_count; i++) {
+    st->qs.root = groups[i].subtree_root;
+    uint64_t group_inserted;
+    err = insert_points_batch_sorted(
+        groups[i].subtree_root, sorted_points + groups[i].start,
+        groups[i].end - groups[i].start, &st->qs, &group_inserted);
+    if (err) {
+      break;
+    }
+    *inserted_count += group_inserted;
+  }
+#ifdef POINT_COUNTS
+  k2node_sum_points_counts_rec(root_node, 0, st->cut_depth);
+#endif
+
+  free(groups);
+  free(sorted_points);
+  return err;
+}
+
+int k2node_insert_points_batch(struct k2node *root_node,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct k2qstate *st, uint64_t *inserted_count) {
+  TREE_ALLOCATOR_ENTER(root_node);
+  int err = k2node_insert_points_batch_internal(root_node, points,
+                                                points_count, st,
+                                                inserted_count);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+int k2node_insert_points_parallel_internal(struct k2node *root_node,
+                                           const pair2dl_t *points,
+                                           uint64_t points_count,
+                                           int threads_count,
+                                           struct k2qstate *st,
+                                           uint64_t *inserted_count) {
+  *inserted_count = 0;
+  if (st->qs.read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  if (threads_count <= 1) {
+    return k2node_insert_points_batch(root_node, points, points_count, st,
+                                      inserted_count);
+  }
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  struct k2node_parallel_insertion work;
+  k2node_group_points_by_subtree(root_node, points, points_count, st,
+                                 &work.sorted_points, &work.groups,
+                                 &work.groups_count);
+  work.next_group = 0;
+  work.inserted_count = 0;
+  work.err = SUCCESS_ECODE_K2T;
+  work.st = st;
+  work.allocator = k2tree_current_allocator();
+
+  if ((uint64_t)threads_count > work.groups_count) {
+    threads_count = (int)work.groups_count;
+  }
+  /* The calling thread is one of the workers */
+  pthread_t *threads =
+      (pthread_t *)malloc(sizeof(pthread_t) * (size_t)threads_count);
+  int started = 0;
+  for (int i = 1; i < threads_count; i++) {
+    if (pthread_create(&threads[started], NULL, k2node_insertion_worker,
+                       &work) != 0) {
+      /* The groups left are taken by the workers already running */
+      break;
+    }
+    started++;
+  }
+  k2node_insertion_worker(&work);
+  for (int i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+#ifdef POINT_COUNTS
+  k2node_sum_points_counts_rec(root_node, 0, st->cut_depth);
+#endif
+  free(threads);
+  free(work.groups);
+  free(work.sorted_points);
+  *inserted_count = work.inserted_count;
+  return work.err;
+}
+
+int k2node_insert_points_parallel(struct k2node *root_node,
+                                  const pair2dl_t *points,
+                                  uint64_t points_count, int threads_count,
+                                  struct k2qstate *st,
+                                  uint64_t *inserted_count) {
+  TREE_ALLOCATOR_ENTER(root_node);
+  int err = k2node_insert_points_parallel_internal(
+      root_node, points, points_count, threads_count, st, inserted_count);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+int k2node_naive_scan_points(struct k2node *input_node, struct k2qstate *st,
                              struct vector_pair2dl_t *result) {
   return k2node_naive_scan_points_rec(input_node, st, 0, result);
 }
@@ -453,6 +1471,48 @@ int k2node_scan_points_interactively(struct k2node *input_node,
                                               report_state);
 }
 
+int k2node_set_operation_interactively(struct k2node *lhs, struct k2node *rhs,
+                                       set_operation_t operation,
+                                       struct k2qstate *st,
+                                       point_reporter_fun_t point_reporter,
+                                       void *report_state) {
+  return k2node_set_operation_rec(lhs, rhs, operation, 0, st, point_reporter,
+                                  report_state);
+}
+
+static int k2node_set_operation(struct k2node *lhs, struct k2node *rhs,
+                                set_operation_t operation, struct k2qstate *st,
+                                struct k2node **result) {
+  if (st->qs.read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  struct vector_pair2dl_t points;
+  vector_pair2dl_t__init_vector(&points);
+  int err = k2node_set_operation_interactively(
+      lhs, rhs, operation, st, report_range_to_vector, &points);
+  if (err == SUCCESS_ECODE_K2T) {
+    *result = k2node_build_from_sorted(points.data, (uint64_t)points.nof_items,
+                                       st);
+  }
+  vector_pair2dl_t__free_vector(&points);
+  return err;
+}
+
+int k2node_union(struct k2node *lhs, struct k2node *rhs, struct k2qstate *st,
+                 struct k2node **result) {
+  return k2node_set_operation(lhs, rhs, SET_UNION, st, result);
+}
+
+int k2node_intersect(struct k2node *lhs, struct k2node *rhs,
+                     struct k2qstate *st, struct k2node **result) {
+  return k2node_set_operation(lhs, rhs, SET_INTERSECTION, st, result);
+}
+
+int k2node_difference(struct k2node *lhs, struct k2node *rhs,
+                      struct k2qstate *st, struct k2node **result) {
+  return k2node_set_operation(lhs, rhs, SET_DIFFERENCE, st, result);
+}
+
 int k2node_report_column(struct k2node *input_node, uint64_t col,
                          struct k2qstate *st, struct vector_pair2dl_t *result) {
   return k2node_report_rec(input_node, col, REPORT_COLUMN, 0, st, result);
@@ -479,19 +1539,174 @@ int k2node_report_row_interactively(struct k2node *input_node,
                                          point_reporter, report_state);
 }
 
+int k2node_naive_scan_points_parallel(struct k2node *input_node,
+                                      struct k2qstate *st, int threads_count,
+                                      struct vector_pair2dl_t *result) {
+  return k2node_parallel_scan_run(input_node, st, K2NODE_FULL_SCAN, 0,
+                                  threads_count, result, NULL, NULL);
+}
+
+int k2node_report_column_parallel(struct k2node *input_node, uint64_t col,
+                                  struct k2qstate *st, int threads_count,
+                                  struct vector_pair2dl_t *result) {
+  return k2node_parallel_scan_run(input_node, st, REPORT_COLUMN, col,
+                                  threads_count, result, NULL, NULL);
+}
+
+int k2node_report_row_parallel(struct k2node *input_node, uint64_t row,
+                               struct k2qstate *st, int threads_count,
+                               struct vector_pair2dl_t *result) {
+  return k2node_parallel_scan_run(input_node, st, REPORT_ROW, row,
+                                  threads_count, result, NULL, NULL);
+}
+
+int k2node_scan_points_parallel_batched(
+    struct k2node *input_node, struct k2qstate *st, int threads_count,
+    points_batch_reporter_fun_t batch_reporter, void *report_state) {
+  return k2node_parallel_scan_run(input_node, st, K2NODE_FULL_SCAN, 0,
+                                  threads_count, NULL, batch_reporter,
+                                  report_state);
+}
+
+int k2node_report_column_parallel_batched(
+    struct k2node *input_node, uint64_t col, struct k2qstate *st,
+    int threads_count, points_batch_reporter_fun_t batch_reporter,
+    void *report_state) {
+  return k2node_parallel_scan_run(input_node, st, REPORT_COLUMN, col,
+                                  threads_count, NULL, batch_reporter,
+                                  report_state);
+}
+
+int k2node_report_row_parallel_batched(
+    struct k2node *input_node, uint64_t row, struct k2qstate *st,
+    int threads_count, points_batch_reporter_fun_t batch_reporter,
+    void *report_state) {
+  return k2node_parallel_scan_run(input_node, st, REPORT_ROW, row,
+                                  threads_count, NULL, batch_reporter,
+                                  report_state);
+}
+
+int k2node_report_range(struct k2node *input_node, uint64_t col_lo,
+                        uint64_t col_hi, uint64_t row_lo, uint64_t row_hi,
+                        struct k2qstate *st, struct vector_pair2dl_t *result) {
+  return k2node_report_range_interactively(input_node, col_lo, col_hi, row_lo,
+                                           row_hi, st, report_range_to_vector,
+                                           result);
+}
+
+int k2node_report_range_interactively(struct k2node *input_node,
+                                      uint64_t col_lo, uint64_t col_hi,
+                                      uint64_t row_lo, uint64_t row_hi,
+                                      struct k2qstate *st,
+                                      point_reporter_fun_t point_reporter,
+                                      void *report_state) {
+  struct report_range range;
+  if (!init_report_range(&range, col_lo, col_hi, row_lo, row_hi,
+                         st->k2tree_depth)) {
+    return SUCCESS_ECODE_K2T;
+  }
+  return k2node_report_range_rec(input_node, &range, 0, st, point_reporter,
+                                 report_state);
+}
+
+static int k2node_report_bands_interactively(
+    struct k2node *input_node, const uint64_t *coords, uint64_t coords_count,
+    int which_report, struct k2qstate *st, point_reporter_fun_t point_reporter,
+    void *report_state) {
+  uint64_t *sorted_coords;
+  uint64_t sorted_count = sort_band_coords(coords, coords_count,
+                                           st->k2tree_depth, &sorted_coords);
+  int err = SUCCESS_ECODE_K2T;
+  if (sorted_count > 0) {
+    err = k2node_report_bands_rec(input_node, sorted_coords, 0, sorted_count,
+                                  which_report, 0, st, point_reporter,
+                                  report_state);
+  }
+  free(sorted_coords);
+  return err;
+}
+
+int k2node_report_rows(struct k2node *input_node, const uint64_t *rows,
+                       uint64_t rows_count, struct k2qstate *st,
+                       struct vector_pair2dl_t *result) {
+  return k2node_report_bands_interactively(input_node, rows, rows_count,
+                                           REPORT_ROW, st,
+                                           report_range_to_vector, result);
+}
+
+int k2node_report_columns(struct k2node *input_node, const uint64_t *cols,
+                          uint64_t cols_count, struct k2qstate *st,
+                          struct vector_pair2dl_t *result) {
+  return k2node_report_bands_interactively(input_node, cols, cols_count,
+                                           REPORT_COLUMN, st,
+                                           report_range_to_vector, result);
+}
+
+int k2node_report_rows_interactively(struct k2node *input_node,
+                                     const uint64_t *rows, uint64_t rows_count,
+                                     struct k2qstate *st,
+                                     point_reporter_fun_t point_reporter,
+                                     void *report_state) {
+  return k2node_report_bands_interactively(input_node, rows, rows_count,
+                                           REPORT_ROW, st, point_reporter,
+                                           report_state);
+}
+
+int k2node_report_columns_interactively(struct k2node *input_node,
+                                        const uint64_t *cols,
+                                        uint64_t cols_count,
+                                        struct k2qstate *st,
+                                        point_reporter_fun_t point_reporter,
+                                        void *report_state) {
+  return k2node_report_bands_interactively(input_node, cols, cols_count,
+                                           REPORT_COLUMN, st, point_reporter,
+                                           report_state);
+}
+
+int k2node_count_points(struct k2node *input_node, struct k2qstate *st,
+                        uint64_t *result) {
+  *result = 0;
+  return k2node_count_points_rec(input_node, st, 0, result);
+}
+
+int k2node_count_column(struct k2node *input_node, uint64_t col,
+                        struct k2qstate *st, uint64_t *result) {
+  return k2node_count_range(input_node, col, col, 0, UINT64_MAX, st, result);
+}
+
+int k2node_count_row(struct k2node *input_node, uint64_t row,
+                     struct k2qstate *st, uint64_t *result) {
+  return k2node_count_range(input_node, 0, UINT64_MAX, row, row, st, result);
+}
+
+int k2node_count_range(struct k2node *input_node, uint64_t col_lo,
+                       uint64_t col_hi, uint64_t row_lo, uint64_t row_hi,
+                       struct k2qstate *st, uint64_t *result) {
+  *result = 0;
+  struct report_range range;
+  if (!init_report_range(&range, col_lo, col_hi, row_lo, row_hi,
+                         st->k2tree_depth)) {
+    return SUCCESS_ECODE_K2T;
+  }
+  return k2node_count_range_rec(input_node, &range, 0, st, result);
+}
+
 struct k2node *create_k2node(void) {
-  return k2tree_allocate_k2node();
+  struct k2node *new_node = k2tree_allocate_k2node();
+  if (new_node)
+    TREE_ALLOCATOR_RECORD(new_node);
+  return new_node;
 }
 
-int free_rec_k2node(struct k2node *input_node, uint64_t current_depth,
-                    uint64_t cut_depth) {
+int free_rec_k2node_internal(struct k2node *input_node,
+                             uint64_t current_depth, uint64_t cut_depth) {
   if (current_depth == cut_depth) {
     free_rec_block(input_node->k2subtree.block_child);
   } else {
     for (int child_pos = 0; child_pos < 4; child_pos++) {
       struct k2node *child_node = input_node->k2subtree.children[child_pos];
       if (child_node)
-        free_rec_k2node(child_node, current_depth + 1, cut_depth);
+        free_rec_k2node_internal(child_node, current_depth + 1, cut_depth);
     }
   }
 
@@ -499,6 +1714,25 @@ int free_rec_k2node(struct k2node *input_node, uint64_t current_depth,
   return SUCCESS_ECODE_K2T;
 }
 
+int free_rec_k2node(struct k2node *input_node, uint64_t current_depth,
+                    uint64_t cut_depth) {
+  TREE_ALLOCATOR_ENTER(input_node);
+  int err = free_rec_k2node_internal(input_node, current_depth, cut_depth);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+#ifdef POINT_COUNTS
+int k2node_refresh_points_count(struct k2node *input_node,
+                                TREE_DEPTH_T treedepth,
+                                TREE_DEPTH_T cut_depth) {
+  CHECK_ERR(
+      k2node_refresh_points_count_rec(input_node, 0, treedepth, cut_depth));
+  k2node_sum_points_counts_rec(input_node, 0, cut_depth);
+  return SUCCESS_ECODE_K2T;
+}
+#endif
+
 struct k2tree_measurement k2node_measure_tree_size(struct k2node *input_node,
                                                    uint64_t cut_depth) {
   return k2node_measure_tree_size_rec(input_node, 0, cut_depth);
@@ -514,6 +1748,16 @@ int init_k2qstate(struct k2qstate *st, TREE_DEPTH_T treedepth,
   return SUCCESS_ECODE_K2T;
 }
 
+int init_k2qstate_read_only(struct k2qstate *st, TREE_DEPTH_T treedepth,
+                            TREE_DEPTH_T cut_depth) {
+  CHECK_ERR(
+      init_read_only_queries_state(&st->qs, treedepth - cut_depth, NULL));
+  init_morton_code(&st->mc, treedepth);
+  st->cut_depth = cut_depth;
+  st->k2tree_depth = treedepth;
+  return SUCCESS_ECODE_K2T;
+}
+
 int clean_k2qstate(struct k2qstate *st) {
   CHECK_ERR(finish_queries_state(&st->qs));
   clean_morton_code(&st->mc);
@@ -613,6 +1857,38 @@ int k2node_naive_scan_points_lazy_clean(
   return SUCCESS_ECODE_K2T;
 }
 
+/* Starts the scan of the block below node, the k2node path to it is in
+ * st->mc */
+static void k2node_naive_scan_enter_block(
+    struct k2node_lazy_handler_naive_scan_t *lazy_handler,
+    struct k2node *node) {
+  struct k2qstate *st = lazy_handler->st;
+  struct pair2dl high_level_coordinates;
+  convert_morton_code_to_coordinates_select_treedepth(
+      &st->mc, &high_level_coordinates, st->cut_depth);
+  lazy_handler->base_col = high_level_coordinates.col
+                           << (st->k2tree_depth - st->cut_depth);
+  lazy_handler->base_row = high_level_coordinates.row
+                           << (st->k2tree_depth - st->cut_depth);
+
+  /* a seek can leave the previous block before its scan is over */
+  lazy_handler->sub_handler.has_next = FALSE;
+  reset_lazy_naive_state_stack(&lazy_handler->sub_handler.states_stack);
+
+  lazy_naive_state first_state;
+  first_state.block_depth = 0;
+  first_state.input_block = node->k2subtree.block_child;
+  first_state.last_iteration = 0;
+  first_state.frontier_traversal_idx = 0;
+  clean_child_result(&first_state.cr);
+
+  push_lazy_naive_state_stack(&lazy_handler->sub_handler.states_stack,
+                              first_state);
+  naive_scan_points_lazy_next(&lazy_handler->sub_handler,
+                              &lazy_handler->sub_handler.next_result);
+  lazy_handler->at_leaf = TRUE;
+}
+
 int k2node_naive_scan_points_lazy_next(
     struct k2node_lazy_handler_naive_scan_t *lazy_handler, pair2dl_t *result) {
   *result = lazy_handler->next_result;
@@ -625,28 +1901,7 @@ int k2node_naive_scan_points_lazy_next(
 
     if (current_depth == st->cut_depth) {
       if (!lazy_handler->at_leaf) {
-        struct pair2dl high_level_coordinates;
-        convert_morton_code_to_coordinates_select_treedepth(
-            &st->mc, &high_level_coordinates, st->cut_depth);
-        lazy_handler->base_col = high_level_coordinates.col
-                                 << (st->k2tree_depth - st->cut_depth);
-        lazy_handler->base_row = high_level_coordinates.row
-                                 << (st->k2tree_depth - st->cut_depth);
-
-        lazy_handler->sub_handler.has_next = FALSE;
-
-        lazy_naive_state first_state;
-        first_state.block_depth = 0;
-        first_state.input_block = node->k2subtree.block_child;
-        first_state.last_iteration = 0;
-        first_state.frontier_traversal_idx = 0;
-        clean_child_result(&first_state.cr);
-
-        push_lazy_naive_state_stack(&lazy_handler->sub_handler.states_stack,
-                                    first_state);
-        naive_scan_points_lazy_next(&lazy_handler->sub_handler,
-                                    &lazy_handler->sub_handler.next_result);
-        lazy_handler->at_leaf = TRUE;
+        k2node_naive_scan_enter_block(lazy_handler, node);
       }
 
       int sub_has_next;
@@ -701,6 +1956,86 @@ int k2node_naive_scan_points_lazy_has_next(
   return SUCCESS_ECODE_K2T;
 }
 
+/* Pushes the states that continue the scan from the first point not before
+ * target, descending from a pending state whose node holds target */
+static int k2node_naive_scan_seek_descend(
+    struct k2node_lazy_handler_naive_scan_t *lazy_handler,
+    k2node_lazy_naive_state current_state, const pair2dl_t *target) {
+  struct k2qstate *st = lazy_handler->st;
+  for (;;) {
+    uint64_t current_depth = current_state.current_depth;
+    struct k2node *node = current_state.input_node;
+
+    if (current_depth == st->cut_depth) {
+      if (!lazy_handler->at_leaf) {
+        k2node_naive_scan_enter_block(lazy_handler, node);
+      }
+      push_k2node_lazy_naive_state_stack(&lazy_handler->states_stack,
+                                         current_state);
+      return naive_scan_points_lazy_seek(&lazy_handler->sub_handler,
+                                         target->col - lazy_handler->base_col,
+                                         target->row - lazy_handler->base_row);
+    }
+
+    uint32_t target_pos = MORTON_CODE_AT(target->col, target->row,
+                                         st->k2tree_depth, current_depth);
+    if (current_state.last_iteration > target_pos) {
+      push_k2node_lazy_naive_state_stack(&lazy_handler->states_stack,
+                                         current_state);
+      return SUCCESS_ECODE_K2T;
+    }
+
+    if (target_pos < 3) {
+      current_state.last_iteration = target_pos + 1;
+      push_k2node_lazy_naive_state_stack(&lazy_handler->states_stack,
+                                         current_state);
+    }
+    struct k2node *child_node = node->k2subtree.children[target_pos];
+    if (!child_node) {
+      return SUCCESS_ECODE_K2T;
+    }
+    add_element_morton_code(&st->mc, current_depth, target_pos);
+
+    k2node_lazy_naive_state child_state;
+    child_state.last_iteration = 0;
+    child_state.input_node = child_node;
+    child_state.current_depth = current_depth + 1;
+    current_state = child_state;
+  }
+}
+
+int k2node_naive_scan_points_lazy_seek(
+    struct k2node_lazy_handler_naive_scan_t *lazy_handler, uint64_t col,
+    uint64_t row) {
+  pair2dl_t target;
+  target.col = col;
+  target.row = row;
+  if (!lazy_handler->has_next ||
+      compare_points_morton_order(&lazy_handler->next_result, &target) >= 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  struct k2qstate *st = lazy_handler->st;
+  pair2dl_t *known = &lazy_handler->next_result;
+  while (!empty_k2node_lazy_naive_state_stack(&lazy_handler->states_stack)) {
+    k2node_lazy_naive_state current_state =
+        pop_k2node_lazy_naive_state_stack(&lazy_handler->states_stack);
+    uint64_t current_depth = current_state.current_depth;
+    if (SAME_NODE_AT(known->col, col, st->k2tree_depth, current_depth) &&
+        SAME_NODE_AT(known->row, row, st->k2tree_depth, current_depth)) {
+      CHECK_ERR(
+          k2node_naive_scan_seek_descend(lazy_handler, current_state, &target));
+      break;
+    }
+    if (current_depth == st->cut_depth) {
+      lazy_handler->at_leaf = FALSE;
+    }
+  }
+
+  pair2dl_t skipped;
+  return k2node_naive_scan_points_lazy_next(lazy_handler, &skipped);
+}
+
 int k2node_report_band_lazy_init(
     struct k2node_lazy_handler_report_band_t *lazy_handler,
     struct k2node *input_node, struct k2qstate *st, uint64_t coord,
@@ -777,6 +2112,40 @@ int k2node_report_band_reset(
   return SUCCESS_ECODE_K2T;
 }
 
+/* Starts the band report of the block below node, the k2node path to it is in
+ * st->mc */
+static void k2node_report_band_enter_block(
+    struct k2node_lazy_handler_report_band_t *lazy_handler, struct k2node *node,
+    uint64_t current_coord) {
+  struct k2qstate *st = lazy_handler->st;
+  struct pair2dl high_level_coordinates;
+  convert_morton_code_to_coordinates_select_treedepth(
+      &st->mc, &high_level_coordinates, st->cut_depth);
+
+  lazy_handler->base_col = high_level_coordinates.col
+                           << (uint64_t)(st->k2tree_depth - st->cut_depth);
+  lazy_handler->base_row = high_level_coordinates.row
+                           << (uint64_t)(st->k2tree_depth - st->cut_depth);
+
+  lazy_handler->sub_handler.has_next = FALSE;
+  reset_lazy_report_band_state_t_stack(&lazy_handler->sub_handler.stack);
+  lazy_handler->sub_handler.which_report = lazy_handler->which_report;
+  lazy_handler->sub_handler.qs = &lazy_handler->st->qs;
+
+  lazy_report_band_state_t first_state;
+  first_state.current_coord = current_coord;
+  clean_child_result(&first_state.current_cr);
+  first_state.last_iteration = 0;
+  first_state.frontier_traversal_idx = 0;
+  first_state.current_cr.resulting_block = node->k2subtree.block_child;
+
+  push_lazy_report_band_state_t_stack(&lazy_handler->sub_handler.stack,
+                                      first_state);
+  report_band_next(&lazy_handler->sub_handler,
+                   &lazy_handler->sub_handler.next_result);
+  lazy_handler->at_leaf = TRUE;
+}
+
 int k2node_report_band_next(
     struct k2node_lazy_handler_report_band_t *lazy_handler, uint64_t *result) {
   *result = lazy_handler->next_result;
@@ -792,33 +2161,8 @@ int k2node_report_band_next(
     if (current_depth == st->cut_depth) {
 
       if (!lazy_handler->at_leaf) {
-        struct pair2dl high_level_coordinates;
-        convert_morton_code_to_coordinates_select_treedepth(
-            &st->mc, &high_level_coordinates, st->cut_depth);
-
-        lazy_handler->base_col =
-            high_level_coordinates.col
-            << (uint64_t)(st->k2tree_depth - st->cut_depth);
-        lazy_handler->base_row =
-            high_level_coordinates.row
-            << (uint64_t)(st->k2tree_depth - st->cut_depth);
-
-        lazy_handler->sub_handler.has_next = FALSE;
-        lazy_handler->sub_handler.which_report = lazy_handler->which_report;
-        lazy_handler->sub_handler.qs = &lazy_handler->st->qs;
-
-        lazy_report_band_state_t first_state;
-        first_state.current_coord = current_state.current_coord;
-        clean_child_result(&first_state.current_cr);
-        first_state.last_iteration = 0;
-        first_state.frontier_traversal_idx = 0;
-        first_state.current_cr.resulting_block = node->k2subtree.block_child;
-
-        push_lazy_report_band_state_t_stack(&lazy_handler->sub_handler.stack,
-                                            first_state);
-        report_band_next(&lazy_handler->sub_handler,
-                         &lazy_handler->sub_handler.next_result);
-        lazy_handler->at_leaf = TRUE;
+        k2node_report_band_enter_block(lazy_handler, node,
+                                       current_state.current_coord);
       }
 
       int sub_has_next;
@@ -883,17 +2227,442 @@ int k2node_report_band_has_next(
   return SUCCESS_ECODE_K2T;
 }
 
-int k2node_delete_point(struct k2node *input_node, uint64_t col,
-                        uint64_t row, struct k2qstate *st,
-                        int *already_not_exists) {
+/* Same as k2node_naive_scan_seek_descend, following the band child holding the
+ * reported coordinate */
+static int k2node_report_band_seek_descend(
+    struct k2node_lazy_handler_report_band_t *lazy_handler,
+    k2node_lazy_report_band_state_t current_state, uint64_t coord) {
+  struct k2qstate *st = lazy_handler->st;
+  for (;;) {
+    uint64_t current_depth = current_state.current_depth;
+    struct k2node *node = current_state.input_node;
+
+    if (current_depth == st->cut_depth) {
+      if (!lazy_handler->at_leaf) {
+        k2node_report_band_enter_block(lazy_handler, node,
+                                       current_state.current_coord);
+      }
+      push_k2node_lazy_report_band_state_t_stack(&lazy_handler->stack,
+                                                 current_state);
+      uint64_t base = lazy_handler->which_report == REPORT_COLUMN
+                          ? lazy_handler->base_row
+                          : lazy_handler->base_col;
+      return report_band_seek(&lazy_handler->sub_handler, coord - base);
+    }
+
+    uint64_t next_remaining_depth = st->k2tree_depth - current_depth - 1UL;
+    uint64_t half_level = 1UL << next_remaining_depth;
+    uint32_t reported_bit = (uint32_t)((coord >> next_remaining_depth) & 1UL);
+    uint32_t target_pos =
+        REPORT_BAND_CHILD(current_state.current_coord, half_level,
+                          lazy_handler->which_report, reported_bit);
+    if (current_state.last_iteration > target_pos) {
+      push_k2node_lazy_report_band_state_t_stack(&lazy_handler->stack,
+                                                 current_state);
+      return SUCCESS_ECODE_K2T;
+    }
+
+    if (target_pos < 3) {
+      current_state.last_iteration = target_pos + 1;
+      push_k2node_lazy_report_band_state_t_stack(&lazy_handler->stack,
+                                                 current_state);
+    }
+    struct k2node *child_node = node->k2subtree.children[target_pos];
+    if (!child_node) {
+      return SUCCESS_ECODE_K2T;
+    }
+    add_element_morton_code(&st->mc, current_depth, target_pos);
+
+    k2node_lazy_report_band_state_t child_state;
+    child_state.current_coord = current_state.current_coord % half_level;
+    child_state.last_iteration = 0;
+    child_state.current_depth = current_depth + 1;
+    child_state.input_node = child_node;
+    current_state = child_state;
+  }
+}
+
+int k2node_report_band_seek(
+    struct k2node_lazy_handler_report_band_t *lazy_handler, uint64_t coord) {
+  if (!lazy_handler->has_next || lazy_handler->next_result >= coord) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  struct k2qstate *st = lazy_handler->st;
+  uint64_t known = lazy_handler->next_result;
+  while (!empty_k2node_lazy_report_band_state_t_stack(&lazy_handler->stack)) {
+    k2node_lazy_report_band_state_t current_state =
+        pop_k2node_lazy_report_band_state_t_stack(&lazy_handler->stack);
+    uint64_t current_depth = current_state.current_depth;
+    if (SAME_NODE_AT(known, coord, st->k2tree_depth, current_depth)) {
+      CHECK_ERR(
+          k2node_report_band_seek_descend(lazy_handler, current_state, coord));
+      break;
+    }
+    if (current_depth == st->cut_depth) {
+      lazy_handler->at_leaf = FALSE;
+    }
+  }
+
+  uint64_t skipped;
+  return k2node_report_band_next(lazy_handler, &skipped);
+}
+
+int k2node_report_range_lazy_init(
+    struct k2node_lazy_handler_report_range_t *lazy_handler,
+    struct k2node *input_node, struct k2qstate *st, uint64_t col_lo,
+    uint64_t col_hi, uint64_t row_lo, uint64_t row_hi) {
+  lazy_handler->st = st;
+  lazy_handler->tree_root = input_node;
+  lazy_handler->empty_range = !init_report_range(
+      &lazy_handler->range, col_lo, col_hi, row_lo, row_hi, st->k2tree_depth);
+  init_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                              st->cut_depth * 4 + 10);
+  init_lazy_report_range_state_t_stack(
+      &lazy_handler->sub_handler.stack,
+      (st->k2tree_depth - st->cut_depth) * 4 + 10);
+  lazy_handler->sub_handler.qs = &st->qs;
+
+  return k2node_report_range_reset(lazy_handler);
+}
+
+int k2node_report_range_lazy_clean(
+    struct k2node_lazy_handler_report_range_t *lazy_handler) {
+  report_range_lazy_clean(&lazy_handler->sub_handler);
+  free_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack);
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_report_range_reset(
+    struct k2node_lazy_handler_report_range_t *lazy_handler) {
+  lazy_handler->has_next = FALSE;
+  lazy_handler->sub_handler.has_next = FALSE;
+  lazy_handler->at_leaf = FALSE;
+  reset_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack);
+  reset_lazy_report_range_state_t_stack(&lazy_handler->sub_handler.stack);
+  if (lazy_handler->empty_range) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  k2node_lazy_report_range_state_t first_state;
+  first_state.current_depth = 0;
+  first_state.input_node = lazy_handler->tree_root;
+  first_state.last_iteration = 0;
+  first_state.range = lazy_handler->range;
+  push_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                              first_state);
+  return k2node_report_range_next(lazy_handler, &lazy_handler->next_result);
+}
+
+int k2node_report_range_next(
+    struct k2node_lazy_handler_report_range_t *lazy_handler,
+    pair2dl_t *result) {
+  *result = lazy_handler->next_result;
+  struct k2qstate *st = lazy_handler->st;
+  while (!empty_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack)) {
+    k2node_lazy_report_range_state_t current_state =
+        pop_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack);
+
+    uint64_t current_depth = current_state.current_depth;
+    uint64_t remaining_depth = st->k2tree_depth - current_depth;
+    struct k2node *node = current_state.input_node;
+
+    if (current_depth == st->cut_depth) {
+      if (!lazy_handler->at_leaf) {
+        struct pair2dl high_level_coordinates;
+        convert_morton_code_to_coordinates_select_treedepth(
+            &st->mc, &high_level_coordinates, st->cut_depth);
+
+        lazy_handler->base_col =
+            high_level_coordinates.col
+            << (uint64_t)(st->k2tree_depth - st->cut_depth);
+        lazy_handler->base_row =
+            high_level_coordinates.row
+            << (uint64_t)(st->k2tree_depth - st->cut_depth);
+
+        // The range was already clipped to this subtree on the way down
+        lazy_handler->sub_handler.range = current_state.range;
+        lazy_handler->sub_handler.empty_range = FALSE;
+        lazy_handler->sub_handler.tree_root = node->k2subtree.block_child;
+        CHECK_ERR(report_range_reset(&lazy_handler->sub_handler));
+        lazy_handler->at_leaf = TRUE;
+      }
+
+      int sub_has_next;
+      report_range_has_next(&lazy_handler->sub_handler, &sub_has_next);
+      if (!sub_has_next) {
+        lazy_handler->at_leaf = FALSE;
+      } else {
+        CHECK_ERR(report_range_next(&lazy_handler->sub_handler,
+                                    &lazy_handler->next_result));
+        lazy_handler->next_result.col += lazy_handler->base_col;
+        lazy_handler->next_result.row += lazy_handler->base_row;
+
+        lazy_handler->has_next = TRUE;
+        push_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                                    current_state);
+        return SUCCESS_ECODE_K2T;
+      }
+      continue;
+    }
+
+    uint64_t next_remaining_depth = remaining_depth - 1UL;
+    uint64_t half_level = 1UL << next_remaining_depth;
+
+    struct report_range child_range;
+    for (uint32_t child_pos = current_state.last_iteration; child_pos < 4;
+         child_pos++) {
+      if (!node->k2subtree.children[child_pos] ||
+          !clip_report_range(&current_state.range, child_pos, half_level,
+                             &child_range))
+        continue;
+      add_element_morton_code(&st->mc, current_depth, child_pos);
+
+      if (child_pos < 3) {
+        k2node_lazy_report_range_state_t sibling_state = current_state;
+        sibling_state.last_iteration = child_pos + 1;
+        push_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                                    sibling_state);
+      }
+      k2node_lazy_report_range_state_t child_state;
+      child_state.range = child_range;
+      child_state.last_iteration = 0;
+      child_state.current_depth = current_depth + 1;
+      child_state.input_node = node->k2subtree.children[child_pos];
+      push_k2node_lazy_report_range_state_t_stack(&lazy_handler->stack,
+                                                  child_state);
+      break;
+    }
+  }
+  lazy_handler->has_next = FALSE;
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_report_range_has_next(
+    struct k2node_lazy_handler_report_range_t *lazy_handler, int *result) {
+  *result = lazy_handler->has_next;
+  return SUCCESS_ECODE_K2T;
+}
+
+static int k2node_report_bands_lazy_init(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler,
+    struct k2node *input_node, struct k2qstate *st, const uint64_t *coords,
+    uint64_t coords_count, int which_report) {
+  lazy_handler->st = st;
+  lazy_handler->tree_root = input_node;
+  lazy_handler->which_report = which_report;
+  lazy_handler->coords_count = sort_band_coords(
+      coords, coords_count, st->k2tree_depth, &lazy_handler->coords);
+  init_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                              st->cut_depth * 4 + 10);
+  init_lazy_report_bands_state_t_stack(
+      &lazy_handler->sub_handler.stack,
+      (st->k2tree_depth - st->cut_depth) * 4 + 10);
+  lazy_handler->sub_handler.qs = &st->qs;
+  lazy_handler->sub_handler.which_report = which_report;
+
+  return k2node_report_bands_reset(lazy_handler);
+}
+
+int k2node_report_rows_lazy_init(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler,
+    struct k2node *input_node, struct k2qstate *st, const uint64_t *rows,
+    uint64_t rows_count) {
+  return k2node_report_bands_lazy_init(lazy_handler, input_node, st, rows,
+                                       rows_count, REPORT_ROW);
+}
+
+int k2node_report_columns_lazy_init(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler,
+    struct k2node *input_node, struct k2qstate *st, const uint64_t *cols,
+    uint64_t cols_count) {
+  return k2node_report_bands_lazy_init(lazy_handler, input_node, st, cols,
+                                       cols_count, REPORT_COLUMN);
+}
+
+int k2node_report_bands_lazy_clean(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler) {
+  /* the coordinates of the sub handler belong to this one */
+  free_lazy_report_bands_state_t_stack(&lazy_handler->sub_handler.stack);
+  free_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack);
+  free(lazy_handler->coords);
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_report_bands_reset(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler) {
+  lazy_handler->has_next = FALSE;
+  lazy_handler->sub_handler.has_next = FALSE;
+  lazy_handler->at_leaf = FALSE;
+  reset_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack);
+  reset_lazy_report_bands_state_t_stack(&lazy_handler->sub_handler.stack);
+  if (lazy_handler->coords_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+
+  k2node_lazy_report_bands_state_t first_state;
+  first_state.current_depth = 0;
+  first_state.input_node = lazy_handler->tree_root;
+  first_state.last_iteration = 0;
+  first_state.coords_lo = 0;
+  first_state.coords_hi = lazy_handler->coords_count;
+  push_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                              first_state);
+  return k2node_report_bands_next(lazy_handler, &lazy_handler->next_result);
+}
+
+int k2node_report_bands_next(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler,
+    pair2dl_t *result) {
+  *result = lazy_handler->next_result;
+  struct k2qstate *st = lazy_handler->st;
+  while (!empty_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack)) {
+    k2node_lazy_report_bands_state_t current_state =
+        pop_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack);
+
+    uint64_t current_depth = current_state.current_depth;
+    struct k2node *node = current_state.input_node;
+
+    if (current_depth == st->cut_depth) {
+      if (!lazy_handler->at_leaf) {
+        struct pair2dl high_level_coordinates;
+        convert_morton_code_to_coordinates_select_treedepth(
+            &st->mc, &high_level_coordinates, st->cut_depth);
+
+        lazy_handler->base_col =
+            high_level_coordinates.col
+            << (uint64_t)(st->k2tree_depth - st->cut_depth);
+        lazy_handler->base_row =
+            high_level_coordinates.row
+            << (uint64_t)(st->k2tree_depth - st->cut_depth);
+
+        // The block only looks at the lowest bits of the coordinates
+        lazy_handler->sub_handler.coords =
+            lazy_handler->coords + current_state.coords_lo;
+        lazy_handler->sub_handler.coords_count =
+            current_state.coords_hi - current_state.coords_lo;
+        lazy_handler->sub_handler.tree_root = node->k2subtree.block_child;
+        CHECK_ERR(report_bands_reset(&lazy_handler->sub_handler));
+        lazy_handler->at_leaf = TRUE;
+      }
+
+      int sub_has_next;
+      report_bands_has_next(&lazy_handler->sub_handler, &sub_has_next);
+      if (!sub_has_next) {
+        lazy_handler->at_leaf = FALSE;
+      } else {
+        CHECK_ERR(report_bands_next(&lazy_handler->sub_handler,
+                                    &lazy_handler->next_result));
+        lazy_handler->next_result.col += lazy_handler->base_col;
+        lazy_handler->next_result.row += lazy_handler->base_row;
+
+        lazy_handler->has_next = TRUE;
+        push_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                                    current_state);
+        return SUCCESS_ECODE_K2T;
+      }
+      continue;
+    }
+
+    uint64_t split = split_band_coords(
+        lazy_handler->coords, current_state.coords_lo, current_state.coords_hi,
+        (uint32_t)(st->k2tree_depth - current_depth - 1));
+
+    for (uint32_t child_pos = current_state.last_iteration; child_pos < 4;
+         child_pos++) {
+      int second_half =
+          REPORT_SECOND_HALF(lazy_handler->which_report, child_pos);
+      uint64_t lo = second_half ? split : current_state.coords_lo;
+      uint64_t hi = second_half ? current_state.coords_hi : split;
+      if (lo == hi || !node->k2subtree.children[child_pos])
+        continue;
+      add_element_morton_code(&st->mc, current_depth, child_pos);
+
+      if (child_pos < 3) {
+        k2node_lazy_report_bands_state_t sibling_state = current_state;
+        sibling_state.last_iteration = child_pos + 1;
+        push_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                                    sibling_state);
+      }
+      k2node_lazy_report_bands_state_t child_state;
+      child_state.coords_lo = lo;
+      child_state.coords_hi = hi;
+      child_state.last_iteration = 0;
+      child_state.current_depth = current_depth + 1;
+      child_state.input_node = node->k2subtree.children[child_pos];
+      push_k2node_lazy_report_bands_state_t_stack(&lazy_handler->stack,
+                                                  child_state);
+      break;
+    }
+  }
+  lazy_handler->has_next = FALSE;
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_report_bands_has_next(
+    struct k2node_lazy_handler_report_bands_t *lazy_handler, int *result) {
+  *result = lazy_handler->has_next;
+  return SUCCESS_ECODE_K2T;
+}
+
+int k2node_delete_point_internal(struct k2node *input_node, uint64_t col,
+                                 uint64_t row, struct k2qstate *st,
+                                 int *already_not_exists) {
 
   *already_not_exists = FALSE;
+  if (st->qs.read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
   convert_coordinates_to_morton_code(col, row, st->k2tree_depth, &st->mc);
   int has_children = TRUE;
   return k2node_delete_point_rec(input_node, st, col, row, 0,
                                  already_not_exists, &has_children);
 }
 
+int k2node_delete_point(struct k2node *input_node, uint64_t col,
+                        uint64_t row, struct k2qstate *st,
+                        int *already_not_exists) {
+  TREE_ALLOCATOR_ENTER(input_node);
+  int err = k2node_delete_point_internal(input_node, col, row, st,
+                                         already_not_exists);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
+int k2node_delete_points_batch_internal(struct k2node *root_node,
+                                        const pair2dl_t *points,
+                                        uint64_t points_count,
+                                        struct k2qstate *st,
+                                        uint64_t *deleted_count) {
+  *deleted_count = 0;
+  if (st->qs.read_only) {
+    return READ_ONLY_QUERY_CONTEXT;
+  }
+  if (points_count == 0) {
+    return SUCCESS_ECODE_K2T;
+  }
+  pair2dl_t *sorted_points =
+      (pair2dl_t *)malloc(sizeof(pair2dl_t) * points_count);
+  memcpy(sorted_points, points, sizeof(pair2dl_t) * points_count);
+  sort_points_morton_order(sorted_points, points_count);
+
+  int err = k2node_delete_points_batch_rec(root_node, st, 0, sorted_points,
+                                           points_count, deleted_count);
+  free(sorted_points);
+  return err;
+}
+
+int k2node_delete_points_batch(struct k2node *root_node,
+                               const pair2dl_t *points, uint64_t points_count,
+                               struct k2qstate *st, uint64_t *deleted_count) {
+  TREE_ALLOCATOR_ENTER(root_node);
+  int err = k2node_delete_points_batch_internal(root_node, points,
+                                                points_count, st,
+                                                deleted_count);
+  TREE_ALLOCATOR_LEAVE();
+  return err;
+}
+
 static int print_debug_k2node_rec(struct k2node *node, int curr_depth,
                                   struct k2qstate *st) {
 
@@ -923,3 +2692,5 @@ int print_debug_k2node(struct k2node *node, struct k2qstate *st) {
 
 declare_stack_of_type(k2node_lazy_naive_state)
     declare_stack_of_type(k2node_lazy_report_band_state_t)
+        declare_stack_of_type(k2node_lazy_report_range_state_t)
+            declare_stack_of_type(k2node_lazy_report_bands_state_t)
@@ -25,36 +25,41 @@ SOFTWARE.
 
 #include "custom_bv_handling.h"
 
+static inline uint64_t level_shift(struct morton_code *mc,
+                                   uint64_t position) {
+  return (uint64_t)mc->treedepth - position - 1UL;
+}
+
+static inline uint64_t coordinate_mask(uint32_t treedepth) {
+  return treedepth >= 64 ? ~0UL : (1UL << (uint64_t)treedepth) - 1UL;
+}
+
 void init_morton_code(struct morton_code *mc, uint32_t treedepth) {
   mc->treedepth = treedepth;
-  /*
-  mc->container =
-      (MC_CONTAINER_T *)calloc(2 * mc->treedepth, sizeof(MC_CONTAINER_T));
-      */
-  mc->container =
-      (MC_CONTAINER_T *)calloc(mc->treedepth, sizeof(MC_CONTAINER_T));
+  mc->col_bits = 0;
+  mc->row_bits = 0;
 }
 
 void clean_morton_code(struct morton_code *mc) {
-  if (mc->container) {
-
-    free(mc->container);
-    mc->container = NULL;
-  }
+  mc->col_bits = 0;
+  mc->row_bits = 0;
 }
 
 void add_element_morton_code(struct morton_code *mc, uint32_t position,
                              uint32_t code) {
-  // mc->container[2 * position] = (code & 2) > 0 ? 1 : 0;
-  // mc->container[2 * position + 1] = (code & 1) > 0 ? 1 : 0;
-  mc->container[position] = code;
+  uint64_t shift = level_shift(mc, position);
+  uint64_t level_bit = 1UL << shift;
+  uint64_t col_bit = (uint64_t)(code >> 1) & 1UL;
+  uint64_t row_bit = (uint64_t)code & 1UL;
+  mc->col_bits = (mc->col_bits & ~level_bit) | (col_bit << shift);
+  mc->row_bits = (mc->row_bits & ~level_bit) | (row_bit << shift);
 }
 
 uint64_t get_code_at_morton_code(struct morton_code *mc,
                                       uint64_t position) {
-  // return (mc->container[2 * position] << 1) + mc->container[2 * position +
-  // 1];
-  return mc->container[position];
+  uint64_t shift = level_shift(mc, position);
+  return (((mc->col_bits >> shift) & 1UL) << 1) |
+         ((mc->row_bits >> shift) & 1UL);
 }
 
 uint64_t leaf_child_morton_code(struct morton_code *mc) {
@@ -64,36 +69,14 @@ uint64_t leaf_child_morton_code(struct morton_code *mc) {
 void convert_coordinates_to_morton_code(uint64_t col, uint64_t row,
                                         uint32_t treedepth,
                                         struct morton_code *result) {
-
-  uint64_t half_level;
   if (treedepth > 64) {
     fprintf(stderr, "K2tree not implemented for depths higher than 64\n");
     exit(1);
-  } else if (treedepth == 64) {
-    half_level = 1UL << 63UL;
-  } else {
-    half_level = (1UL << (uint64_t)(treedepth - 1));
-  }
-  uint32_t mc_position = 0;
-  while (half_level > 0) {
-    uint32_t quadrant;
-
-    if (col >= half_level && row >= half_level) {
-      quadrant = 3;
-    } else if (col >= half_level && row < half_level) {
-      quadrant = 2;
-    } else if (col < half_level && row >= half_level) {
-      quadrant = 1;
-    } else {
-      quadrant = 0;
-    }
-
-    col %= half_level;
-    row %= half_level;
-    half_level >>= 1UL;
-
-    add_element_morton_code(result, mc_position++, quadrant);
   }
+  // Bits above the tree depth don't select any quadrant
+  uint64_t mask = coordinate_mask(treedepth);
+  result->col_bits = col & mask;
+  result->row_bits = row & mask;
 }
 
 int convert_morton_code_to_coordinates(struct morton_code *input_mc,
@@ -102,34 +85,69 @@ int convert_morton_code_to_coordinates(struct morton_code *input_mc,
       input_mc, result, input_mc->treedepth);
 }
 
+/**
+ * @brief Coordinates of the node reached by the first treedepth codes, in a
+ * matrix of side 2^treedepth
+ */
 int convert_morton_code_to_coordinates_select_treedepth(
     struct morton_code *input_mc, struct pair2dl *result,
     TREE_DEPTH_T treedepth) {
-  uint64_t tree_depth_ul = treedepth;
-  uint64_t col = 0;
-  uint64_t row = 0;
-  for (uint64_t i = 0; i < tree_depth_ul; i++) {
-    uint64_t current = get_code_at_morton_code(input_mc, i);
-    uint64_t current_pow = tree_depth_ul - 1 - i;
-    switch (current) {
-    case 3:
-      col += 1UL << current_pow;
-      row += 1UL << current_pow;
-      break;
-    case 2:
-      col += 1UL << current_pow;
-      break;
-    case 1:
-      row += 1UL << current_pow;
-      break;
-    case 0:
-      break;
-    default:
-      return INVALID_MC_VALUE;
-    }
+  if (treedepth == 0) {
+    result->col = 0;
+    result->row = 0;
+    return SUCCESS_ECODE_K2T;
+  }
+  if (treedepth > input_mc->treedepth) {
+    return INVALID_MC_VALUE;
   }
-  result->col = col;
-  result->row = row;
+  uint64_t shift = (uint64_t)input_mc->treedepth - (uint64_t)treedepth;
+  result->col = input_mc->col_bits >> shift;
+  result->row = input_mc->row_bits >> shift;
 
   return SUCCESS_ECODE_K2T;
 }
+
+static int less_msb(uint64_t lhs, uint64_t rhs) {
+  return lhs < rhs && lhs < (lhs ^ rhs);
+}
+
+/**
+ * @brief Compares two points by the order of their morton codes (Z-order)
+ *
+ * At each level the column bit is more significant than the row bit, which is
+ * the same order in which the tree stores its children.
+ *
+ * @return int negative, zero or positive like strcmp
+ */
+int compare_points_morton_order(const pair2dl_t *lhs, const pair2dl_t *rhs) {
+  uint64_t col_diff = lhs->col ^ rhs->col;
+  uint64_t row_diff = lhs->row ^ rhs->row;
+  if (less_msb(col_diff, row_diff)) {
+    return (lhs->row > rhs->row) - (lhs->row < rhs->row);
+  }
+  if (col_diff != 0) {
+    return (lhs->col > rhs->col) - (lhs->col < rhs->col);
+  }
+  return 0;
+}
+
+static int qsort_points_morton_cmp(const void *lhs, const void *rhs) {
+  return compare_points_morton_order((const pair2dl_t *)lhs,
+                                     (const pair2dl_t *)rhs);
+}
+
+static int qsort_indexed_points_morton_cmp(const void *lhs, const void *rhs) {
+  const ipair2dl_t *l = (const ipair2dl_t *)lhs;
+  const ipair2dl_t *r = (const ipair2dl_t *)rhs;
+  return compare_points_morton_order(&l->point, &r->point);
+}
+
+void sort_points_morton_order(pair2dl_t *points, uint64_t points_count) {
+  qsort(points, points_count, sizeof(pair2dl_t), qsort_points_morton_cmp);
+}
+
+void sort_indexed_points_morton_order(ipair2dl_t *points,
+                                      uint64_t points_count) {
+  qsort(points, points_count, sizeof(ipair2dl_t),
+        qsort_indexed_points_morton_cmp);
+}
@@ -23,14 +23,9 @@ SOFTWARE.
 */
 #include "queries_state.h"
 
-#include <math.h>
+#include <stdlib.h>
 
-/* PRIVATE PROTOTYPES */
-int init_sequential_scan_result(struct sequential_scan_result *scr,
-                                MAX_NODE_COUNT_T max_nodes_count);
-int clean_sequential_scan_result(struct sequential_scan_result *scr,
-                                 MAX_NODE_COUNT_T max_nodes_count);
-/* END PRIVATE PROTOTYPES */
+declare_cvector(compaction_candidate_t, long)
 
 /* IMPLEMENTATION PUBLIC FUNCTIONS */
 int init_queries_state(struct queries_state *qs, uint32_t tree_depth,
@@ -38,49 +33,79 @@ int init_queries_state(struct queries_state *qs, uint32_t tree_depth,
                        struct block *root_block) {
   init_morton_code(&(qs->mc), tree_depth);
   init_int_stack(&(qs->not_yet_traversed), 2 * tree_depth);
-  init_nsi_t_stack(&(qs->subtrees_count), 2 * tree_depth);
-  qs->find_split_data = FALSE;
   qs->max_nodes_count = max_nodes_count;
   qs->root = root_block;
   qs->treedepth = tree_depth;
+  qs->read_only = FALSE;
 
-  qs->level_threshold_1 = 4;
-  qs->level_threshold_2 = 8;
-  qs->max_nodes_1 = 64 < max_nodes_count ? 64 : max_nodes_count;
-  qs->max_nodes_2 = 128 < max_nodes_count ? 128 : max_nodes_count;
+  qs->level_threshold_1 = LEVEL_THRESHOLD_1;
+  qs->level_threshold_2 = LEVEL_THRESHOLD_2;
+  qs->max_nodes_1 = MAX_NODES_LEVEL_1 < max_nodes_count ? MAX_NODES_LEVEL_1
+                                                        : max_nodes_count;
+  qs->max_nodes_2 = MAX_NODES_LEVEL_2 < max_nodes_count ? MAX_NODES_LEVEL_2
+                                                        : max_nodes_count;
+  qs->block_growth_percent = BLOCK_GROWTH_POWER_OF_TWO;
+  qs->deferred_compaction = FALSE;
+  vector_compaction_candidate_t__init_vector(&qs->compaction_candidates);
+  qs->compaction_candidates_deduped = 0;
+
+  qs->sc_result.child_preorder = 0;
+  qs->sc_result.node_relative_depth = 0;
 
 #ifdef DEBUG_STATS
   qs->dstats.time_on_sequential_scan = 0;
   qs->dstats.time_on_frontier_check = 0;
   qs->dstats.split_count = 0;
+  qs->dstats.time_on_split = 0;
 #endif
-  return init_sequential_scan_result(&qs->sc_result, qs->max_nodes_count);
+  return SUCCESS_ECODE_K2T;
 }
 
 int finish_queries_state(struct queries_state *qs) {
-  free_nsi_t_stack(&qs->subtrees_count);
   free_int_stack(&qs->not_yet_traversed);
   clean_morton_code(&qs->mc);
-  return clean_sequential_scan_result(&qs->sc_result, qs->max_nodes_count);
+  vector_compaction_candidate_t__free_vector(&qs->compaction_candidates);
+  return SUCCESS_ECODE_K2T;
 }
-/* END IMPLEMENTATION PUBLIC FUNCTIONS */
 
-/* PRIVATE FUNCTIONS IMPLEMENTATION */
-int init_sequential_scan_result(struct sequential_scan_result *scr,
-                                MAX_NODE_COUNT_T max_nodes_count) {
-  int sz = 1 << (int)ceil(log2(max_nodes_count));
-  scr->subtrees_count_map = k2tree_alloc_u32array(sz);
-  scr->relative_depth_map = k2tree_alloc_u32array(sz);
+int init_read_only_queries_state(struct queries_state *qs,
+                                 uint32_t tree_depth,
+                                 struct block *root_block) {
+  init_morton_code(&qs->mc, tree_depth);
+  init_int_stack(&qs->not_yet_traversed, 2 * tree_depth);
+  qs->max_nodes_count = 0;
+  qs->root = root_block;
+  qs->treedepth = tree_depth;
+  qs->read_only = TRUE;
+
+  qs->level_threshold_1 = LEVEL_THRESHOLD_1;
+  qs->level_threshold_2 = LEVEL_THRESHOLD_2;
+  qs->max_nodes_1 = 0;
+  qs->max_nodes_2 = 0;
+  qs->block_growth_percent = BLOCK_GROWTH_POWER_OF_TWO;
+  qs->deferred_compaction = FALSE;
+  vector_compaction_candidate_t__init_vector(&qs->compaction_candidates);
+  qs->compaction_candidates_deduped = 0;
 
+  qs->sc_result.child_preorder = 0;
+  qs->sc_result.node_relative_depth = 0;
+
+#ifdef DEBUG_STATS
+  qs->dstats.time_on_sequential_scan = 0;
+  qs->dstats.time_on_frontier_check = 0;
+  qs->dstats.split_count = 0;
+  qs->dstats.time_on_split = 0;
+#endif
   return SUCCESS_ECODE_K2T;
 }
 
-int clean_sequential_scan_result(struct sequential_scan_result *scr,
-                                 MAX_NODE_COUNT_T max_nodes_count) {
-
-  k2tree_free_u32array(scr->subtrees_count_map, max_nodes_count);
-  k2tree_free_u32array(scr->relative_depth_map, max_nodes_count);
+int init_query_ctx(struct query_ctx *ctx, uint32_t tree_depth,
+                   struct block *root_block) {
+  return init_read_only_queries_state(&ctx->qs, tree_depth, root_block);
+}
 
-  return SUCCESS_ECODE_K2T;
+int finish_query_ctx(struct query_ctx *ctx) {
+  return finish_queries_state(&ctx->qs);
 }
-/* END PRIVATE FUNCTIONS IMPLEMENTATION */
+/* END IMPLEMENTATION PUBLIC FUNCTIONS */
+
@@ -0,0 +1,229 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "shared_tree.h"
+
+#include <sched.h>
+#include <time.h>
+
+#define CHECK_LOCK(pthread_call)                                               \
+  do {                                                                         \
+    if ((pthread_call) != 0)                                                   \
+      return SHARED_TREE_LOCK_FAILED;                                          \
+  } while (0)
+
+int init_shared_block_tree(struct shared_block_tree *tree, uint32_t treedepth,
+                           MAX_NODE_COUNT_T max_nodes_count) {
+  CHECK_LOCK(pthread_rwlock_init(&tree->lock, NULL));
+  CHECK_LOCK(pthread_mutex_init(&tree->compaction_lock, NULL));
+  CHECK_LOCK(pthread_cond_init(&tree->compaction_wakeup, NULL));
+  tree->compaction_running = FALSE;
+  tree->compaction_stop = FALSE;
+  tree->compaction_interval_ms = 0;
+  tree->compaction_budget_us = 0;
+  tree->compaction_err = SUCCESS_ECODE_K2T;
+  tree->root = create_block();
+  return init_queries_state(&tree->writer_qs, treedepth, max_nodes_count,
+                            tree->root);
+}
+
+int free_shared_block_tree(struct shared_block_tree *tree) {
+  shared_tree_stop_compaction(tree);
+  CHECK_ERR(free_rec_block(tree->root));
+  tree->root = NULL;
+  CHECK_ERR(finish_queries_state(&tree->writer_qs));
+  CHECK_LOCK(pthread_rwlock_destroy(&tree->lock));
+  CHECK_LOCK(pthread_mutex_destroy(&tree->compaction_lock));
+  CHECK_LOCK(pthread_cond_destroy(&tree->compaction_wakeup));
+  return SUCCESS_ECODE_K2T;
+}
+
+int init_shared_tree_query_ctx(struct shared_block_tree *tree,
+                               struct query_ctx *ctx) {
+  return init_query_ctx(ctx, tree->writer_qs.treedepth, tree->root);
+}
+
+int shared_tree_read_lock(struct shared_block_tree *tree) {
+  CHECK_LOCK(pthread_rwlock_rdlock(&tree->lock));
+  return SUCCESS_ECODE_K2T;
+}
+
+int shared_tree_read_unlock(struct shared_block_tree *tree) {
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return SUCCESS_ECODE_K2T;
+}
+
+int shared_tree_has_point(struct shared_block_tree *tree, uint64_t col,
+                          uint64_t row, struct query_ctx *ctx, int *result) {
+  CHECK_LOCK(pthread_rwlock_rdlock(&tree->lock));
+  int err = has_point(tree->root, col, row, &ctx->qs, result);
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
+
+int shared_tree_report_range_interactively(
+    struct shared_block_tree *tree, uint64_t col_lo, uint64_t col_hi,
+    uint64_t row_lo, uint64_t row_hi, struct query_ctx *ctx,
+    point_reporter_fun_t point_reporter, void *report_state) {
+  CHECK_LOCK(pthread_rwlock_rdlock(&tree->lock));
+  int err =
+      report_range_interactively(tree->root, col_lo, col_hi, row_lo, row_hi,
+                                 &ctx->qs, point_reporter, report_state);
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
+
+int shared_tree_insert_point(struct shared_block_tree *tree, uint64_t col,
+                             uint64_t row, int *already_exists) {
+  CHECK_LOCK(pthread_rwlock_wrlock(&tree->lock));
+  int err = insert_point(tree->root, col, row, &tree->writer_qs, already_exists);
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
+
+int shared_tree_insert_points_batch(struct shared_block_tree *tree,
+                                    const pair2dl_t *points,
+                                    uint64_t points_count,
+                                    uint64_t *inserted_count) {
+  CHECK_LOCK(pthread_rwlock_wrlock(&tree->lock));
+  int err = insert_points_batch(tree->root, points, points_count,
+                                &tree->writer_qs, inserted_count);
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
+
+int shared_tree_delete_point(struct shared_block_tree *tree, uint64_t col,
+                             uint64_t row, int *already_not_exists) {
+  CHECK_LOCK(pthread_rwlock_wrlock(&tree->lock));
+  int err =
+      delete_point(tree->root, col, row, &tree->writer_qs, already_not_exists);
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
+
+int shared_tree_delete_points_batch(struct shared_block_tree *tree,
+                                    const pair2dl_t *points,
+                                    uint64_t points_count,
+                                    uint64_t *deleted_count) {
+  CHECK_LOCK(pthread_rwlock_wrlock(&tree->lock));
+  int err = delete_points_batch(tree->root, points, points_count,
+                                &tree->writer_qs, deleted_count);
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
+
+int shared_tree_compact(struct shared_block_tree *tree,
+                        uint64_t time_budget_us, uint64_t *pending_count) {
+  CHECK_LOCK(pthread_rwlock_wrlock(&tree->lock));
+  int err = compact_block_tree(tree->root, &tree->writer_qs, time_budget_us,
+                               pending_count);
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
+
+/* Compacts in steps of compaction_budget_us until stopped, sleeping while
+ * nothing is queued */
+static void *shared_tree_compaction_worker(void *data) {
+  struct shared_block_tree *tree = (struct shared_block_tree *)data;
+  pthread_mutex_lock(&tree->compaction_lock);
+  while (!tree->compaction_stop) {
+    pthread_mutex_unlock(&tree->compaction_lock);
+    uint64_t pending_count = 0;
+    int err = shared_tree_compact(tree, tree->compaction_budget_us,
+                                  &pending_count);
+    pthread_mutex_lock(&tree->compaction_lock);
+    if (err != SUCCESS_ECODE_K2T &&
+        tree->compaction_err == SUCCESS_ECODE_K2T) {
+      tree->compaction_err = err;
+    }
+    if (tree->compaction_stop) {
+      break;
+    }
+    if (pending_count > 0 && err == SUCCESS_ECODE_K2T) {
+      /* lets the writers waiting for the lock in before the next step */
+      pthread_mutex_unlock(&tree->compaction_lock);
+      sched_yield();
+      pthread_mutex_lock(&tree->compaction_lock);
+      continue;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t nanoseconds = (uint64_t)deadline.tv_nsec +
+                           (uint64_t)tree->compaction_interval_ms * 1000000;
+    deadline.tv_sec += (time_t)(nanoseconds / 1000000000);
+    deadline.tv_nsec = (long)(nanoseconds % 1000000000);
+    pthread_cond_timedwait(&tree->compaction_wakeup, &tree->compaction_lock,
+                           &deadline);
+  }
+  pthread_mutex_unlock(&tree->compaction_lock);
+  return NULL;
+}
+
+int shared_tree_start_compaction(struct shared_block_tree *tree,
+                                 uint32_t interval_ms,
+                                 uint64_t time_budget_us) {
+  CHECK_LOCK(pthread_mutex_lock(&tree->compaction_lock));
+  if (tree->compaction_running) {
+    CHECK_LOCK(pthread_mutex_unlock(&tree->compaction_lock));
+    return SUCCESS_ECODE_K2T;
+  }
+  CHECK_LOCK(pthread_rwlock_wrlock(&tree->lock));
+  tree->writer_qs.deferred_compaction = TRUE;
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+
+  tree->compaction_stop = FALSE;
+  tree->compaction_interval_ms = interval_ms;
+  tree->compaction_budget_us = time_budget_us;
+  tree->compaction_err = SUCCESS_ECODE_K2T;
+  int err = SUCCESS_ECODE_K2T;
+  if (pthread_create(&tree->compaction_thread, NULL,
+                     shared_tree_compaction_worker, tree) != 0) {
+    err = PARALLEL_THREAD_FAILED;
+  } else {
+    tree->compaction_running = TRUE;
+  }
+  CHECK_LOCK(pthread_mutex_unlock(&tree->compaction_lock));
+  return err;
+}
+
+int shared_tree_stop_compaction(struct shared_block_tree *tree) {
+  CHECK_LOCK(pthread_mutex_lock(&tree->compaction_lock));
+  if (!tree->compaction_running) {
+    CHECK_LOCK(pthread_mutex_unlock(&tree->compaction_lock));
+    return SUCCESS_ECODE_K2T;
+  }
+  tree->compaction_stop = TRUE;
+  CHECK_LOCK(pthread_cond_signal(&tree->compaction_wakeup));
+  CHECK_LOCK(pthread_mutex_unlock(&tree->compaction_lock));
+  CHECK_LOCK(pthread_join(tree->compaction_thread, NULL));
+
+  CHECK_LOCK(pthread_mutex_lock(&tree->compaction_lock));
+  tree->compaction_running = FALSE;
+  int err = tree->compaction_err;
+  CHECK_LOCK(pthread_mutex_unlock(&tree->compaction_lock));
+
+  CHECK_LOCK(pthread_rwlock_wrlock(&tree->lock));
+  tree->writer_qs.deferred_compaction = FALSE;
+  CHECK_LOCK(pthread_rwlock_unlock(&tree->lock));
+  return err;
+}
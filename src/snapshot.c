@@ -0,0 +1,492 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_WRITE_BUFFER_SIZE (1 << 16)
+/* containers start at multiples of their word size */
+#define SNAPSHOT_ALIGN(x)                                                      \
+  (((x) + sizeof(BVCTYPE) - 1) & ~(uint64_t)(sizeof(BVCTYPE) - 1))
+
+struct snapshot_writer {
+  int fd;
+  uint64_t used;
+  uint8_t buffer[SNAPSHOT_WRITE_BUFFER_SIZE];
+};
+
+/* Blocks and k2nodes in the order they are stored */
+struct snapshot_layout {
+  struct block **blocks;
+  uint64_t blocks_count;
+  uint64_t blocks_capacity;
+
+  struct k2node **k2nodes;
+  TREE_DEPTH_T *k2nodes_depth;
+  uint64_t k2nodes_count;
+  uint64_t k2nodes_capacity;
+};
+
+/* PRIVATE FUNCTIONS PROTOTYPES */
+static int writer_flush(struct snapshot_writer *writer);
+static int writer_put(struct snapshot_writer *writer, const void *data,
+                      uint64_t size);
+static void layout_push_block(struct snapshot_layout *layout,
+                              struct block *input_block);
+static void layout_push_k2node(struct snapshot_layout *layout,
+                               struct k2node *node, TREE_DEPTH_T depth);
+static void layout_add_block_trees(struct snapshot_layout *layout);
+static void free_layout(struct snapshot_layout *layout);
+static uint32_t stored_container_words(struct block *input_block);
+static int write_snapshot(struct snapshot_layout *layout, uint32_t kind,
+                          TREE_DEPTH_T treedepth, TREE_DEPTH_T cut_depth,
+                          int fd);
+static int map_snapshot(struct k2tree_snapshot *snapshot);
+/* END PRIVATE FUNCTIONS PROTOTYPES */
+
+/* PRIVATE FUNCTIONS IMPLEMENTATIONS */
+static int writer_flush(struct snapshot_writer *writer) {
+  uint64_t done = 0;
+  while (done < writer->used) {
+    ssize_t written =
+        write(writer->fd, writer->buffer + done, writer->used - done);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return SNAPSHOT_IO_ERROR;
+    }
+    done += (uint64_t)written;
+  }
+  writer->used = 0;
+  return SUCCESS_ECODE_K2T;
+}
+
+/* data == NULL writes size zero bytes */
+static int writer_put(struct snapshot_writer *writer, const void *data,
+                      uint64_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (size > 0) {
+    if (writer->used == SNAPSHOT_WRITE_BUFFER_SIZE) {
+      int err = writer_flush(writer);
+      if (err != SUCCESS_ECODE_K2T)
+        return err;
+    }
+    uint64_t chunk = SNAPSHOT_WRITE_BUFFER_SIZE - writer->used;
+    if (chunk > size)
+      chunk = size;
+    if (bytes) {
+      memcpy(writer->buffer + writer->used, bytes, chunk);
+      bytes += chunk;
+    } else {
+      memset(writer->buffer + writer->used, 0, chunk);
+    }
+    writer->used += chunk;
+    size -= chunk;
+  }
+  return SUCCESS_ECODE_K2T;
+}
+
+static void layout_push_block(struct snapshot_layout *layout,
+                              struct block *input_block) {
+  if (layout->blocks_count == layout->blocks_capacity) {
+    layout->blocks_capacity =
+        layout->blocks_capacity ? 2 * layout->blocks_capacity : 64;
+    layout->blocks = (struct block **)realloc(
+        layout->blocks, layout->blocks_capacity * sizeof(struct block *));
+  }
+  layout->blocks[layout->blocks_count++] = input_block;
+}
+
+static void layout_push_k2node(struct snapshot_layout *layout,
+                               struct k2node *node, TREE_DEPTH_T depth) {
+  if (layout->k2nodes_count == layout->k2nodes_capacity) {
+    layout->k2nodes_capacity =
+        layout->k2nodes_capacity ? 2 * layout->k2nodes_capacity : 64;
+    layout->k2nodes = (struct k2node **)realloc(
+        layout->k2nodes, layout->k2nodes_capacity * sizeof(struct k2node *));
+    layout->k2nodes_depth = (TREE_DEPTH_T *)realloc(
+        layout->k2nodes_depth,
+        layout->k2nodes_capacity * sizeof(TREE_DEPTH_T));
+  }
+  layout->k2nodes[layout->k2nodes_count] = node;
+  layout->k2nodes_depth[layout->k2nodes_count] = depth;
+  layout->k2nodes_count++;
+}
+
+/* Appends the descendants of the roots already in the layout, breadth first so
+ * that the children of each block end up consecutive */
+static void layout_add_block_trees(struct snapshot_layout *layout) {
+  for (uint64_t i = 0; i < layout->blocks_count; i++) {
+    struct block *current = layout->blocks[i];
+    for (uint32_t c = 0; c < current->children; c++) {
+      layout_push_block(layout, &current->children_blocks[c]);
+    }
+  }
+}
+
+static void free_layout(struct snapshot_layout *layout) {
+  free(layout->blocks);
+  free(layout->k2nodes);
+  free(layout->k2nodes_depth);
+}
+
+/* Only the words holding nodes are stored, not the spare capacity */
+static uint32_t stored_container_words(struct block *input_block) {
+  uint32_t words = CEIL_OF_DIV((uint32_t)input_block->nodes_count,
+                               NODES_PER_BVCTYPE);
+  return words < input_block->container_size ? words
+                                             : input_block->container_size;
+}
+
+static int write_snapshot(struct snapshot_layout *layout, uint32_t kind,
+                          TREE_DEPTH_T treedepth, TREE_DEPTH_T cut_depth,
+                          int fd) {
+  uint64_t roots_count = 0;
+  for (uint64_t i = 0; i < layout->k2nodes_count; i++) {
+    if (layout->k2nodes_depth[i] == cut_depth &&
+        layout->k2nodes[i]->k2subtree.block_child)
+      roots_count++;
+  }
+  if (kind == SNAPSHOT_KIND_BLOCK_TREE)
+    roots_count = 1;
+
+  uint64_t data_offset =
+      sizeof(struct snapshot_header) +
+      layout->k2nodes_count * sizeof(struct snapshot_k2node_record) +
+      layout->blocks_count * sizeof(struct snapshot_block_record);
+  uint64_t file_size = data_offset;
+  for (uint64_t i = 0; i < layout->blocks_count; i++) {
+    struct block *b = layout->blocks[i];
+    file_size += (uint64_t)stored_container_words(b) * sizeof(BVCTYPE);
+    file_size = SNAPSHOT_ALIGN(file_size +
+                                 (uint64_t)b->children * sizeof(NODES_BV_T));
+  }
+
+  struct snapshot_writer *writer =
+      (struct snapshot_writer *)malloc(sizeof(struct snapshot_writer));
+  writer->fd = fd;
+  writer->used = 0;
+
+  struct snapshot_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.byte_order_mark = SNAPSHOT_BYTE_ORDER_MARK;
+  header.kind = kind;
+  header.nodes_bv_size = sizeof(NODES_BV_T);
+  header.bvctype_size = sizeof(BVCTYPE);
+  header.treedepth = treedepth;
+  header.cut_depth = cut_depth;
+  header.k2nodes_count = layout->k2nodes_count;
+  header.blocks_count = layout->blocks_count;
+  header.file_size = file_size;
+  int err = writer_put(writer, &header, sizeof(header));
+
+  /* k2nodes were laid out breadth first too, so the children of the k2node i
+   * come right after the children of the previous k2nodes */
+  uint64_t next_k2node = 1;
+  uint64_t next_root = 0;
+  for (uint64_t i = 0; i < layout->k2nodes_count && !err; i++) {
+    struct k2node *node = layout->k2nodes[i];
+    struct snapshot_k2node_record record;
+    memset(&record, 0, sizeof(record));
+    if (layout->k2nodes_depth[i] == cut_depth) {
+      record.at_cut_depth = 1;
+      if (node->k2subtree.block_child)
+        record.links[0] = ++next_root;
+    } else {
+      for (int c = 0; c < 4; c++) {
+        if (node->k2subtree.children[c])
+          record.links[c] = ++next_k2node;
+      }
+    }
+    err = writer_put(writer, &record, sizeof(record));
+  }
+
+  uint64_t next_child = roots_count;
+  uint64_t offset = data_offset;
+  for (uint64_t i = 0; i < layout->blocks_count && !err; i++) {
+    struct block *b = layout->blocks[i];
+    struct snapshot_block_record record;
+    memset(&record, 0, sizeof(record));
+    record.container_size = stored_container_words(b);
+    record.nodes_count = b->nodes_count;
+    record.children = b->children;
+    record.container_offset = offset;
+    offset += (uint64_t)record.container_size * sizeof(BVCTYPE);
+    record.preorders_offset = offset;
+    offset = SNAPSHOT_ALIGN(offset + (uint64_t)b->children * sizeof(NODES_BV_T));
+    record.first_child = next_child;
+    next_child += b->children;
+    err = writer_put(writer, &record, sizeof(record));
+  }
+
+  for (uint64_t i = 0; i < layout->blocks_count && !err; i++) {
+    struct block *b = layout->blocks[i];
+    uint64_t container_bytes =
+        (uint64_t)stored_container_words(b) * sizeof(BVCTYPE);
+    uint64_t preorders_bytes = (uint64_t)b->children * sizeof(NODES_BV_T);
+    err = writer_put(writer, b->container, container_bytes);
+    if (!err)
+      err = writer_put(writer, b->preorders, preorders_bytes);
+    if (!err)
+      err = writer_put(writer, NULL,
+                       SNAPSHOT_ALIGN(preorders_bytes) - preorders_bytes);
+  }
+
+  if (!err)
+    err = writer_flush(writer);
+  free(writer);
+  return err;
+}
+
+static int map_snapshot(struct k2tree_snapshot *snapshot) {
+  const uint8_t *base = (const uint8_t *)snapshot->mapping;
+  uint64_t size = snapshot->mapping_size;
+  struct snapshot_header header;
+  if (size < sizeof(header))
+    return SNAPSHOT_INVALID_FORMAT;
+  memcpy(&header, base, sizeof(header));
+
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SNAPSHOT_VERSION ||
+      header.byte_order_mark != SNAPSHOT_BYTE_ORDER_MARK ||
+      header.nodes_bv_size != sizeof(NODES_BV_T) ||
+      header.bvctype_size != sizeof(BVCTYPE) || header.treedepth > 64 ||
+      header.cut_depth > header.treedepth || header.file_size != size)
+    return SNAPSHOT_INVALID_FORMAT;
+  if (header.kind == SNAPSHOT_KIND_BLOCK_TREE) {
+    if (header.k2nodes_count != 0 || header.blocks_count == 0)
+      return SNAPSHOT_INVALID_FORMAT;
+  } else if (header.kind == SNAPSHOT_KIND_K2NODE_TREE) {
+    if (header.k2nodes_count == 0)
+      return SNAPSHOT_INVALID_FORMAT;
+  } else {
+    return SNAPSHOT_INVALID_FORMAT;
+  }
+
+  uint64_t records_room = size - sizeof(header);
+  if (header.k2nodes_count >
+          records_room / sizeof(struct snapshot_k2node_record) ||
+      header.blocks_count >
+          (records_room -
+           header.k2nodes_count * sizeof(struct snapshot_k2node_record)) /
+              sizeof(struct snapshot_block_record))
+    return SNAPSHOT_INVALID_FORMAT;
+
+  const struct snapshot_k2node_record *k2node_records =
+      (const struct snapshot_k2node_record *)(base + sizeof(header));
+  const struct snapshot_block_record *block_records =
+      (const struct snapshot_block_record *)(k2node_records +
+                                             header.k2nodes_count);
+
+  snapshot->treedepth = (TREE_DEPTH_T)header.treedepth;
+  snapshot->cut_depth = (TREE_DEPTH_T)header.cut_depth;
+  snapshot->blocks = (struct block *)calloc(
+      header.blocks_count ? header.blocks_count : 1, sizeof(struct block));
+  snapshot->k2nodes = (struct k2node *)calloc(
+      header.k2nodes_count ? header.k2nodes_count : 1, sizeof(struct k2node));
+  snapshot->blocks_count = header.blocks_count;
+
+  for (uint64_t i = 0; i < header.blocks_count; i++) {
+    const struct snapshot_block_record *record = &block_records[i];
+    uint64_t container_bytes = (uint64_t)record->container_size * sizeof(BVCTYPE);
+    uint64_t preorders_bytes = (uint64_t)record->children * sizeof(NODES_BV_T);
+    if (record->container_offset % sizeof(BVCTYPE) != 0 ||
+        record->preorders_offset % sizeof(NODES_BV_T) != 0 ||
+        record->container_offset > size ||
+        container_bytes > size - record->container_offset ||
+        record->preorders_offset > size ||
+        preorders_bytes > size - record->preorders_offset ||
+        (uint64_t)record->nodes_count >
+            (uint64_t)NODES_PER_BVCTYPE * record->container_size ||
+        (NODES_BV_T)record->nodes_count != record->nodes_count ||
+        (NODES_BV_T)record->children != record->children ||
+        (CONTAINER_SZ_T)record->container_size != record->container_size ||
+        record->first_child > header.blocks_count ||
+        record->children > header.blocks_count - record->first_child ||
+        /* children always come after their parent, so there are no cycles */
+        (record->children != 0 && record->first_child <= i))
+      return SNAPSHOT_INVALID_FORMAT;
+
+    /* the frontier is searched by preorder, it must be sorted and in the
+     * block */
+    const NODES_BV_T *preorders =
+        (const NODES_BV_T *)(base + record->preorders_offset);
+    for (uint32_t c = 0; c < record->children; c++) {
+      if (preorders[c] >= record->nodes_count ||
+          (c > 0 && preorders[c] <= preorders[c - 1]))
+        return SNAPSHOT_INVALID_FORMAT;
+    }
+
+    struct block *b = &snapshot->blocks[i];
+    /* the mapping is read-only, writing through these pointers faults */
+    b->container = record->container_size
+                       ? (BVCTYPE *)(base + record->container_offset)
+                       : NULL;
+    b->preorders = record->children
+                       ? (NODES_BV_T *)(base + record->preorders_offset)
+                       : NULL;
+    b->children_blocks =
+        record->children ? &snapshot->blocks[record->first_child] : NULL;
+    b->container_size = (CONTAINER_SZ_T)record->container_size;
+    b->nodes_count = (NODES_BV_T)record->nodes_count;
+    b->children = (NODES_BV_T)record->children;
+  }
+
+  for (uint64_t i = 0; i < header.k2nodes_count; i++) {
+    const struct snapshot_k2node_record *record = &k2node_records[i];
+    struct k2node *node = &snapshot->k2nodes[i];
+    if (record->at_cut_depth) {
+      if (record->links[0] > header.blocks_count)
+        return SNAPSHOT_INVALID_FORMAT;
+      node->k2subtree.block_child =
+          record->links[0] ? &snapshot->blocks[record->links[0] - 1] : NULL;
+      continue;
+    }
+    for (int c = 0; c < 4; c++) {
+      /* children always come after their parent, so there are no cycles */
+      if (record->links[c] > header.k2nodes_count ||
+          (record->links[c] != 0 && record->links[c] <= i + 1))
+        return SNAPSHOT_INVALID_FORMAT;
+      node->k2subtree.children[c] =
+          record->links[c] ? &snapshot->k2nodes[record->links[c] - 1] : NULL;
+    }
+  }
+
+  if (header.kind == SNAPSHOT_KIND_BLOCK_TREE)
+    snapshot->root_block = &snapshot->blocks[0];
+  else
+    snapshot->root_node = &snapshot->k2nodes[0];
+#ifdef POINT_COUNTS
+  /* the counts aren't stored, computing them pages in every container */
+  if (header.kind == SNAPSHOT_KIND_BLOCK_TREE)
+    return refresh_points_count(snapshot->root_block, 0, snapshot->treedepth);
+  return k2node_refresh_points_count(snapshot->root_node, snapshot->treedepth,
+                                     snapshot->cut_depth);
+#endif
+  return SUCCESS_ECODE_K2T;
+}
+/* END PRIVATE FUNCTIONS IMPLEMENTATIONS */
+
+/* PUBLIC FUNCTIONS */
+
+/**
+ * @brief Writes a block tree to fd in the snapshot format, starting at the
+ * current position of fd
+ */
+int k2tree_save(struct block *root_block, TREE_DEPTH_T treedepth, int fd) {
+  struct snapshot_layout layout;
+  memset(&layout, 0, sizeof(layout));
+  layout_push_block(&layout, root_block);
+  layout_add_block_trees(&layout);
+  int err =
+      write_snapshot(&layout, SNAPSHOT_KIND_BLOCK_TREE, treedepth, 0, fd);
+  free_layout(&layout);
+  return err;
+}
+
+/**
+ * @brief Writes a k2node tree to fd in the snapshot format, starting at the
+ * current position of fd
+ */
+int k2tree_save_k2node(struct k2node *root_node, TREE_DEPTH_T treedepth,
+                       TREE_DEPTH_T cut_depth, int fd) {
+  struct snapshot_layout layout;
+  memset(&layout, 0, sizeof(layout));
+  layout_push_k2node(&layout, root_node, 0);
+  for (uint64_t i = 0; i < layout.k2nodes_count; i++) {
+    struct k2node *node = layout.k2nodes[i];
+    TREE_DEPTH_T depth = layout.k2nodes_depth[i];
+    if (depth == cut_depth) {
+      if (node->k2subtree.block_child)
+        layout_push_block(&layout, node->k2subtree.block_child);
+      continue;
+    }
+    for (int c = 0; c < 4; c++) {
+      if (node->k2subtree.children[c])
+        layout_push_k2node(&layout, node->k2subtree.children[c], depth + 1);
+    }
+  }
+  layout_add_block_trees(&layout);
+  int err = write_snapshot(&layout, SNAPSHOT_KIND_K2NODE_TREE, treedepth,
+                           cut_depth, fd);
+  free_layout(&layout);
+  return err;
+}
+
+/**
+ * @brief Maps a snapshot written by k2tree_save or k2tree_save_k2node
+ *
+ * Only the struct block and struct k2node headers are allocated, in a single
+ * pass over the records which also checks the preorders; the nodes are paged
+ * in from the file as queries touch them.
+ */
+int k2tree_load_mmap(const char *path, struct k2tree_snapshot *snapshot) {
+  memset(snapshot, 0, sizeof(struct k2tree_snapshot));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return SNAPSHOT_IO_ERROR;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return SNAPSHOT_IO_ERROR;
+  }
+  if ((uint64_t)file_stat.st_size < sizeof(struct snapshot_header)) {
+    close(fd);
+    return SNAPSHOT_INVALID_FORMAT;
+  }
+  void *mapping =
+      mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return SNAPSHOT_IO_ERROR;
+
+  snapshot->mapping = mapping;
+  snapshot->mapping_size = (uint64_t)file_stat.st_size;
+  int err = map_snapshot(snapshot);
+  if (err != SUCCESS_ECODE_K2T)
+    k2tree_snapshot_close(snapshot);
+  return err;
+}
+
+int k2tree_snapshot_close(struct k2tree_snapshot *snapshot) {
+#ifdef BLOCK_SKIP_INDEX
+  /* built by the queries, the mapping only holds the blocks */
+  for (uint64_t i = 0; snapshot->blocks && i < snapshot->blocks_count; i++)
+    SKIP_INDEX_FREE(&snapshot->blocks[i]);
+#endif
+  free(snapshot->blocks);
+  free(snapshot->k2nodes);
+  if (snapshot->mapping && munmap(snapshot->mapping, snapshot->mapping_size))
+    return SNAPSHOT_IO_ERROR;
+  memset(snapshot, 0, sizeof(struct k2tree_snapshot));
+  return SUCCESS_ECODE_K2T;
+}
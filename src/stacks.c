@@ -23,4 +23,4 @@ SOFTWARE.
 */
 #include "stacks.h"
 
-declare_stack_of_type(int) declare_stack_of_type(nsi_t)
+declare_stack_of_type(int)
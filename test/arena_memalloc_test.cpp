@@ -0,0 +1,435 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <arena_memalloc.h>
+#include <block.h>
+#include <k2node.h>
+#include <memalloc.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+struct counting_allocator_state {
+  uint64_t allocations = 0;
+  uint64_t releases = 0;
+};
+
+static void *counting_allocate(void *ctx, size_t size) {
+  reinterpret_cast<counting_allocator_state *>(ctx)->allocations++;
+  return malloc(size);
+}
+
+static void counting_release(void *ctx, void *ptr) {
+  reinterpret_cast<counting_allocator_state *>(ctx)->releases++;
+  free(ptr);
+}
+
+static uint64_t reallocations = 0;
+
+static void *counting_reallocate(void *ctx, void *ptr, size_t old_size,
+                                 size_t new_size) {
+  (void)ctx;
+  (void)old_size;
+  reallocations++;
+  return realloc(ptr, new_size);
+}
+
+TEST(arena_memalloc_test, block_tree_in_arena) {
+  uint32_t treedepth = 16;
+  struct k2tree_arena *arena = k2tree_arena_create();
+  ASSERT_NE(arena, nullptr);
+  struct k2tree_allocator allocator = k2tree_arena_allocator(arena);
+
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  struct block *root = create_block();
+
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 256, root);
+
+  std::mt19937 gen(5);
+  auto points = random_points(20000, 1UL << treedepth, gen);
+  for (auto &p : points) {
+    int already_exists;
+    ASSERT_EQ(insert_point(root, p.col, p.row, &qs, &already_exists),
+              SUCCESS_ECODE_K2T);
+  }
+  ASSERT_GT(k2tree_arena_chunks_count(arena), 1UL);
+
+  for (size_t i = 0; i < points.size(); i += 2) {
+    int already_not_exists;
+    ASSERT_EQ(delete_point(root, points[i].col, points[i].row, &qs,
+                           &already_not_exists),
+              SUCCESS_ECODE_K2T);
+    ASSERT_FALSE(already_not_exists);
+  }
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+
+  for (size_t i = 0; i < points.size(); i++) {
+    int result;
+    has_point(root, points[i].col, points[i].row, &qs, &result);
+    ASSERT_EQ(result, i % 2 == 1);
+  }
+
+  /* the whole tree goes with the arena */
+  finish_queries_state(&qs);
+  k2tree_bind_allocator(previous);
+  k2tree_arena_destroy(arena);
+}
+
+TEST(arena_memalloc_test, k2node_tree_in_arena_parallel) {
+  uint32_t treedepth = 20;
+  uint32_t cutdepth = 4;
+  struct k2tree_arena *arena = k2tree_arena_create();
+  struct k2tree_allocator allocator = k2tree_arena_allocator(arena);
+
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 256, cutdepth);
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  struct k2node *root = create_k2node();
+
+  std::mt19937 gen(6);
+  auto points = random_points(30000, 1UL << treedepth, gen);
+  uint64_t inserted_count;
+  ASSERT_EQ(k2node_insert_points_parallel(root, points.data(), points.size(),
+                                          4, &st, &inserted_count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(inserted_count, points.size());
+  ASSERT_EQ(debug_validate_k2node_rec(root, &st, 0), 0);
+
+  for (auto &p : points) {
+    int result;
+    k2node_has_point(root, p.col, p.row, &st, &result);
+    ASSERT_TRUE(result);
+  }
+
+  clean_k2qstate(&st);
+  k2tree_bind_allocator(previous);
+  k2tree_arena_destroy(arena);
+}
+
+TEST(arena_memalloc_test, every_allocation_goes_through_the_hooks) {
+  counting_allocator_state counts;
+  struct k2tree_allocator allocator;
+  allocator.allocate = counting_allocate;
+  allocator.release = counting_release;
+  allocator.ctx = &counts;
+  allocator.reallocate = NULL;
+
+  uint32_t treedepth = 14;
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  struct block *root = create_block();
+
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 256, root);
+  std::mt19937 gen(7);
+  auto points = random_points(5000, 1UL << treedepth, gen);
+  uint64_t inserted_count;
+  insert_points_batch(root, points.data(), points.size() / 2, &qs,
+                      &inserted_count);
+  for (size_t i = points.size() / 2; i < points.size(); i++) {
+    int already_exists;
+    insert_point(root, points[i].col, points[i].row, &qs, &already_exists);
+  }
+  for (size_t i = 0; i < points.size(); i += 3) {
+    int already_not_exists;
+    delete_point(root, points[i].col, points[i].row, &qs,
+                 &already_not_exists);
+  }
+  finish_queries_state(&qs);
+  ASSERT_GT(counts.allocations, 0UL);
+
+  free_rec_block(root);
+  k2tree_bind_allocator(previous);
+  ASSERT_EQ(counts.allocations, counts.releases);
+}
+
+#ifndef BVCTYPE_64
+TEST(arena_memalloc_test, u32array_aliases_go_through_the_hooks) {
+  counting_allocator_state counts;
+  struct k2tree_allocator allocator;
+  allocator.allocate = counting_allocate;
+  allocator.release = counting_release;
+  allocator.ctx = &counts;
+  allocator.reallocate = NULL;
+
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  uint32_t *data = k2tree_alloc_u32array(16);
+  ASSERT_NE(data, nullptr);
+  for (int i = 0; i < 16; i++)
+    ASSERT_EQ(data[i], 0U);
+  ASSERT_EQ(k2tree_free_u32array(data, 16), SUCCESS_ECODE_K2T);
+  k2tree_bind_allocator(previous);
+
+  ASSERT_EQ(counts.allocations, 1UL);
+  ASSERT_EQ(counts.releases, 1UL);
+}
+#endif
+
+/* Block trees emptied by k2node_delete_point are released with all their
+ * memory, not only their root block */
+TEST(arena_memalloc_test, k2node_deletions_release_emptied_block_trees) {
+  counting_allocator_state counts;
+  struct k2tree_allocator allocator;
+  allocator.allocate = counting_allocate;
+  allocator.release = counting_release;
+  allocator.ctx = &counts;
+  allocator.reallocate = NULL;
+
+  uint32_t treedepth = 12;
+  uint32_t cutdepth = 4;
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  struct k2node *root = create_k2node();
+
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 256, cutdepth);
+  std::mt19937 gen(23);
+  auto points = random_points(3000, 1UL << treedepth, gen);
+  for (auto &p : points) {
+    int already_exists;
+    k2node_insert_point(root, p.col, p.row, &st, &already_exists);
+  }
+  ASSERT_GT(counts.allocations, 1UL);
+  for (auto &p : points) {
+    int already_not_exists;
+    ASSERT_EQ(k2node_delete_point(root, p.col, p.row, &st,
+                                  &already_not_exists),
+              SUCCESS_ECODE_K2T);
+  }
+  clean_k2qstate(&st);
+  /* only the root k2node is left */
+  ASSERT_EQ(counts.allocations, counts.releases + 1);
+
+  free_rec_k2node(root, 0, cutdepth);
+  k2tree_bind_allocator(previous);
+  ASSERT_EQ(counts.allocations, counts.releases);
+}
+
+#ifdef TREE_ALLOCATOR
+/* The tree keeps the allocator it was created with, whatever the states
+ * modifying it and the thread binding */
+TEST(arena_memalloc_test, block_tree_keeps_its_allocator) {
+  uint32_t treedepth = 14;
+  struct k2tree_arena *arena = k2tree_arena_create();
+  struct k2tree_allocator allocator = k2tree_arena_allocator(arena);
+
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  struct block *root = create_block();
+  k2tree_bind_allocator(previous);
+
+  std::mt19937 gen(17);
+  auto points = random_points(8000, 1UL << treedepth, gen);
+  struct queries_state insertion_qs;
+  init_queries_state(&insertion_qs, treedepth, 128, root);
+  uint64_t inserted_count;
+  ASSERT_EQ(insert_points_batch(root, points.data(), points.size() / 2,
+                                &insertion_qs, &inserted_count),
+            SUCCESS_ECODE_K2T);
+  for (size_t i = points.size() / 2; i < points.size(); i++) {
+    int already_exists;
+    ASSERT_EQ(insert_point(root, points[i].col, points[i].row, &insertion_qs,
+                           &already_exists),
+              SUCCESS_ECODE_K2T);
+  }
+  finish_queries_state(&insertion_qs);
+
+  /* a different allocator bound to the thread must not serve the tree */
+  counting_allocator_state counts;
+  struct k2tree_allocator other;
+  other.allocate = counting_allocate;
+  other.release = counting_release;
+  other.ctx = &counts;
+  other.reallocate = NULL;
+  previous = k2tree_bind_allocator(&other);
+
+  struct queries_state deletion_qs;
+  init_queries_state(&deletion_qs, treedepth, 128, root);
+  deletion_qs.deferred_compaction = TRUE;
+  for (size_t i = 0; i < points.size() / 2; i++) {
+    int already_not_exists;
+    ASSERT_EQ(delete_point(root, points[i].col, points[i].row, &deletion_qs,
+                           &already_not_exists),
+              SUCCESS_ECODE_K2T);
+  }
+  uint64_t pending_count;
+  ASSERT_EQ(compact_block_tree(root, &deletion_qs, 0, &pending_count),
+            SUCCESS_ECODE_K2T);
+  finish_queries_state(&deletion_qs);
+
+  struct queries_state batch_qs;
+  init_queries_state(&batch_qs, treedepth, 128, root);
+  uint64_t deleted_count;
+  ASSERT_EQ(delete_points_batch(root, points.data() + points.size() / 2,
+                                points.size() / 4, &batch_qs, &deleted_count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(deleted_count, points.size() / 4);
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+  for (size_t i = 0; i < points.size(); i++) {
+    int result;
+    has_point(root, points[i].col, points[i].row, &batch_qs, &result);
+    ASSERT_EQ(result, i >= points.size() * 3 / 4);
+  }
+  finish_queries_state(&batch_qs);
+
+  uint64_t reserved = k2tree_arena_reserved_bytes(arena);
+  ASSERT_EQ(free_rec_block(root), SUCCESS_ECODE_K2T);
+  k2tree_bind_allocator(previous);
+  ASSERT_EQ(counts.allocations, 0UL);
+  ASSERT_EQ(counts.releases, 0UL);
+  ASSERT_EQ(k2tree_arena_reserved_bytes(arena), reserved);
+  k2tree_arena_destroy(arena);
+}
+
+TEST(arena_memalloc_test, k2node_tree_keeps_its_allocator) {
+  counting_allocator_state counts;
+  struct k2tree_allocator allocator;
+  allocator.allocate = counting_allocate;
+  allocator.release = counting_release;
+  allocator.ctx = &counts;
+  allocator.reallocate = NULL;
+
+  uint32_t treedepth = 18;
+  uint32_t cutdepth = 4;
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  struct k2node *root = create_k2node();
+  k2tree_bind_allocator(previous);
+
+  std::mt19937 gen(19);
+  auto points = random_points(20000, 1UL << treedepth, gen);
+  struct k2qstate insertion_st;
+  init_k2qstate(&insertion_st, treedepth, 256, cutdepth);
+  uint64_t inserted_count;
+  ASSERT_EQ(k2node_insert_points_parallel(root, points.data(), points.size(),
+                                          4, &insertion_st, &inserted_count),
+            SUCCESS_ECODE_K2T);
+  clean_k2qstate(&insertion_st);
+
+  struct k2qstate deletion_st;
+  init_k2qstate(&deletion_st, treedepth, 256, cutdepth);
+  uint64_t deleted_count;
+  ASSERT_EQ(k2node_delete_points_batch(root, points.data(), points.size() / 2,
+                                       &deletion_st, &deleted_count),
+            SUCCESS_ECODE_K2T);
+  for (size_t i = points.size() / 2; i < points.size(); i++) {
+    int already_not_exists;
+    ASSERT_EQ(k2node_delete_point(root, points[i].col, points[i].row,
+                                  &deletion_st, &already_not_exists),
+              SUCCESS_ECODE_K2T);
+    ASSERT_FALSE(already_not_exists);
+  }
+  clean_k2qstate(&deletion_st);
+
+  ASSERT_GT(counts.allocations, 0UL);
+  free_rec_k2node(root, 0, cutdepth);
+  ASSERT_EQ(counts.allocations, counts.releases);
+}
+#endif /* TREE_ALLOCATOR */
+
+TEST(arena_memalloc_test, reuses_released_memory) {
+  struct k2tree_arena *arena = k2tree_arena_create();
+  struct k2tree_allocator allocator = k2tree_arena_allocator(arena);
+
+  std::vector<void *> small;
+  for (int i = 0; i < 1000; i++)
+    small.push_back(allocator.allocate(allocator.ctx, 40));
+  uint64_t reserved = k2tree_arena_reserved_bytes(arena);
+  for (void *ptr : small)
+    allocator.release(allocator.ctx, ptr);
+  for (int i = 0; i < 1000; i++)
+    small[i] = allocator.allocate(allocator.ctx, 33 + i % 16);
+  ASSERT_EQ(k2tree_arena_reserved_bytes(arena), reserved);
+
+  uint64_t chunks = k2tree_arena_chunks_count(arena);
+  void *large = allocator.allocate(allocator.ctx, 100000);
+  ASSERT_NE(large, nullptr);
+  memset(large, 1, 100000);
+  ASSERT_EQ(k2tree_arena_chunks_count(arena), chunks + 1);
+  allocator.release(allocator.ctx, large);
+  ASSERT_EQ(k2tree_arena_chunks_count(arena), chunks);
+  ASSERT_EQ(k2tree_arena_reserved_bytes(arena), reserved);
+
+  k2tree_arena_destroy(arena);
+}
+
+TEST(arena_memalloc_test, containers_grow_through_reallocate) {
+  counting_allocator_state counts;
+  struct k2tree_allocator allocator;
+  allocator.allocate = counting_allocate;
+  allocator.release = counting_release;
+  allocator.ctx = &counts;
+  allocator.reallocate = counting_reallocate;
+  reallocations = 0;
+
+  uint32_t treedepth = 14;
+  const struct k2tree_allocator *previous = k2tree_bind_allocator(&allocator);
+  struct block *root = create_block();
+
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 256, root);
+  qs.block_growth_percent = 125;
+  std::mt19937 gen(13);
+  auto points = random_points(5000, 1UL << treedepth, gen);
+  for (auto &p : points) {
+    int already_exists;
+    ASSERT_EQ(insert_point(root, p.col, p.row, &qs, &already_exists),
+              SUCCESS_ECODE_K2T);
+  }
+  ASSERT_GT(reallocations, 0UL);
+  for (auto &p : points) {
+    int result;
+    has_point(root, p.col, p.row, &qs, &result);
+    ASSERT_TRUE(result);
+  }
+
+  free_rec_block(root);
+  k2tree_bind_allocator(previous);
+  /* reallocations replace the containers without new allocations */
+  ASSERT_EQ(counts.allocations, counts.releases);
+  finish_queries_state(&qs);
+}
+
+TEST(arena_memalloc_test, reallocate_stays_in_size_class) {
+  struct k2tree_arena *arena = k2tree_arena_create();
+  struct k2tree_allocator allocator = k2tree_arena_allocator(arena);
+
+  uint32_t *data = (uint32_t *)allocator.allocate(allocator.ctx, 36);
+  for (uint32_t i = 0; i < 9; i++)
+    data[i] = i;
+  ASSERT_EQ(allocator.reallocate(allocator.ctx, data, 36, 48), data);
+
+  uint32_t *moved =
+      (uint32_t *)allocator.reallocate(allocator.ctx, data, 48, 200);
+  ASSERT_NE(moved, data);
+  for (uint32_t i = 0; i < 9; i++)
+    ASSERT_EQ(moved[i], i);
+  allocator.release(allocator.ctx, moved);
+
+  k2tree_arena_destroy(arena);
+}
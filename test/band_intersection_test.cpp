@@ -0,0 +1,205 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <band_intersection.h>
+#include <block.h>
+#include <k2node.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+struct band_request {
+  int tree;
+  int which_report;
+  uint64_t coord;
+};
+
+/* Points of three trees, with rows 5 and 9 and column 7 crowded by
+ * coordinates taken from a range small enough for the bands to overlap */
+static std::vector<std::vector<pair2dl_t>> band_trees_points() {
+  std::mt19937_64 gen(8642);
+  std::uniform_int_distribution<uint64_t> shared(0, 3000);
+  std::uniform_int_distribution<uint64_t> any(0, (1UL << 16) - 1);
+  std::vector<std::vector<pair2dl_t>> trees(3);
+  for (int i = 0; i < 3000; i++) {
+    trees[0].push_back({shared(gen), 5});
+    trees[1].push_back({7, shared(gen)});
+    trees[2].push_back({shared(gen), 9});
+    trees[2].push_back({shared(gen), 5});
+    for (auto &points : trees)
+      points.push_back({any(gen), any(gen)});
+  }
+  return trees;
+}
+
+static std::vector<uint64_t>
+expected_intersection(const std::vector<std::vector<pair2dl_t>> &trees,
+                      const std::vector<band_request> &requests) {
+  std::vector<uint64_t> result;
+  for (size_t i = 0; i < requests.size(); i++) {
+    std::set<uint64_t> band;
+    for (auto &p : trees[requests[i].tree]) {
+      if (requests[i].which_report == REPORT_ROW && p.row == requests[i].coord)
+        band.insert(p.col);
+      if (requests[i].which_report == REPORT_COLUMN &&
+          p.col == requests[i].coord)
+        band.insert(p.row);
+    }
+    if (i == 0) {
+      result.assign(band.begin(), band.end());
+      continue;
+    }
+    std::vector<uint64_t> common;
+    std::set_intersection(result.begin(), result.end(), band.begin(),
+                          band.end(), std::back_inserter(common));
+    result = common;
+  }
+  return result;
+}
+
+static const std::vector<std::vector<band_request>> all_requests = {
+    {{0, REPORT_ROW, 5}},
+    {{0, REPORT_ROW, 5}, {1, REPORT_COLUMN, 7}},
+    {{0, REPORT_ROW, 5}, {1, REPORT_COLUMN, 7}, {2, REPORT_ROW, 9}},
+    {{0, REPORT_ROW, 5}, {2, REPORT_ROW, 5}, {2, REPORT_ROW, 9}},
+    {{0, REPORT_ROW, 5}, {1, REPORT_ROW, 5}},
+    {{1, REPORT_COLUMN, 7}, {2, REPORT_ROW, 1000}},
+};
+
+TEST(band_intersection_test, block_bands) {
+  auto trees_points = band_trees_points();
+  std::vector<std::unique_ptr<BlockWrapper>> trees;
+  for (auto &points : trees_points) {
+    trees.emplace_back(new BlockWrapper(16, 256));
+    for (auto &p : points)
+      trees.back()->insert(p.col, p.row);
+  }
+
+  for (auto &requests : all_requests) {
+    auto expected = expected_intersection(trees_points, requests);
+
+    std::vector<struct query_ctx> contexts(requests.size());
+    std::vector<struct band_spec> specs;
+    for (size_t i = 0; i < requests.size(); i++) {
+      struct block *root = trees[requests[i].tree]->get_root();
+      init_query_ctx(&contexts[i], 16, root);
+      specs.push_back({root, &contexts[i].qs, requests[i].which_report,
+                       requests[i].coord});
+    }
+
+    struct lazy_handler_band_intersection_t lh;
+    ASSERT_EQ(band_intersection_lazy_init(&lh, specs.data(),
+                                          (uint32_t)specs.size()),
+              SUCCESS_ECODE_K2T);
+    for (int round = 0; round < 2; round++) {
+      std::vector<uint64_t> results;
+      int has_next;
+      for (band_intersection_has_next(&lh, &has_next); has_next;
+           band_intersection_has_next(&lh, &has_next)) {
+        uint64_t result;
+        ASSERT_EQ(band_intersection_next(&lh, &result), SUCCESS_ECODE_K2T);
+        results.push_back(result);
+      }
+      ASSERT_EQ(results, expected);
+      band_intersection_reset(&lh);
+    }
+
+    /* seeking half way gives the upper half of the intersection */
+    if (!expected.empty()) {
+      uint64_t middle = expected[expected.size() / 2];
+      band_intersection_seek(&lh, middle);
+      uint64_t result;
+      band_intersection_next(&lh, &result);
+      ASSERT_EQ(result, middle);
+    }
+    band_intersection_lazy_clean(&lh);
+    for (auto &ctx : contexts)
+      finish_query_ctx(&ctx);
+  }
+}
+
+TEST(band_intersection_test, k2node_bands) {
+  auto trees_points = band_trees_points();
+  std::vector<struct k2node *> trees;
+  struct k2qstate build_st;
+  init_k2qstate(&build_st, 16, 256, 5);
+  for (auto &points : trees_points) {
+    trees.push_back(create_k2node());
+    uint64_t inserted;
+    k2node_insert_points_batch(trees.back(), points.data(), points.size(),
+                               &build_st, &inserted);
+  }
+
+  for (auto &requests : all_requests) {
+    auto expected = expected_intersection(trees_points, requests);
+
+    std::vector<struct k2qstate> states(requests.size());
+    std::vector<struct k2node_band_spec> specs;
+    for (size_t i = 0; i < requests.size(); i++) {
+      init_k2qstate(&states[i], 16, 256, 5);
+      specs.push_back({trees[requests[i].tree], &states[i],
+                       requests[i].which_report, requests[i].coord});
+    }
+
+    struct k2node_lazy_handler_band_intersection_t lh;
+    ASSERT_EQ(k2node_band_intersection_lazy_init(&lh, specs.data(),
+                                                 (uint32_t)specs.size()),
+              SUCCESS_ECODE_K2T);
+    std::vector<uint64_t> results;
+    int has_next;
+    for (k2node_band_intersection_has_next(&lh, &has_next); has_next;
+         k2node_band_intersection_has_next(&lh, &has_next)) {
+      uint64_t result;
+      ASSERT_EQ(k2node_band_intersection_next(&lh, &result),
+                SUCCESS_ECODE_K2T);
+      results.push_back(result);
+    }
+    ASSERT_EQ(results, expected);
+
+    k2node_band_intersection_reset(&lh);
+    if (!expected.empty()) {
+      uint64_t middle = expected[expected.size() / 2];
+      k2node_band_intersection_seek(&lh, middle);
+      uint64_t result;
+      k2node_band_intersection_next(&lh, &result);
+      ASSERT_EQ(result, middle);
+    }
+    k2node_band_intersection_lazy_clean(&lh);
+    for (auto &st : states)
+      clean_k2qstate(&st);
+  }
+
+  for (auto *tree : trees)
+    free_rec_k2node(tree, 0, build_st.cut_depth);
+  clean_k2qstate(&build_st);
+}
@@ -0,0 +1,449 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <morton_code.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+TEST(batch_operations_test, has_point_batch_matches_has_point) {
+  TREE_DEPTH_T treedepth = 10;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, MAX_NODES_IN_BLOCK, root);
+
+  std::mt19937 gen(1);
+  auto inserted = shuffled_random_points(5000, 1UL << treedepth, gen);
+  for (auto &p : inserted) {
+    int already_exists;
+    insert_point(root, p.col, p.row, &qs, &already_exists);
+  }
+
+  auto queries = shuffled_random_points(5000, 1UL << treedepth, gen);
+  queries.insert(queries.end(), inserted.begin(), inserted.begin() + 2000);
+
+  std::vector<int> results(queries.size(), -1);
+  ASSERT_EQ(has_point_batch(root, queries.data(), queries.size(), &qs,
+                            results.data()),
+            SUCCESS_ECODE_K2T);
+
+  for (size_t i = 0; i < queries.size(); i++) {
+    int expected;
+    has_point(root, queries[i].col, queries[i].row, &qs, &expected);
+    ASSERT_EQ(expected, results[i]) << "failed at query " << i;
+  }
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(batch_operations_test, has_point_batch_empty_tree) {
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, 8, MAX_NODES_IN_BLOCK, root);
+
+  std::mt19937 gen(3);
+  auto queries = shuffled_random_points(100, 1UL << 8, gen);
+  std::vector<int> results(queries.size(), -1);
+  has_point_batch(root, queries.data(), queries.size(), &qs, results.data());
+  for (int r : results) {
+    ASSERT_EQ(FALSE, r);
+  }
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(batch_operations_test, k2node_has_point_batch_matches_has_point) {
+  struct k2node *root = create_k2node();
+  struct k2qstate st;
+  init_k2qstate(&st, 32, 256, 10);
+
+  std::mt19937 gen(4);
+  auto inserted = shuffled_random_points(5000, 1UL << 20, gen);
+  for (auto &p : inserted) {
+    int already_exists;
+    k2node_insert_point(root, p.col, p.row, &st, &already_exists);
+  }
+
+  auto queries = shuffled_random_points(3000, 1UL << 20, gen);
+  queries.insert(queries.end(), inserted.begin(), inserted.end());
+
+  std::vector<int> results(queries.size(), -1);
+  k2node_has_point_batch(root, queries.data(), queries.size(), &st,
+                         results.data());
+
+  for (size_t i = 0; i < queries.size(); i++) {
+    int expected;
+    k2node_has_point(root, queries[i].col, queries[i].row, &st, &expected);
+    ASSERT_EQ(expected, results[i]) << "failed at query " << i;
+  }
+
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
+
+TEST(batch_operations_test, insert_points_batch_matches_insert_point) {
+  TREE_DEPTH_T treedepth = 10;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 256, root);
+
+  std::mt19937 gen(6);
+  auto previous = shuffled_random_points(1000, 1UL << treedepth, gen);
+  for (auto &p : previous) {
+    int already_exists;
+    insert_point(root, p.col, p.row, &qs, &already_exists);
+  }
+
+  /* points already in the tree and points repeated within the batch */
+  auto batch = shuffled_random_points(8000, 1UL << treedepth, gen);
+  batch.insert(batch.end(), previous.begin(), previous.begin() + 500);
+  std::vector<pair2dl_t> repeated(batch.begin(), batch.begin() + 300);
+  batch.insert(batch.end(), repeated.begin(), repeated.end());
+
+  uint64_t inserted_count;
+  ASSERT_EQ(insert_points_batch(root, batch.data(), batch.size(), &qs,
+                                &inserted_count),
+            SUCCESS_ECODE_K2T);
+
+  auto expected = as_set(previous);
+  uint64_t previous_size = expected.size();
+  auto batch_set = as_set(batch);
+  expected.insert(batch_set.begin(), batch_set.end());
+  ASSERT_EQ(expected.size() - previous_size, inserted_count);
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+  for (auto &p : expected) {
+    int exists;
+    has_point(root, p.first, p.second, &qs, &exists);
+    ASSERT_TRUE(exists) << "missing (" << p.first << ", " << p.second << ")";
+  }
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(batch_operations_test, insert_points_batch_many_batches) {
+  TREE_DEPTH_T treedepth = 12;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 128, root);
+
+  point_set expected;
+  for (unsigned int batch_i = 0; batch_i < 10; batch_i++) {
+    std::mt19937 gen(100 + batch_i);
+    auto batch = shuffled_random_points(3000, 1UL << treedepth, gen);
+    uint64_t inserted_count;
+    ASSERT_EQ(insert_points_batch(root, batch.data(), batch.size(), &qs,
+                                  &inserted_count),
+              SUCCESS_ECODE_K2T);
+    uint64_t previous_size = expected.size();
+    auto batch_set = as_set(batch);
+    expected.insert(batch_set.begin(), batch_set.end());
+    ASSERT_EQ(expected.size() - previous_size, inserted_count);
+  }
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(batch_operations_test, insert_points_batch_dense_square) {
+  TREE_DEPTH_T treedepth = 8;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, MAX_NODES_IN_BLOCK, root);
+
+  std::vector<pair2dl_t> batch;
+  for (uint64_t col = 0; col < 64; col++) {
+    for (uint64_t row = 0; row < 64; row++) {
+      pair2dl_t p;
+      p.col = col;
+      p.row = row;
+      batch.push_back(p);
+    }
+  }
+
+  uint64_t inserted_count;
+  insert_points_batch(root, batch.data(), batch.size(), &qs, &inserted_count);
+  ASSERT_EQ(batch.size(), inserted_count);
+  ASSERT_EQ(as_set(batch), scan_block_tree(root, &qs));
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(batch_operations_test, k2node_insert_points_batch_matches_insert_point) {
+  struct k2node *root = create_k2node();
+  struct k2qstate st;
+  init_k2qstate(&st, 32, 256, 10);
+
+  std::mt19937 gen(8);
+  auto previous = shuffled_random_points(2000, 1UL << 20, gen);
+  for (auto &p : previous) {
+    int already_exists;
+    k2node_insert_point(root, p.col, p.row, &st, &already_exists);
+  }
+
+  auto batch = shuffled_random_points(6000, 1UL << 20, gen);
+  batch.insert(batch.end(), previous.begin(), previous.begin() + 1000);
+
+  uint64_t inserted_count;
+  ASSERT_EQ(k2node_insert_points_batch(root, batch.data(), batch.size(), &st,
+                                       &inserted_count),
+            SUCCESS_ECODE_K2T);
+
+  auto expected = as_set(previous);
+  uint64_t previous_size = expected.size();
+  auto batch_set = as_set(batch);
+  expected.insert(batch_set.begin(), batch_set.end());
+  ASSERT_EQ(expected.size() - previous_size, inserted_count);
+
+  struct vector_pair2dl_t scanned;
+  vector_pair2dl_t__init_vector(&scanned);
+  k2node_naive_scan_points(root, &st, &scanned);
+  std::set<std::pair<uint64_t, uint64_t>> scanned_set;
+  for (int i = 0; i < scanned.nof_items; i++) {
+    scanned_set.insert({scanned.data[i].col, scanned.data[i].row});
+  }
+  vector_pair2dl_t__free_vector(&scanned);
+  ASSERT_EQ(expected, scanned_set);
+
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
+
+TEST(batch_operations_test, k2node_insert_points_parallel_matches_batch) {
+  for (int threads_count : {2, 4, 64}) {
+    struct k2node *root = create_k2node();
+    struct k2qstate st;
+    init_k2qstate(&st, 20, 256, 4);
+
+    std::mt19937 gen(10);
+    auto previous = shuffled_random_points(3000, 1UL << 20, gen);
+    uint64_t inserted_count;
+    k2node_insert_points_batch(root, previous.data(), previous.size(), &st,
+                               &inserted_count);
+
+    auto batch = shuffled_random_points(20000, 1UL << 20, gen);
+    batch.insert(batch.end(), previous.begin(), previous.begin() + 1500);
+    ASSERT_EQ(k2node_insert_points_parallel(root, batch.data(), batch.size(),
+                                            threads_count, &st,
+                                            &inserted_count),
+              SUCCESS_ECODE_K2T);
+
+    auto expected = as_set(previous);
+    uint64_t previous_size = expected.size();
+    auto batch_set = as_set(batch);
+    expected.insert(batch_set.begin(), batch_set.end());
+    ASSERT_EQ(expected.size() - previous_size, inserted_count);
+
+    struct vector_pair2dl_t scanned;
+    vector_pair2dl_t__init_vector(&scanned);
+    k2node_naive_scan_points(root, &st, &scanned);
+    ASSERT_EQ(expected, as_set(&scanned));
+    vector_pair2dl_t__free_vector(&scanned);
+    ASSERT_EQ(debug_validate_k2node_rec(root, &st, 0), 0);
+
+    free_rec_k2node(root, 0, st.cut_depth);
+    clean_k2qstate(&st);
+  }
+}
+
+static uint64_t block_points_count(struct block *root,
+                                   struct queries_state *qs) {
+  uint64_t count;
+  count_points(root, qs, &count);
+  return count;
+}
+
+TEST(batch_operations_test, delete_points_batch_matches_delete_point) {
+  TREE_DEPTH_T treedepth = 10;
+  for (MAX_NODE_COUNT_T max_nodes : {(MAX_NODE_COUNT_T)32,
+                                     (MAX_NODE_COUNT_T)256}) {
+    struct block *root = create_block();
+    struct queries_state qs;
+    init_queries_state(&qs, treedepth, max_nodes, root);
+
+    std::mt19937 gen(12);
+    auto previous = shuffled_random_points(8000, 1UL << treedepth, gen);
+    for (auto &p : previous) {
+      int already_exists;
+      insert_point(root, p.col, p.row, &qs, &already_exists);
+    }
+
+    /* half of the points, twice some of them and a few which don't exist */
+    std::vector<pair2dl_t> batch(previous.begin(),
+                                 previous.begin() + previous.size() / 2);
+    batch.insert(batch.end(), previous.begin(), previous.begin() + 100);
+    auto missing = shuffled_random_points(500, 1UL << treedepth, gen);
+    batch.insert(batch.end(), missing.begin(), missing.end());
+
+    auto expected = as_set(previous);
+    uint64_t previous_size = expected.size();
+    for (auto &p : batch) {
+      expected.erase({p.col, p.row});
+    }
+
+    uint64_t deleted_count;
+    ASSERT_EQ(delete_points_batch(root, batch.data(), batch.size(), &qs,
+                                  &deleted_count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(previous_size - expected.size(), deleted_count);
+    ASSERT_EQ(expected, scan_block_tree(root, &qs));
+    ASSERT_EQ(expected.size(), block_points_count(root, &qs));
+    ASSERT_EQ(debug_validate_block_rec(root), 0);
+    for (auto &p : batch) {
+      int exists;
+      has_point(root, p.col, p.row, &qs, &exists);
+      ASSERT_EQ(exists, (int)expected.count({p.col, p.row}));
+    }
+
+    /* the tree keeps working after the batch */
+    auto more = shuffled_random_points(2000, 1UL << treedepth, gen);
+    for (auto &p : more) {
+      int already_exists;
+      insert_point(root, p.col, p.row, &qs, &already_exists);
+      expected.insert({p.col, p.row});
+    }
+    ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+    std::vector<pair2dl_t> remaining;
+    for (auto &p : expected) {
+      pair2dl_t point;
+      point.col = p.first;
+      point.row = p.second;
+      remaining.push_back(point);
+    }
+    ASSERT_EQ(delete_points_batch(root, remaining.data(), remaining.size(),
+                                  &qs, &deleted_count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(expected.size(), deleted_count);
+    ASSERT_TRUE(scan_block_tree(root, &qs).empty());
+    ASSERT_EQ(0UL, block_points_count(root, &qs));
+
+    int already_exists;
+    insert_point(root, 5, 7, &qs, &already_exists);
+    ASSERT_FALSE(already_exists);
+    ASSERT_EQ(1UL, scan_block_tree(root, &qs).size());
+
+    free_rec_block(root);
+    finish_queries_state(&qs);
+  }
+}
+
+TEST(batch_operations_test, delete_points_batch_merges_children_blocks) {
+  TREE_DEPTH_T treedepth = 8;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 64, root);
+
+  std::vector<pair2dl_t> square;
+  for (uint64_t col = 0; col < 64; col++) {
+    for (uint64_t row = 0; row < 64; row++) {
+      pair2dl_t p;
+      p.col = col;
+      p.row = row;
+      square.push_back(p);
+    }
+  }
+  uint64_t count;
+  insert_points_batch(root, square.data(), square.size(), &qs, &count);
+  ASSERT_GT(root->children, 0);
+
+  /* leave a single point, the children blocks fit back in the root */
+  std::vector<pair2dl_t> batch(square.begin() + 1, square.end());
+  ASSERT_EQ(delete_points_batch(root, batch.data(), batch.size(), &qs, &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(batch.size(), count);
+  ASSERT_EQ(0, root->children);
+  ASSERT_EQ((int)treedepth, (int)root->nodes_count);
+  ASSERT_EQ(as_set(std::vector<pair2dl_t>(square.begin(), square.begin() + 1)),
+            scan_block_tree(root, &qs));
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(batch_operations_test, k2node_delete_points_batch_matches_delete_point) {
+  struct k2node *root = create_k2node();
+  struct k2qstate st;
+  init_k2qstate(&st, 20, 128, 6);
+
+  std::mt19937 gen(15);
+  auto previous = shuffled_random_points(20000, 1UL << 20, gen);
+  uint64_t count;
+  k2node_insert_points_batch(root, previous.data(), previous.size(), &st,
+                             &count);
+
+  std::vector<pair2dl_t> batch(previous.begin() + 5000, previous.end());
+  auto missing = shuffled_random_points(1000, 1UL << 20, gen);
+  batch.insert(batch.end(), missing.begin(), missing.end());
+
+  auto expected = as_set(previous);
+  uint64_t previous_size = expected.size();
+  for (auto &p : batch) {
+    expected.erase({p.col, p.row});
+  }
+
+  ASSERT_EQ(k2node_delete_points_batch(root, batch.data(), batch.size(), &st,
+                                       &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(previous_size - expected.size(), count);
+
+  struct vector_pair2dl_t scanned;
+  vector_pair2dl_t__init_vector(&scanned);
+  k2node_naive_scan_points(root, &st, &scanned);
+  std::set<std::pair<uint64_t, uint64_t>> scanned_set;
+  for (int i = 0; i < scanned.nof_items; i++) {
+    scanned_set.insert({scanned.data[i].col, scanned.data[i].row});
+  }
+  vector_pair2dl_t__free_vector(&scanned);
+  ASSERT_EQ(expected, scanned_set);
+  ASSERT_EQ(debug_validate_k2node_rec(root, &st, 0), 0);
+  ASSERT_EQ(k2node_count_points(root, &st, &count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(expected.size(), count);
+
+  ASSERT_EQ(k2node_delete_points_batch(root, previous.data(), previous.size(),
+                                       &st, &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(expected.size(), count);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(root->k2subtree.children[i], nullptr);
+  }
+
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
@@ -3,7 +3,9 @@
 #include "block_wrapper.hpp"
 
 #include <iostream>
+#include <random>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -161,4 +163,66 @@ TEST(write_bv_to_bv, test1) {
       ASSERT_EQ((int)rd1, -1);
       ASSERT_EQ((int)rd2, -1);
     }
-}
\ No newline at end of file
+}
+
+static bool reference_bit(const std::vector<BVCTYPE> &uarr, uint32_t pos) {
+  return (uarr[pos / BVCTYPE_BITS] >> (BVCTYPE_BITS - 1 - pos % BVCTYPE_BITS)) &
+         1;
+}
+
+static void reference_set(std::vector<BVCTYPE> &uarr, uint32_t pos,
+                          bool value) {
+  BVCTYPE mask = (BVCTYPE)1 << (BVCTYPE_BITS - 1 - pos % BVCTYPE_BITS);
+  BVCTYPE &word = uarr[pos / BVCTYPE_BITS];
+  word = value ? word | mask : word & ~mask;
+}
+
+TEST(shift_kernels, move_matches_bit_by_bit) {
+  std::mt19937_64 gen(17);
+  uint32_t words = 16;
+  std::uniform_int_distribution<uint32_t> pos_dist(0, words * BVCTYPE_BITS);
+  for (int round = 0; round < 20000; round++) {
+    std::vector<BVCTYPE> uarr(words), other(words);
+    for (uint32_t i = 0; i < words; i++) {
+      uarr[i] = (BVCTYPE)gen();
+      other[i] = (BVCTYPE)gen();
+    }
+    uint32_t src_from = pos_dist(gen);
+    uint32_t dst_from = pos_dist(gen);
+    if (round % 4 == 0) { /* nibble aligned, as the nodes */
+      src_from &= ~3u;
+      dst_from = std::min<uint32_t>(src_from + 4 * (uint32_t)(gen() % 64),
+                                    words * BVCTYPE_BITS);
+    }
+    uint32_t room = words * BVCTYPE_BITS - std::max(src_from, dst_from);
+    uint32_t length = pos_dist(gen) % (room + 1);
+
+    bool same_array = round % 2 == 0;
+    std::vector<BVCTYPE> expected = same_array ? uarr : other;
+    for (uint32_t i = 0; i < length; i++)
+      reference_set(expected, dst_from + i, reference_bit(uarr, src_from + i));
+
+    std::vector<BVCTYPE> &dst = same_array ? uarr : other;
+    bits_move_uarray(dst.data(), dst_from, uarr.data(), src_from, length);
+    ASSERT_EQ(dst, expected) << "src " << src_from << " dst " << dst_from
+                             << " length " << length;
+  }
+}
+
+TEST(shift_kernels, clear_matches_bit_by_bit) {
+  std::mt19937_64 gen(19);
+  uint32_t words = 8;
+  for (uint32_t from = 0; from <= words * BVCTYPE_BITS; from++) {
+    for (uint32_t length = 0; from + length <= words * BVCTYPE_BITS;
+         length += 3) {
+      std::vector<BVCTYPE> uarr(words);
+      for (auto &word : uarr)
+        word = (BVCTYPE)gen();
+      std::vector<BVCTYPE> expected = uarr;
+      for (uint32_t i = 0; i < length; i++)
+        reference_set(expected, from + i, false);
+      bits_clear_uarray(uarr.data(), from, length);
+      ASSERT_EQ(uarr, expected) << "from " << from << " length " << length;
+    }
+  }
+}
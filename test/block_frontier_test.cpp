@@ -0,0 +1,137 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <block_frontier.h>
+#include <block_topology.h>
+
+int find_insertion_point(struct block *input_block, uint32_t preorder);
+}
+
+static std::vector<uint32_t> random_preorders(size_t amount,
+                                              std::mt19937 &gen) {
+  std::uniform_int_distribution<uint32_t> dist(1, 4 * amount + 1);
+  std::set<uint32_t> unique;
+  while (unique.size() < amount) {
+    unique.insert(dist(gen));
+  }
+  return std::vector<uint32_t>(unique.begin(), unique.end());
+}
+
+static void init_frontier(struct block *b,
+                          const std::vector<uint32_t> &preorders) {
+  init_block_frontier(b);
+  init_block_topology(b, 0);
+  if (!preorders.empty()) {
+    init_block_frontier_with_capacity(b, preorders.size());
+  }
+  for (size_t i = 0; i < preorders.size(); i++) {
+    b->preorders[i] = (NODES_BV_T)preorders[i];
+  }
+  b->children = preorders.size();
+}
+
+static void free_frontier(struct block *b) {
+  free_block_frontier(b);
+  free_block_topology(b);
+}
+
+static std::vector<uint32_t> frontier_preorders(struct block *b) {
+  return std::vector<uint32_t>(b->preorders, b->preorders + b->children);
+}
+
+TEST(block_frontier_test, lookups_match_linear_search) {
+  std::mt19937 gen(1);
+  for (size_t amount : {0, 1, 2, 3, 7, 64, 300}) {
+    auto preorders = random_preorders(amount, gen);
+    struct block b;
+    init_frontier(&b, preorders);
+    uint32_t max_preorder = 4 * amount + 3;
+
+    for (uint32_t p = 0; p <= max_preorder; p++) {
+      auto upper = std::upper_bound(preorders.begin(), preorders.end(), p);
+      ASSERT_EQ(upper - preorders.begin(), find_insertion_point(&b, p));
+    }
+
+    /* increasing lookups, as done while traversing a block */
+    uint32_t fidx = 0;
+    for (uint32_t p = 0; p <= max_preorder; p++) {
+      int expected = std::binary_search(preorders.begin(), preorders.end(), p);
+      ASSERT_EQ(expected, frontier_check(&b, p, &fidx));
+      auto lower = std::lower_bound(preorders.begin(), preorders.end(), p);
+      if (lower != preorders.end()) {
+        ASSERT_EQ(lower - preorders.begin(), fidx);
+      }
+    }
+
+    free_frontier(&b);
+  }
+}
+
+TEST(block_frontier_test, fix_indexes_shifts_suffix) {
+  std::mt19937 gen(2);
+  auto preorders = random_preorders(200, gen);
+  for (uint32_t start : {0u, 1u, preorders[57], preorders[57] + 1, 100000u}) {
+    for (int delta : {-3, 0, 1}) {
+      struct block b;
+      init_frontier(&b, preorders);
+      ASSERT_EQ(SUCCESS_ECODE_K2T, fix_frontier_indexes(&b, start, delta));
+      std::vector<uint32_t> expected = preorders;
+      for (auto &p : expected) {
+        if (p >= start) {
+          p -= delta;
+        }
+      }
+      ASSERT_EQ(expected, frontier_preorders(&b));
+      free_frontier(&b);
+    }
+  }
+}
+
+TEST(block_frontier_test, collapse_removes_range) {
+  std::mt19937 gen(3);
+  auto preorders = random_preorders(100, gen);
+  std::uniform_int_distribution<uint32_t> dist(0, 410);
+  for (int i = 0; i < 200; i++) {
+    uint32_t from = dist(gen);
+    uint32_t to = from + dist(gen) % 50;
+    struct block b;
+    init_frontier(&b, preorders);
+    ASSERT_EQ(SUCCESS_ECODE_K2T, collapse_frontier_nodes(&b, from, to));
+    std::vector<uint32_t> expected;
+    for (auto p : preorders) {
+      if (p < from || p > to) {
+        expected.push_back(p);
+      }
+    }
+    ASSERT_EQ(expected, frontier_preorders(&b));
+    free_frontier(&b);
+  }
+}
@@ -0,0 +1,142 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <block_scan.h>
+#include <queries_state.h>
+
+int sequential_scan_child(struct block *input_block, uint32_t input_node_idx,
+                          uint32_t subtrees_to_skip,
+                          uint32_t *frontier_traversal_idx,
+                          TREE_DEPTH_T input_node_relative_depth,
+                          struct queries_state *qs, TREE_DEPTH_T block_depth);
+}
+
+static uint32_t read_node(struct block *b, uint32_t i) {
+  return BVCTYPE_NODE(b->container, i);
+}
+
+/* Depth in the tree of every node of the block */
+static std::vector<uint32_t> node_depths(struct block *b, uint32_t block_depth,
+                                         uint32_t treedepth) {
+  std::vector<uint32_t> depths(b->nodes_count);
+  std::vector<uint32_t> remaining;
+  uint32_t depth = block_depth;
+  uint32_t fidx = 0;
+  for (uint32_t i = 0; i < b->nodes_count; i++) {
+    depths[i] = depth;
+    bool is_frontier = fidx < b->children && b->preorders[fidx] == i;
+    if (is_frontier) {
+      fidx++;
+    }
+    uint32_t children = 0;
+    if (!is_frontier && depth + 1 < treedepth) {
+      children = __builtin_popcount(read_node(b, i));
+    }
+    if (children > 0) {
+      remaining.push_back(children);
+      depth++;
+    } else {
+      while (!remaining.empty() && --remaining.back() == 0) {
+        remaining.pop_back();
+        depth--;
+      }
+    }
+  }
+  return depths;
+}
+
+/* Compares the kernel against the node by node scan for every possible
+ * amount of subtrees to skip below every internal node */
+static void compare_scans(struct block *b, uint32_t block_depth,
+                          struct queries_state *qs) {
+  uint32_t treedepth = qs->treedepth;
+  auto depths = node_depths(b, block_depth, treedepth);
+  uint32_t fidx = 0;
+  for (uint32_t i = 0; i < b->nodes_count; i++) {
+    bool is_frontier = fidx < b->children && b->preorders[fidx] == i;
+    if (is_frontier) {
+      fidx++;
+      compare_scans(&b->children_blocks[fidx - 1], depths[i], qs);
+      continue;
+    }
+    if (depths[i] + 1 >= treedepth) {
+      continue;
+    }
+    uint32_t children = __builtin_popcount(read_node(b, i));
+    for (uint32_t skip = 1; skip <= children; skip++) {
+      uint32_t expected_fidx = fidx;
+      sequential_scan_child(b, i, skip, &expected_fidx, depths[i] - block_depth,
+                            qs, block_depth);
+      uint32_t expected = qs->sc_result.child_preorder;
+
+      uint32_t kernel_fidx = fidx;
+      uint32_t result = block_scan_skip_subtrees(
+          b, i + 1, skip, depths[i] + 1, treedepth, &kernel_fidx);
+      ASSERT_EQ(expected, result) << "node " << i << " skip " << skip;
+      ASSERT_EQ(expected_fidx, kernel_fidx) << "node " << i << " skip " << skip;
+    }
+  }
+}
+
+static void run_scan_comparison(TREE_DEPTH_T treedepth,
+                                MAX_NODE_COUNT_T max_nodes_count,
+                                int points_count, uint64_t side,
+                                unsigned int seed) {
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes_count, root);
+
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  for (int i = 0; i < points_count; i++) {
+    int already_exists;
+    insert_point(root, dist(gen), dist(gen), &qs, &already_exists);
+  }
+
+  compare_scans(root, 0, &qs);
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(block_scan_test, sparse_tree_matches_sequential_scan) {
+  run_scan_comparison(24, 256, 5000, 1UL << 24, 1);
+}
+
+TEST(block_scan_test, dense_tree_matches_sequential_scan) {
+  run_scan_comparison(10, 256, 20000, 1UL << 10, 2);
+}
+
+TEST(block_scan_test, big_blocks_match_sequential_scan) {
+  run_scan_comparison(20, 1024, 20000, 1UL << 14, 3);
+}
+
+TEST(block_scan_test, shallow_tree_matches_sequential_scan) {
+  run_scan_comparison(3, 256, 40, 8, 4);
+}
@@ -0,0 +1,317 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <morton_code.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+static void check_queries(struct block *root, struct queries_state *qs,
+                          const point_set &expected, uint64_t side,
+                          std::mt19937_64 &gen) {
+  for (auto &p : expected) {
+    int exists;
+    has_point(root, p.first, p.second, qs, &exists);
+    ASSERT_TRUE(exists);
+  }
+
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  for (int i = 0; i < 2000; i++) {
+    uint64_t col = dist(gen);
+    uint64_t row = dist(gen);
+    int exists;
+    has_point(root, col, row, qs, &exists);
+    ASSERT_EQ(expected.count({col, row}) > 0, (bool)exists);
+  }
+
+  for (int i = 0; i < 20; i++) {
+    uint64_t row = dist(gen);
+    point_set expected_row;
+    for (auto &p : expected) {
+      if (p.second == row) {
+        expected_row.insert(p);
+      }
+    }
+    struct vector_pair2dl_t result;
+    vector_pair2dl_t__init_vector(&result);
+    report_row(root, row, qs, &result);
+    ASSERT_EQ(expected_row, as_set(&result));
+    vector_pair2dl_t__free_vector(&result);
+  }
+}
+
+#ifdef BLOCK_SKIP_INDEX
+static int count_indexed_blocks(struct block *b) {
+  int result = b->skip_index != NULL;
+  for (int i = 0; i < (int)b->children; i++) {
+    result += count_indexed_blocks(&b->children_blocks[i]);
+  }
+  return result;
+}
+
+static int count_invalid_indexes(struct block *b) {
+  int result = debug_validate_skip_index(b);
+  for (int i = 0; i < (int)b->children; i++) {
+    result += count_invalid_indexes(&b->children_blocks[i]);
+  }
+  return result;
+}
+#endif
+
+/* The indexes updated along with the blocks must match rebuilt ones */
+static void check_indexes(struct block *root) {
+#ifdef BLOCK_SKIP_INDEX
+  ASSERT_EQ(count_invalid_indexes(root), 0);
+#else
+  (void)root;
+#endif
+}
+
+static uint32_t max_block_size(struct block *b) {
+  uint32_t result = b->nodes_count;
+  for (int i = 0; i < (int)b->children; i++) {
+    result = std::max(result, max_block_size(&b->children_blocks[i]));
+  }
+  return result;
+}
+
+static void insert_random_points(struct block *root, struct queries_state *qs,
+                                 point_set &expected, int points_count,
+                                 uint64_t side, std::mt19937_64 &gen) {
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  for (int i = 0; i < points_count; i++) {
+    uint64_t col = dist(gen);
+    uint64_t row = dist(gen);
+    int already_exists;
+    insert_point(root, col, row, qs, &already_exists);
+    ASSERT_EQ(expected.count({col, row}) > 0, (bool)already_exists);
+    expected.insert({col, row});
+  }
+}
+
+/*
+ * Blocks only get big below depth LEVEL_THRESHOLD_2, so the points are
+ * clustered in a corner of a deep tree to get blocks of up to max_nodes_count
+ * nodes, which are the ones the skip index is meant for
+ */
+static void run_big_blocks_test(MAX_NODE_COUNT_T max_nodes_count,
+                                int points_count, uint64_t side,
+                                unsigned int seed) {
+  TREE_DEPTH_T treedepth = 24;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes_count, root);
+
+  std::mt19937_64 gen(seed);
+  point_set expected;
+  insert_random_points(root, &qs, expected, points_count, side, gen);
+  ASSERT_GE(max_block_size(root), (uint32_t)SKIP_INDEX_MIN_NODES);
+
+  check_queries(root, &qs, expected, side, gen);
+#ifdef BLOCK_SKIP_INDEX
+  ASSERT_GT(count_indexed_blocks(root), 0);
+#endif
+  check_indexes(root);
+
+  /* updates keep the indexes in step with the blocks */
+  insert_random_points(root, &qs, expected, points_count / 4, side, gen);
+  check_indexes(root);
+  check_queries(root, &qs, expected, side, gen);
+  check_indexes(root);
+
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  std::vector<pair2dl_t> batch;
+  for (int j = 0; j < points_count / 4; j++) {
+    pair2dl_t p;
+    p.col = dist(gen);
+    p.row = dist(gen);
+    batch.push_back(p);
+    expected.insert({p.col, p.row});
+  }
+  uint64_t inserted_count;
+  insert_points_batch(root, batch.data(), batch.size(), &qs, &inserted_count);
+  check_indexes(root);
+  check_queries(root, &qs, expected, side, gen);
+
+  std::vector<std::pair<uint64_t, uint64_t>> to_delete;
+  int i = 0;
+  for (auto &p : expected) {
+    if (i++ % 3 == 0) {
+      to_delete.push_back(p);
+    }
+  }
+  for (auto &p : to_delete) {
+    int already_not_exists;
+    delete_point(root, p.first, p.second, &qs, &already_not_exists);
+    ASSERT_FALSE(already_not_exists);
+    expected.erase(p);
+  }
+  check_indexes(root);
+  check_queries(root, &qs, expected, side, gen);
+
+  batch.clear();
+  i = 0;
+  for (auto &p : expected) {
+    if (i++ % 2 == 0) {
+      batch.push_back({p.first, p.second});
+    }
+  }
+  for (auto &p : batch) {
+    expected.erase({p.col, p.row});
+  }
+  uint64_t deleted_count;
+  delete_points_batch(root, batch.data(), batch.size(), &qs, &deleted_count);
+  ASSERT_EQ(deleted_count, batch.size());
+  check_indexes(root);
+  check_queries(root, &qs, expected, side, gen);
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(block_skip_index_test, queries_with_1024_nodes_blocks) {
+  run_big_blocks_test(1024, 20000, 1UL << 12, 1);
+}
+
+TEST(block_skip_index_test, queries_with_4096_nodes_blocks) {
+  run_big_blocks_test(4096, 20000, 1UL << 12, 2);
+}
+
+/*
+ * Clustered points in a shallow tree are split in many small blocks, which
+ * are merged into big ones while the points are deleted one by one
+ */
+static void run_clustered_deletes_test(MAX_NODE_COUNT_T max_nodes_count,
+                                       unsigned int seed) {
+  TREE_DEPTH_T treedepth = 15;
+  uint64_t side = 1UL << treedepth;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes_count, root);
+
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<uint64_t> col_dist(0, side - 1);
+  std::uniform_int_distribution<uint64_t> row_dist(0, 63);
+  point_set expected;
+  for (int i = 0; i < 3000; i++) {
+    uint64_t col = col_dist(gen);
+    uint64_t row = row_dist(gen);
+    int already_exists;
+    insert_point(root, col, row, &qs, &already_exists);
+    expected.insert({col, row});
+  }
+
+  uint32_t max_merged_size = 0;
+  std::vector<std::pair<uint64_t, uint64_t>> to_delete(expected.begin(),
+                                                       expected.end());
+  std::shuffle(to_delete.begin(), to_delete.end(), gen);
+  for (size_t i = 0; i < to_delete.size(); i++) {
+    int already_not_exists;
+    delete_point(root, to_delete[i].first, to_delete[i].second, &qs,
+                 &already_not_exists);
+    ASSERT_FALSE(already_not_exists) << "deletion " << i;
+    expected.erase(to_delete[i]);
+    max_merged_size = std::max(max_merged_size, max_block_size(root));
+    check_indexes(root);
+    if (i % 100 == 0) {
+      for (auto &p : expected) {
+        int exists;
+        has_point(root, p.first, p.second, &qs, &exists);
+        ASSERT_TRUE(exists) << "deletion " << i;
+      }
+    }
+  }
+  ASSERT_GE(max_merged_size, (uint32_t)SKIP_INDEX_MIN_NODES);
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(block_skip_index_test, clustered_deletes_with_1024_nodes_blocks) {
+  for (unsigned int seed = 0; seed < 8; seed++) {
+    run_clustered_deletes_test(1024, seed);
+  }
+}
+
+TEST(block_skip_index_test, clustered_deletes_with_4096_nodes_blocks) {
+  for (unsigned int seed = 0; seed < 8; seed++) {
+    run_clustered_deletes_test(4096, seed);
+  }
+}
+
+/*
+ * Insertions index the blocks they split, so read-only queries find them
+ * ready, and read-only queries index the blocks of a tree which was never
+ * queried by a writable state
+ */
+TEST(block_skip_index_test, read_only_queries_use_the_index) {
+  TREE_DEPTH_T treedepth = 24;
+  uint64_t side = 1UL << 12;
+  struct block *root = create_block();
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, 4096, root);
+  std::mt19937_64 gen(3);
+  point_set expected;
+  insert_random_points(root, &qs, expected, 20000, side, gen);
+  finish_queries_state(&qs);
+#ifdef BLOCK_SKIP_INDEX
+  ASSERT_GT(count_indexed_blocks(root), 0);
+#endif
+  check_indexes(root);
+
+  struct query_ctx ctx;
+  init_query_ctx(&ctx, treedepth, root);
+  check_queries(root, &ctx.qs, expected, side, gen);
+  finish_query_ctx(&ctx);
+  check_indexes(root);
+
+  std::vector<pair2dl_t> sorted;
+  for (auto &p : expected) {
+    sorted.push_back({p.first, p.second});
+  }
+  sort_points_morton_order(sorted.data(), sorted.size());
+  struct block *built = build_block_tree_from_sorted(
+      sorted.data(), sorted.size(), treedepth, 4096);
+#ifdef BLOCK_SKIP_INDEX
+  ASSERT_EQ(count_indexed_blocks(built), 0);
+#endif
+  init_query_ctx(&ctx, treedepth, built);
+  check_queries(built, &ctx.qs, expected, side, gen);
+  finish_query_ctx(&ctx);
+#ifdef BLOCK_SKIP_INDEX
+  ASSERT_GT(count_indexed_blocks(built), 0);
+#endif
+  check_indexes(built);
+
+  free_rec_block(built);
+  free_rec_block(root);
+}
@@ -1412,4 +1412,46 @@ TEST(block_test, band_scan_test_2) {
   ASSERT_EQ(count, cols);
 
   vector_pair2dl_t__free_vector(&resulting_pairs);
-}
\ No newline at end of file
+}
+
+TEST(block_test, fixed_step_growth_policy) {
+  uint32_t treedepth = 16;
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<uint64_t> dist(0, (1UL << treedepth) - 1);
+  std::vector<std::pair<uint64_t, uint64_t>> points;
+  for (int i = 0; i < 20000; i++)
+    points.push_back({dist(gen), dist(gen)});
+
+  for (uint32_t growth_percent :
+       {(uint32_t)BLOCK_GROWTH_POWER_OF_TWO, 100U, 125U}) {
+    struct block *root_block = create_block();
+    struct queries_state qs {};
+    init_queries_state(&qs, treedepth, 256, root_block);
+    qs.block_growth_percent = growth_percent;
+
+    for (auto &p : points) {
+      int already_exists;
+      ASSERT_EQ(insert_point(root_block, p.first, p.second, &qs,
+                             &already_exists),
+                SUCCESS_ECODE_K2T);
+    }
+    ASSERT_EQ(debug_validate_block_rec(root_block), 0);
+    for (auto &p : points) {
+      int result;
+      has_point(root_block, p.first, p.second, &qs, &result);
+      ASSERT_TRUE(result) << "growth percent " << growth_percent;
+    }
+
+    /* shrinking after growing with slack */
+    for (size_t i = 0; i < points.size(); i += 2) {
+      int already_not_exists;
+      ASSERT_EQ(delete_point(root_block, points[i].first, points[i].second,
+                             &qs, &already_not_exists),
+                SUCCESS_ECODE_K2T);
+    }
+    ASSERT_EQ(debug_validate_block_rec(root_block), 0);
+
+    free_rec_block(root_block);
+    finish_queries_state(&qs);
+  }
+}
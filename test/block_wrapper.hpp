@@ -30,16 +30,132 @@ extern "C" {
 #include <block.h>
 #include <block_frontier.h>
 #include <block_topology.h>
+#include <morton_code.h>
 #include <queries_state.h>
 }
 
+#include <algorithm>
 #include <iostream>
+#include <random>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
+using point_set = std::set<std::pair<uint64_t, uint64_t>>;
+using point_list = std::vector<std::pair<uint64_t, uint64_t>>;
+
+/* amount distinct points in [0, side) x [0, side) */
+inline point_set random_point_set(size_t amount, uint64_t side,
+                                  std::mt19937 &gen) {
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  point_set points;
+  while (points.size() < amount)
+    points.insert({dist(gen), dist(gen)});
+  return points;
+}
+
+/* The points of random_point_set, sorted by column and then row */
+inline std::vector<pair2dl_t> random_points(size_t amount, uint64_t side,
+                                            std::mt19937 &gen) {
+  std::vector<pair2dl_t> points;
+  for (auto &p : random_point_set(amount, side, gen))
+    points.push_back({p.first, p.second});
+  return points;
+}
+
+/* random_points in random order */
+inline std::vector<pair2dl_t> shuffled_random_points(size_t amount,
+                                                    uint64_t side,
+                                                    std::mt19937 &gen) {
+  auto points = random_points(amount, side, gen);
+  std::shuffle(points.begin(), points.end(), gen);
+  return points;
+}
+
+/* random_points sorted in morton order, as the bulk loads take them */
+inline std::vector<pair2dl_t> morton_sorted_random_points(size_t amount,
+                                                         uint64_t side,
+                                                         std::mt19937 &gen) {
+  auto points = random_points(amount, side, gen);
+  sort_points_morton_order(points.data(), points.size());
+  return points;
+}
+
+inline point_set as_set(const std::vector<pair2dl_t> &points) {
+  point_set result;
+  for (auto &p : points)
+    result.insert({p.col, p.row});
+  return result;
+}
+
+inline point_set as_set(const struct vector_pair2dl_t *points) {
+  point_set result;
+  for (long i = 0; i < points->nof_items; i++)
+    result.insert({points->data[i].col, points->data[i].row});
+  return result;
+}
+
+/* The points of the block tree at root, found with naive_scan_points */
+inline point_set scan_block_tree(struct block *root,
+                                 struct queries_state *qs) {
+  struct vector_pair2dl_t scanned;
+  vector_pair2dl_t__init_vector(&scanned);
+  naive_scan_points(root, qs, &scanned);
+  point_set result = as_set(&scanned);
+  vector_pair2dl_t__free_vector(&scanned);
+  return result;
+}
+
+/* Inclusive rectangle of columns and rows */
+struct query_rect {
+  uint64_t col_lo, col_hi, row_lo, row_hi;
+};
+
+/* amount random rectangles, plus the whole tree, single cells, an empty one
+ * and one reaching past the tree */
+inline std::vector<query_rect> random_rects(size_t amount, uint64_t side,
+                                            std::mt19937 &gen) {
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  std::vector<query_rect> rects = {{0, side - 1, 0, side - 1},
+                                   {0, 0, 0, 0},
+                                   {side - 1, side - 1, side - 1, side - 1},
+                                   {5, 4, 0, side - 1},
+                                   {0, UINT64_MAX, 0, UINT64_MAX}};
+  for (size_t i = 0; i < amount; i++) {
+    uint64_t c1 = dist(gen), c2 = dist(gen), r1 = dist(gen), r2 = dist(gen);
+    rects.push_back({std::min(c1, c2), std::max(c1, c2), std::min(r1, r2),
+                     std::max(r1, r2)});
+  }
+  return rects;
+}
+
+/* The points inside r */
+inline point_set brute_force_range(const point_set &points,
+                                   const query_rect &r) {
+  point_set result;
+  for (auto &p : points)
+    if (p.first >= r.col_lo && p.first <= r.col_hi && p.second >= r.row_lo &&
+        p.second <= r.row_hi)
+      result.insert(p);
+  return result;
+}
+
+/* point_reporter_fun_t counting the points in the uint64_t report_state */
+inline void count_point(uint64_t, uint64_t, void *report_state) {
+  (*reinterpret_cast<uint64_t *>(report_state))++;
+}
+
+/* point_reporter_fun_t appending the points to the point_list report_state,
+ * in the order they are reported */
+inline void collect_point(uint64_t col, uint64_t row, void *report_state) {
+  reinterpret_cast<point_list *>(report_state)->emplace_back(col, row);
+}
+
 class BlockWrapper {
 
 public:
@@ -117,14 +233,15 @@ public:
   static string getStringRepBlock(struct block *a_block, bool separate) {
     stringstream ss;
 
-    uint32_t *container = a_block->container;
     uint32_t uint_bits = sizeof(uint32_t) * 8;
     uint32_t nodes_count = get_nodes_count(a_block);
     uint32_t used_bits = nodes_count * 4;
     uint32_t blocks_count = used_bits / uint_bits;
     uint32_t extra_bits = used_bits % uint_bits;
     for (uint32_t blockIndex = 0; blockIndex < blocks_count; blockIndex++) {
-      int currentBlock = container[blockIndex];
+      uint32_t currentBlock;
+      bits_read(a_block, blockIndex * uint_bits,
+                (blockIndex + 1) * uint_bits - 1, &currentBlock);
       pass_to_ss_bin(currentBlock, uint_bits, ss, separate);
       // ss << " - ";
     }
@@ -205,9 +322,12 @@ public:
     }
   }
 
-  uint32_t read_block(uint32_t index) { return b->container[index]; }
+  /* 32 bits at index * 32, whatever the container word is */
+  uint32_t read_block(uint32_t index) {
+    return bitsread(32 * index, 32 * index + 31);
+  }
 
-  uint32_t bv_size() { return b->container_size * 8 * sizeof(uint32_t); }
+  uint32_t bv_size() { return b->container_size * BVCTYPE_BITS; }
 
   void init_topology_debug(uint32_t size) { enlarge_block_size_to(b, size); }
 };
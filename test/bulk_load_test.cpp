@@ -0,0 +1,169 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+static void check_block_structure(struct block *b,
+                                  MAX_NODE_COUNT_T max_nodes_count) {
+  ASSERT_GT(b->nodes_count, 0);
+  ASSERT_LE(b->nodes_count, max_nodes_count);
+  for (int i = 0; i < (int)b->children; i++) {
+    ASSERT_GT(b->preorders[i], 0);
+    ASSERT_LT(b->preorders[i], b->nodes_count);
+    if (i > 0) {
+      ASSERT_LT(b->preorders[i - 1], b->preorders[i]);
+    }
+    check_block_structure(&b->children_blocks[i], max_nodes_count);
+  }
+}
+
+TEST(bulk_load_test, build_block_tree_matches_points) {
+  TREE_DEPTH_T treedepth = 14;
+  MAX_NODE_COUNT_T max_nodes_count = 256;
+  std::mt19937 gen(1);
+  auto points = morton_sorted_random_points(20000, 1UL << treedepth, gen);
+
+  struct block *root = build_block_tree_from_sorted(
+      points.data(), points.size(), treedepth, max_nodes_count);
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes_count, root);
+
+  check_block_structure(root, max_nodes_count);
+
+  struct vector_pair2dl_t scanned;
+  vector_pair2dl_t__init_vector(&scanned);
+  naive_scan_points(root, &qs, &scanned);
+  ASSERT_EQ(as_set(points), as_set(&scanned));
+  vector_pair2dl_t__free_vector(&scanned);
+
+  for (auto &p : points) {
+    int exists;
+    has_point(root, p.col, p.row, &qs, &exists);
+    ASSERT_TRUE(exists);
+  }
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(bulk_load_test, built_block_tree_supports_updates) {
+  TREE_DEPTH_T treedepth = 12;
+  MAX_NODE_COUNT_T max_nodes_count = 128;
+  std::mt19937 gen(2);
+  auto points = morton_sorted_random_points(10000, 1UL << treedepth, gen);
+
+  struct block *root = build_block_tree_from_sorted(
+      points.data(), points.size(), treedepth, max_nodes_count);
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes_count, root);
+
+  auto expected = as_set(points);
+  auto to_insert = morton_sorted_random_points(5000, 1UL << treedepth, gen);
+  for (auto &p : to_insert) {
+    int already_exists;
+    insert_point(root, p.col, p.row, &qs, &already_exists);
+    ASSERT_EQ(expected.count({p.col, p.row}) > 0, already_exists);
+    expected.insert({p.col, p.row});
+  }
+
+  for (size_t i = 0; i < points.size(); i += 2) {
+    int already_not_exists;
+    delete_point(root, points[i].col, points[i].row, &qs,
+                 &already_not_exists);
+    ASSERT_EQ(expected.count({points[i].col, points[i].row}) == 0,
+              already_not_exists);
+    expected.erase({points[i].col, points[i].row});
+  }
+
+  struct vector_pair2dl_t scanned;
+  vector_pair2dl_t__init_vector(&scanned);
+  naive_scan_points(root, &qs, &scanned);
+  ASSERT_EQ(expected, as_set(&scanned));
+  vector_pair2dl_t__free_vector(&scanned);
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(bulk_load_test, build_block_tree_empty) {
+  struct block *root = build_block_tree_from_sorted(NULL, 0, 8, 256);
+  struct queries_state qs;
+  init_queries_state(&qs, 8, 256, root);
+
+  int already_exists;
+  insert_point(root, 3, 5, &qs, &already_exists);
+  int exists;
+  has_point(root, 3, 5, &qs, &exists);
+  ASSERT_TRUE(exists);
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(bulk_load_test, k2node_build_from_sorted_matches_points) {
+  struct k2qstate st;
+  init_k2qstate(&st, 32, 256, 10);
+  std::mt19937 gen(4);
+  auto points = morton_sorted_random_points(20000, 1UL << 24, gen);
+
+  struct k2node *root = k2node_build_from_sorted(points.data(), points.size(),
+                                                 &st);
+
+  auto expected = as_set(points);
+  struct vector_pair2dl_t scanned;
+  vector_pair2dl_t__init_vector(&scanned);
+  k2node_naive_scan_points(root, &st, &scanned);
+  ASSERT_EQ(expected, as_set(&scanned));
+  vector_pair2dl_t__free_vector(&scanned);
+
+  auto to_insert = morton_sorted_random_points(2000, 1UL << 24, gen);
+  for (auto &p : to_insert) {
+    int already_exists;
+    k2node_insert_point(root, p.col, p.row, &st, &already_exists);
+    expected.insert({p.col, p.row});
+  }
+  for (size_t i = 0; i < points.size(); i += 3) {
+    int already_not_exists;
+    k2node_delete_point(root, points[i].col, points[i].row, &st,
+                        &already_not_exists);
+    expected.erase({points[i].col, points[i].row});
+  }
+
+  vector_pair2dl_t__init_vector(&scanned);
+  k2node_naive_scan_points(root, &st, &scanned);
+  ASSERT_EQ(expected, as_set(&scanned));
+  vector_pair2dl_t__free_vector(&scanned);
+
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
@@ -0,0 +1,319 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+static uint64_t brute_force_band(const point_set &points, uint64_t coord,
+                                 bool column) {
+  uint64_t result = 0;
+  for (auto &p : points)
+    if ((column ? p.first : p.second) == coord)
+      result++;
+  return result;
+}
+
+TEST(count_points_test, block_counts_match_brute_force) {
+  std::mt19937 gen(777);
+  uint32_t treedepth = 10;
+  uint64_t side = 1UL << treedepth;
+  BlockWrapper b(treedepth, 64);
+
+  /* a dense corner, so whole quadrants fall inside the rectangles */
+  point_set points = random_point_set(2000, side, gen);
+  for (uint64_t col = 0; col < 40; col++)
+    for (uint64_t row = 0; row < 40; row++)
+      points.insert({col, row});
+  for (auto &p : points)
+    b.insert(p.first, p.second);
+
+  uint64_t count;
+  ASSERT_EQ(count_points(b.get_root(), b.get_qs(), &count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, points.size());
+
+  for (auto &r : random_rects(200, side, gen)) {
+    ASSERT_EQ(count_range(b.get_root(), r.col_lo, r.col_hi, r.row_lo,
+                          r.row_hi, b.get_qs(), &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_range(points, r).size());
+  }
+
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  for (int i = 0; i < 100; i++) {
+    uint64_t coord = i < 40 ? (uint64_t)i : dist(gen);
+    ASSERT_EQ(count_column(b.get_root(), coord, b.get_qs(), &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_band(points, coord, true));
+    ASSERT_EQ(count_row(b.get_root(), coord, b.get_qs(), &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_band(points, coord, false));
+  }
+}
+
+TEST(count_points_test, k2node_counts_match_brute_force) {
+  std::mt19937 gen(8765);
+  TREE_DEPTH_T treedepth = 16;
+  TREE_DEPTH_T cutdepth = 6;
+  uint64_t side = 1UL << treedepth;
+
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 255, cutdepth);
+  struct k2node *root_node = create_k2node();
+
+  point_set points = random_point_set(5000, side, gen);
+  for (uint64_t col = 0; col < 64; col++)
+    for (uint64_t row = 1024; row < 1088; row++)
+      points.insert({col, row});
+  for (auto &p : points) {
+    int already_exists;
+    ASSERT_EQ(k2node_insert_point(root_node, p.first, p.second, &st,
+                                  &already_exists),
+              SUCCESS_ECODE_K2T);
+  }
+
+  uint64_t count;
+  ASSERT_EQ(k2node_count_points(root_node, &st, &count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, points.size());
+
+  auto rects = random_rects(200, side, gen);
+  rects.push_back({0, 63, 1024, 1087});
+  rects.push_back({0, 1023, 1024, 2047});
+  for (auto &r : rects) {
+    ASSERT_EQ(k2node_count_range(root_node, r.col_lo, r.col_hi, r.row_lo,
+                                 r.row_hi, &st, &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_range(points, r).size());
+  }
+
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  for (int i = 0; i < 100; i++) {
+    uint64_t col = i < 64 ? (uint64_t)i : dist(gen);
+    uint64_t row = i < 64 ? 1024 + (uint64_t)i : dist(gen);
+    ASSERT_EQ(k2node_count_column(root_node, col, &st, &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_band(points, col, true));
+    ASSERT_EQ(k2node_count_row(root_node, row, &st, &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_band(points, row, false));
+  }
+
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
+
+TEST(count_points_test, empty_tree_counts_nothing) {
+  BlockWrapper b(8);
+  uint64_t count = 1;
+  ASSERT_EQ(count_points(b.get_root(), b.get_qs(), &count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, 0UL);
+  count = 1;
+  ASSERT_EQ(count_range(b.get_root(), 0, 255, 0, 255, b.get_qs(), &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, 0UL);
+  count = 1;
+  ASSERT_EQ(count_row(b.get_root(), 3, b.get_qs(), &count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, 0UL);
+  count = 1;
+  ASSERT_EQ(count_column(b.get_root(), 3, b.get_qs(), &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, 0UL);
+}
+
+#ifdef POINT_COUNTS
+static void collect_block_counts(struct block *b, std::vector<uint64_t> &out) {
+  out.push_back(b->points_count);
+  for (int i = 0; i < (int)b->children; i++)
+    collect_block_counts(&b->children_blocks[i], out);
+}
+
+static void collect_k2node_counts(struct k2node *node, TREE_DEPTH_T depth,
+                                  TREE_DEPTH_T cut_depth,
+                                  std::vector<uint64_t> &out) {
+  out.push_back(node->points_count);
+  if (depth == cut_depth) {
+    if (node->k2subtree.block_child)
+      collect_block_counts(node->k2subtree.block_child, out);
+    return;
+  }
+  for (int i = 0; i < 4; i++)
+    if (node->k2subtree.children[i])
+      collect_k2node_counts(node->k2subtree.children[i], depth + 1, cut_depth,
+                            out);
+}
+#endif
+
+/* Every stored count must be the one a full recount gives */
+static void check_block_counts(struct block *root, struct queries_state *qs,
+                               const point_set &points) {
+  uint64_t count;
+  ASSERT_EQ(count_points(root, qs, &count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, points.size());
+#ifdef POINT_COUNTS
+  std::vector<uint64_t> kept, recounted;
+  collect_block_counts(root, kept);
+  ASSERT_EQ(refresh_points_count(root, 0, qs->treedepth), SUCCESS_ECODE_K2T);
+  collect_block_counts(root, recounted);
+  ASSERT_EQ(kept, recounted);
+#endif
+}
+
+static void check_k2node_counts(struct k2node *root, struct k2qstate *st,
+                                const point_set &points) {
+  uint64_t count;
+  ASSERT_EQ(k2node_count_points(root, st, &count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, points.size());
+#ifdef POINT_COUNTS
+  std::vector<uint64_t> kept, recounted;
+  collect_k2node_counts(root, 0, st->cut_depth, kept);
+  ASSERT_EQ(k2node_refresh_points_count(root, st->k2tree_depth, st->cut_depth),
+            SUCCESS_ECODE_K2T);
+  collect_k2node_counts(root, 0, st->cut_depth, recounted);
+  ASSERT_EQ(kept, recounted);
+#endif
+}
+
+TEST(count_points_test, block_counts_follow_modifications) {
+  std::mt19937 gen(4242);
+  uint32_t treedepth = 12;
+  uint64_t side = 1UL << treedepth;
+  /* small blocks, so the tree splits and merges often */
+  BlockWrapper b(treedepth, 64);
+
+  point_set points = random_point_set(3000, side, gen);
+  for (auto &p : points)
+    b.insert(p.first, p.second);
+  check_block_counts(b.get_root(), b.get_qs(), points);
+
+  std::vector<std::pair<uint64_t, uint64_t>> to_delete;
+  for (auto &p : points)
+    if (gen() % 2)
+      to_delete.push_back(p);
+  for (auto &p : to_delete) {
+    b.erase(p.first, p.second);
+    points.erase(p);
+  }
+  /* points that don't exist leave the counts as they are */
+  for (auto &p : random_point_set(200, side, gen)) {
+    if (points.count(p) == 0)
+      b.erase(p.first, p.second);
+  }
+  check_block_counts(b.get_root(), b.get_qs(), points);
+
+  point_set batch = random_point_set(2000, side, gen);
+  std::vector<pair2dl_t> batch_points;
+  for (auto &p : batch)
+    batch_points.push_back({p.first, p.second});
+  /* some of them are already in the tree */
+  for (auto &p : points)
+    if (batch_points.size() < 2500)
+      batch_points.push_back({p.first, p.second});
+  uint64_t inserted_count;
+  ASSERT_EQ(insert_points_batch(b.get_root(), batch_points.data(),
+                                batch_points.size(), b.get_qs(),
+                                &inserted_count),
+            SUCCESS_ECODE_K2T);
+  points.insert(batch.begin(), batch.end());
+  check_block_counts(b.get_root(), b.get_qs(), points);
+
+  uint64_t count;
+  for (auto &r : random_rects(100, side, gen)) {
+    ASSERT_EQ(count_range(b.get_root(), r.col_lo, r.col_hi, r.row_lo,
+                          r.row_hi, b.get_qs(), &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_range(points, r).size());
+  }
+}
+
+TEST(count_points_test, k2node_counts_follow_modifications) {
+  std::mt19937 gen(2424);
+  TREE_DEPTH_T treedepth = 14;
+  TREE_DEPTH_T cutdepth = 4;
+  uint64_t side = 1UL << treedepth;
+
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 64, cutdepth);
+  struct k2node *root_node = create_k2node();
+
+  point_set points = random_point_set(3000, side, gen);
+  int flag;
+  for (auto &p : points)
+    ASSERT_EQ(k2node_insert_point(root_node, p.first, p.second, &st, &flag),
+              SUCCESS_ECODE_K2T);
+  check_k2node_counts(root_node, &st, points);
+
+  std::vector<std::pair<uint64_t, uint64_t>> to_delete;
+  for (auto &p : points)
+    if (gen() % 3)
+      to_delete.push_back(p);
+  for (auto &p : to_delete) {
+    ASSERT_EQ(k2node_delete_point(root_node, p.first, p.second, &st, &flag),
+              SUCCESS_ECODE_K2T);
+    points.erase(p);
+  }
+  check_k2node_counts(root_node, &st, points);
+
+  point_set batch = random_point_set(2000, side, gen);
+  std::vector<pair2dl_t> batch_points;
+  for (auto &p : batch)
+    batch_points.push_back({p.first, p.second});
+  uint64_t inserted_count;
+  ASSERT_EQ(k2node_insert_points_parallel(root_node, batch_points.data(),
+                                          batch_points.size(), 4, &st,
+                                          &inserted_count),
+            SUCCESS_ECODE_K2T);
+  points.insert(batch.begin(), batch.end());
+  check_k2node_counts(root_node, &st, points);
+
+  uint64_t count;
+  for (auto &r : random_rects(100, side, gen)) {
+    ASSERT_EQ(k2node_count_range(root_node, r.col_lo, r.col_hi, r.row_lo,
+                                 r.row_hi, &st, &count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(count, brute_force_range(points, r).size());
+  }
+
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+
+  std::vector<pair2dl_t> sorted_points;
+  for (auto &p : points)
+    sorted_points.push_back({p.first, p.second});
+  sort_points_morton_order(sorted_points.data(), sorted_points.size());
+  init_k2qstate(&st, treedepth, 64, cutdepth);
+  root_node =
+      k2node_build_from_sorted(sorted_points.data(), sorted_points.size(), &st);
+  check_k2node_counts(root_node, &st, points);
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
@@ -0,0 +1,282 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <morton_code.h>
+#include <queries_state.h>
+#include <shared_tree.h>
+}
+
+#include "block_wrapper.hpp"
+
+/* Words of the containers beyond the nodes they hold */
+static uint64_t containers_slack(struct block *b) {
+  uint64_t needed = (4 * (uint64_t)b->nodes_count + BVCTYPE_BITS - 1) /
+                    BVCTYPE_BITS;
+  uint64_t slack = b->container_size - needed;
+  for (int i = 0; i < (int)b->children; i++)
+    slack += containers_slack(&b->children_blocks[i]);
+  return slack;
+}
+
+static struct block *build_tree(std::vector<pair2dl_t> points,
+                                TREE_DEPTH_T treedepth,
+                                MAX_NODE_COUNT_T max_nodes) {
+  sort_points_morton_order(points.data(), points.size());
+  return build_block_tree_from_sorted(points.data(), points.size(), treedepth,
+                                      max_nodes);
+}
+
+TEST(deferred_compaction_test, deletions_are_compacted_later) {
+  TREE_DEPTH_T treedepth = 16;
+  MAX_NODE_COUNT_T max_nodes = 128;
+  std::mt19937 gen(1);
+  auto points = shuffled_random_points(20000, 1UL << treedepth, gen);
+  struct block *root = build_tree(points, treedepth, max_nodes);
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes, root);
+  qs.deferred_compaction = TRUE;
+  ASSERT_EQ(containers_slack(root), 0UL);
+  uint64_t blocks_before = measure_tree_size(root).total_blocks;
+
+  point_set expected;
+  for (auto &p : points)
+    expected.insert({p.col, p.row});
+  for (size_t i = 0; i < 3 * points.size() / 4; i++) {
+    int already_not_exists;
+    ASSERT_EQ(delete_point(root, points[i].col, points[i].row, &qs,
+                           &already_not_exists),
+              SUCCESS_ECODE_K2T);
+    ASSERT_FALSE(already_not_exists);
+    expected.erase({points[i].col, points[i].row});
+  }
+
+  /* only the emptied blocks are gone, nothing was merged nor shrunk yet, but
+   * the tree is consistent */
+  ASSERT_GT(qs.compaction_candidates.nof_items, 0);
+  uint64_t blocks_deferred = measure_tree_size(root).total_blocks;
+  ASSERT_LE(blocks_deferred, blocks_before);
+  ASSERT_GT(containers_slack(root), 0UL);
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+  /* insertions reuse the room left by the deletions */
+  auto more = shuffled_random_points(2000, 1UL << treedepth, gen);
+  for (auto &p : more) {
+    int already_exists;
+    insert_point(root, p.col, p.row, &qs, &already_exists);
+    expected.insert({p.col, p.row});
+  }
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+  uint64_t pending_count;
+  ASSERT_EQ(compact_block_tree(root, &qs, 0, &pending_count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(pending_count, 0UL);
+  ASSERT_EQ(qs.compaction_candidates.nof_items, 0);
+  ASSERT_LT(measure_tree_size(root).total_blocks, blocks_deferred);
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+#ifdef POINT_COUNTS
+  uint64_t count;
+  count_points(root, &qs, &count);
+  ASSERT_EQ(count, expected.size());
+#endif
+  for (auto &p : points) {
+    int result;
+    has_point(root, p.col, p.row, &qs, &result);
+    ASSERT_EQ(result, (int)expected.count({p.col, p.row}));
+  }
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+/* Random deletions reach the same blocks again and again, the queue keeps
+ * few entries per block instead of one per deletion */
+TEST(deferred_compaction_test, queue_stays_within_the_blocks) {
+  TREE_DEPTH_T treedepth = 16;
+  MAX_NODE_COUNT_T max_nodes = 128;
+  std::mt19937 gen(5);
+  auto points = shuffled_random_points(20000, 1UL << treedepth, gen);
+  struct block *root = build_tree(points, treedepth, max_nodes);
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes, root);
+  qs.deferred_compaction = TRUE;
+  uint64_t blocks_before = measure_tree_size(root).total_blocks;
+
+  point_set expected;
+  for (auto &p : points)
+    expected.insert({p.col, p.row});
+  size_t deletions = 3 * points.size() / 4;
+  for (size_t i = 0; i < deletions; i++) {
+    int already_not_exists;
+    ASSERT_EQ(delete_point(root, points[i].col, points[i].row, &qs,
+                           &already_not_exists),
+              SUCCESS_ECODE_K2T);
+    expected.erase({points[i].col, points[i].row});
+    ASSERT_LE((uint64_t)qs.compaction_candidates.nof_items,
+              2 * blocks_before + COMPACTION_DEDUP_MIN_CANDIDATES)
+        << "deletion " << i;
+  }
+  ASSERT_LT((uint64_t)qs.compaction_candidates.nof_items, deletions / 4);
+
+  uint64_t pending_count;
+  ASSERT_EQ(compact_block_tree(root, &qs, 0, &pending_count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(pending_count, 0UL);
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(deferred_compaction_test, time_budget_compacts_in_steps) {
+  TREE_DEPTH_T treedepth = 14;
+  MAX_NODE_COUNT_T max_nodes = 64;
+  std::mt19937 gen(3);
+  auto points = shuffled_random_points(10000, 1UL << treedepth, gen);
+  struct block *root = build_tree(points, treedepth, max_nodes);
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes, root);
+  qs.deferred_compaction = TRUE;
+
+  point_set expected;
+  for (auto &p : points)
+    expected.insert({p.col, p.row});
+  for (size_t i = 0; i < points.size(); i += 2) {
+    int already_not_exists;
+    delete_point(root, points[i].col, points[i].row, &qs, &already_not_exists);
+    expected.erase({points[i].col, points[i].row});
+  }
+
+  uint64_t pending_count = qs.compaction_candidates.nof_items;
+  ASSERT_GT(pending_count, 1UL);
+  int steps = 0;
+  while (pending_count > 0) {
+    uint64_t previous_pending = pending_count;
+    ASSERT_EQ(compact_block_tree(root, &qs, 1, &pending_count),
+              SUCCESS_ECODE_K2T);
+    ASSERT_LT(pending_count, previous_pending);
+    steps++;
+    if (steps % 64 == 0) {
+      ASSERT_EQ(expected, scan_block_tree(root, &qs));
+    }
+  }
+  ASSERT_GT(steps, 1);
+  ASSERT_EQ(containers_slack(root), 0UL);
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(deferred_compaction_test, batch_deletion_merges_after_compaction) {
+  TREE_DEPTH_T treedepth = 16;
+  MAX_NODE_COUNT_T max_nodes = 128;
+  std::mt19937 gen(5);
+  auto points = shuffled_random_points(20000, 1UL << treedepth, gen);
+  struct block *root = build_tree(points, treedepth, max_nodes);
+  struct queries_state qs;
+  init_queries_state(&qs, treedepth, max_nodes, root);
+  qs.deferred_compaction = TRUE;
+
+  std::vector<pair2dl_t> batch(points.begin(),
+                               points.begin() + 3 * points.size() / 4);
+  point_set expected;
+  for (auto it = points.begin() + batch.size(); it != points.end(); it++)
+    expected.insert({it->col, it->row});
+
+  uint64_t count;
+  ASSERT_EQ(delete_points_batch(root, batch.data(), batch.size(), &qs, &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(batch.size(), count);
+  ASSERT_GT(qs.compaction_candidates.nof_items, 0);
+  ASSERT_GT(containers_slack(root), 0UL);
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+  uint64_t blocks_deferred = measure_tree_size(root).total_blocks;
+
+  uint64_t pending_count;
+  ASSERT_EQ(compact_block_tree(root, &qs, 0, &pending_count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(pending_count, 0UL);
+  ASSERT_LT(measure_tree_size(root).total_blocks, blocks_deferred);
+  ASSERT_EQ(containers_slack(root), 0UL);
+  ASSERT_EQ(debug_validate_block_rec(root), 0);
+  ASSERT_EQ(expected, scan_block_tree(root, &qs));
+
+  free_rec_block(root);
+  finish_queries_state(&qs);
+}
+
+TEST(deferred_compaction_test, shared_tree_background_compaction) {
+  TREE_DEPTH_T treedepth = 16;
+  struct shared_block_tree tree;
+  ASSERT_EQ(init_shared_block_tree(&tree, treedepth, 128), SUCCESS_ECODE_K2T);
+  std::mt19937 gen(4);
+  auto points = shuffled_random_points(20000, 1UL << treedepth, gen);
+  uint64_t count;
+  ASSERT_EQ(shared_tree_insert_points_batch(&tree, points.data(),
+                                            points.size(), &count),
+            SUCCESS_ECODE_K2T);
+
+  ASSERT_EQ(shared_tree_start_compaction(&tree, 1, 100), SUCCESS_ECODE_K2T);
+  ASSERT_TRUE(tree.writer_qs.deferred_compaction);
+  for (size_t i = 0; i < points.size(); i += 2) {
+    int already_not_exists;
+    ASSERT_EQ(shared_tree_delete_point(&tree, points[i].col, points[i].row,
+                                       &already_not_exists),
+              SUCCESS_ECODE_K2T);
+    ASSERT_FALSE(already_not_exists);
+  }
+  ASSERT_EQ(shared_tree_stop_compaction(&tree), SUCCESS_ECODE_K2T);
+  ASSERT_FALSE(tree.writer_qs.deferred_compaction);
+
+  uint64_t pending_count;
+  ASSERT_EQ(shared_tree_compact(&tree, 0, &pending_count), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(pending_count, 0UL);
+  ASSERT_EQ(debug_validate_block_rec(tree.root), 0);
+
+  struct query_ctx ctx;
+  init_shared_tree_query_ctx(&tree, &ctx);
+  for (size_t i = 0; i < points.size(); i++) {
+    int result;
+    shared_tree_has_point(&tree, points[i].col, points[i].row, &ctx, &result);
+    ASSERT_EQ(result, i % 2 == 1);
+  }
+  finish_query_ctx(&ctx);
+
+  /* stopping twice and freeing a running tree are fine */
+  ASSERT_EQ(shared_tree_stop_compaction(&tree), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(shared_tree_start_compaction(&tree, 1, 100), SUCCESS_ECODE_K2T);
+  ASSERT_EQ(free_shared_block_tree(&tree), SUCCESS_ECODE_K2T);
+}
@@ -25,6 +25,8 @@ furnished to do so, subject to the following conditions:
 IN THE SOFTWARE.
             */
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
 
 extern "C" {
 #include <block.h>
@@ -34,6 +36,8 @@ extern "C" {
 #include <queries_state.h>
 }
 
+#include "block_wrapper.hpp"
+
 TEST(k2node_delete_test, simple_test_1) {
 
   struct k2node *root_node = create_k2node();
@@ -118,4 +122,71 @@ TEST(k2node_delete_test, only_delete_existing_points_test) {
 
   free_rec_k2node(root_node, 0, st.cut_depth);
   clean_k2qstate(&st);
-}
\ No newline at end of file
+}
+/* (0, 0) and (64, 64) are under the same k2node of depth 1 and under
+ * different ones below it. Deleting the first one empties its k2nodes up to
+ * depth 2, and the k2node of depth 1 must stay for the second one */
+TEST(k2node_delete_test, keeps_k2nodes_with_one_child_left) {
+  struct k2node *root_node = create_k2node();
+
+  struct k2qstate st;
+  TREE_DEPTH_T treedepth = 8;
+  TREE_DEPTH_T cutdepth = 3;
+  init_k2qstate(&st, treedepth, 256, cutdepth);
+
+  int already_exists;
+  k2node_insert_point(root_node, 0, 0, &st, &already_exists);
+  k2node_insert_point(root_node, 64, 64, &st, &already_exists);
+
+  int already_not_exists;
+  ASSERT_EQ(k2node_delete_point(root_node, 0, 0, &st, &already_not_exists),
+            SUCCESS_ECODE_K2T);
+  ASSERT_FALSE(already_not_exists);
+
+  int does_exist;
+  k2node_has_point(root_node, 0, 0, &st, &does_exist);
+  ASSERT_FALSE(does_exist);
+  k2node_has_point(root_node, 64, 64, &st, &does_exist);
+  ASSERT_TRUE(does_exist);
+  ASSERT_EQ(debug_validate_k2node_rec(root_node, &st, 0), 0);
+
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
+
+TEST(k2node_delete_test, random_deletes_keep_the_other_points) {
+  TREE_DEPTH_T treedepth = 12;
+  TREE_DEPTH_T cutdepth = 6;
+  for (unsigned int seed = 0; seed < 4; seed++) {
+    struct k2node *root_node = create_k2node();
+    struct k2qstate st;
+    init_k2qstate(&st, treedepth, 256, cutdepth);
+
+    std::mt19937 gen(seed);
+    auto points = random_points(600, 1UL << treedepth, gen);
+    for (auto &p : points) {
+      int already_exists;
+      k2node_insert_point(root_node, p.col, p.row, &st, &already_exists);
+    }
+
+    std::shuffle(points.begin(), points.end(), gen);
+    for (size_t i = 0; i < points.size(); i++) {
+      int already_not_exists;
+      ASSERT_EQ(k2node_delete_point(root_node, points[i].col, points[i].row,
+                                    &st, &already_not_exists),
+                SUCCESS_ECODE_K2T);
+      ASSERT_FALSE(already_not_exists) << "deletion " << i;
+      if (i % 50 == 0) {
+        for (size_t j = i + 1; j < points.size(); j++) {
+          int does_exist;
+          k2node_has_point(root_node, points[j].col, points[j].row, &st,
+                           &does_exist);
+          ASSERT_TRUE(does_exist) << "deletion " << i << ", point " << j;
+        }
+      }
+    }
+
+    free_rec_k2node(root_node, 0, st.cut_depth);
+    clean_k2qstate(&st);
+  }
+}
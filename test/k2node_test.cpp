@@ -24,6 +24,7 @@ SOFTWARE.
 #include <algorithm>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <random>
 #include <utility>
 #include <vector>
 #include <inttypes.h>
@@ -361,3 +362,106 @@ TEST(k2node_tests, report_all_lazy_test_1) {
   free_rec_k2node(root_node, 0, st.cut_depth);
   clean_k2qstate(&st);
 }
+
+static void collect_batch(const pair2dl_t *points, uint64_t points_count,
+                          void *report_state) {
+  auto *collected =
+      reinterpret_cast<std::vector<std::pair<uint64_t, uint64_t>> *>(
+          report_state);
+  for (uint64_t i = 0; i < points_count; i++)
+    collected->push_back({points[i].col, points[i].row});
+}
+
+static std::vector<std::pair<uint64_t, uint64_t>>
+as_pairs(struct vector_pair2dl_t *v) {
+  std::vector<std::pair<uint64_t, uint64_t>> result;
+  for (long i = 0; i < v->nof_items; i++)
+    result.push_back({v->data[i].col, v->data[i].row});
+  return result;
+}
+
+TEST(k2node_tests, parallel_scans_match_sequential) {
+  TREE_DEPTH_T treedepth = 20;
+  TREE_DEPTH_T cutdepth = 4;
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 256, cutdepth);
+  struct k2node *root_node = create_k2node();
+
+  std::mt19937 gen(21);
+  std::uniform_int_distribution<uint64_t> dist(0, (1UL << treedepth) - 1);
+  /* a dense column and row so the band reports cross many block trees */
+  uint64_t band = 123456;
+  for (int i = 0; i < 20000; i++) {
+    int already_exists;
+    uint64_t col = dist(gen);
+    uint64_t row = dist(gen);
+    if (i % 10 == 0)
+      col = band;
+    if (i % 10 == 1)
+      row = band;
+    k2node_insert_point(root_node, col, row, &st, &already_exists);
+  }
+
+  struct k2qstate reader_st;
+  init_k2qstate_read_only(&reader_st, treedepth, cutdepth);
+
+  for (int threads_count : {1, 3, 8}) {
+    struct vector_pair2dl_t expected, parallel;
+    vector_pair2dl_t__init_vector(&expected);
+    vector_pair2dl_t__init_vector(&parallel);
+    k2node_naive_scan_points(root_node, &st, &expected);
+    ASSERT_EQ(k2node_naive_scan_points_parallel(root_node, &reader_st,
+                                                threads_count, &parallel),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(as_pairs(&expected), as_pairs(&parallel));
+
+    std::vector<std::pair<uint64_t, uint64_t>> batched;
+    ASSERT_EQ(k2node_scan_points_parallel_batched(
+                  root_node, &reader_st, threads_count, collect_batch,
+                  &batched),
+              SUCCESS_ECODE_K2T);
+    auto expected_pairs = as_pairs(&expected);
+    std::sort(expected_pairs.begin(), expected_pairs.end());
+    std::sort(batched.begin(), batched.end());
+    ASSERT_EQ(expected_pairs, batched);
+    vector_pair2dl_t__free_vector(&expected);
+    vector_pair2dl_t__free_vector(&parallel);
+
+    for (int which : {REPORT_COLUMN, REPORT_ROW}) {
+      vector_pair2dl_t__init_vector(&expected);
+      vector_pair2dl_t__init_vector(&parallel);
+      batched.clear();
+      if (which == REPORT_COLUMN) {
+        k2node_report_column(root_node, band, &st, &expected);
+        ASSERT_EQ(k2node_report_column_parallel(
+                      root_node, band, &reader_st, threads_count, &parallel),
+                  SUCCESS_ECODE_K2T);
+        ASSERT_EQ(k2node_report_column_parallel_batched(
+                      root_node, band, &reader_st, threads_count,
+                      collect_batch, &batched),
+                  SUCCESS_ECODE_K2T);
+      } else {
+        k2node_report_row(root_node, band, &st, &expected);
+        ASSERT_EQ(k2node_report_row_parallel(root_node, band, &reader_st,
+                                             threads_count, &parallel),
+                  SUCCESS_ECODE_K2T);
+        ASSERT_EQ(k2node_report_row_parallel_batched(
+                      root_node, band, &reader_st, threads_count,
+                      collect_batch, &batched),
+                  SUCCESS_ECODE_K2T);
+      }
+      ASSERT_GT(expected.nof_items, 1000);
+      ASSERT_EQ(as_pairs(&expected), as_pairs(&parallel));
+      auto band_pairs = as_pairs(&expected);
+      std::sort(band_pairs.begin(), band_pairs.end());
+      std::sort(batched.begin(), batched.end());
+      ASSERT_EQ(band_pairs, batched);
+      vector_pair2dl_t__free_vector(&expected);
+      vector_pair2dl_t__free_vector(&parallel);
+    }
+  }
+
+  clean_k2qstate(&reader_st);
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
@@ -260,3 +260,234 @@ TEST(lazy_scan_test, test_k2node_band_scan_1) {
   free_rec_k2node(root_node, 0, st.cut_depth);
   clean_k2qstate(&st);
 }
+
+static std::vector<pair2dl_t> seek_test_points(uint64_t band_row,
+                                               uint64_t band_col) {
+  std::mt19937 gen(4321);
+  std::uniform_int_distribution<uint64_t> dense(0, 511);
+  std::uniform_int_distribution<uint64_t> sparse(0, (1UL << 16) - 1);
+  std::vector<pair2dl_t> points;
+  for (int i = 0; i < 6000; i++) {
+    pair2dl_t p;
+    p.col = i % 2 ? dense(gen) : sparse(gen);
+    p.row = i % 3 ? dense(gen) : sparse(gen);
+    points.push_back(p);
+    if (i % 4 == 0) {
+      pair2dl_t in_row = {i % 8 ? dense(gen) : sparse(gen), band_row};
+      pair2dl_t in_col = {band_col, i % 8 ? dense(gen) : sparse(gen)};
+      points.push_back(in_row);
+      points.push_back(in_col);
+    }
+  }
+  sort_points_morton_order(points.data(), points.size());
+  points.erase(std::unique(points.begin(), points.end(),
+                           [](const pair2dl_t &lhs, const pair2dl_t &rhs) {
+                             return lhs.col == rhs.col && lhs.row == rhs.row;
+                           }),
+               points.end());
+  return points;
+}
+
+static std::vector<uint64_t> band_of(const std::vector<pair2dl_t> &points,
+                                     int which_report, uint64_t coord) {
+  std::vector<uint64_t> result;
+  for (auto &p : points) {
+    if (which_report == REPORT_ROW && p.row == coord)
+      result.push_back(p.col);
+    if (which_report == REPORT_COLUMN && p.col == coord)
+      result.push_back(p.row);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+/* Mixes next and seek calls, checking each result against the sorted points */
+template <typename Handler>
+static void check_naive_seek(Handler &&handler,
+                             const std::vector<pair2dl_t> &expected) {
+  std::mt19937 gen(99);
+  std::uniform_int_distribution<uint64_t> coord(0, (1UL << 16) - 1);
+  std::uniform_int_distribution<uint64_t> small_coord(0, 511);
+  size_t position = 0;
+  for (int i = 0; i < 3000; i++) {
+    if (i % 3 != 0) {
+      pair2dl_t target = {i % 2 ? coord(gen) : small_coord(gen),
+                          i % 5 ? small_coord(gen) : coord(gen)};
+      if (i % 7 == 0 && position < expected.size())
+        target = expected[position + (expected.size() - position) / 2];
+      handler.seek(target.col, target.row);
+      while (position < expected.size() &&
+             compare_points_morton_order(&expected[position], &target) < 0)
+        position++;
+    }
+    int has_next = handler.has_next();
+    ASSERT_EQ(has_next, (int)(position < expected.size()));
+    if (!has_next) {
+      handler.reset();
+      position = 0;
+      continue;
+    }
+    pair2dl_t result = handler.next();
+    ASSERT_EQ(result.col, expected[position].col);
+    ASSERT_EQ(result.row, expected[position].row);
+    position++;
+  }
+}
+
+template <typename Handler>
+static void check_band_seek(Handler &&handler,
+                            const std::vector<uint64_t> &expected) {
+  std::mt19937 gen(77);
+  std::uniform_int_distribution<uint64_t> coord(0, (1UL << 16) - 1);
+  std::uniform_int_distribution<uint64_t> small_coord(0, 600);
+  size_t position = 0;
+  for (int i = 0; i < 3000; i++) {
+    if (i % 3 != 0) {
+      uint64_t target = i % 4 ? small_coord(gen) : coord(gen);
+      if (i % 7 == 0 && position < expected.size())
+        target = expected[position + (expected.size() - position) / 2];
+      handler.seek(target);
+      while (position < expected.size() && expected[position] < target)
+        position++;
+    }
+    int has_next = handler.has_next();
+    ASSERT_EQ(has_next, (int)(position < expected.size()));
+    if (!has_next) {
+      handler.reset();
+      position = 0;
+      continue;
+    }
+    ASSERT_EQ(handler.next(), expected[position]);
+    position++;
+  }
+}
+
+struct BlockNaiveSeek {
+  struct lazy_handler_naive_scan_t *lh;
+  void seek(uint64_t col, uint64_t row) {
+    ASSERT_EQ(naive_scan_points_lazy_seek(lh, col, row), SUCCESS_ECODE_K2T);
+  }
+  int has_next() {
+    int result;
+    naive_scan_points_lazy_has_next(lh, &result);
+    return result;
+  }
+  pair2dl_t next() {
+    pair2dl_t result;
+    naive_scan_points_lazy_next(lh, &result);
+    return result;
+  }
+  void reset() { naive_scan_points_lazy_reset(lh); }
+};
+
+struct BlockBandSeek {
+  struct lazy_handler_report_band_t *lh;
+  void seek(uint64_t coord) {
+    ASSERT_EQ(report_band_seek(lh, coord), SUCCESS_ECODE_K2T);
+  }
+  int has_next() {
+    int result;
+    report_band_has_next(lh, &result);
+    return result;
+  }
+  uint64_t next() {
+    uint64_t result;
+    report_band_next(lh, &result);
+    return result;
+  }
+  void reset() { report_band_reset(lh); }
+};
+
+struct K2NodeNaiveSeek {
+  struct k2node_lazy_handler_naive_scan_t *lh;
+  void seek(uint64_t col, uint64_t row) {
+    ASSERT_EQ(k2node_naive_scan_points_lazy_seek(lh, col, row),
+              SUCCESS_ECODE_K2T);
+  }
+  int has_next() {
+    int result;
+    k2node_naive_scan_points_lazy_has_next(lh, &result);
+    return result;
+  }
+  pair2dl_t next() {
+    pair2dl_t result;
+    k2node_naive_scan_points_lazy_next(lh, &result);
+    return result;
+  }
+  void reset() { k2node_naive_scan_points_lazy_reset(lh); }
+};
+
+struct K2NodeBandSeek {
+  struct k2node_lazy_handler_report_band_t *lh;
+  void seek(uint64_t coord) {
+    ASSERT_EQ(k2node_report_band_seek(lh, coord), SUCCESS_ECODE_K2T);
+  }
+  int has_next() {
+    int result;
+    k2node_report_band_has_next(lh, &result);
+    return result;
+  }
+  uint64_t next() {
+    uint64_t result;
+    k2node_report_band_next(lh, &result);
+    return result;
+  }
+  void reset() { k2node_report_band_reset(lh); }
+};
+
+TEST(lazy_scan_test, test_seek_block) {
+  const uint64_t band_row = 37;
+  const uint64_t band_col = 300;
+  auto points = seek_test_points(band_row, band_col);
+  BlockWrapper b(16, 256);
+  for (auto &p : points)
+    b.insert(p.col, p.row);
+
+  struct lazy_handler_naive_scan_t lh;
+  naive_scan_points_lazy_init(b.get_root(), b.get_qs(), &lh);
+  check_naive_seek(BlockNaiveSeek{&lh}, points);
+  naive_scan_points_lazy_clean(&lh);
+
+  struct lazy_handler_report_band_t band_lh;
+  report_row_lazy_init(&band_lh, b.get_root(), b.get_qs(), band_row);
+  check_band_seek(BlockBandSeek{&band_lh},
+                  band_of(points, REPORT_ROW, band_row));
+  report_band_lazy_clean(&band_lh);
+
+  report_column_lazy_init(&band_lh, b.get_root(), b.get_qs(), band_col);
+  check_band_seek(BlockBandSeek{&band_lh},
+                  band_of(points, REPORT_COLUMN, band_col));
+  report_band_lazy_clean(&band_lh);
+}
+
+TEST(lazy_scan_test, test_seek_k2node) {
+  const uint64_t band_row = 37;
+  const uint64_t band_col = 300;
+  auto points = seek_test_points(band_row, band_col);
+
+  struct k2node *root_node = create_k2node();
+  struct k2qstate st;
+  init_k2qstate(&st, 16, 256, 6);
+  int already_exists;
+  for (auto &p : points)
+    k2node_insert_point(root_node, p.col, p.row, &st, &already_exists);
+
+  struct k2node_lazy_handler_naive_scan_t lh;
+  k2node_naive_scan_points_lazy_init(root_node, &st, &lh);
+  check_naive_seek(K2NodeNaiveSeek{&lh}, points);
+  k2node_naive_scan_points_lazy_clean(&lh);
+
+  struct k2node_lazy_handler_report_band_t band_lh;
+  k2node_report_row_lazy_init(&band_lh, root_node, &st, band_row);
+  check_band_seek(K2NodeBandSeek{&band_lh},
+                  band_of(points, REPORT_ROW, band_row));
+  k2node_report_band_lazy_clean(&band_lh);
+
+  k2node_report_column_lazy_init(&band_lh, root_node, &st, band_col);
+  check_band_seek(K2NodeBandSeek{&band_lh},
+                  band_of(points, REPORT_COLUMN, band_col));
+  k2node_report_band_lazy_clean(&band_lh);
+
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
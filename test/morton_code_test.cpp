@@ -54,4 +54,86 @@ TEST(test_morton_code, test_convert_back_1) {
   EXPECT_EQ(row_expected, result.row) << "ROW not matching";
 
   clean_morton_code(&mc);
-}
\ No newline at end of file
+}
+
+TEST(test_morton_code, test_sort_points_morton_order) {
+  TREE_DEPTH_T treedepth = 4;
+  std::vector<pair2dl_t> points;
+  for (uint64_t col = 0; col < 16; col++) {
+    for (uint64_t row = 0; row < 16; row++) {
+      points.push_back({col, row});
+    }
+  }
+  std::reverse(points.begin(), points.end());
+  sort_points_morton_order(points.data(), points.size());
+
+  struct morton_code mc;
+  init_morton_code(&mc, treedepth);
+  std::vector<uint64_t> keys;
+  for (auto &p : points) {
+    convert_coordinates_to_morton_code(p.col, p.row, treedepth, &mc);
+    uint64_t key = 0;
+    for (int i = 0; i < treedepth; i++) {
+      key = (key << 2) | get_code_at_morton_code(&mc, i);
+      ASSERT_EQ(get_code_at_morton_code(&mc, i),
+                MORTON_CODE_AT(p.col, p.row, treedepth, i));
+    }
+    keys.push_back(key);
+  }
+  clean_morton_code(&mc);
+
+  for (size_t i = 1; i < keys.size(); i++) {
+    ASSERT_LT(keys[i - 1], keys[i]);
+  }
+}
+
+TEST(test_morton_code, test_round_trip_all_depths) {
+  for (uint32_t treedepth = 1; treedepth <= 64; treedepth++) {
+    uint64_t mask = treedepth == 64 ? ~0UL : (1UL << treedepth) - 1;
+    uint64_t col = 0x9E3779B97F4A7C15UL & mask;
+    uint64_t row = 0xC2B2AE3D27D4EB4FUL & mask;
+
+    struct morton_code mc;
+    init_morton_code(&mc, treedepth);
+    convert_coordinates_to_morton_code(col, row, treedepth, &mc);
+
+    struct morton_code rebuilt;
+    init_morton_code(&rebuilt, treedepth);
+    for (uint32_t i = 0; i < treedepth; i++) {
+      ASSERT_EQ(get_code_at_morton_code(&mc, i),
+                MORTON_CODE_AT(col, row, treedepth, i));
+      add_element_morton_code(&rebuilt, i,
+                              (uint32_t)get_code_at_morton_code(&mc, i));
+    }
+
+    struct pair2dl result;
+    ASSERT_EQ(convert_morton_code_to_coordinates(&rebuilt, &result),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(result.col, col);
+    ASSERT_EQ(result.row, row);
+
+    for (uint32_t cut = 0; cut <= treedepth; cut++) {
+      convert_morton_code_to_coordinates_select_treedepth(&mc, &result, cut);
+      uint64_t expected_col = cut == 0 ? 0 : col >> (treedepth - cut);
+      uint64_t expected_row = cut == 0 ? 0 : row >> (treedepth - cut);
+      ASSERT_EQ(result.col, expected_col);
+      ASSERT_EQ(result.row, expected_row);
+    }
+    clean_morton_code(&rebuilt);
+    clean_morton_code(&mc);
+  }
+}
+
+TEST(test_morton_code, test_overwrite_level) {
+  struct morton_code mc;
+  init_morton_code(&mc, 4);
+  convert_coordinates_to_morton_code(15, 15, 4, &mc);
+  add_element_morton_code(&mc, 1, 0);
+  add_element_morton_code(&mc, 3, 2);
+
+  struct pair2dl result;
+  convert_morton_code_to_coordinates(&mc, &result);
+  EXPECT_EQ(result.col, 11UL);
+  EXPECT_EQ(result.row, 10UL);
+  clean_morton_code(&mc);
+}
@@ -0,0 +1,248 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <queries_state.h>
+#include <shared_tree.h>
+}
+
+#include "block_wrapper.hpp"
+
+TEST(query_ctx_test, answers_same_as_queries_state) {
+  std::mt19937 gen(1);
+  uint32_t treedepth = 14;
+  BlockWrapper b(treedepth, 256);
+  auto points = random_points(5000, 1UL << treedepth, gen);
+  for (auto &p : points)
+    b.insert(p.col, p.row);
+
+  struct query_ctx ctx;
+  ASSERT_EQ(init_query_ctx(&ctx, treedepth, b.get_root()), SUCCESS_ECODE_K2T);
+
+  for (auto &p : points) {
+    int result;
+    ASSERT_EQ(has_point(b.get_root(), p.col, p.row, &ctx.qs, &result),
+              SUCCESS_ECODE_K2T);
+    ASSERT_TRUE(result);
+    ASSERT_EQ(has_point(b.get_root(), p.col ^ 1, p.row, &ctx.qs, &result),
+              SUCCESS_ECODE_K2T);
+    int expected;
+    has_point(b.get_root(), p.col ^ 1, p.row, b.get_qs(), &expected);
+    ASSERT_EQ(result, expected);
+  }
+
+  struct vector_pair2dl_t scanned;
+  vector_pair2dl_t__init_vector(&scanned);
+  ASSERT_EQ(naive_scan_points(b.get_root(), &ctx.qs, &scanned),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ((size_t)scanned.nof_items, points.size());
+  vector_pair2dl_t__free_vector(&scanned);
+
+  uint64_t in_range = 0;
+  ASSERT_EQ(report_range_interactively(b.get_root(), 0, 5000, 0, 5000,
+                                       &ctx.qs, count_point, &in_range),
+            SUCCESS_ECODE_K2T);
+  uint64_t expected_in_range = 0;
+  for (auto &p : points)
+    expected_in_range += p.col <= 5000 && p.row <= 5000;
+  ASSERT_EQ(in_range, expected_in_range);
+
+  ASSERT_EQ(finish_query_ctx(&ctx), SUCCESS_ECODE_K2T);
+}
+
+TEST(query_ctx_test, rejects_modifications) {
+  BlockWrapper b(10);
+  b.insert(3, 4);
+
+  struct query_ctx ctx;
+  init_query_ctx(&ctx, 10, b.get_root());
+  int flag;
+  ASSERT_EQ(insert_point(b.get_root(), 5, 5, &ctx.qs, &flag),
+            READ_ONLY_QUERY_CONTEXT);
+  ASSERT_EQ(delete_point(b.get_root(), 3, 4, &ctx.qs, &flag),
+            READ_ONLY_QUERY_CONTEXT);
+  pair2dl_t batch[2] = {{1, 1}, {2, 2}};
+  uint64_t inserted;
+  ASSERT_EQ(insert_points_batch(b.get_root(), batch, 2, &ctx.qs, &inserted),
+            READ_ONLY_QUERY_CONTEXT);
+
+  has_point(b.get_root(), 3, 4, &ctx.qs, &flag);
+  ASSERT_TRUE(flag);
+  has_point(b.get_root(), 5, 5, &ctx.qs, &flag);
+  ASSERT_FALSE(flag);
+  finish_query_ctx(&ctx);
+}
+
+TEST(query_ctx_test, concurrent_readers_on_block_tree) {
+  std::mt19937 gen(2);
+  uint32_t treedepth = 16;
+  BlockWrapper b(treedepth, 1024);
+  auto points = random_points(20000, 1UL << treedepth, gen);
+  for (auto &p : points)
+    b.insert(p.col, p.row);
+
+  const int threads_count = 8;
+  std::vector<int> found(threads_count, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threads_count; t++) {
+    threads.emplace_back([&, t]() {
+      struct query_ctx ctx;
+      init_query_ctx(&ctx, treedepth, b.get_root());
+      for (size_t i = t; i < points.size(); i += 2) {
+        int result;
+        has_point(b.get_root(), points[i].col, points[i].row, &ctx.qs,
+                  &result);
+        found[t] += result;
+      }
+      finish_query_ctx(&ctx);
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+  for (int t = 0; t < threads_count; t++) {
+    ASSERT_EQ((size_t)found[t], (points.size() - t + 1) / 2);
+  }
+}
+
+TEST(query_ctx_test, concurrent_readers_on_k2node_tree) {
+  std::mt19937 gen(3);
+  TREE_DEPTH_T treedepth = 20;
+  TREE_DEPTH_T cutdepth = 8;
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 256, cutdepth);
+  struct k2node *root = create_k2node();
+  auto points = random_points(20000, 1UL << treedepth, gen);
+  for (auto &p : points) {
+    int already_exists;
+    k2node_insert_point(root, p.col, p.row, &st, &already_exists);
+  }
+
+  const int threads_count = 4;
+  std::vector<int> found(threads_count, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threads_count; t++) {
+    threads.emplace_back([&, t]() {
+      struct k2qstate reader_st;
+      init_k2qstate_read_only(&reader_st, treedepth, cutdepth);
+      for (auto &p : points) {
+        int result;
+        k2node_has_point(root, p.col, p.row, &reader_st, &result);
+        found[t] += result;
+      }
+      clean_k2qstate(&reader_st);
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+  for (int t = 0; t < threads_count; t++) {
+    ASSERT_EQ((size_t)found[t], points.size());
+  }
+
+  struct k2qstate reader_st;
+  init_k2qstate_read_only(&reader_st, treedepth, cutdepth);
+  int flag;
+  ASSERT_EQ(k2node_insert_point(root, 1, 1, &reader_st, &flag),
+            READ_ONLY_QUERY_CONTEXT);
+  clean_k2qstate(&reader_st);
+
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
+
+TEST(query_ctx_test, shared_tree_mixed_workload) {
+  std::mt19937 gen(4);
+  uint32_t treedepth = 16;
+  struct shared_block_tree tree;
+  ASSERT_EQ(init_shared_block_tree(&tree, treedepth, 256), SUCCESS_ECODE_K2T);
+
+  auto points = random_points(10000, 1UL << treedepth, gen);
+  std::vector<pair2dl_t> first_half(points.begin(),
+                                    points.begin() + points.size() / 2);
+  uint64_t inserted;
+  ASSERT_EQ(shared_tree_insert_points_batch(&tree, first_half.data(),
+                                            first_half.size(), &inserted),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(inserted, first_half.size());
+
+  std::thread writer([&]() {
+    for (size_t i = points.size() / 2; i < points.size(); i++) {
+      int already_exists;
+      shared_tree_insert_point(&tree, points[i].col, points[i].row,
+                               &already_exists);
+    }
+  });
+
+  const int readers_count = 4;
+  std::vector<int> readers_ok(readers_count, TRUE);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < readers_count; t++) {
+    readers.emplace_back([&, t]() {
+      struct query_ctx ctx;
+      init_shared_tree_query_ctx(&tree, &ctx);
+      for (auto &p : first_half) {
+        int result;
+        if (shared_tree_has_point(&tree, p.col, p.row, &ctx, &result) !=
+                SUCCESS_ECODE_K2T ||
+            !result) {
+          readers_ok[t] = FALSE;
+        }
+      }
+      finish_query_ctx(&ctx);
+    });
+  }
+  writer.join();
+  for (auto &th : readers)
+    th.join();
+  for (int t = 0; t < readers_count; t++) {
+    ASSERT_TRUE(readers_ok[t]);
+  }
+
+  struct query_ctx ctx;
+  init_shared_tree_query_ctx(&tree, &ctx);
+  uint64_t total = 0;
+  ASSERT_EQ(shared_tree_report_range_interactively(
+                &tree, 0, UINT64_MAX, 0, UINT64_MAX, &ctx, count_point, &total),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(total, points.size());
+
+  int already_not_exists;
+  ASSERT_EQ(shared_tree_delete_point(&tree, points[0].col, points[0].row,
+                                     &already_not_exists),
+            SUCCESS_ECODE_K2T);
+  ASSERT_FALSE(already_not_exists);
+  int result;
+  shared_tree_has_point(&tree, points[0].col, points[0].row, &ctx, &result);
+  ASSERT_FALSE(result);
+  finish_query_ctx(&ctx);
+
+  ASSERT_EQ(free_shared_block_tree(&tree), SUCCESS_ECODE_K2T);
+}
@@ -0,0 +1,271 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+/* Random bands with repetitions, plus an empty set, a single band and
+ * coordinates outside the tree */
+static std::vector<std::vector<uint64_t>> random_bands(size_t amount,
+                                                       uint64_t side,
+                                                       std::mt19937 &gen) {
+  std::uniform_int_distribution<uint64_t> dist(0, side - 1);
+  std::uniform_int_distribution<size_t> size_dist(1, 40);
+  std::vector<std::vector<uint64_t>> bands = {
+      {}, {0}, {side - 1, side, UINT64_MAX, side - 1}};
+  for (size_t i = 0; i < amount; i++) {
+    std::vector<uint64_t> coords;
+    size_t size = size_dist(gen);
+    for (size_t j = 0; j < size; j++)
+      coords.push_back(dist(gen));
+    coords.push_back(coords[0]);
+    bands.push_back(coords);
+  }
+  return bands;
+}
+
+static point_set brute_force_bands(const point_set &points,
+                                   const std::vector<uint64_t> &coords,
+                                   int which_report) {
+  std::set<uint64_t> wanted(coords.begin(), coords.end());
+  point_set result;
+  for (auto &p : points)
+    if (wanted.count(which_report == REPORT_ROW ? p.second : p.first))
+      result.insert(p);
+  return result;
+}
+
+static uint64_t morton_key(uint64_t col, uint64_t row) {
+  uint64_t key = 0;
+  for (int bit = 31; bit >= 0; bit--)
+    key = (key << 2) | (((col >> bit) & 1UL) << 1) | ((row >> bit) & 1UL);
+  return key;
+}
+
+static void check_collected(const point_list &collected,
+                            const point_set &expected) {
+  ASSERT_EQ(collected.size(), expected.size());
+  ASSERT_EQ(point_set(collected.begin(), collected.end()), expected);
+  for (size_t i = 1; i < collected.size(); i++)
+    ASSERT_LT(morton_key(collected[i - 1].first, collected[i - 1].second),
+              morton_key(collected[i].first, collected[i].second));
+}
+
+static void check_vector(struct vector_pair2dl_t *result,
+                         const point_set &expected) {
+  point_list collected;
+  for (int i = 0; i < result->nof_items; i++)
+    collect_point(result->data[i].col, result->data[i].row, &collected);
+  check_collected(collected, expected);
+}
+
+TEST(report_bands_test, block_matches_brute_force) {
+  std::mt19937 gen(2468);
+  uint32_t treedepth = 10;
+  uint64_t side = 1UL << treedepth;
+  BlockWrapper b(treedepth, 128);
+
+  point_set points = random_point_set(4000, side, gen);
+  for (auto &p : points)
+    b.insert(p.first, p.second);
+
+  for (auto &coords : random_bands(100, side, gen)) {
+    for (int which_report : {REPORT_ROW, REPORT_COLUMN}) {
+      point_set expected = brute_force_bands(points, coords, which_report);
+
+      struct vector_pair2dl_t result;
+      vector_pair2dl_t__init_vector(&result);
+      if (which_report == REPORT_ROW)
+        ASSERT_EQ(report_rows(b.get_root(), coords.data(), coords.size(),
+                              b.get_qs(), &result),
+                  SUCCESS_ECODE_K2T);
+      else
+        ASSERT_EQ(report_columns(b.get_root(), coords.data(), coords.size(),
+                                 b.get_qs(), &result),
+                  SUCCESS_ECODE_K2T);
+      check_vector(&result, expected);
+      vector_pair2dl_t__free_vector(&result);
+
+      point_list reported;
+      if (which_report == REPORT_ROW)
+        ASSERT_EQ(report_rows_interactively(b.get_root(), coords.data(),
+                                            coords.size(), b.get_qs(),
+                                            collect_point, &reported),
+                  SUCCESS_ECODE_K2T);
+      else
+        ASSERT_EQ(report_columns_interactively(b.get_root(), coords.data(),
+                                               coords.size(), b.get_qs(),
+                                               collect_point, &reported),
+                  SUCCESS_ECODE_K2T);
+      check_collected(reported, expected);
+
+      struct lazy_handler_report_bands_t lh;
+      if (which_report == REPORT_ROW)
+        report_rows_lazy_init(&lh, b.get_root(), b.get_qs(), coords.data(),
+                              coords.size());
+      else
+        report_columns_lazy_init(&lh, b.get_root(), b.get_qs(), coords.data(),
+                                 coords.size());
+      for (int pass = 0; pass < 2; pass++) {
+        point_list lazy_points;
+        for (;;) {
+          int has_next;
+          report_bands_has_next(&lh, &has_next);
+          if (!has_next)
+            break;
+          pair2dl_t p;
+          report_bands_next(&lh, &p);
+          collect_point(p.col, p.row, &lazy_points);
+        }
+        check_collected(lazy_points, expected);
+        report_bands_reset(&lh);
+      }
+      report_bands_lazy_clean(&lh);
+    }
+  }
+}
+
+TEST(report_bands_test, k2node_matches_brute_force) {
+  std::mt19937 gen(8642);
+  TREE_DEPTH_T treedepth = 16;
+  TREE_DEPTH_T cutdepth = 6;
+
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 255, cutdepth);
+  struct k2node *root_node = create_k2node();
+
+  /* few distinct rows and columns, so the bands are not empty */
+  std::uniform_int_distribution<uint64_t> dist(0, 255);
+  point_set points;
+  while (points.size() < 5000)
+    points.insert({dist(gen) * 257, dist(gen) * 257});
+  for (auto &p : points) {
+    int already_exists;
+    ASSERT_EQ(k2node_insert_point(root_node, p.first, p.second, &st,
+                                  &already_exists),
+              SUCCESS_ECODE_K2T);
+  }
+
+  for (auto coords : random_bands(100, 256, gen)) {
+    for (auto &coord : coords)
+      if (coord < 256)
+        coord *= 257;
+    for (int which_report : {REPORT_ROW, REPORT_COLUMN}) {
+      point_set expected = brute_force_bands(points, coords, which_report);
+
+      struct vector_pair2dl_t result;
+      vector_pair2dl_t__init_vector(&result);
+      if (which_report == REPORT_ROW)
+        ASSERT_EQ(k2node_report_rows(root_node, coords.data(), coords.size(),
+                                     &st, &result),
+                  SUCCESS_ECODE_K2T);
+      else
+        ASSERT_EQ(k2node_report_columns(root_node, coords.data(),
+                                        coords.size(), &st, &result),
+                  SUCCESS_ECODE_K2T);
+      check_vector(&result, expected);
+      vector_pair2dl_t__free_vector(&result);
+
+      point_list reported;
+      if (which_report == REPORT_ROW)
+        ASSERT_EQ(k2node_report_rows_interactively(root_node, coords.data(),
+                                                   coords.size(), &st,
+                                                   collect_point, &reported),
+                  SUCCESS_ECODE_K2T);
+      else
+        ASSERT_EQ(k2node_report_columns_interactively(
+                      root_node, coords.data(), coords.size(), &st,
+                      collect_point, &reported),
+                  SUCCESS_ECODE_K2T);
+      check_collected(reported, expected);
+
+      struct k2node_lazy_handler_report_bands_t lh;
+      if (which_report == REPORT_ROW)
+        k2node_report_rows_lazy_init(&lh, root_node, &st, coords.data(),
+                                     coords.size());
+      else
+        k2node_report_columns_lazy_init(&lh, root_node, &st, coords.data(),
+                                        coords.size());
+      for (int pass = 0; pass < 2; pass++) {
+        point_list lazy_points;
+        for (;;) {
+          int has_next;
+          k2node_report_bands_has_next(&lh, &has_next);
+          if (!has_next)
+            break;
+          pair2dl_t p;
+          k2node_report_bands_next(&lh, &p);
+          collect_point(p.col, p.row, &lazy_points);
+        }
+        check_collected(lazy_points, expected);
+        k2node_report_bands_reset(&lh);
+      }
+      k2node_report_bands_lazy_clean(&lh);
+    }
+  }
+
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
+
+TEST(report_bands_test, matches_single_band_reports) {
+  std::mt19937 gen(1357);
+  uint32_t treedepth = 8;
+  uint64_t side = 1UL << treedepth;
+  BlockWrapper b(treedepth, 32);
+
+  point_set points = random_point_set(6000, side, gen);
+  for (auto &p : points)
+    b.insert(p.first, p.second);
+
+  std::vector<uint64_t> rows = {200, 3, 17, 3, 128, 127};
+  point_set expected;
+  for (uint64_t row : rows) {
+    struct vector_pair2dl_t single;
+    vector_pair2dl_t__init_vector(&single);
+    ASSERT_EQ(report_row(b.get_root(), row, b.get_qs(), &single),
+              SUCCESS_ECODE_K2T);
+    for (int i = 0; i < single.nof_items; i++)
+      expected.insert({single.data[i].col, single.data[i].row});
+    vector_pair2dl_t__free_vector(&single);
+  }
+
+  struct vector_pair2dl_t result;
+  vector_pair2dl_t__init_vector(&result);
+  ASSERT_EQ(report_rows(b.get_root(), rows.data(), rows.size(), b.get_qs(),
+                        &result),
+            SUCCESS_ECODE_K2T);
+  check_vector(&result, expected);
+  vector_pair2dl_t__free_vector(&result);
+}
@@ -0,0 +1,172 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+TEST(report_range_test, block_matches_brute_force) {
+  std::mt19937 gen(1234);
+  uint32_t treedepth = 10;
+  uint64_t side = 1UL << treedepth;
+  BlockWrapper b(treedepth, 128);
+
+  point_set points = random_point_set(3000, side, gen);
+  for (auto &p : points)
+    b.insert(p.first, p.second);
+
+  for (auto &r : random_rects(200, side, gen)) {
+    point_set expected = brute_force_range(points, r);
+
+    struct vector_pair2dl_t result;
+    vector_pair2dl_t__init_vector(&result);
+    ASSERT_EQ(report_range(b.get_root(), r.col_lo, r.col_hi, r.row_lo,
+                           r.row_hi, b.get_qs(), &result),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ((size_t)result.nof_items, expected.size());
+    ASSERT_EQ(as_set(&result), expected);
+    vector_pair2dl_t__free_vector(&result);
+
+    point_list reported;
+    ASSERT_EQ(report_range_interactively(b.get_root(), r.col_lo, r.col_hi,
+                                         r.row_lo, r.row_hi, b.get_qs(),
+                                         collect_point, &reported),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(reported.size(), expected.size());
+    ASSERT_EQ(point_set(reported.begin(), reported.end()), expected);
+
+    struct lazy_handler_report_range_t lh;
+    report_range_lazy_init(&lh, b.get_root(), b.get_qs(), r.col_lo, r.col_hi,
+                           r.row_lo, r.row_hi);
+    for (int pass = 0; pass < 2; pass++) {
+      point_set lazy_points;
+      size_t lazy_count = 0;
+      for (;;) {
+        int has_next;
+        report_range_has_next(&lh, &has_next);
+        if (!has_next)
+          break;
+        pair2dl_t p;
+        report_range_next(&lh, &p);
+        lazy_points.insert({p.col, p.row});
+        lazy_count++;
+      }
+      ASSERT_EQ(lazy_count, expected.size());
+      ASSERT_EQ(lazy_points, expected);
+      report_range_reset(&lh);
+    }
+    report_range_lazy_clean(&lh);
+  }
+}
+
+TEST(report_range_test, k2node_matches_brute_force) {
+  std::mt19937 gen(4321);
+  TREE_DEPTH_T treedepth = 16;
+  TREE_DEPTH_T cutdepth = 6;
+  uint64_t side = 1UL << treedepth;
+
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 255, cutdepth);
+  struct k2node *root_node = create_k2node();
+
+  point_set points = random_point_set(5000, side, gen);
+  for (auto &p : points) {
+    int already_exists;
+    ASSERT_EQ(k2node_insert_point(root_node, p.first, p.second, &st,
+                                  &already_exists),
+              SUCCESS_ECODE_K2T);
+  }
+
+  for (auto &r : random_rects(200, side, gen)) {
+    point_set expected = brute_force_range(points, r);
+
+    struct vector_pair2dl_t result;
+    vector_pair2dl_t__init_vector(&result);
+    ASSERT_EQ(k2node_report_range(root_node, r.col_lo, r.col_hi, r.row_lo,
+                                  r.row_hi, &st, &result),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ((size_t)result.nof_items, expected.size());
+    ASSERT_EQ(as_set(&result), expected);
+    vector_pair2dl_t__free_vector(&result);
+
+    point_list reported;
+    ASSERT_EQ(k2node_report_range_interactively(root_node, r.col_lo, r.col_hi,
+                                                r.row_lo, r.row_hi, &st,
+                                                collect_point, &reported),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(reported.size(), expected.size());
+    ASSERT_EQ(point_set(reported.begin(), reported.end()), expected);
+
+    struct k2node_lazy_handler_report_range_t lh;
+    k2node_report_range_lazy_init(&lh, root_node, &st, r.col_lo, r.col_hi,
+                                  r.row_lo, r.row_hi);
+    for (int pass = 0; pass < 2; pass++) {
+      point_set lazy_points;
+      size_t lazy_count = 0;
+      for (;;) {
+        int has_next;
+        k2node_report_range_has_next(&lh, &has_next);
+        if (!has_next)
+          break;
+        pair2dl_t p;
+        k2node_report_range_next(&lh, &p);
+        lazy_points.insert({p.col, p.row});
+        lazy_count++;
+      }
+      ASSERT_EQ(lazy_count, expected.size());
+      ASSERT_EQ(lazy_points, expected);
+      k2node_report_range_reset(&lh);
+    }
+    k2node_report_range_lazy_clean(&lh);
+  }
+
+  free_rec_k2node(root_node, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
+
+TEST(report_range_test, empty_tree_reports_nothing) {
+  BlockWrapper b(8);
+  struct vector_pair2dl_t result;
+  vector_pair2dl_t__init_vector(&result);
+  ASSERT_EQ(report_range(b.get_root(), 0, 255, 0, 255, b.get_qs(), &result),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(result.nof_items, 0);
+  vector_pair2dl_t__free_vector(&result);
+
+  struct lazy_handler_report_range_t lh;
+  report_range_lazy_init(&lh, b.get_root(), b.get_qs(), 0, 255, 0, 255);
+  int has_next;
+  report_range_has_next(&lh, &has_next);
+  ASSERT_FALSE(has_next);
+  report_range_lazy_clean(&lh);
+}
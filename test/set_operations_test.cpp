@@ -0,0 +1,240 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <morton_code.h>
+#include <queries_state.h>
+}
+
+#include "block_wrapper.hpp"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using point_t = std::pair<uint64_t, uint64_t>;
+
+/* Two overlapping sets: a shared dense region, plus points of their own */
+static void random_sets(std::set<point_t> &lhs, std::set<point_t> &rhs,
+                        uint64_t side) {
+  std::mt19937_64 gen(1357);
+  std::uniform_int_distribution<uint64_t> dense(0, 255);
+  std::uniform_int_distribution<uint64_t> sparse(0, side - 1);
+  for (int i = 0; i < 4000; i++) {
+    point_t shared = {dense(gen), dense(gen)};
+    if (i % 3 != 0)
+      lhs.insert(shared);
+    if (i % 3 != 1)
+      rhs.insert(shared);
+    lhs.emplace(sparse(gen), sparse(gen));
+    rhs.emplace(sparse(gen), dense(gen));
+  }
+}
+
+static std::vector<point_t> expected_result(const std::set<point_t> &lhs,
+                                            const std::set<point_t> &rhs,
+                                            set_operation_t operation) {
+  std::vector<point_t> result;
+  switch (operation) {
+  case SET_UNION:
+    std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                   std::back_inserter(result));
+    break;
+  case SET_INTERSECTION:
+    std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                          std::back_inserter(result));
+    break;
+  case SET_DIFFERENCE:
+    std::set_difference(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                        std::back_inserter(result));
+    break;
+  }
+  return result;
+}
+
+static void expect_morton_order(const std::vector<point_t> &points) {
+  for (size_t i = 1; i < points.size(); i++) {
+    pair2dl_t previous = {points[i - 1].first, points[i - 1].second};
+    pair2dl_t current = {points[i].first, points[i].second};
+    ASSERT_LT(compare_points_morton_order(&previous, &current), 0);
+  }
+}
+
+static const set_operation_t all_operations[] = {SET_UNION, SET_INTERSECTION,
+                                                 SET_DIFFERENCE};
+
+TEST(set_operations_test, block_set_operations) {
+  const TREE_DEPTH_T treedepth = 16;
+  std::set<point_t> lhs_points, rhs_points;
+  random_sets(lhs_points, rhs_points, 1UL << treedepth);
+
+  BlockWrapper lhs(treedepth, 256);
+  BlockWrapper rhs(treedepth, 256);
+  for (auto &p : lhs_points)
+    lhs.insert(p.first, p.second);
+  for (auto &p : rhs_points)
+    rhs.insert(p.first, p.second);
+
+  for (auto operation : all_operations) {
+    auto expected = expected_result(lhs_points, rhs_points, operation);
+
+    std::vector<point_t> reported;
+    ASSERT_EQ(k2tree_set_operation_interactively(lhs.get_root(),
+                                                 rhs.get_root(), operation,
+                                                 lhs.get_qs(), collect_point,
+                                                 &reported),
+              SUCCESS_ECODE_K2T);
+    expect_morton_order(reported);
+    std::sort(reported.begin(), reported.end());
+    ASSERT_EQ(reported, expected);
+
+    struct block *result = nullptr;
+    int err = operation == SET_UNION ? k2tree_union(lhs.get_root(),
+                                                    rhs.get_root(),
+                                                    lhs.get_qs(), &result)
+              : operation == SET_INTERSECTION
+                  ? k2tree_intersect(lhs.get_root(), rhs.get_root(),
+                                     lhs.get_qs(), &result)
+                  : k2tree_difference(lhs.get_root(), rhs.get_root(),
+                                      lhs.get_qs(), &result);
+    ASSERT_EQ(err, SUCCESS_ECODE_K2T);
+
+    struct vector_pair2dl_t scanned;
+    vector_pair2dl_t__init_vector(&scanned);
+    naive_scan_points(result, lhs.get_qs(), &scanned);
+    std::vector<point_t> built;
+    for (long i = 0; i < scanned.nof_items; i++)
+      built.emplace_back(scanned.data[i].col, scanned.data[i].row);
+    std::sort(built.begin(), built.end());
+    ASSERT_EQ(built, expected);
+
+    uint64_t count;
+    count_points(result, lhs.get_qs(), &count);
+    ASSERT_EQ(count, expected.size());
+
+    vector_pair2dl_t__free_vector(&scanned);
+    free_rec_block(result);
+  }
+}
+
+TEST(set_operations_test, block_set_operations_with_empty_and_same_tree) {
+  const TREE_DEPTH_T treedepth = 12;
+  BlockWrapper full(treedepth, 64);
+  BlockWrapper empty(treedepth, 64);
+  std::vector<point_t> points;
+  for (uint64_t i = 0; i < 500; i++) {
+    full.insert(i * 7 % 4096, i * 13 % 4096);
+    points.emplace_back(i * 7 % 4096, i * 13 % 4096);
+  }
+  std::sort(points.begin(), points.end());
+
+  auto run = [&](struct block *lhs, struct block *rhs,
+                 set_operation_t operation) {
+    std::vector<point_t> reported;
+    EXPECT_EQ(k2tree_set_operation_interactively(lhs, rhs, operation,
+                                                 full.get_qs(), collect_point,
+                                                 &reported),
+              SUCCESS_ECODE_K2T);
+    std::sort(reported.begin(), reported.end());
+    return reported;
+  };
+
+  ASSERT_EQ(run(full.get_root(), empty.get_root(), SET_UNION), points);
+  ASSERT_EQ(run(empty.get_root(), full.get_root(), SET_UNION), points);
+  ASSERT_TRUE(run(full.get_root(), empty.get_root(), SET_INTERSECTION).empty());
+  ASSERT_EQ(run(full.get_root(), empty.get_root(), SET_DIFFERENCE), points);
+  ASSERT_TRUE(run(empty.get_root(), full.get_root(), SET_DIFFERENCE).empty());
+  ASSERT_EQ(run(full.get_root(), full.get_root(), SET_INTERSECTION), points);
+  ASSERT_TRUE(run(full.get_root(), full.get_root(), SET_DIFFERENCE).empty());
+
+  struct query_ctx ctx;
+  init_query_ctx(&ctx, treedepth, full.get_root());
+  std::vector<point_t> reported;
+  ASSERT_EQ(k2tree_set_operation_interactively(full.get_root(),
+                                               empty.get_root(), SET_UNION,
+                                               &ctx.qs, collect_point,
+                                               &reported),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(reported.size(), points.size());
+  struct block *result = nullptr;
+  ASSERT_EQ(k2tree_union(full.get_root(), empty.get_root(), &ctx.qs, &result),
+            READ_ONLY_QUERY_CONTEXT);
+  ASSERT_EQ(result, nullptr);
+  finish_query_ctx(&ctx);
+}
+
+TEST(set_operations_test, k2node_set_operations) {
+  const TREE_DEPTH_T treedepth = 16;
+  std::set<point_t> lhs_points, rhs_points;
+  random_sets(lhs_points, rhs_points, 1UL << treedepth);
+
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 256, 5);
+  struct k2node *lhs = create_k2node();
+  struct k2node *rhs = create_k2node();
+  int already_exists;
+  for (auto &p : lhs_points)
+    k2node_insert_point(lhs, p.first, p.second, &st, &already_exists);
+  for (auto &p : rhs_points)
+    k2node_insert_point(rhs, p.first, p.second, &st, &already_exists);
+
+  for (auto operation : all_operations) {
+    auto expected = expected_result(lhs_points, rhs_points, operation);
+
+    std::vector<point_t> reported;
+    ASSERT_EQ(k2node_set_operation_interactively(lhs, rhs, operation, &st,
+                                                 collect_point, &reported),
+              SUCCESS_ECODE_K2T);
+    expect_morton_order(reported);
+    std::sort(reported.begin(), reported.end());
+    ASSERT_EQ(reported, expected);
+
+    struct k2node *result = nullptr;
+    int err = operation == SET_UNION ? k2node_union(lhs, rhs, &st, &result)
+              : operation == SET_INTERSECTION
+                  ? k2node_intersect(lhs, rhs, &st, &result)
+                  : k2node_difference(lhs, rhs, &st, &result);
+    ASSERT_EQ(err, SUCCESS_ECODE_K2T);
+
+    std::vector<point_t> built;
+    k2node_scan_points_interactively(result, &st, collect_point, &built);
+    std::sort(built.begin(), built.end());
+    ASSERT_EQ(built, expected);
+
+    uint64_t count;
+    k2node_count_points(result, &st, &count);
+    ASSERT_EQ(count, expected.size());
+
+    free_rec_k2node(result, 0, st.cut_depth);
+  }
+
+  free_rec_k2node(lhs, 0, st.cut_depth);
+  free_rec_k2node(rhs, 0, st.cut_depth);
+  clean_k2qstate(&st);
+}
@@ -0,0 +1,304 @@
+/*
+MIT License
+
+Copyright (c) 2020 Cristobal Miranda T.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C" {
+#include <block.h>
+#include <k2node.h>
+#include <queries_state.h>
+#include <snapshot.h>
+}
+
+#include "block_wrapper.hpp"
+
+static std::string temp_snapshot_path(int *fd) {
+  char path[] = "/tmp/k2dyn_snapshot_XXXXXX";
+  *fd = mkstemp(path);
+  return path;
+}
+
+/* Saves a block tree whose root has children, checks the file loads, and
+ * checks it is rejected once patch rewrites the record of the root */
+template <typename F> static void expect_rejected_after(F patch) {
+  std::mt19937 gen(11);
+  uint32_t treedepth = 12;
+  BlockWrapper b(treedepth, 64);
+  for (auto &p : random_points(200, 1UL << treedepth, gen))
+    b.insert(p.col, p.row);
+  ASSERT_GT(b.get_root()->children, 1U);
+
+  int fd;
+  std::string path = temp_snapshot_path(&fd);
+  ASSERT_EQ(k2tree_save(b.get_root(), treedepth, fd), SUCCESS_ECODE_K2T);
+  struct k2tree_snapshot snapshot;
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot), SUCCESS_ECODE_K2T);
+  k2tree_snapshot_close(&snapshot);
+
+  struct snapshot_block_record record;
+  off_t offset = sizeof(struct snapshot_header);
+  ASSERT_EQ(pread(fd, &record, sizeof(record), offset),
+            (ssize_t)sizeof(record));
+  patch(fd, record);
+  ASSERT_EQ(pwrite(fd, &record, sizeof(record), offset),
+            (ssize_t)sizeof(record));
+  close(fd);
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot),
+            SNAPSHOT_INVALID_FORMAT);
+  unlink(path.c_str());
+}
+
+TEST(snapshot_test, block_tree_roundtrip) {
+  std::mt19937 gen(3);
+  uint32_t treedepth = 14;
+  BlockWrapper b(treedepth, 64);
+  auto points = random_points(4000, 1UL << treedepth, gen);
+  for (auto &p : points)
+    b.insert(p.col, p.row);
+
+  int fd;
+  std::string path = temp_snapshot_path(&fd);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(k2tree_save(b.get_root(), treedepth, fd), SUCCESS_ECODE_K2T);
+  close(fd);
+
+  struct k2tree_snapshot snapshot;
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot), SUCCESS_ECODE_K2T);
+  ASSERT_NE(snapshot.root_block, nullptr);
+  ASSERT_EQ(snapshot.root_node, nullptr);
+  ASSERT_EQ(snapshot.treedepth, treedepth);
+
+  struct query_ctx ctx;
+  ASSERT_EQ(init_query_ctx(&ctx, treedepth, snapshot.root_block),
+            SUCCESS_ECODE_K2T);
+  for (auto &p : points) {
+    int result;
+    ASSERT_EQ(has_point(snapshot.root_block, p.col, p.row, &ctx.qs, &result),
+              SUCCESS_ECODE_K2T);
+    ASSERT_TRUE(result);
+    int expected;
+    has_point(b.get_root(), p.col ^ 1, p.row, b.get_qs(), &expected);
+    ASSERT_EQ(has_point(snapshot.root_block, p.col ^ 1, p.row, &ctx.qs,
+                        &result),
+              SUCCESS_ECODE_K2T);
+    ASSERT_EQ(result, expected);
+  }
+
+  uint64_t in_range = 0;
+  ASSERT_EQ(report_range_interactively(snapshot.root_block, 100, 9000, 200,
+                                       7000, &ctx.qs, count_point, &in_range),
+            SUCCESS_ECODE_K2T);
+  uint64_t expected_in_range = 0;
+  for (auto &p : points)
+    expected_in_range +=
+        p.col >= 100 && p.col <= 9000 && p.row >= 200 && p.row <= 7000;
+  ASSERT_EQ(in_range, expected_in_range);
+  uint64_t count;
+  ASSERT_EQ(count_range(snapshot.root_block, 100, 9000, 200, 7000, &ctx.qs,
+                        &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, expected_in_range);
+  ASSERT_EQ(count_points(snapshot.root_block, &ctx.qs, &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, points.size());
+
+  finish_query_ctx(&ctx);
+  ASSERT_EQ(k2tree_snapshot_close(&snapshot), SUCCESS_ECODE_K2T);
+  unlink(path.c_str());
+}
+
+TEST(snapshot_test, k2node_tree_roundtrip) {
+  std::mt19937 gen(4);
+  uint32_t treedepth = 16;
+  uint32_t cutdepth = 6;
+  struct k2qstate st;
+  init_k2qstate(&st, treedepth, 64, cutdepth);
+  struct k2node *root = create_k2node();
+  auto points = random_points(6000, 1UL << treedepth, gen);
+  for (auto &p : points) {
+    int already_exists;
+    k2node_insert_point(root, p.col, p.row, &st, &already_exists);
+  }
+
+  int fd;
+  std::string path = temp_snapshot_path(&fd);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(k2tree_save_k2node(root, treedepth, cutdepth, fd),
+            SUCCESS_ECODE_K2T);
+  close(fd);
+
+  struct k2tree_snapshot snapshot;
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot), SUCCESS_ECODE_K2T);
+  ASSERT_NE(snapshot.root_node, nullptr);
+  ASSERT_EQ(snapshot.cut_depth, cutdepth);
+
+  struct k2qstate reader_st;
+  init_k2qstate_read_only(&reader_st, treedepth, cutdepth);
+  for (auto &p : points) {
+    int result;
+    ASSERT_EQ(k2node_has_point(snapshot.root_node, p.col, p.row, &reader_st,
+                               &result),
+              SUCCESS_ECODE_K2T);
+    ASSERT_TRUE(result);
+    int expected;
+    k2node_has_point(root, p.col, p.row ^ 1, &st, &expected);
+    k2node_has_point(snapshot.root_node, p.col, p.row ^ 1, &reader_st,
+                     &result);
+    ASSERT_EQ(result, expected);
+  }
+
+  uint64_t all_points = 0;
+  ASSERT_EQ(k2node_report_range_interactively(
+                snapshot.root_node, 0, UINT64_MAX, 0, UINT64_MAX, &reader_st,
+                count_point, &all_points),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(all_points, points.size());
+  uint64_t count;
+  ASSERT_EQ(k2node_count_points(snapshot.root_node, &reader_st, &count),
+            SUCCESS_ECODE_K2T);
+  ASSERT_EQ(count, points.size());
+
+  int already_exists;
+  ASSERT_EQ(k2node_insert_point(snapshot.root_node, 1, 1, &reader_st,
+                                &already_exists),
+            READ_ONLY_QUERY_CONTEXT);
+
+  clean_k2qstate(&reader_st);
+  ASSERT_EQ(k2tree_snapshot_close(&snapshot), SUCCESS_ECODE_K2T);
+  free_rec_k2node(root, 0, st.cut_depth);
+  clean_k2qstate(&st);
+  unlink(path.c_str());
+}
+
+TEST(snapshot_test, empty_trees_roundtrip) {
+  BlockWrapper b(10, 64);
+  int fd;
+  std::string path = temp_snapshot_path(&fd);
+  ASSERT_EQ(k2tree_save(b.get_root(), 10, fd), SUCCESS_ECODE_K2T);
+  close(fd);
+
+  struct k2tree_snapshot snapshot;
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot), SUCCESS_ECODE_K2T);
+  struct query_ctx ctx;
+  init_query_ctx(&ctx, 10, snapshot.root_block);
+  int result;
+  ASSERT_EQ(has_point(snapshot.root_block, 3, 4, &ctx.qs, &result),
+            SUCCESS_ECODE_K2T);
+  ASSERT_FALSE(result);
+  finish_query_ctx(&ctx);
+  k2tree_snapshot_close(&snapshot);
+
+  struct k2node *root = create_k2node();
+  fd = open(path.c_str(), O_WRONLY | O_TRUNC);
+  ASSERT_EQ(k2tree_save_k2node(root, 10, 4, fd), SUCCESS_ECODE_K2T);
+  close(fd);
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot), SUCCESS_ECODE_K2T);
+  struct k2qstate reader_st;
+  init_k2qstate_read_only(&reader_st, 10, 4);
+  ASSERT_EQ(k2node_has_point(snapshot.root_node, 3, 4, &reader_st, &result),
+            SUCCESS_ECODE_K2T);
+  ASSERT_FALSE(result);
+  clean_k2qstate(&reader_st);
+  k2tree_snapshot_close(&snapshot);
+  free_rec_k2node(root, 0, 4);
+  unlink(path.c_str());
+}
+
+TEST(snapshot_test, rejects_invalid_files) {
+  BlockWrapper b(10, 64);
+  b.insert(3, 4);
+  b.insert(500, 7);
+  int fd;
+  std::string path = temp_snapshot_path(&fd);
+  ASSERT_EQ(k2tree_save(b.get_root(), 10, fd), SUCCESS_ECODE_K2T);
+  close(fd);
+
+  struct k2tree_snapshot snapshot;
+  ASSERT_EQ(k2tree_load_mmap("/nonexistent/k2dyn_snapshot", &snapshot),
+            SNAPSHOT_IO_ERROR);
+
+  /* wrong version */
+  fd = open(path.c_str(), O_RDWR);
+  uint32_t bad_version = SNAPSHOT_VERSION + 1;
+  ASSERT_EQ(pwrite(fd, &bad_version, sizeof(bad_version),
+                   offsetof(struct snapshot_header, version)),
+            (ssize_t)sizeof(bad_version));
+  close(fd);
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot),
+            SNAPSHOT_INVALID_FORMAT);
+
+  /* truncated */
+  fd = open(path.c_str(), O_RDWR | O_TRUNC);
+  ASSERT_EQ(k2tree_save(b.get_root(), 10, fd), SUCCESS_ECODE_K2T);
+  off_t full_size = lseek(fd, 0, SEEK_END);
+  ASSERT_EQ(ftruncate(fd, full_size - 4), 0);
+  close(fd);
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot),
+            SNAPSHOT_INVALID_FORMAT);
+
+  /* not a snapshot */
+  fd = open(path.c_str(), O_RDWR | O_TRUNC);
+  std::vector<char> garbage(256, 'x');
+  ASSERT_EQ(write(fd, garbage.data(), garbage.size()),
+            (ssize_t)garbage.size());
+  close(fd);
+  ASSERT_EQ(k2tree_load_mmap(path.c_str(), &snapshot),
+            SNAPSHOT_INVALID_FORMAT);
+  unlink(path.c_str());
+}
+
+TEST(snapshot_test, rejects_children_stored_before_their_parent) {
+  expect_rejected_after([](int, struct snapshot_block_record &record) {
+    record.first_child = 0;
+  });
+}
+
+TEST(snapshot_test, rejects_preorders_past_the_block) {
+  expect_rejected_after([](int fd, struct snapshot_block_record &record) {
+    NODES_BV_T preorder = (NODES_BV_T)record.nodes_count;
+    off_t last = (off_t)(record.preorders_offset +
+                         (record.children - 1) * sizeof(NODES_BV_T));
+    ASSERT_EQ(pwrite(fd, &preorder, sizeof(preorder), last),
+              (ssize_t)sizeof(preorder));
+  });
+}
+
+TEST(snapshot_test, rejects_unsorted_preorders) {
+  expect_rejected_after([](int fd, struct snapshot_block_record &record) {
+    NODES_BV_T preorders[2];
+    off_t first = (off_t)record.preorders_offset;
+    ASSERT_EQ(pread(fd, preorders, sizeof(preorders), first),
+              (ssize_t)sizeof(preorders));
+    std::swap(preorders[0], preorders[1]);
+    ASSERT_EQ(pwrite(fd, preorders, sizeof(preorders), first),
+              (ssize_t)sizeof(preorders));
+  });
+}